@@ -118,6 +118,8 @@ qerror_t FS_RenameFile(const char *from, const char *to);
 
 qerror_t FS_CreatePath(char *path);
 
+void    FS_InvalidatePathCache(void);
+
 char    *FS_CopyExtraInfo(const char *name, const file_info_t *info);
 
 ssize_t FS_FOpenFile(const char *filename, qhandle_t *f, unsigned mode);
@@ -143,6 +145,31 @@ ssize_t FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t
 // a NULL buffer will just return the file length without loading
 // length < 0 indicates error
 
+// priority classes for asynchronous loads, lower values are read first
+typedef enum {
+    FS_PRIORITY_WORLD,
+    FS_PRIORITY_MODEL,
+    FS_PRIORITY_IMAGE,
+    FS_PRIORITY_SOUND,
+    FS_PRIORITY_LOW,
+
+    FS_PRIORITY_MAX
+} fs_priority_t;
+
+// receives ownership of the buffer, which is NULL if len < 0
+typedef void (*fs_async_callback_t)(const char *path, void *buffer, ssize_t len, void *arg);
+
+qhandle_t FS_LoadFileAsync(const char *path, unsigned flags, fs_priority_t priority,
+                           fs_async_callback_t callback, void *arg);
+ssize_t FS_WaitFileAsync(qhandle_t handle, void **buffer);
+qboolean FS_PrefetchFile(const char *path, fs_priority_t priority);
+void    FS_RunAsyncLoads(void);
+void    FS_FlushAsyncLoads(void);
+
+ssize_t FS_MapFile(const char *path, const void **buffer, unsigned flags);
+void    FS_UnmapFile(const void *buffer);
+// read-only view of binary file contents, not NUL terminated
+
 qerror_t FS_WriteFile(const char *path, const void *data, size_t len);
 
 qboolean FS_EasyWriteFile(char *buf, size_t size, unsigned mode,
@@ -170,6 +197,8 @@ qboolean FS_ExtCmp(const char *extension, const char *string);
 qerror_t FS_LastModified(char const * file, uint64_t * last_modified);
 
 void    **FS_ListFiles(const char *path, const char *filter, unsigned flags, int *count_p);
+void    **FS_ListFilesView(const char *path, const char *filter, unsigned flags, int *count_p);
+void    FS_ReleaseListing(void **view);
 void    **FS_CopyList(void **list, int count);
 file_info_t *FS_CopyInfo(const char *name, size_t size, time_t ctime, time_t mtime);
 void    FS_FreeList(void **list);
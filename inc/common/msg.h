@@ -145,6 +145,14 @@ void    MSG_ReadDeltaClientMoveCommand(const ClientMoveCommand* from, ClientMove
 int     MSG_ParseEntityBits(int* bits);
 void    MSG_ParseDeltaEntity(const EntityState* from, EntityState* to, int number, int bits, EntityStateMessageFlags flags);
 #if USE_CLIENT
+// Largest possible entity header plus delta: 4 bytes of bits, a 16 bit
+// number, and every field at its widest encoding.
+#define MAX_ENTITY_DELTA_BYTES  67
+
+int     MSG_ParseEntityBitsUnchecked(int* bits);
+void    MSG_ParseDeltaEntityUnchecked(const EntityState* from, EntityState* to, int number, int bits, EntityStateMessageFlags flags);
+#endif
+#if USE_CLIENT
 void    MSG_ParseDeltaPlayerstate(const PlayerState* from, PlayerState* to, int flags, int extraflags);
 #endif
 
@@ -0,0 +1,62 @@
+/*
+Copyright (C) 1997-2001 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation; either version 2 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with this program; if not, write to the Free Software Foundation, Inc.,
+51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+*/
+
+#ifndef FORMAT_PKX_H
+#define FORMAT_PKX_H
+
+/*
+========================================================================
+
+The .pkx files are indexed packs meant to be memory mapped. Every file
+starts on a page boundary. The directory at the end of the pack is
+sorted by name, with names already normalized, and includes the hash
+table used for lookups, so mounting requires no parsing of entries.
+
+Layout: header, page aligned file data, then at a page boundary the
+directory: dpkxfile_t[numfiles], uint32_t[hashsize], names.
+
+========================================================================
+*/
+
+#define IDPKXHEADER         (('X'<<24)+('K'<<16)+('P'<<8)+'I')
+#define PKX_VERSION         1
+
+#define PKX_PAGESIZE        4096
+
+#define MAX_FILES_IN_PKX    0x100000
+
+typedef struct {
+    uint32_t    nameofs;    // offset into names, NUL terminated
+    uint32_t    namelen;
+    uint32_t    hashnext;   // index + 1 of next file in hash chain, 0 ends chain
+    uint32_t    filepage;   // offset of file data in PKX_PAGESIZE units
+    uint32_t    filelen;
+    uint32_t    complen;    // raw deflate length, 0 if stored
+    uint32_t    crc;        // crc32 of uncompressed data
+} dpkxfile_t;
+
+typedef struct {
+    uint32_t    ident;      // == IDPKXHEADER
+    uint32_t    version;    // == PKX_VERSION
+    uint32_t    numfiles;
+    uint32_t    hashsize;   // power of two, buckets hold index + 1 of first file
+    uint32_t    dirpage;    // offset of directory in PKX_PAGESIZE units
+    uint32_t    nameslen;
+} dpkxheader_t;
+
+#endif // FORMAT_PKX_H
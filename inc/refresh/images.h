@@ -119,6 +119,14 @@ image_t *IMG_ForHandle(qhandle_t h);
 
 qerror_t IMG_GetDimensions(const char* name, int* width, int* height);
 
+#if USE_REF == REF_VKPT
+typedef void (*imgpostfunc_t)(image_t *image, int arg);
+
+void IMG_BeginBatch(void);
+void IMG_EndBatch(void);
+qboolean IMG_QueuePostProcess(image_t *image, const char *name, imgpostfunc_t func, int arg);
+#endif
+
 void IMG_ResampleTexture(const byte *in, int inwidth, int inheight,
                          byte *out, int outwidth, int outheight);
 void IMG_MipMap(byte *out, byte *in, int width, int height);
@@ -161,8 +161,6 @@ typedef struct cl_sustain_s {
 #define INSTANT_PARTICLE    -10000.0
 
 typedef struct cparticle_s {
-    struct cparticle_s    *next;
-
     float   time;
 
     vec3_t  org;
@@ -200,6 +200,12 @@ typedef struct {
     void (*AddCommandString)(const char *text);
 
     void (*DebugGraph)(float value, int color);
+
+    // savegames are serialized into memory by the game, the server compresses
+    // and writes them out in the background. ReadSaveFile waits for pending
+    // writes and returns a buffer to be freed with TagFree.
+    void (*WriteSaveFile)(const char *filename, const void *data, size_t len);
+    ssize_t (*ReadSaveFile)(const char *filename, void **data);
 } ServerGameImports;
 
 //
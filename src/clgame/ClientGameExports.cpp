@@ -41,6 +41,10 @@ void ClientGameExports::ClientClearState() {
     // Clear Effects.
     CLG_ClearEffects();
 
+    // Forget about predicted movement.
+    CLG_ClearPrediction();
+    CLG_ClearSolidBroadphase();
+
     // WID: TODO: I think this #ifdef can go lol.
 #if USE_LIGHTSTYLES
     CLG_ClearLightStyles();
@@ -167,6 +171,9 @@ void ClientGameExports::ClientBegin() {
 void ClientGameExports::ClientDeltaFrame() {
     // Called each time a valid client frame has been 
     SCR_SetCrosshairColor();
+
+    // Sort out the solid entities for prediction traces.
+    CLG_BuildSolidBroadphase();
 }
 
 //---------------
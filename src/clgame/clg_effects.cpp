@@ -7,6 +7,9 @@
 // Contains code for all special effects, simple steam leaking particles to
 // awesome big banging explosions!
 //
+#include <algorithm>
+#include <chrono>
+
 #include "clg_local.h"
 
 #include "clg_effects.h"
@@ -19,10 +22,49 @@ static void CLG_LogoutEffect(vec3_t org, int type);
 
 static vec3_t avelocities[NUMVERTEXNORMALS];
 
-static cparticle_t* active_particles, * free_particles;
-
-static cparticle_t  particles[MAX_PARTICLES];
-static const int    cl_numparticles = MAX_PARTICLES;
+//
+// Live particles, kept as a structure of arrays so that CLG_AddParticles
+// can evaluate them in tight loops the compiler turns into SIMD code. Dead
+// particles are removed by moving the last one into their slot.
+//
+// Effects don't write into the pool directly. They fill in cparticle_t
+// records handed out by CLG_AllocParticles, which are moved into the pool
+// by the next CLG_FinishParticles.
+//
+static struct {
+    int32_t numParticles;
+
+    alignas(16) float time[MAX_PARTICLES];
+    alignas(16) float timeScale[MAX_PARTICLES];    // Milliseconds to seconds, 0 for instant particles.
+    alignas(16) float orgX[MAX_PARTICLES];
+    alignas(16) float orgY[MAX_PARTICLES];
+    alignas(16) float orgZ[MAX_PARTICLES];
+    alignas(16) float velX[MAX_PARTICLES];
+    alignas(16) float velY[MAX_PARTICLES];
+    alignas(16) float velZ[MAX_PARTICLES];
+    alignas(16) float accelX[MAX_PARTICLES];
+    alignas(16) float accelY[MAX_PARTICLES];
+    alignas(16) float accelZ[MAX_PARTICLES];
+    alignas(16) float alpha[MAX_PARTICLES];
+    alignas(16) float alphaVelocity[MAX_PARTICLES];
+    float   brightness[MAX_PARTICLES];
+    int32_t color[MAX_PARTICLES];
+    color_t rgba[MAX_PARTICLES];
+
+    // Results of the evaluation pass.
+    alignas(16) float evalAlpha[MAX_PARTICLES];
+    alignas(16) float evalX[MAX_PARTICLES];
+    alignas(16) float evalY[MAX_PARTICLES];
+    alignas(16) float evalZ[MAX_PARTICLES];
+} particlePool;
+
+// Particles spawned since the last CLG_AddParticles.
+static cparticle_t  spawnedParticles[MAX_PARTICLES];
+static int32_t      numSpawnedParticles;
+
+// Output of CLG_SimulateParticles, added to the view by CLG_FinishParticles.
+static rparticle_t  simulatedParticles[MAX_PARTICLES];
+static int32_t      numSimulatedParticles;
 
 static void CLG_ClearParticles(void);
 #if USE_DLIGHTS
@@ -502,37 +544,46 @@ void CLG_MuzzleFlash2() {
 //
 static void CLG_ClearParticles(void)
 {
-    int     i;
-
-    free_particles = &particles[0];
-    active_particles = NULL;
-
-    for (i = 0; i < cl_numparticles; i++)
-        particles[i].next = &particles[i + 1];
-    particles[cl_numparticles - 1].next = NULL;
+    particlePool.numParticles = 0;
+    numSpawnedParticles = 0;
+    numSimulatedParticles = 0;
 }
 
 //
 //===============
-// CLG_AllocParticle
+// CLG_AllocParticles
 // 
-// Allocate a new particle, if there is room.s
+// Allocates count consecutive particles, cleared to zero. Returns NULL if
+// there isn't room for all of them.
 //===============
 //
-cparticle_t* CLG_AllocParticle(void)
+cparticle_t* CLG_AllocParticles(int count)
 {
     cparticle_t* p;
 
-    if (!free_particles)
+    count = Maxi(count, 0);
+    if (particlePool.numParticles + numSpawnedParticles + count > MAX_PARTICLES)
         return NULL;
-    p = free_particles;
-    free_particles = p->next;
-    p->next = active_particles;
-    active_particles = p;
+
+    p = &spawnedParticles[numSpawnedParticles];
+    numSpawnedParticles += count;
+    std::fill_n(p, count, cparticle_t{});
 
     return p;
 }
 
+//
+//===============
+// CLG_AllocParticle
+// 
+// Allocate a new particle, if there is room.
+//===============
+//
+cparticle_t* CLG_AllocParticle(void)
+{
+    return CLG_AllocParticles(1);
+}
+
 //
 //===============
 // CLG_ParticleEffect
@@ -563,11 +614,11 @@ void CLG_ParticleEffect(vec3_t org, vec3_t dir, int color, int count)
     const float spark_base_velocity = 50.0f;
     const float spark_rand_velocity = 130.0f;
 
-    for (int i = 0; i < count; i++) {
-        cparticle_t* p = CLG_AllocParticle();
-        if (!p)
-            return;
+    cparticle_t* p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (int i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = color + (rand() & 7);
@@ -592,11 +643,11 @@ void CLG_ParticleEffect(vec3_t org, vec3_t dir, int color, int count)
         p->alphavel = -1.0 / (0.5 + frand() * 0.3);
     }
 
-    for (int i = 0; i < spark_count; i++) {
-        cparticle_t* p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(spark_count);
+    if (!p)
+        return;
 
+    for (int i = 0; i < spark_count; i++, p++) {
         p->time = cl->time;
 
         p->color = 0xe0 + (rand() & 7);
@@ -639,11 +690,11 @@ void CLG_ParticleEffectWaterSplash(vec3_t org, vec3_t dir, int color, int count)
     const float water_base_velocity = 80.0f;
     const float water_rand_velocity = 150.0f;
 
-    for (int i = 0; i < count; i++) {
-        cparticle_t* p = CLG_AllocParticle();
-        if (!p)
-            return;
+    cparticle_t* p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (int i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = color + (rand() & 7);
@@ -695,11 +746,11 @@ void CLG_BloodParticleEffect(vec3_t org, vec3_t dir, int color, int count)
 
     count *= cl_particle_num_factor->value;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = color + (rand() & 7);
@@ -738,11 +789,11 @@ void CLG_ParticleEffect2(vec3_t org, vec3_t dir, int color, int count)
 
     count *= cl_particle_num_factor->value;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = color;
@@ -775,11 +826,11 @@ void CLG_TeleporterParticles(vec3_t org)
 
     const int count = 8 * cl_particle_num_factor->value;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = 0xdb;
@@ -813,11 +864,11 @@ static void CLG_LogoutEffect(vec3_t org, int type)
     int         i, j;
     cparticle_t* p;
 
-    for (i = 0; i < 500; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(500);
+    if (!p)
+        return;
 
+    for (i = 0; i < 500; i++, p++) {
         p->time = cl->time;
 
         int color;
@@ -860,11 +911,11 @@ void CLG_ItemRespawnParticles(vec3_t org)
 
     const int count = 64 * cl_particle_num_factor->value;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = 0xd4 + (rand() & 3); // green
@@ -898,11 +949,11 @@ void CLG_ExplosionParticles(vec3_t org)
 
     const int count = 256 * cl_particle_num_factor->value;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = 0xe0 + (rand() & 7);
@@ -933,11 +984,11 @@ void CLG_BigTeleportParticles(vec3_t org)
     cparticle_t* p;
     float       angle, dist;
 
-    for (i = 0; i < 4096; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(4096);
+    if (!p)
+        return;
 
+    for (i = 0; i < 4096; i++, p++) {
         p->time = cl->time;
 
         p->color = colortable[rand() & 3];
@@ -978,11 +1029,11 @@ void CLG_BlasterParticles(vec3_t org, vec3_t dir)
 
     const int count = 400 * cl_particle_num_factor->value;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
 
         p->color = 0xe0 + (rand() & 7);
@@ -1229,77 +1280,245 @@ void CLG_TeleportParticles(vec3_t org)
 
 /*
 ===============
-CLG_AddParticles
+CLG_MoveParticle
+
+Moves a particle of the pool into another slot, for swap-removal.
 ===============
 */
-void CLG_AddParticles(void)
+static inline void CLG_MoveParticle(int32_t from, int32_t to)
 {
-    cparticle_t* p, * next;
+    particlePool.time[to] = particlePool.time[from];
+    particlePool.timeScale[to] = particlePool.timeScale[from];
+    particlePool.orgX[to] = particlePool.orgX[from];
+    particlePool.orgY[to] = particlePool.orgY[from];
+    particlePool.orgZ[to] = particlePool.orgZ[from];
+    particlePool.velX[to] = particlePool.velX[from];
+    particlePool.velY[to] = particlePool.velY[from];
+    particlePool.velZ[to] = particlePool.velZ[from];
+    particlePool.accelX[to] = particlePool.accelX[from];
+    particlePool.accelY[to] = particlePool.accelY[from];
+    particlePool.accelZ[to] = particlePool.accelZ[from];
+    particlePool.alpha[to] = particlePool.alpha[from];
+    particlePool.alphaVelocity[to] = particlePool.alphaVelocity[from];
+    particlePool.brightness[to] = particlePool.brightness[from];
+    particlePool.color[to] = particlePool.color[from];
+    particlePool.rgba[to] = particlePool.rgba[from];
+
+    particlePool.evalAlpha[to] = particlePool.evalAlpha[from];
+    particlePool.evalX[to] = particlePool.evalX[from];
+    particlePool.evalY[to] = particlePool.evalY[from];
+    particlePool.evalZ[to] = particlePool.evalZ[from];
+}
+
+/*
+===============
+CLG_EvaluateParticles
+
+Evaluates the pool particles first to n - 1 at the current time, removes
+the faded out ones and writes the others to out, up to MAX_PARTICLES.
+Returns the new end of the range.
+===============
+*/
+static int32_t CLG_EvaluateParticles(int32_t first, int32_t n, rparticle_t* out, int32_t* numOut)
+{
+    int32_t         i;
     float           alpha;
-    float           time = 0, time2;
-    int             color;
-    cparticle_t* active, * tail;
-    rparticle_t* part;
-
-    active = NULL;
-    tail = NULL;
-
-    for (p = active_particles; p; p = next) {
-        next = p->next;
-
-        if (p->alphavel != INSTANT_PARTICLE) {
-            time = (cl->time - p->time) * 0.001;
-            alpha = p->alpha + time * p->alphavel;
-            if (alpha <= 0) {
-                // faded out
-                p->next = free_particles;
-                free_particles = p;
-                continue;
+    rparticle_t*    part;
+
+    // Evaluate alpha and origin of all particles. This loop is kept free of
+    // branches and calls, so that the compiler can vectorize it. Instant
+    // particles have their time scaled to zero, which keeps their alpha.
+    const float now = cl->time;
+    for (i = first; i < n; i++) {
+        const float time = (now - particlePool.time[i]) * particlePool.timeScale[i];
+        const float time2 = time * time;
+
+        particlePool.evalAlpha[i] = particlePool.alpha[i] + time * particlePool.alphaVelocity[i];
+        particlePool.evalX[i] = particlePool.orgX[i] + particlePool.velX[i] * time + particlePool.accelX[i] * time2;
+        particlePool.evalY[i] = particlePool.orgY[i] + particlePool.velY[i] * time + particlePool.accelY[i] * time2;
+        particlePool.evalZ[i] = particlePool.orgZ[i] + particlePool.velZ[i] * time + particlePool.accelZ[i] * time2;
+    }
+
+    // Remove faded out particles and hand the rest to the renderer.
+    for (i = first; i < n; ) {
+        const bool instant = !particlePool.timeScale[i];
+
+        alpha = particlePool.evalAlpha[i];
+        if (!instant && alpha <= 0) {
+            // faded out
+            CLG_MoveParticle(--n, i);
+            continue;
+        }
+
+        if (*numOut < MAX_PARTICLES) {
+            part = &out[(*numOut)++];
+
+            if (alpha > 1.0)
+                alpha = 1;
+
+            part->origin[0] = particlePool.evalX[i];
+            part->origin[1] = particlePool.evalY[i];
+            part->origin[2] = particlePool.evalZ[i];
+
+            if (particlePool.color[i] == -1) {
+                part->rgba.u8[0] = particlePool.rgba[i].u8[0];
+                part->rgba.u8[1] = particlePool.rgba[i].u8[1];
+                part->rgba.u8[2] = particlePool.rgba[i].u8[2];
+                part->rgba.u8[3] = particlePool.rgba[i].u8[3] * alpha;
             }
+
+            part->color = particlePool.color[i];
+            part->brightness = particlePool.brightness[i];
+            part->alpha = alpha;
+            part->radius = 0.f;
         }
-        else {
-            alpha = p->alpha;
+
+        if (instant) {
+            particlePool.timeScale[i] = 0.001f;
+            particlePool.alphaVelocity[i] = 0.0;
+            particlePool.alpha[i] = 0.0;
         }
 
-        if (view.num_particles >= MAX_PARTICLES)
-            break;
-        part = &view.particles[view.num_particles++];
+        i++;
+    }
 
-        p->next = NULL;
-        if (!tail)
-            active = tail = p;
-        else {
-            tail->next = p;
-            tail = p;
-        }
+    return n;
+}
 
-        if (alpha > 1.0)
-            alpha = 1;
-        color = p->color;
+/*
+===============
+CLG_SimulateParticles
 
-        time2 = time * time;
+Moves the particles already in the pool and removes the faded out ones.
+Doesn't touch the view or the particles spawned this frame, so it can run
+on a scene worker thread, as long as nothing spawns particles meanwhile.
+===============
+*/
+void CLG_SimulateParticles(void)
+{
+    numSimulatedParticles = 0;
+    particlePool.numParticles = CLG_EvaluateParticles(0, particlePool.numParticles,
+        simulatedParticles, &numSimulatedParticles);
+}
 
-        part->origin[0] = p->org[0] + p->vel[0] * time + p->acceleration[0] * time2;
-        part->origin[1] = p->org[1] + p->vel[1] * time + p->acceleration[1] * time2;
-        part->origin[2] = p->org[2] + p->vel[2] * time + p->acceleration[2] * time2;
+/*
+===============
+CLG_FinishParticles
 
-        if (color == -1) {
-            part->rgba.u8[0] = p->rgba.u8[0];
-            part->rgba.u8[1] = p->rgba.u8[1];
-            part->rgba.u8[2] = p->rgba.u8[2];
-            part->rgba.u8[3] = p->rgba.u8[3] * alpha;
-        }
+Adds the simulated particles to the view, followed by the ones spawned
+since the last frame, which are moved into the pool.
+===============
+*/
+void CLG_FinishParticles(void)
+{
+    int32_t i, n, count;
+
+    count = Mini(numSimulatedParticles, MAX_PARTICLES - view.num_particles);
+    memcpy(&view.particles[view.num_particles], simulatedParticles, count * sizeof(rparticle_t));
+    view.num_particles += count;
+    numSimulatedParticles = 0;
+
+    // Move the particles spawned since last frame into the pool.
+    n = particlePool.numParticles;
+    for (i = 0; i < numSpawnedParticles; i++, n++) {
+        const cparticle_t* p = &spawnedParticles[i];
+
+        particlePool.time[n] = p->time;
+        particlePool.timeScale[n] = p->alphavel == INSTANT_PARTICLE ? 0.f : 0.001f;
+        particlePool.orgX[n] = p->org[0];
+        particlePool.orgY[n] = p->org[1];
+        particlePool.orgZ[n] = p->org[2];
+        particlePool.velX[n] = p->vel[0];
+        particlePool.velY[n] = p->vel[1];
+        particlePool.velZ[n] = p->vel[2];
+        particlePool.accelX[n] = p->acceleration[0];
+        particlePool.accelY[n] = p->acceleration[1];
+        particlePool.accelZ[n] = p->acceleration[2];
+        particlePool.alpha[n] = p->alpha;
+        particlePool.alphaVelocity[n] = p->alphavel;
+        particlePool.brightness[n] = p->brightness;
+        particlePool.color[n] = p->color;
+        particlePool.rgba[n] = p->rgba;
+    }
+    numSpawnedParticles = 0;
+
+    particlePool.numParticles = CLG_EvaluateParticles(particlePool.numParticles, n,
+        view.particles, &view.num_particles);
+}
+
+/*
+===============
+CLG_AddParticles
+===============
+*/
+void CLG_AddParticles(void)
+{
+    CLG_SimulateParticles();
+    CLG_FinishParticles();
+}
+
+/*
+===============
+CLG_ParticleBenchmark_f
+
+particlebench [iterations]
+
+Fills the particle pool with explosion and blaster bursts in front of the
+view, then times spawning them and running CLG_AddParticles over the full
+pool. All particles are cleared afterwards.
+===============
+*/
+void CLG_ParticleBenchmark_f(void)
+{
+    using clock = std::chrono::steady_clock;
+    const int32_t savedNumParticles = view.num_particles;
+    double spawnTime = 0, addTime = 0;
+    int32_t i, iterations, numBursts = 0;
+    vec3_t origin, dir = { 0.f, 0.f, 1.f };
+
+    if (clgi.GetClienState() != ClientConnectionState::Active) {
+        Com_Print("Not connected.\n");
+        return;
+    }
 
-        part->color = color;
-        part->brightness = p->brightness;
-        part->alpha = alpha;
-        part->radius = 0.f;
+    iterations = clgi.Cmd_Argc() > 1 ? atoi(clgi.Cmd_Argv(1)) : 100;
+    iterations = Maxi(iterations, 1);
 
-        if (p->alphavel == INSTANT_PARTICLE) {
-            p->alphavel = 0.0;
-            p->alpha = 0.0;
+    for (i = 0; i < iterations; i++) {
+        CLG_ClearParticles();
+
+        // Spawn bursts until the pool is full.
+        auto start = clock::now();
+        for (int32_t burst = 0; particlePool.numParticles + numSpawnedParticles < MAX_PARTICLES; burst++) {
+            const int32_t before = numSpawnedParticles;
+
+            VectorCopy(cl->predictedState.viewOrigin, origin);
+            origin[0] += 64.f + (burst & 7) * 16.f;
+            origin[1] += ((burst >> 3) & 7) * 16.f;
+
+            if (burst & 1)
+                CLG_BlasterParticles(origin, dir);
+            else
+                CLG_ExplosionParticles(origin);
+
+            if (numSpawnedParticles == before)
+                break;  // the last one didn't fit
+            if (!i)
+                numBursts++;
         }
+        auto middle = clock::now();
+
+        view.num_particles = 0;
+        CLG_AddParticles();
+        auto end = clock::now();
+
+        spawnTime += std::chrono::duration<double, std::milli>(middle - start).count();
+        addTime += std::chrono::duration<double, std::milli>(end - middle).count();
     }
 
-    active_particles = active;
+    Com_Print("%i particles in %i bursts: spawn %.3f ms, add %.3f ms, average of %i runs\n",
+        particlePool.numParticles, numBursts, spawnTime / iterations, addTime / iterations, iterations);
+
+    CLG_ClearParticles();
+    view.num_particles = savedNumParticles;
 }
\ No newline at end of file
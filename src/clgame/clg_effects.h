@@ -13,7 +13,11 @@ void CLG_ClearEffects(void);
 void CLG_EffectsInit(void);
 
 cparticle_t* CLG_AllocParticle(void);
+cparticle_t* CLG_AllocParticles(int count);
+void CLG_SimulateParticles(void);
+void CLG_FinishParticles(void);
 void CLG_AddParticles(void);
+void CLG_ParticleBenchmark_f(void);
 #if USE_DLIGHTS
 cdlight_t* CLG_AllocDLight(int key);
 void CLG_AddDLights(void);
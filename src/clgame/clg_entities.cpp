@@ -75,15 +75,28 @@ static int adjust_shell_fx(int renderEffects)
     return renderEffects;
 }
 
+// Trails allocate particles, so they are spawned by CLG_FinishPacketEntities.
+static void CLG_RecordTrail(clg_scene_buffer_t* buffer, cl_entity_t* cent, const vec3_t& end, int effects)
+{
+    clg_scene_trail_t* trail = &buffer->trails[buffer->num_trails++];
+
+    trail->cent = cent;
+    trail->start = cent->lerpOrigin;
+    trail->end = end;
+    trail->effects = effects;
+}
+
 //
 //===============
-// CLG_AddPacketEntities
+// CLG_AddPacketEntityRange
 // 
-// Parse the server frames, and add the server entities to our client view.
-// Also apply special effects to them where desired.
+// Interpolates the packet entities first to last - 1 of the current frame
+// and adds them, their linked models and lights to the scene buffer.
+// Trails and disguise skins are only recorded, CLG_FinishPacketEntities
+// creates them. Safe to run on a scene worker thread.
 //===============
 //
-void CLG_AddPacketEntities(void)
+void CLG_AddPacketEntityRange(int first, int last, clg_scene_buffer_t* buffer)
 {
     r_entity_t            ent;
     EntityState* s1;
@@ -95,6 +108,13 @@ void CLG_AddPacketEntities(void)
     ClientInfo* ci;
     unsigned int        effects, renderEffects;
 
+    buffer->num_entities = 0;
+#if USE_DLIGHTS
+    buffer->num_dlights = 0;
+#endif
+    buffer->num_trails = 0;
+    buffer->num_skins = 0;
+
     // bonus items rotate at a fixed rate
     autorotate = AngleMod(cl->time * BASE_1_FRAMETIME);
 
@@ -103,9 +123,11 @@ void CLG_AddPacketEntities(void)
 
     memset(&ent, 0, sizeof(ent));
 
-    for (pnum = 0; pnum < cl->frame.numEntities; pnum++) {
+    for (pnum = first; pnum < last; pnum++) {
         // C++20: Had to be placed here because of label skip.
         int base_entity_flags = 0;
+        int firstEntity = 0;
+        ClientInfo* disguise = nullptr;
 
         i = (cl->frame.firstEntity + pnum) & PARSE_ENTITIES_MASK;
         s1 = &cl->entityStates[i];
@@ -186,10 +208,8 @@ void CLG_AddPacketEntities(void)
                     ci = &cl->baseClientInfo;
                 }
                 if (renderEffects & RenderEffects::UseDisguise) {
-                    char buffer[MAX_QPATH];
-
-                    Q_concat(buffer, sizeof(buffer), "players/", ci->model_name, "/disguise.pcx", NULL);
-                    ent.skin = clgi.R_RegisterSkin(buffer);
+                    // registered by CLG_FinishPacketEntities
+                    disguise = ci;
                 }
             }
             else {
@@ -265,7 +285,8 @@ void CLG_AddPacketEntities(void)
         }
 
         // add to refresh list
-        V_AddEntity(&ent);
+        firstEntity = buffer->num_entities;
+        CLG_SceneAddEntity(buffer, &ent);
 
         // add dlights for flares
         model_t* model;
@@ -284,7 +305,7 @@ void CLG_AddPacketEntities(void)
                 VectorCopy(ent.origin, origin);
                 origin[2] += offset;
 
-                V_AddLightEx(origin, 500.f, 1.6f * brightness, 1.0f * brightness, 0.2f * brightness, 5.f);
+                CLG_SceneAddLight(buffer, origin, 500.f, 1.6f * brightness, 1.0f * brightness, 0.2f * brightness, 5.f);
             }
         }
 
@@ -293,7 +314,15 @@ void CLG_AddPacketEntities(void)
             renderEffects = adjust_shell_fx(renderEffects);
             ent.flags = renderEffects | RenderEffects::Translucent | base_entity_flags;
             ent.alpha = 0.30;
-            V_AddEntity(&ent);
+            CLG_SceneAddEntity(buffer, &ent);
+        }
+
+        if (disguise && buffer->num_skins < MAX_CLIENTS) {
+            clg_scene_skin_t* skin = &buffer->skins[buffer->num_skins++];
+
+            skin->first = firstEntity;
+            skin->last = buffer->num_entities;
+            skin->ci = disguise;
         }
 
         ent.skin = 0;       // never use a custom skin on others
@@ -331,7 +360,7 @@ void CLG_AddPacketEntities(void)
                 ent.flags |= renderEffects;
             }
 
-            V_AddEntity(&ent);
+            CLG_SceneAddEntity(buffer, &ent);
 
             //PGM - make sure these get reset.
             ent.flags = base_entity_flags;
@@ -341,23 +370,23 @@ void CLG_AddPacketEntities(void)
         // Add an entity to the current rendering frame that has model index 3 attached to it.
         if (s1->modelIndex3) {
             ent.model = cl->drawModels[s1->modelIndex3];
-            V_AddEntity(&ent);
+            CLG_SceneAddEntity(buffer, &ent);
         }
 
         // Add an entity to the current rendering frame that has model index 4 attached to it.
         if (s1->modelIndex4) {
             ent.model = cl->drawModels[s1->modelIndex4];
-            V_AddEntity(&ent);
+            CLG_SceneAddEntity(buffer, &ent);
         }
 
 
         // Add automatic particle trail effects where desired.
         if (effects & ~EntityEffectType::Rotate) {
             if (effects & EntityEffectType::Blaster) {
-                CLG_BlasterTrail(cent->lerpOrigin, ent.origin);
-                V_AddLight(ent.origin, 200, 0.6f, 0.4f, 0.12f);
+                CLG_RecordTrail(buffer, cent, ent.origin, effects);
+                CLG_SceneAddLight(buffer, ent.origin, 200, 0.6f, 0.4f, 0.12f, 10.f);
             } else if (effects & EntityEffectType::Gib) {
-                CLG_DiminishingTrail(cent->lerpOrigin, ent.origin, cent, effects);
+                CLG_RecordTrail(buffer, cent, ent.origin, effects);
             } else if (effects & EntityEffectType::Torch) {
                 const float anim = sinf((float)ent.id + ((float)cl->time / 60.f + frand() * 3.3)) / (3.14356 - (frand() / 3.14356));
                 const float offset = anim * 0.0f;
@@ -368,7 +397,7 @@ void CLG_AddPacketEntities(void)
                     ent.origin.z + offset 
                 };
 
-                V_AddLightEx(origin, 25.f, 1.0f * brightness, 0.425f * brightness, 0.1f * brightness, 3.6f);
+                CLG_SceneAddLight(buffer, origin, 25.f, 1.0f * brightness, 0.425f * brightness, 0.1f * brightness, 3.6f);
 
                 //V_AddLight(ent.origin, 200 * RandomRangef(0.65, 1.0f), 0.8f, 0.4f, 0.12f);
             }
@@ -382,6 +411,52 @@ void CLG_AddPacketEntities(void)
     }
 }
 
+//
+//===============
+// CLG_FinishPacketEntities
+// 
+// Registers the disguise skins and spawns the trails recorded by
+// CLG_AddPacketEntityRange, then appends the buffer to the view.
+// Buffers have to be finished in entity order, on the main thread.
+//===============
+//
+void CLG_FinishPacketEntities(clg_scene_buffer_t* buffer)
+{
+    char    path[MAX_QPATH];
+    int     i, j, count;
+
+    for (i = 0; i < buffer->num_skins; i++) {
+        const clg_scene_skin_t* skin = &buffer->skins[i];
+
+        Q_concat(path, sizeof(path), "players/", skin->ci->model_name, "/disguise.pcx", NULL);
+        const qhandle_t handle = clgi.R_RegisterSkin(path);
+
+        for (j = skin->first; j < skin->last; j++)
+            buffer->entities[j].skin = handle;
+    }
+
+    for (i = 0; i < buffer->num_trails; i++) {
+        clg_scene_trail_t* trail = &buffer->trails[i];
+
+        if (trail->effects & EntityEffectType::Blaster)
+            CLG_BlasterTrail(trail->start, trail->end);
+        else
+            CLG_DiminishingTrail(trail->start, trail->end, trail->cent, trail->effects);
+    }
+
+    count = Mini(buffer->num_entities, MAX_ENTITIES - view.num_entities);
+    memcpy(&view.entities[view.num_entities], buffer->entities, count * sizeof(r_entity_t));
+    view.num_entities += count;
+
+#if USE_DLIGHTS
+    for (i = 0; i < buffer->num_dlights; i++) {
+        const rdlight_t* dl = &buffer->dlights[i];
+
+        V_AddLightEx(dl->origin, dl->intensity, dl->color[0], dl->color[1], dl->color[2], dl->radius);
+    }
+#endif
+}
+
 /*
 ==============
 CLG_AddViewWeapon
@@ -9,9 +9,12 @@
 #ifndef __CLGAME_ENTITIES_H__
 #define __CLGAME_ENTITIES_H__
 
+typedef struct clg_scene_buffer_s clg_scene_buffer_t;
+
 void CLG_EntityEvent(int number);
 
-void CLG_AddPacketEntities(void);
+void CLG_AddPacketEntityRange(int first, int last, clg_scene_buffer_t* buffer);
+void CLG_FinishPacketEntities(clg_scene_buffer_t* buffer);
 void CLG_AddViewWeapon(void);
 void CLG_UpdateOrigin(void);
 
@@ -148,6 +148,7 @@ extern cvar_t* cl_noskins;
 extern cvar_t* cl_player_model;
 extern cvar_t* cl_predict;
 extern cvar_t* cl_rollhack;
+extern cvar_t* cl_showpmoves;
 extern cvar_t* cl_thirdperson_angle;
 extern cvar_t* cl_thirdperson_range;
 extern cvar_t* cl_vwep;
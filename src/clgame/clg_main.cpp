@@ -66,6 +66,7 @@ cvar_t *cl_noskins              = nullptr;
 cvar_t *cl_player_model         = nullptr;
 cvar_t *cl_predict              = nullptr;
 cvar_t *cl_rollhack             = nullptr;
+cvar_t *cl_showpmoves           = nullptr;
 cvar_t *cl_thirdperson_angle    = nullptr;
 cvar_t *cl_thirdperson_range    = nullptr;
 cvar_t *cl_vwep                 = nullptr;
@@ -417,6 +418,9 @@ void CLG_ClientBegin() {
 void CLG_ClientDeltaFrame(void) {
     // Called each time a valid client frame has been 
     SCR_SetCrosshairColor();
+
+    // Sort out the solid entities for prediction traces.
+    CLG_BuildSolidBroadphase();
 }
 
 //
@@ -461,6 +465,10 @@ void CLG_ClearState(void) {
     // Clear Effects.
     CLG_ClearEffects();
 
+    // Forget about predicted movement.
+    CLG_ClearPrediction();
+    CLG_ClearSolidBroadphase();
+
 #if USE_LIGHTSTYLES
     CLG_ClearLightStyles();
 #endif
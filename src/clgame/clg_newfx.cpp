@@ -189,11 +189,11 @@ void CLG_GenericParticleEffect(vec3_t org, vec3_t dir, int color, int count, int
     cparticle_t* p;
     float       d;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
         if (numcolors > 1)
             p->color = color + (rand() & numcolors);
@@ -343,11 +343,11 @@ void CLG_ParticleSteamEffect(vec3_t org, vec3_t dir, int color, int count, int m
 
     MakeNormalVectors(dir, r, u);
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
         p->color = color + (rand() & 7);
 
@@ -379,11 +379,11 @@ void CLG_ParticleSteamEffect2(cl_sustain_t* self)
     VectorCopy(self->dir, dir);
     MakeNormalVectors(dir, r, u);
 
-    for (i = 0; i < self->count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(self->count);
+    if (!p)
+        return;
 
+    for (i = 0; i < self->count; i++, p++) {
         p->time = cl->time;
         p->color = self->color + (rand() & 7);
 
@@ -465,10 +465,11 @@ void CLG_Tracker_Shell(vec3_t origin)
     int             i;
     cparticle_t* p;
 
-    for (i = 0; i < 300; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(300);
+    if (!p)
+        return;
+
+    for (i = 0; i < 300; i++, p++) {
         VectorClear(p->acceleration);
 
         p->time = cl->time;
@@ -492,10 +493,11 @@ void CLG_MonsterPlasma_Shell(vec3_t origin)
     int             i;
     cparticle_t* p;
 
-    for (i = 0; i < 40; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(40);
+    if (!p)
+        return;
+
+    for (i = 0; i < 40; i++, p++) {
         VectorClear(p->acceleration);
 
         p->time = cl->time;
@@ -523,10 +525,11 @@ void CLG_Widowbeamout(cl_sustain_t* self)
 
     ratio = 1.0 - (((float)self->endTime - (float)cl->time) / 2100.0);
 
-    for (i = 0; i < 300; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(300);
+    if (!p)
+        return;
+
+    for (i = 0; i < 300; i++, p++) {
         VectorClear(p->acceleration);
 
         p->time = cl->time;
@@ -554,10 +557,11 @@ void CLG_Nukeblast(cl_sustain_t* self)
 
     ratio = 1.0 - (((float)self->endTime - (float)cl->time) / 1000.0);
 
-    for (i = 0; i < 700; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(700);
+    if (!p)
+        return;
+
+    for (i = 0; i < 700; i++, p++) {
         VectorClear(p->acceleration);
 
         p->time = cl->time;
@@ -581,10 +585,11 @@ void CLG_Tracker_Explode(vec3_t  origin)
     int             i;
     cparticle_t* p;
 
-    for (i = 0; i < 300; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(300);
+    if (!p)
+        return;
+
+    for (i = 0; i < 300; i++, p++) {
         VectorClear(p->acceleration);
 
         p->time = cl->time;
@@ -659,11 +664,11 @@ void CLG_ColorExplosionParticles(vec3_t org, int color, int run)
     int         i, j;
     cparticle_t* p;
 
-    for (i = 0; i < 128; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(128);
+    if (!p)
+        return;
 
+    for (i = 0; i < 128; i++, p++) {
         p->time = cl->time;
         p->color = color + (rand() % run);
 
@@ -694,11 +699,11 @@ void CLG_ParticleSmokeEffect(vec3_t org, vec3_t dir, int color, int count, int m
 
     MakeNormalVectors(dir, r, u);
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
         p->color = color + (rand() & 7);
 
@@ -733,11 +738,11 @@ void CLG_BlasterParticles2(vec3_t org, vec3_t dir, unsigned int color)
     int         count;
 
     count = 40;
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
         p->color = color + (rand() & 7);
 
@@ -960,11 +965,11 @@ void CLG_ParticleEffect3(vec3_t org, vec3_t dir, int color, int count)
     cparticle_t* p;
     float       d;
 
-    for (i = 0; i < count; i++) {
-        p = CLG_AllocParticle();
-        if (!p)
-            return;
+    p = CLG_AllocParticles(count);
+    if (!p)
+        return;
 
+    for (i = 0; i < count; i++, p++) {
         p->time = cl->time;
         p->color = color;
 
@@ -6,9 +6,13 @@
 //
 // Movement prediction implementation for the client side.
 //
+#include <algorithm>
+#include <chrono>
+
 #include "clg_local.h"
 
 #include "clg_main.h"
+#include "clg_predict.h"
 
 // Distance that is allowed to be taken as a delta before we reset it.
 #define MAX_DELTA_ORIGIN (2400.f * (1.0f / BASE_FRAMERATE))
@@ -41,6 +45,9 @@ void CLG_CheckPredictionError(ClientMoveCommand *moveCommand) {
     // If the error is too large, it was likely a teleport or respawn, so ignore it
     const float len = vec3_length(out->error);
     if (len > .1f) {
+        // Don't build upon mispredicted results.
+        CLG_ClearPrediction();
+
         if (len > MAX_DELTA_ORIGIN) {
             Com_DPrint("CLG_PredictionError: if (len > MAX_DELTA_ORIGIN): %s\n", Vec3ToString(out->error));
 
@@ -72,12 +79,154 @@ void CLG_PredictAngles(void) {
 
 //
 //===============
-// CLG_ClipMoveToEntities
+// Solid entity broadphase.
 // 
+// Bounds of all solid entities of the current frame, sorted by their minimum
+// X coordinate, so that traces only have to test the entities they might hit.
+// Entities with angles get bounds that hold them in any orientation.
+//================
+//
+typedef struct {
+    vec3_t  absMin, absMax;
+    int32_t index;      // Into cl->solidEntities.
+} SolidEntityBounds;
+
+static struct {
+    int32_t             frameNumber;
+    int32_t             numSolidEntities;
+    qboolean            valid;
+
+    int32_t             numBounds;
+    SolidEntityBounds   bounds[MAX_PACKET_ENTITIES];
+    float               maxSizeX;   // Largest X extent, limits how far back an overlap can start.
+} solidBroadphase;
+
+// Prediction traces recorded on request of "tracebench record", for
+// CLG_TraceBenchmark_f.
+#define MAX_TRACE_RECORDS 4096
+
+static struct {
+    vec3_t start, mins, maxs, end;
+} traceRecords[MAX_TRACE_RECORDS];
+static int32_t numTraceRecords;
+static qboolean recordTraces;
+
+//
+//===============
+// CLG_BuildSolidBroadphase
 // 
+// Rebuilds the broadphase from the solid entities of the current frame.
 //================
 //
-static void CLG_ClipMoveToEntities(const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end, trace_t* tr)
+void CLG_BuildSolidBroadphase(void) {
+    solidBroadphase.frameNumber = cl->frame.number;
+    solidBroadphase.numSolidEntities = cl->numSolidEntities;
+    solidBroadphase.valid = true;
+    solidBroadphase.numBounds = 0;
+    solidBroadphase.maxSizeX = 0;
+
+    for (int32_t i = 0; i < cl->numSolidEntities; i++) {
+        cl_entity_t *ent = cl->solidEntities[i];
+        vec3_t mins, maxs;
+
+        if (ent->current.solid == PACKED_BSP) {
+            mmodel_t *cmodel = cl->clipModels[ent->current.modelIndex];
+            if (!cmodel)
+                continue;
+            mins = cmodel->mins;
+            maxs = cmodel->maxs;
+        } else {
+            mins = ent->mins;
+            maxs = ent->maxs;
+        }
+
+        // Rotated entities can reach out as far as their furthest corner.
+        if (ent->current.angles[0] || ent->current.angles[1] || ent->current.angles[2]) {
+            const float radius = Maxf(vec3_length(mins), vec3_length(maxs));
+            mins = { -radius, -radius, -radius };
+            maxs = { radius, radius, radius };
+        }
+
+        SolidEntityBounds *b = &solidBroadphase.bounds[solidBroadphase.numBounds++];
+        b->absMin = ent->current.origin + mins - vec3_t{ 1.f, 1.f, 1.f };
+        b->absMax = ent->current.origin + maxs + vec3_t{ 1.f, 1.f, 1.f };
+        b->index = i;
+
+        solidBroadphase.maxSizeX = Maxf(solidBroadphase.maxSizeX, b->absMax.x - b->absMin.x);
+    }
+
+    std::sort(solidBroadphase.bounds, solidBroadphase.bounds + solidBroadphase.numBounds,
+        [](const SolidEntityBounds &a, const SolidEntityBounds &b) { return a.absMin.x < b.absMin.x; });
+}
+
+//
+//===============
+// CLG_ClearSolidBroadphase
+// 
+//================
+//
+void CLG_ClearSolidBroadphase(void) {
+    solidBroadphase.valid = false;
+}
+
+//
+//===============
+// CLG_QuerySolidEntities
+// 
+// Fills list with the solid entities whose bounds touch the given box, in the
+// order of cl->solidEntities, so results match testing every entity.
+//================
+//
+static int32_t CLG_QuerySolidEntities(const vec3_t &absMin, const vec3_t &absMax, cl_entity_t **list) {
+    int32_t indices[MAX_PACKET_ENTITIES];
+    int32_t count = 0;
+
+    // Catch frames that didn't go through CLG_ClientDeltaFrame.
+    if (!solidBroadphase.valid || solidBroadphase.frameNumber != cl->frame.number
+        || solidBroadphase.numSolidEntities != cl->numSolidEntities) {
+        CLG_BuildSolidBroadphase();
+    }
+
+    // Find the first entity that may overlap along X.
+    const float minX = absMin.x - solidBroadphase.maxSizeX;
+    int32_t lo = 0, hi = solidBroadphase.numBounds;
+    while (lo < hi) {
+        const int32_t mid = (lo + hi) / 2;
+        if (solidBroadphase.bounds[mid].absMin.x < minX)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    for (int32_t i = lo; i < solidBroadphase.numBounds; i++) {
+        const SolidEntityBounds *b = &solidBroadphase.bounds[i];
+
+        if (b->absMin.x > absMax.x)
+            break;
+        if (b->absMax.x < absMin.x || b->absMin.y > absMax.y || b->absMax.y < absMin.y
+            || b->absMin.z > absMax.z || b->absMax.z < absMin.z)
+            continue;
+
+        indices[count++] = b->index;
+    }
+
+    std::sort(indices, indices + count);
+
+    for (int32_t i = 0; i < count; i++) {
+        list[i] = cl->solidEntities[indices[i]];
+    }
+
+    return count;
+}
+
+//
+//===============
+// CLG_ClipMoveToEntityList
+// 
+// 
+//================
+//
+static void CLG_ClipMoveToEntityList(const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end, trace_t* tr, cl_entity_t **list, int32_t count)
 {
     int         i;
     trace_t     trace;
@@ -85,8 +234,8 @@ static void CLG_ClipMoveToEntities(const vec3_t &start, const vec3_t &mins, cons
     cl_entity_t* ent;
     mmodel_t* cmodel;
 
-    for (i = 0; i < cl->numSolidEntities; i++) {
-        ent = cl->solidEntities[i];
+    for (i = 0; i < count; i++) {
+        ent = list[i];
 
         if (ent->current.solid == PACKED_BSP) {
             // special value for bmodel
@@ -110,6 +259,24 @@ static void CLG_ClipMoveToEntities(const vec3_t &start, const vec3_t &mins, cons
     }
 }
 
+//
+//===============
+// CLG_ClipMoveToEntities
+// 
+// 
+//================
+//
+static void CLG_ClipMoveToEntities(const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end, trace_t* tr)
+{
+    cl_entity_t *list[MAX_PACKET_ENTITIES];
+
+    const vec3_t absMin = vec3_minf(start, end) + mins;
+    const vec3_t absMax = vec3_maxf(start, end) + maxs;
+    const int32_t count = CLG_QuerySolidEntities(absMin, absMax, list);
+
+    CLG_ClipMoveToEntityList(start, mins, maxs, end, tr, list, count);
+}
+
 /*
 ================
 CL_PMTrace
@@ -119,6 +286,20 @@ trace_t q_gameabi CLG_Trace(const vec3_t &start, const vec3_t &mins, const vec3_
 {
     trace_t    t;
 
+    // Keep traces around for benchmarking, until the buffer is full.
+    if (recordTraces) {
+        auto &record = traceRecords[numTraceRecords++];
+        record.start = start;
+        record.mins = mins;
+        record.maxs = maxs;
+        record.end = end;
+
+        if (numTraceRecords == MAX_TRACE_RECORDS) {
+            recordTraces = false;
+            Com_Print("Recorded %i traces.\n", numTraceRecords);
+        }
+    }
+
     // check against world
     clgi.CM_BoxTrace(&t, start, end, mins, maxs, cl->bsp->nodes, CONTENTS_MASK_PLAYERSOLID);
     if (t.fraction < 1.0)
@@ -132,15 +313,18 @@ trace_t q_gameabi CLG_Trace(const vec3_t &start, const vec3_t &mins, const vec3_
 
 int CLG_PointContents(const vec3_t &point)
 {
-    int         i;
+    int         i, count;
+    cl_entity_t* list[MAX_PACKET_ENTITIES];
     cl_entity_t* ent;
     mmodel_t* cmodel;
     int         contents;
 
     contents = clgi.CM_PointContents(point, cl->bsp->nodes);
 
-    for (i = 0; i < cl->numSolidEntities; i++) {
-        ent = cl->solidEntities[i];
+    count = CLG_QuerySolidEntities(point, point, list);
+
+    for (i = 0; i < count; i++) {
+        ent = list[i];
 
         if (ent->current.solid != PACKED_BSP) // special value for bmodel
             continue;
@@ -158,6 +342,78 @@ int CLG_PointContents(const vec3_t &point)
     return contents;
 }
 
+//
+//===============
+// CLG_TraceBenchmark_f
+// 
+// tracebench record
+// tracebench [iterations]
+//
+// Starts recording prediction traces, or runs the recorded ones against the solid entities of the
+// current frame, once testing every entity and once through the broadphase,
+// and compares timings and results.
+//================
+//
+void CLG_TraceBenchmark_f(void) {
+    using clock = std::chrono::steady_clock;
+    const int32_t count = numTraceRecords;
+    int32_t iterations, mismatches = 0;
+    double bruteTime = 0, broadTime = 0;
+    size_t candidates = 0;
+
+    if (clgi.Cmd_Argc() > 1 && !strcmp(clgi.Cmd_Argv(1), "record")) {
+        numTraceRecords = 0;
+        recordTraces = true;
+        Com_Print("Recording %i traces.\n", MAX_TRACE_RECORDS);
+        return;
+    }
+
+    if (clgi.GetClienState() != ClientConnectionState::Active) {
+        Com_Print("Not connected.\n");
+        return;
+    }
+    if (!count) {
+        Com_Print("No traces recorded, use \"tracebench record\" first.\n");
+        return;
+    }
+
+    iterations = clgi.Cmd_Argc() > 1 ? atoi(clgi.Cmd_Argv(1)) : 10;
+    iterations = Maxi(iterations, 1);
+
+    CLG_BuildSolidBroadphase();
+
+    for (int32_t n = 0; n < iterations; n++) {
+        for (int32_t i = 0; i < count; i++) {
+            const auto &r = traceRecords[i];
+            cl_entity_t *list[MAX_PACKET_ENTITIES];
+            trace_t brute = {}, broad = {};
+
+            brute.fraction = broad.fraction = 1.f;
+            brute.endPosition = broad.endPosition = r.end;
+
+            auto start = clock::now();
+            CLG_ClipMoveToEntityList(r.start, r.mins, r.maxs, r.end, &brute, cl->solidEntities, cl->numSolidEntities);
+            auto middle = clock::now();
+            const int32_t numListed = CLG_QuerySolidEntities(vec3_minf(r.start, r.end) + r.mins, vec3_maxf(r.start, r.end) + r.maxs, list);
+            CLG_ClipMoveToEntityList(r.start, r.mins, r.maxs, r.end, &broad, list, numListed);
+            auto end = clock::now();
+
+            bruteTime += std::chrono::duration<double, std::milli>(middle - start).count();
+            broadTime += std::chrono::duration<double, std::milli>(end - middle).count();
+            candidates += numListed;
+
+            if (!n && (brute.fraction != broad.fraction || brute.ent != broad.ent
+                || brute.allSolid != broad.allSolid || brute.startSolid != broad.startSolid)) {
+                mismatches++;
+            }
+        }
+    }
+
+    Com_Print("%i traces, %i solid entities, %.1f candidates per trace: all %.3f ms, broadphase %.3f ms, %i mismatches\n",
+        count, cl->numSolidEntities, (double)candidates / ((double)count * iterations),
+        bruteTime / iterations, broadTime / iterations, mismatches);
+}
+
 //
 //================
 // PM_UpdateClientSoundSpecialEffects
@@ -196,6 +452,39 @@ void CLG_UpdateClientSoundSpecialEffects(PlayerMove* pm)
     }
 }
 
+//
+//===============
+// Prediction cache.
+// 
+// Results of running the commands that the server hasn't acknowledged yet.
+// Kept until a new server frame arrives, or a prediction error shows up, so
+// that in between rendered frames only need to simulate the commands added
+// since, along with the pending partial command.
+//================
+//
+static struct {
+    qboolean        valid;
+    int32_t         frameNumber;        // Server frame the results build upon.
+    uint32_t        acknowledgedIndex;  // Last command applied by the server.
+    uint32_t        commandIndex;       // Last command simulated.
+
+    // Results of the last simulated command.
+    PlayerMoveState state;
+    struct entity_s *groundEntityPtr;
+    vec3_t          viewAngles;
+} predictionCache;
+
+//
+//===============
+// CLG_ClearPrediction
+// 
+// Forces the next prediction to replay all unacknowledged commands.
+//================
+//
+void CLG_ClearPrediction(void) {
+    predictionCache.valid = false;
+}
+
 //
 //===============
 // CLG_PredictMovement
@@ -205,6 +494,7 @@ void CLG_UpdateClientSoundSpecialEffects(PlayerMove* pm)
 //
 void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int currentCommandIndex) {
     PlayerMove   pm = {};
+    int32_t      numMoves = 0;
 
     if (!acknowledgedCommandIndex || !currentCommandIndex)
         return;
@@ -212,16 +502,32 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
     // Setup base trace calls.
     pm.Trace = CLG_Trace;
     pm.PointContents = CLG_PointContents;
-    
-    // Restore ground entity for this frame.
-    pm.groundEntityPtr = cl->predictedState.groundEntityPtr;
 
-    // Copy current state to pmove
-    pm.state = cl->frame.playerState.pmove;
+    // Continue from the cached results if they still apply, otherwise
+    // start over from the last state received from the server.
+    if (predictionCache.valid
+        && predictionCache.frameNumber == cl->frame.number
+        && predictionCache.acknowledgedIndex == acknowledgedCommandIndex
+        && predictionCache.commandIndex - acknowledgedCommandIndex <= currentCommandIndex - acknowledgedCommandIndex) {
+        pm.state = predictionCache.state;
+        pm.groundEntityPtr = predictionCache.groundEntityPtr;
+        pm.viewAngles = predictionCache.viewAngles;
+        acknowledgedCommandIndex = predictionCache.commandIndex;
+    } else {
+        // Restore ground entity for this frame.
+        pm.groundEntityPtr = cl->predictedState.groundEntityPtr;
+
+        // Copy current state to pmove
+        pm.state = cl->frame.playerState.pmove;
 #if USE_SMOOTH_DELTA_ANGLES
-    pm.state.deltaAngles = cl->deltaAngles;
+        pm.state.deltaAngles = cl->deltaAngles;
 #endif
 
+        predictionCache.valid = true;
+        predictionCache.frameNumber = cl->frame.number;
+        predictionCache.acknowledgedIndex = acknowledgedCommandIndex;
+    }
+
     // Run frames in order.
     while (++acknowledgedCommandIndex <= currentCommandIndex) {
         // Fetch the command.
@@ -234,6 +540,7 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
 
             pm.moveCommand = *cmd;
             PMove(&pm);
+            numMoves++;
 
             // Update player move client side audio effects.
             CLG_UpdateClientSoundSpecialEffects(&pm);
@@ -243,6 +550,12 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
         cmd->prediction.origin = pm.state.origin;
     }
 
+    // Store the results of all complete commands.
+    predictionCache.commandIndex = currentCommandIndex;
+    predictionCache.state = pm.state;
+    predictionCache.groundEntityPtr = pm.groundEntityPtr;
+    predictionCache.viewAngles = pm.viewAngles;
+
     // Run pending cmd
     if (cl->moveCommand.input.msec) {
         // Saved for prediction error checking.
@@ -253,6 +566,7 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
         pm.moveCommand.input.rightMove = cl->localmove[1];
         pm.moveCommand.input.upMove = cl->localmove[2];
         PMove(&pm);
+        numMoves++;
 
         // Update player move client side audio effects.
         CLG_UpdateClientSoundSpecialEffects(&pm);
@@ -261,6 +575,10 @@ void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int cur
         cl->moveCommand.prediction.origin = pm.state.origin;
     }
 
+    if (cl_showpmoves->integer) {
+        Com_Print("%i: %i pmoves\n", cl->frame.number, numMoves);
+    }
+
     // Copy results out for rendering
     cl->predictedState.viewOrigin  = pm.state.origin;
     //cl->predictedState.velocity    = pm.state.velocity;
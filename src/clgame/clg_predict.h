@@ -12,6 +12,11 @@
 void CLG_CheckPredictionError(ClientMoveCommand* moveCommand);
 void CLG_PredictAngles(void);
 void CLG_PredictMovement(unsigned int acknowledgedCommandIndex, unsigned int currentCommandIndex);
+void CLG_ClearPrediction(void);
+
+void CLG_BuildSolidBroadphase(void);
+void CLG_ClearSolidBroadphase(void);
+void CLG_TraceBenchmark_f(void);
 
 // WID: TODO: Another concern, clean up later.
 void CLG_UpdateClientSoundSpecialEffects(PlayerMove* pm);
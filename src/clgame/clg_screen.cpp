@@ -11,6 +11,7 @@
 #include "clg_main.h"
 #include "clg_media.h"
 #include "clg_screen.h"
+#include "clg_view.h"
 
 RenderScreenData scr;
 
@@ -20,6 +21,7 @@ RenderScreenData scr;
 cvar_t* scr_viewsize;           // Scale of the view size.
 
 static cvar_t* scr_fps;         // Show FPS count, or not.
+static cvar_t* scr_scenetimes;  // Show scene build stage times, or not.
 static cvar_t* scr_showitemname;// Show item name, or not.
 
 static cvar_t* scr_draw2d;      // To draw 2D elements or not.
@@ -735,6 +737,41 @@ void SCR_DrawFPS(void)
     SCR_DrawString(x, y, UI_RIGHT, buffer);
 }
 
+void SCR_DrawSceneTimes(void)
+{
+    if (scr_scenetimes->integer == 0)
+        return;
+
+    const clg_scene_times_t* times = CLG_GetSceneTimes();
+    const struct {
+        const char* name;
+        double      msec;
+    } stages[] = {
+        { "entities", times->entities },
+        { "particles", times->particles },
+        { "lightstyles", times->lightstyles },
+        { "merge", times->merge },
+        { "effects", times->effects },
+        { "total", times->total },
+    };
+
+    char buffer[MAX_QPATH];
+    int x = scr.hud_width - 2;
+    int y = 1 + CHAR_HEIGHT * 2;
+
+    clgi.R_SetColor(~0u);
+
+    Q_snprintf(buffer, MAX_QPATH, "scene: %d threads", times->threads);
+    SCR_DrawString(x, y, UI_RIGHT, buffer);
+    y += CHAR_HEIGHT;
+
+    for (const auto& stage : stages) {
+        Q_snprintf(buffer, MAX_QPATH, "%s %.3f ms", stage.name, stage.msec);
+        SCR_DrawString(x, y, UI_RIGHT, buffer);
+        y += CHAR_HEIGHT;
+    }
+}
+
 //
 //=============================================================================
 //
@@ -1504,6 +1541,7 @@ void SCR_Init(void)
     scr_scale->changed      = scr_scale_changed;
 
     scr_showitemname        = clgi.Cvar_Get("scr_showitemname", "1", CVAR_ARCHIVE);
+    scr_scenetimes          = clgi.Cvar_Get("scr_scenetimes", "0", 0);
 
     scr_centertime          = clgi.Cvar_Get("scr_centertime", "2.5", 0);
 
@@ -1603,6 +1641,9 @@ void CLG_RenderScreen(void) {
     // Draw FPS.
     SCR_DrawFPS();
 
+    // Draw scene build times.
+    SCR_DrawSceneTimes();
+
     // Draw Chat Hud.
     SCR_DrawChatHUD();
 }
@@ -64,6 +64,7 @@ void SCR_DrawInventory(void);
 void SCR_DrawCenterString(void);
 void SCR_DrawObjects(void);
 void SCR_DrawFPS(void);
+void SCR_DrawSceneTimes(void);
 void SCR_DrawChatHUD(void);
 
 #endif // __CLGAME_SCREEN_H__
\ No newline at end of file
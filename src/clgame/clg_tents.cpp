@@ -864,11 +864,11 @@ static void CLG_RailSpiral(void)
 
 	MakeNormalVectors(vec, right, up);
 
-	for (i = 0; i < len; i++) {
-		p = CLG_AllocParticle();
-		if (!p)
-			return;
+	p = CLG_AllocParticles(ceilf(len));
+	if (!p)
+		return;
 
+	for (i = 0; i < len; i++, p++) {
 		p->time = cl->time;
 		VectorClear(p->acceleration);
 
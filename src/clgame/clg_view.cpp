@@ -6,6 +6,11 @@
 //
 // View handling on a per frame basis.
 //
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "clg_local.h"
 
 #include "clg_effects.h"
@@ -44,6 +49,7 @@ static cvar_t* cl_stats;
 #endif
 
 static cvar_t* cl_adjustfov;
+static cvar_t* cl_scene_threads;
 
 
 //
@@ -160,6 +166,248 @@ void V_AddLightStyle(int style, const vec4_t &value)
 }
 #endif
 
+//
+//=============================================================================
+//
+// SCENE BUILD.
+//
+//=============================================================================
+//
+
+using sceneclock_t = std::chrono::steady_clock;
+
+// Packet entities, particle simulation and light styles.
+#define MAX_SCENE_JOBS      (MAX_SCENE_THREADS + 2)
+
+// Frames with fewer packet entities per thread aren't worth splitting up.
+#define MIN_SCENE_CHUNK     64
+
+typedef struct {
+    void    (*func)(int arg);
+    int     arg;
+    double  msec;               // time spent running it
+} scenejob_t;
+
+static struct {
+    std::thread             threads[MAX_SCENE_THREADS];
+    int                     numthreads;     // workers running
+    bool                    quit;
+
+    std::mutex              mutex;
+    std::condition_variable work;           // signaled when jobs are queued
+    std::condition_variable done;           // signaled when the last job finishes
+    scenejob_t              jobs[MAX_SCENE_JOBS];
+    int                     numjobs;
+    int                     nextjob;
+    int                     pending;        // jobs queued or running
+} scene;
+
+// Packet entities first to last - 1 go into the buffer of the same index.
+static struct {
+    int first;
+    int last;
+} sceneChunks[MAX_SCENE_THREADS];
+static clg_scene_buffer_t   sceneBuffers[MAX_SCENE_THREADS];
+
+static clg_scene_times_t    sceneTimes;     // last published averages
+static clg_scene_times_t    sceneTimesSum;
+static int                  sceneTimesFrames;
+static sceneclock_t::time_point sceneTimesStart;
+
+//
+//===============
+// CLG_SceneAddEntity
+// 
+// Adds the entity to a scene buffer, see V_AddEntity.
+//===============
+//
+void CLG_SceneAddEntity(clg_scene_buffer_t* buffer, const r_entity_t* ent)
+{
+    if (buffer->num_entities >= MAX_ENTITIES)
+        return;
+
+    buffer->entities[buffer->num_entities++] = *ent;
+}
+
+//
+//===============
+// CLG_SceneAddLight
+// 
+// Adds the light to a scene buffer, see V_AddLightEx.
+//===============
+//
+void CLG_SceneAddLight(clg_scene_buffer_t* buffer, const vec3_t& org, float intensity, float r, float g, float b, float radius)
+{
+#if USE_DLIGHTS
+    rdlight_t* dl;
+
+    if (buffer->num_dlights >= MAX_DLIGHTS)
+        return;
+    dl = &buffer->dlights[buffer->num_dlights++];
+    VectorCopy(org, dl->origin);
+    dl->intensity = intensity;
+    dl->color[0] = r;
+    dl->color[1] = g;
+    dl->color[2] = b;
+    dl->radius = radius;
+#endif
+}
+
+//
+//===============
+// CLG_GetSceneTimes
+// 
+// Returns the stage times of the scene build, for the profiling overlay.
+//===============
+//
+const clg_scene_times_t* CLG_GetSceneTimes(void)
+{
+    return &sceneTimes;
+}
+
+static void CLG_RunSceneJob(scenejob_t* job)
+{
+    const sceneclock_t::time_point start = sceneclock_t::now();
+
+    job->func(job->arg);
+
+    job->msec = std::chrono::duration<double, std::milli>(sceneclock_t::now() - start).count();
+}
+
+// runs queued jobs until none are left, called with the lock held
+static void CLG_RunQueuedSceneJobs(std::unique_lock<std::mutex>& lock)
+{
+    while (scene.nextjob < scene.numjobs) {
+        scenejob_t* job = &scene.jobs[scene.nextjob++];
+
+        lock.unlock();
+        CLG_RunSceneJob(job);
+        lock.lock();
+
+        if (!--scene.pending)
+            scene.done.notify_all();
+    }
+}
+
+static void CLG_SceneWorker(void)
+{
+    std::unique_lock<std::mutex> lock(scene.mutex);
+
+    while (!scene.quit) {
+        if (scene.nextjob < scene.numjobs)
+            CLG_RunQueuedSceneJobs(lock);
+        else
+            scene.work.wait(lock);
+    }
+}
+
+//
+//===============
+// CLG_StopSceneThreads
+// 
+// Stops the scene workers. They have to be gone before the module is
+// unloaded, the next scene build starts them again.
+//===============
+//
+static void CLG_StopSceneThreads(void)
+{
+    int i;
+
+    {
+        std::lock_guard<std::mutex> lock(scene.mutex);
+        scene.quit = true;
+        scene.work.notify_all();
+    }
+
+    for (i = 0; i < scene.numthreads; i++)
+        scene.threads[i].join();
+
+    scene.numthreads = 0;
+    scene.quit = false;
+}
+
+//
+//===============
+// CLG_RunSceneJobs
+// 
+// Runs the jobs on numthreads threads, calling thread included, and waits
+// for all of them to finish. Job times are written back to the array.
+//===============
+//
+static void CLG_RunSceneJobs(scenejob_t* jobs, int numjobs, int numthreads)
+{
+    int i;
+
+    if (scene.numthreads != numthreads - 1) {
+        CLG_StopSceneThreads();
+
+        for (i = 0; i < numthreads - 1; i++)
+            scene.threads[i] = std::thread(CLG_SceneWorker);
+        scene.numthreads = numthreads - 1;
+    }
+
+    std::unique_lock<std::mutex> lock(scene.mutex);
+
+    memcpy(scene.jobs, jobs, numjobs * sizeof(scenejob_t));
+    scene.numjobs = numjobs;
+    scene.nextjob = 0;
+    scene.pending = numjobs;
+    scene.work.notify_all();
+
+    CLG_RunQueuedSceneJobs(lock);
+
+    while (scene.pending)
+        scene.done.wait(lock);
+
+    memcpy(jobs, scene.jobs, numjobs * sizeof(scenejob_t));
+}
+
+static void CLG_PacketEntityJob(int chunk)
+{
+    CLG_AddPacketEntityRange(sceneChunks[chunk].first, sceneChunks[chunk].last, &sceneBuffers[chunk]);
+}
+
+static void CLG_ParticleJob(int arg)
+{
+    CLG_SimulateParticles();
+}
+
+#if USE_LIGHTSTYLES
+static void CLG_LightStyleJob(int arg)
+{
+    CLG_AddLightStyles();
+}
+#endif
+
+// publishes the averages once a second
+static void CLG_AccumulateSceneTimes(const clg_scene_times_t* times, sceneclock_t::time_point now)
+{
+    clg_scene_times_t* sum = &sceneTimesSum;
+
+    sum->entities += times->entities;
+    sum->particles += times->particles;
+    sum->lightstyles += times->lightstyles;
+    sum->merge += times->merge;
+    sum->effects += times->effects;
+    sum->total += times->total;
+    sceneTimesFrames++;
+
+    if (now - sceneTimesStart < std::chrono::seconds(1))
+        return;
+
+    sceneTimes.entities = sum->entities / sceneTimesFrames;
+    sceneTimes.particles = sum->particles / sceneTimesFrames;
+    sceneTimes.lightstyles = sum->lightstyles / sceneTimesFrames;
+    sceneTimes.merge = sum->merge / sceneTimesFrames;
+    sceneTimes.effects = sum->effects / sceneTimesFrames;
+    sceneTimes.total = sum->total / sceneTimesFrames;
+    sceneTimes.threads = times->threads;
+
+    memset(sum, 0, sizeof(*sum));
+    sceneTimesFrames = 0;
+    sceneTimesStart = now;
+}
+
 //
 //===============
 // V_Init
@@ -179,6 +427,7 @@ void V_Init(void)
     //cl_add_blend->changed = cl_add_blend_changed;
 
     cl_adjustfov        = clgi.Cvar_Get("cl_adjustfov", "1", 0);
+    cl_scene_threads    = clgi.Cvar_Get("cl_scene_threads", "0", 0);
 
     // Register possible view related commands and cvars here.
     // ...
@@ -193,6 +442,7 @@ void V_Init(void)
 //
 void V_Shutdown(void)
 {
+    CLG_StopSceneThreads();
 
     // Unregister cmd's here.
     // ...
@@ -346,27 +596,77 @@ first:
 // CLG_AddEntities
 // 
 // Adds all the CG Module entities to tthe current frame scene.
+//
+// Packet entities are split into chunks that are interpolated on the scene
+// threads, next to the particle simulation and light styles. The chunk
+// buffers are then merged in order on this thread, which also runs the
+// stages that spawn particles or register media.
 //===============
 //
 static void CLG_AddEntities (void) {
+    scenejob_t          jobs[MAX_SCENE_JOBS];
+    clg_scene_times_t   times = {};
+    int                 i, numjobs = 0, numchunks, numthreads;
+
+    const sceneclock_t::time_point start = sceneclock_t::now();
+
     // Calculate client view values.
     CLG_UpdateOrigin();
 
     // Finish calculating view values.
     CLG_FinishViewValues();
 
+    numthreads = cl_scene_threads->integer;
+    if (numthreads < 1)
+        numthreads = std::thread::hardware_concurrency();
+    clamp(numthreads, 1, MAX_SCENE_THREADS);
+
+    numchunks = cl->frame.numEntities / MIN_SCENE_CHUNK;
+    clamp(numchunks, 1, numthreads);
+
+    for (i = 0; i < numchunks; i++) {
+        sceneChunks[i].first = cl->frame.numEntities * i / numchunks;
+        sceneChunks[i].last = cl->frame.numEntities * (i + 1) / numchunks;
+        jobs[numjobs++] = { CLG_PacketEntityJob, i };
+    }
+    jobs[numjobs++] = { CLG_ParticleJob, 0 };
+#if USE_LIGHTSTYLES
+    jobs[numjobs++] = { CLG_LightStyleJob, 0 };
+#endif
+
+    CLG_RunSceneJobs(jobs, numjobs, numthreads);
+
+    const sceneclock_t::time_point merge = sceneclock_t::now();
+
+    // Merge in entity order, spawning the trails on the way.
+    for (i = 0; i < numchunks; i++)
+        CLG_FinishPacketEntities(&sceneBuffers[i]);
+
+    const sceneclock_t::time_point effects = sceneclock_t::now();
+
     // Add entities here.
-    CLG_AddPacketEntities();
     CLG_AddTempEntities();
-    CLG_AddParticles();
+    CLG_FinishParticles();
 
 #if USE_DLIGHTS
     CLG_AddDLights();
 #endif
+    //LOC_AddLocationsToScene();
+
+    const sceneclock_t::time_point end = sceneclock_t::now();
+
+    for (i = 0; i < numchunks; i++)
+        times.entities += jobs[i].msec;
+    times.particles = jobs[numchunks].msec;
 #if USE_LIGHTSTYLES
-    CLG_AddLightStyles();
+    times.lightstyles = jobs[numchunks + 1].msec;
 #endif
-    //LOC_AddLocationsToScene();
+    times.merge = std::chrono::duration<double, std::milli>(effects - merge).count();
+    times.effects = std::chrono::duration<double, std::milli>(end - effects).count();
+    times.total = std::chrono::duration<double, std::milli>(end - start).count();
+    times.threads = numthreads;
+
+    CLG_AccumulateSceneTimes(&times, end);
 }
 
 //
@@ -18,6 +18,58 @@ void V_AddLightEx(const vec3_t& org, float intensity, float r, float g, float b,
 void V_AddLightStyle(int style, const vec4_t& value);
 void V_AddParticle(rparticle_t* p);
 
+//
+// Scene build.
+//
+// CLG_RenderView fans the scene build out over up to MAX_SCENE_THREADS
+// threads, the calling one included. Stages that run on a worker fill in
+// their own scene buffer, which is merged into the view afterwards.
+//
+#define MAX_SCENE_THREADS   8
+
+// Trail effect of a packet entity, spawned on the main thread.
+typedef struct {
+    cl_entity_t *cent;
+    vec3_t      start;
+    vec3_t      end;
+    int         effects;
+} clg_scene_trail_t;
+
+// Disguise skin for a range of buffered entities, registered on the main thread.
+typedef struct {
+    int         first;
+    int         last;
+    ClientInfo  *ci;
+} clg_scene_skin_t;
+
+typedef struct clg_scene_buffer_s {
+    r_entity_t          entities[MAX_ENTITIES];
+    int                 num_entities;
+#if USE_DLIGHTS
+    rdlight_t           dlights[MAX_DLIGHTS];
+    int                 num_dlights;
+#endif
+    clg_scene_trail_t   trails[MAX_PACKET_ENTITIES];
+    int                 num_trails;
+    clg_scene_skin_t    skins[MAX_CLIENTS];
+    int                 num_skins;
+} clg_scene_buffer_t;
+
+// Per stage times of the scene build in milliseconds, averaged over a second.
+typedef struct {
+    double  entities;       // packet entities, summed over all threads
+    double  particles;      // particle simulation
+    double  lightstyles;
+    double  merge;          // merging the buffers and spawning trails
+    double  effects;        // temp entities, new particles and dlights
+    double  total;          // wall time of the whole build
+    int     threads;
+} clg_scene_times_t;
+
+void CLG_SceneAddEntity(clg_scene_buffer_t* buffer, const r_entity_t* ent);
+void CLG_SceneAddLight(clg_scene_buffer_t* buffer, const vec3_t& org, float intensity, float r, float g, float b, float radius);
+const clg_scene_times_t* CLG_GetSceneTimes(void);
+
 float CLG_CalculateFOV(float fov_x, float width, float height);
 void CLG_UpdateOrigin(void);
 
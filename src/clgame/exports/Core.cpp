@@ -137,6 +137,8 @@ static const cmdreg_t cmd_cgmodule[] = {
     // Client commands.
     //
     { "skins", CL_Skins_f },
+    { "tracebench", CLG_TraceBenchmark_f },
+    { "particlebench", CLG_ParticleBenchmark_f },
 
     //
     // Forward to server commands
@@ -187,6 +189,7 @@ void ClientGameCore::Initialize() {
     cl_monsterfootsteps = clgi.Cvar_Get("cl_monsterfootsteps", "1", 0);
     cl_player_model = clgi.Cvar_Get("cl_player_model", va("%d", CL_PLAYER_MODEL_FIRST_PERSON), CVAR_ARCHIVE);
     cl_player_model->changed = cl_player_model_changed;
+    cl_showpmoves = clgi.Cvar_Get("cl_showpmoves", "0", 0);
     cl_thirdperson_angle = clgi.Cvar_Get("cl_thirdperson_angle", "0", 0);
     cl_thirdperson_range = clgi.Cvar_Get("cl_thirdperson_range", "60", 0);
 
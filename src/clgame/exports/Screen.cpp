@@ -64,6 +64,9 @@ void ClientGameScreen::RenderScreen() {
     // Draw FPS.
     SCR_DrawFPS();
 
+    // Draw scene build times.
+    SCR_DrawSceneTimes();
+
     // Draw Chat Hud.
     SCR_DrawChatHUD();
 }
@@ -41,36 +41,8 @@ void ClientGameView::ClearScene() {
 //
 //---------------
 void ClientGameView::RenderView() {
-    // Calculate client view values.
-    CLG_UpdateOrigin();
-
-    // Finish calculating view values.
-    CLG_FinishViewValues();
-
-    // Add entities here.
-    CLG_AddPacketEntities();
-    CLG_AddTempEntities();
-    CLG_AddParticles();
-
-#if USE_DLIGHTS
-    CLG_AddDLights();
-#endif
-#if USE_LIGHTSTYLES
-    CLG_AddLightStyles();
-#endif
-
-    // Last but not least, pass our array over to the client.
-    cl->refdef.num_entities = view.num_entities;
-    cl->refdef.entities = view.entities;
-    cl->refdef.num_particles = view.num_particles;
-    cl->refdef.particles = view.particles;
-#if USE_DLIGHTS
-    cl->refdef.num_dlights = view.num_dlights;
-    cl->refdef.dlights = view.dlights;
-#endif
-#if USE_LIGHTSTYLES
-    cl->refdef.lightstyles = view.lightstyles;
-#endif
+    // Builds the scene on the scene threads and passes it to the client.
+    CLG_RenderView();
 }
 
 //---------------
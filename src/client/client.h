@@ -441,6 +441,7 @@ extern mz_params_t      mz;
 extern snd_params_t     snd;
 
 void CL_ParseServerMessage(void);
+void CL_ParseBenchmark_f(void);
 void CL_SeekDemoMessage(void);
 
 
@@ -103,14 +103,12 @@ entity_update_old(cl_entity_t *ent, const EntityState *state, const vec_t *origi
     ent->prev = ent->current;
 }
 
-static inline qboolean entity_new(const cl_entity_t *ent)
+// the parts of entity_new that are the same for every entity in the frame
+static qboolean frame_new(void)
 {
     if (!cl.oldframe.valid)
         return true;   // last received frame was invalid
 
-    if (ent->serverFrame != cl.oldframe.number)
-        return true;   // wasn't in last received frame
-
     if (cl_nolerp->integer == 2)
         return true;   // developer option, always new
 
@@ -123,11 +121,23 @@ static inline qboolean entity_new(const cl_entity_t *ent)
     return false;
 }
 
-static void entity_update(const EntityState *state)
+static inline qboolean entity_new(const cl_entity_t *ent, qboolean framenew)
+{
+    if (framenew)
+        return true;
+
+    if (ent->serverFrame != cl.oldframe.number)
+        return true;   // wasn't in last received frame
+
+    return false;
+}
+
+static void entity_update(const EntityState *state, qboolean framenew)
 {
     cl_entity_t *ent = &cs.entities[state->number];
     const vec_t *origin;
     vec3_t origin_v;
+    qboolean optimized = entity_optimized(state);
 
     // if entity is solid, decode mins/maxs and add to the list
     if (state->solid && state->number != cl.frame.clientNumber + 1
@@ -140,13 +150,13 @@ static void entity_update(const EntityState *state)
     }
 
     // work around Q2PRO server bandwidth optimization
-    if (entity_optimized(state)) {
+    if (optimized) {
         origin = origin_v = cl.frame.playerState.pmove.origin;
     } else {
         origin = state->origin;
     }
 
-    if (entity_new(ent)) {
+    if (entity_new(ent, framenew)) {
         // wasn't in last update, so initialize some things
         entity_update_new(ent, state, origin);
     } else {
@@ -157,7 +167,7 @@ static void entity_update(const EntityState *state)
     ent->current = *state;
 
     // work around Q2PRO server bandwidth optimization
-    if (entity_optimized(state)) {
+    if (optimized) {
         Com_PlayerToEntityState(&cl.frame.playerState, &ent->current);
     }
 }
@@ -285,6 +295,7 @@ void CL_DeltaFrame(void)
     int                 i, j;
     int                 frameNumber;
     int                 prevstate = cls.connectionState;
+    qboolean            framenew;
 
     // getting a valid frame message ends the connection process
     if (cls.connectionState == ClientConnectionState::Precached)
@@ -303,12 +314,14 @@ void CL_DeltaFrame(void)
     ent = &cs.entities[cl.frame.clientNumber + 1];
     Com_PlayerToEntityState(&cl.frame.playerState, &ent->current);
 
+    framenew = frame_new();
+
     for (i = 0; i < cl.frame.numEntities; i++) {
         j = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
         state = &cl.entityStates[j];
 
         // set current and prev
-        entity_update(state);
+        entity_update(state, framenew);
 
         // fire events
         entity_event(state->number);
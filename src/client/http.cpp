@@ -870,6 +870,9 @@ fail2:
                             dl->path, dl->queue->path, strerror(errno));
             dl->path[0] = 0;
 
+            // file may have been looked up and cached as missing before
+            FS_InvalidatePathCache();
+
             //a pak file is very special...
             if (dl->queue->type == DL_PAK) {
                 CL_RestartFilesystem(false);
@@ -2571,6 +2571,7 @@ static const cmdreg_t c_client[] = {
 //    { "msgtab", CL_Msgtab_f, CL_Msgtab_g },
     { "vid_restart", CL_RestartRefresh_f },
     { "r_reload", CL_ReloadRefresh_f },
+    { "parsebench", CL_ParseBenchmark_f },
 
     //
     // forward to server commands
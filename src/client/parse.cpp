@@ -17,6 +17,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 // cl_parse.c  -- parse a message received from the server
 
+#include <chrono>
+
 #include "client.h"
 #include "client/gamemodule.h"
 #include "shared/clgame.h"
@@ -32,21 +34,28 @@ extern IClientGameExports* cge;
 =====================================================================
 */
 
-static inline void CL_ParseDeltaEntity(ServerFrame  *frame,
-                                       int             newnum,
-                                       EntityState  *old,
-                                       int             bits)
+// Contiguous scratch copies of the old and new frame entities, used when
+// either one would wrap around the end of cl.entityStates.
+static EntityState  cl_oldstates[MAX_EDICTS];
+static EntityState  cl_newstates[MAX_EDICTS];
+
+static void CL_ParseCapture(const EntityState *oldstates, int numold, size_t start);
+
+static inline void CL_ParseDeltaEntity(EntityState        *out,
+                                       int                *count,
+                                       int                newnum,
+                                       const EntityState  *old,
+                                       int                bits,
+                                       qboolean           unchecked)
 {
     EntityState    *state;
 
     // suck up to MAX_EDICTS for servers that don't cap at MAX_PACKET_ENTITIES
-    if (frame->numEntities >= MAX_EDICTS) {
+    if (*count >= MAX_EDICTS) {
         Com_Error(ERR_DROP, "%s: MAX_EDICTS exceeded", __func__);
     }
 
-    state = &cl.entityStates[cl.numEntityStates & PARSE_ENTITIES_MASK];
-    cl.numEntityStates++;
-    frame->numEntities++;
+    state = &out[(*count)++];
 
 #ifdef _DEBUG
     if (cl_shownet->integer > 2 && bits) {
@@ -55,42 +64,47 @@ static inline void CL_ParseDeltaEntity(ServerFrame  *frame,
     }
 #endif
 
-    MSG_ParseDeltaEntity(old, state, newnum, bits, cl.esFlags);
+    if (unchecked)
+        MSG_ParseDeltaEntityUnchecked(old, state, newnum, bits, cl.esFlags);
+    else
+        MSG_ParseDeltaEntity(old, state, newnum, bits, cl.esFlags);
 
     // shuffle previous origin to old
     if (!(bits & U_OLDORIGIN) && !(state->renderEffects & RenderEffects::Beam))
         VectorCopy(old->origin, state->oldOrigin);
 }
 
-static void CL_ParsePacketEntities(ServerFrame *oldframe,
-                                   ServerFrame *frame)
+/*
+==================
+CL_ParseEntityBlock
+
+Merges the entity deltas in msg_read against oldstates (NULL if there is no
+frame to delta from) and writes the new frame contiguously to out. While at
+least MAX_ENTITY_DELTA_BYTES of the message are left, an entity is read with
+the unchecked readers, so the bounds are tested once per entity rather than
+once per field. Returns the number of entities in the new frame.
+==================
+*/
+static int CL_ParseEntityBlock(const EntityState  *oldstates,
+                               int                numold,
+                               EntityState        *out,
+                               qboolean           fast)
 {
-    int            newnum;
-    int            bits;
-    EntityState    *oldstate;
-    int            oldindex, oldnum;
-    int i;
+    const EntityState   *oldstate;
+    int                 newnum, bits, oldindex, oldnum, count;
+    qboolean            unchecked;
 
-    frame->firstEntity = cl.numEntityStates;
-    frame->numEntities = 0;
-
-    // delta from the entities present in oldframe
+    count = 0;
     oldindex = 0;
-    oldstate = NULL;
-    if (!oldframe) {
-        oldnum = 99999;
-    } else {
-        if (oldindex >= oldframe->numEntities) {
-            oldnum = 99999;
-        } else {
-            i = oldframe->firstEntity + oldindex;
-            oldstate = &cl.entityStates[i & PARSE_ENTITIES_MASK];
-            oldnum = oldstate->number;
-        }
-    }
+    oldstate = oldstates;
+    oldnum = numold ? oldstate->number : 99999;
 
     while (1) {
-        newnum = MSG_ParseEntityBits(&bits);
+        unchecked = fast && msg_read.currentSize - msg_read.readCount >= MAX_ENTITY_DELTA_BYTES;
+        if (unchecked)
+            newnum = MSG_ParseEntityBitsUnchecked(&bits);
+        else
+            newnum = MSG_ParseEntityBits(&bits);
         if (newnum < 0 || newnum >= MAX_EDICTS) {
             Com_Error(ERR_DROP, "%s: bad number: %d", __func__, newnum);
         }
@@ -106,17 +120,10 @@ static void CL_ParsePacketEntities(ServerFrame *oldframe,
         while (oldnum < newnum) {
             // one or more entities from the old packet are unchanged
             SHOWNET(3, "   unchanged: %i\n", oldnum);
-            CL_ParseDeltaEntity(frame, oldnum, oldstate, 0);
+            CL_ParseDeltaEntity(out, &count, oldnum, oldstate, 0, true);
 
-            oldindex++;
-
-            if (oldindex >= oldframe->numEntities) {
-                oldnum = 99999;
-            } else {
-                i = oldframe->firstEntity + oldindex;
-                oldstate = &cl.entityStates[i & PARSE_ENTITIES_MASK];
-                oldnum = oldstate->number;
-            }
+            oldstate = &oldstates[++oldindex];
+            oldnum = oldindex < numold ? oldstate->number : 99999;
         }
 
         if (bits & U_REMOVE) {
@@ -125,70 +132,244 @@ static void CL_ParsePacketEntities(ServerFrame *oldframe,
             if (oldnum != newnum) {
                 Com_DPrintf("U_REMOVE: oldnum != newnum\n");
             }
-            if (!oldframe) {
+            if (!oldstates) {
                 Com_Error(ERR_DROP, "%s: U_REMOVE with NULL oldframe", __func__);
             }
 
-            oldindex++;
-
-            if (oldindex >= oldframe->numEntities) {
-                oldnum = 99999;
-            } else {
-                i = oldframe->firstEntity + oldindex;
-                oldstate = &cl.entityStates[i & PARSE_ENTITIES_MASK];
-                oldnum = oldstate->number;
-            }
+            oldstate = &oldstates[++oldindex];
+            oldnum = oldindex < numold ? oldstate->number : 99999;
             continue;
         }
 
         if (oldnum == newnum) {
             // delta from previous state
             SHOWNET(2, "   delta: %i ", newnum);
-            CL_ParseDeltaEntity(frame, newnum, oldstate, bits);
+            CL_ParseDeltaEntity(out, &count, newnum, oldstate, bits, unchecked);
             if (!bits) {
                 SHOWNET(2, "\n");
             }
 
-            oldindex++;
-
-            if (oldindex >= oldframe->numEntities) {
-                oldnum = 99999;
-            } else {
-                i = oldframe->firstEntity + oldindex;
-                oldstate = &cl.entityStates[i & PARSE_ENTITIES_MASK];
-                oldnum = oldstate->number;
-            }
+            oldstate = &oldstates[++oldindex];
+            oldnum = oldindex < numold ? oldstate->number : 99999;
             continue;
         }
 
         if (oldnum > newnum) {
             // delta from baseline
             SHOWNET(2, "   baseline: %i ", newnum);
-            CL_ParseDeltaEntity(frame, newnum, &cl.entityBaselines[newnum], bits);
+            CL_ParseDeltaEntity(out, &count, newnum, &cl.entityBaselines[newnum], bits, unchecked);
             if (!bits) {
                 SHOWNET(2, "\n");
             }
             continue;
         }
-
     }
 
     // any remaining entities in the old frame are copied over
     while (oldnum != 99999) {
         // one or more entities from the old packet are unchanged
         SHOWNET(3, "   unchanged: %i\n", oldnum);
-        CL_ParseDeltaEntity(frame, oldnum, oldstate, 0);
+        CL_ParseDeltaEntity(out, &count, oldnum, oldstate, 0, true);
+
+        oldstate = &oldstates[++oldindex];
+        oldnum = oldindex < numold ? oldstate->number : 99999;
+    }
 
-        oldindex++;
+    return count;
+}
 
-        if (oldindex >= oldframe->numEntities) {
-            oldnum = 99999;
+static void CL_ParsePacketEntities(ServerFrame *oldframe,
+                                   ServerFrame *frame)
+{
+    EntityState    *oldstates, *newstates;
+    int            numold, first, count;
+    size_t         start = msg_read.readCount;
+
+    // the old frame is delta'd from in place unless it wraps
+    oldstates = NULL;
+    numold = 0;
+    if (oldframe) {
+        numold = oldframe->numEntities;
+        first = oldframe->firstEntity & PARSE_ENTITIES_MASK;
+        if (first + numold <= MAX_PARSE_ENTITIES) {
+            oldstates = &cl.entityStates[first];
         } else {
-            i = oldframe->firstEntity + oldindex;
-            oldstate = &cl.entityStates[i & PARSE_ENTITIES_MASK];
-            oldnum = oldstate->number;
+            count = MAX_PARSE_ENTITIES - first;
+            memcpy(cl_oldstates, &cl.entityStates[first], count * sizeof(EntityState));
+            memcpy(cl_oldstates + count, cl.entityStates, (numold - count) * sizeof(EntityState));
+            oldstates = cl_oldstates;
         }
     }
+
+    // likewise, the new frame is parsed straight into place if it can't wrap
+    frame->firstEntity = cl.numEntityStates;
+    first = frame->firstEntity & PARSE_ENTITIES_MASK;
+    if (first + MAX_EDICTS <= MAX_PARSE_ENTITIES)
+        newstates = &cl.entityStates[first];
+    else
+        newstates = cl_newstates;
+
+    frame->numEntities = CL_ParseEntityBlock(oldstates, numold, newstates, true);
+    cl.numEntityStates += frame->numEntities;
+
+    if (newstates == cl_newstates) {
+        count = min(frame->numEntities, MAX_PARSE_ENTITIES - first);
+        memcpy(&cl.entityStates[first], cl_newstates, count * sizeof(EntityState));
+        memcpy(cl.entityStates, cl_newstates + count, (frame->numEntities - count) * sizeof(EntityState));
+    }
+
+    CL_ParseCapture(oldstates, numold, start);
+}
+
+/*
+=====================================================================
+
+  PARSING BENCHMARK
+
+=====================================================================
+*/
+
+typedef struct {
+    EntityState *oldstates;     // NULL if there was no frame to delta from
+    int         numold;
+    byte        *data;
+    size_t      size;
+} parsecapture_t;
+
+static struct {
+    parsecapture_t  *frames;
+    int             numframes;
+    int             maxframes;
+} cl_capture;
+
+static void CL_FreeCaptures(void)
+{
+    for (int i = 0; i < cl_capture.numframes; i++) {
+        Z_Free(cl_capture.frames[i].oldstates);
+        Z_Free(cl_capture.frames[i].data);
+    }
+    Z_Free(cl_capture.frames);
+    memset(&cl_capture, 0, sizeof(cl_capture));
+}
+
+// Keeps a copy of the entity block just parsed, together with the states it
+// was delta'd from, so it can be parsed again by the benchmark.
+static void CL_ParseCapture(const EntityState *oldstates, int numold, size_t start)
+{
+    parsecapture_t *cap;
+
+    if (cl_capture.numframes >= cl_capture.maxframes)
+        return;
+
+    cap = &cl_capture.frames[cl_capture.numframes++];
+    cap->numold = numold;
+    cap->oldstates = NULL;
+    if (oldstates) {
+        cap->oldstates = (EntityState *)Z_Malloc(max(numold, 1) * sizeof(EntityState));
+        memcpy(cap->oldstates, oldstates, numold * sizeof(EntityState));
+    }
+    // pad as if the rest of the message followed, so the unchecked readers
+    // get to the end of the block as they would in a live message
+    cap->size = msg_read.readCount - start + MAX_ENTITY_DELTA_BYTES;
+    cap->data = (byte *)Z_Mallocz(cap->size);
+    memcpy(cap->data, msg_read.data + start, msg_read.readCount - start);
+
+    if (cl_capture.numframes == cl_capture.maxframes)
+        Com_Printf("Captured %d frames, use 'parsebench run' to parse them.\n", cl_capture.numframes);
+}
+
+static double CL_ParseCaptures(int runs, qboolean fast, int *total)
+{
+    using clock = std::chrono::steady_clock;
+    parsecapture_t *cap;
+    int i, j;
+
+    *total = 0;
+    auto start = clock::now();
+    for (j = 0; j < runs; j++) {
+        for (i = 0, cap = cl_capture.frames; i < cl_capture.numframes; i++, cap++) {
+            msg_read.data = cap->data;
+            msg_read.maximumSize = msg_read.currentSize = cap->size;
+            msg_read.readCount = msg_read.bitPosition = 0;
+            *total += CL_ParseEntityBlock(cap->oldstates, cap->numold, cl_newstates, fast);
+        }
+    }
+    return std::chrono::duration<double, std::milli>(clock::now() - start).count();
+}
+
+/*
+===============
+CL_ParseBenchmark_f
+
+parsebench capture [frames]
+parsebench run [runs]
+parsebench clear
+
+Captures the entity blocks of the next frames received from the server or
+read from a demo, then parses them again with the unchecked and the checked
+readers, verifying both produce the same states. New entities are delta'd
+from the current baselines.
+===============
+*/
+void CL_ParseBenchmark_f(void)
+{
+    static EntityState checked[MAX_EDICTS];
+    SizeBuffer saved;
+    parsecapture_t *cap;
+    int i, runs, count, total;
+    const char *cmd = Cmd_Argv(1);
+
+    if (!strcmp(cmd, "capture")) {
+        CL_FreeCaptures();
+        cl_capture.maxframes = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 1000;
+        clamp(cl_capture.maxframes, 1, 100000);
+        cl_capture.frames = (parsecapture_t *)Z_Mallocz(cl_capture.maxframes * sizeof(parsecapture_t));
+        Com_Printf("Capturing %d frames.\n", cl_capture.maxframes);
+        return;
+    }
+
+    if (!strcmp(cmd, "clear")) {
+        CL_FreeCaptures();
+        return;
+    }
+
+    if (strcmp(cmd, "run")) {
+        Com_Printf("Usage: %s <capture [frames]|run [runs]|clear>\n", Cmd_Argv(0));
+        return;
+    }
+
+    if (!cl_capture.numframes) {
+        Com_Printf("No frames captured.\n");
+        return;
+    }
+
+    runs = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 100;
+    clamp(runs, 1, 100000);
+
+    saved = msg_read;
+
+    // verify the unchecked readers against the checked ones
+    for (i = 0, cap = cl_capture.frames; i < cl_capture.numframes; i++, cap++) {
+        msg_read.data = cap->data;
+        msg_read.maximumSize = msg_read.currentSize = cap->size;
+        msg_read.readCount = msg_read.bitPosition = 0;
+        count = CL_ParseEntityBlock(cap->oldstates, cap->numold, checked, false);
+
+        msg_read.readCount = msg_read.bitPosition = 0;
+        if (CL_ParseEntityBlock(cap->oldstates, cap->numold, cl_newstates, true) != count ||
+            memcmp(checked, cl_newstates, count * sizeof(EntityState))) {
+            Com_Printf("Frame %d parsed differently.\n", i);
+        }
+    }
+
+    double checkedms = CL_ParseCaptures(runs, false, &total);
+    double fastms = CL_ParseCaptures(runs, true, &total);
+
+    msg_read = saved;
+
+    Com_Printf("%d frames, %d entities, %d runs: checked %.3f ms, unchecked %.3f ms (%.2fx)\n",
+               cl_capture.numframes, total / runs, runs, checkedms, fastms,
+               fastms > 0 ? checkedms / fastms : 0.0);
 }
 
 static void CL_ParseFrame(int extrabits)
@@ -84,6 +84,61 @@ void CL_RegisterBspModels(void)
 }
 
 
+/*
+=================
+CL_PrefetchMedia
+
+Queues reads for the world, models and sounds up front, so the I/O threads
+can load them while registration is busy parsing the files before them.
+=================
+*/
+static void CL_PrefetchMedia(void)
+{
+    char path[MAX_QPATH];
+    char *name;
+    size_t len;
+    int i;
+
+    // world first, everything else waits on it
+    FS_PrefetchFile(cl.configstrings[ConfigStrings::Models + 1], FS_PRIORITY_WORLD);
+
+    for (i = 2; i < MAX_MODELS; i++) {
+        name = cl.configstrings[ConfigStrings::Models + i];
+        if (!name[0]) {
+            break;
+        }
+        if (name[0] == '*' || name[0] == '#') {
+            continue;
+        }
+
+        // R_RegisterModel prefers an MD3 replacement of MD2 models
+        len = Q_strlcpy(path, name, sizeof(path));
+        if (len > 4 && len < sizeof(path) && !Q_stricmp(path + len - 4, ".md2")) {
+            memcpy(path + len - 4, ".md3", 4);
+            if (FS_PrefetchFile(path, FS_PRIORITY_MODEL)) {
+                continue;
+            }
+        }
+        FS_PrefetchFile(name, FS_PRIORITY_MODEL);
+    }
+
+    for (i = 1; i < MAX_SOUNDS; i++) {
+        name = cl.configstrings[ConfigStrings::Sounds + i];
+        if (!name[0]) {
+            break;
+        }
+        // sexed sounds are resolved per player model
+        if (name[0] == '*') {
+            continue;
+        }
+        if (name[0] == '#') {
+            FS_PrefetchFile(name + 1, FS_PRIORITY_SOUND);
+        } else if (Q_concat(path, sizeof(path), "sound/", name, NULL) < sizeof(path)) {
+            FS_PrefetchFile(path, FS_PRIORITY_SOUND);
+        }
+    }
+}
+
 /*
 =================
 CL_PrepareMedia
@@ -98,6 +153,8 @@ void CL_PrepareMedia(void)
     if (!cl.mapName[0])
         return;     // no map loaded
 
+    // issue all reads up front
+    CL_PrefetchMedia();
 
     // register models, pics, and skins
     R_BeginRegistration(cl.mapName);
@@ -117,6 +174,9 @@ void CL_PrepareMedia(void)
     // the renderer can now free unneeded stuff
     R_EndRegistration(cl.mapName);
 
+    // drop whatever has been prefetched but not used
+    FS_FlushAsyncLoads();
+
     // clear any lines of console text
     Con_ClearNotify_f();
 
@@ -17,7 +17,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 // snd_dma.c -- main control for any streaming sound output device
 
+#include <chrono>
+#include <thread>
+
 #include "sound.h"
+#include "common/files.h"
+
+#define MIXER_COMMANDS      256     // must be a power of two
+#define MIXER_SLEEP_MSEC    2
 
 dma_t       dma;
 
@@ -27,9 +34,143 @@ cvar_t      *s_testsound;
 static cvar_t       *s_direct;
 #endif
 static cvar_t       *s_mixahead;
+static cvar_t       *s_mixthread;
+static cvar_t       *s_mixthread_ahead;
+static cvar_t       *s_nulldma;
+static cvar_t       *s_dmafile;
 
 static snddmaAPI_t snddma;
 
+// The mixer thread owns the channels, the playsound lists and paintedtime
+// while it runs. The main thread reaches it through a single producer,
+// single consumer ring of commands, so neither side ever blocks the other.
+static struct {
+    std::thread             thread;
+    std::atomic<bool>       quit;
+    bool                    running;        // main thread only
+
+    s_command_t             commands[MIXER_COMMANDS];
+    std::atomic<unsigned>   head;           // next command written by the main thread
+    std::atomic<unsigned>   tail;           // next command read by the mixer
+
+    std::atomic<int>        paintedtime;    // published after each mix
+    std::atomic<int>        overflows;      // reported by the main thread
+} dma_mixer;
+
+/*
+===============================================================================
+
+NULL OUTPUT
+
+Stands in for a sound device. The play position follows the wall clock,
+and with s_dmafile set, everything played is appended to that file in the
+game directory as raw 16 bit stereo samples. This keeps the mixer running,
+and its output checkable, on machines without a sound device.
+
+===============================================================================
+*/
+
+static struct {
+    FILE        *file;
+    unsigned    start;          // msec
+    uint64_t    written;        // sample pairs written to file
+} null_dma;
+
+static sndinitstat_t NULL_Init(void)
+{
+    char    path[MAX_OSPATH];
+
+    switch (s_khz->integer) {
+    case 48:
+        dma.speed = 48000;
+        break;
+    case 44:
+        dma.speed = 44100;
+        break;
+    case 22:
+        dma.speed = 22050;
+        break;
+    default:
+        dma.speed = 11025;
+        break;
+    }
+
+    dma.channels = 2;
+    dma.samples = 0x8000 * dma.channels;
+    dma.submission_chunk = 1;
+    dma.samplebits = 16;
+    dma.buffer = (byte *)Z_Mallocz(dma.samples * 2);
+    dma.samplepos = 0;
+
+    null_dma.start = Sys_Milliseconds();
+    null_dma.written = 0;
+    null_dma.file = NULL;
+
+    if (*s_dmafile->string) {
+        if (Q_concat(path, sizeof(path), fs_gamedir, "/", s_dmafile->string, NULL) >= sizeof(path)) {
+            Com_EPrintf("Oversize sound output path\n");
+        } else if (!(null_dma.file = fopen(path, "wb"))) {
+            Com_EPrintf("Couldn't open %s: %s\n", path, strerror(errno));
+        } else {
+            Com_Printf("Writing sound output to %s\n", path);
+        }
+    }
+
+    Com_Printf("Using null sound output.\n");
+
+    return SIS_SUCCESS;
+}
+
+static void NULL_Shutdown(void)
+{
+    if (null_dma.file) {
+        fclose(null_dma.file);
+        null_dma.file = NULL;
+    }
+
+    if (dma.buffer) {
+        Z_Free(dma.buffer);
+        dma.buffer = NULL;
+    }
+}
+
+static void NULL_BeginPainting(void)
+{
+    uint64_t    played = (uint64_t)(Sys_Milliseconds() - null_dma.start) * dma.speed / 1000;
+    int         fullsamples = dma.samples / dma.channels;
+    int         pos, count;
+
+    if (null_dma.file) {
+        // anything older than the buffer has been painted over
+        if (played - null_dma.written > (uint64_t)fullsamples)
+            null_dma.written = played - fullsamples;
+
+        while (null_dma.written < played) {
+            pos = null_dma.written & (fullsamples - 1);
+            count = min(played - null_dma.written, (uint64_t)(fullsamples - pos));
+            fwrite(dma.buffer + pos * 4, 4, count, null_dma.file);
+            null_dma.written += count;
+        }
+    }
+
+    dma.samplepos = (played & (fullsamples - 1)) * dma.channels;
+}
+
+static void NULL_Submit(void)
+{
+}
+
+static void NULL_FillAPI(snddmaAPI_t *api)
+{
+    api->Init = NULL_Init;
+    api->Shutdown = NULL_Shutdown;
+    api->BeginPainting = NULL_BeginPainting;
+    api->Submit = NULL_Submit;
+    api->Activate = NULL;
+}
+
+//=============================================================================
+
 void DMA_SoundInfo(void)
 {
     Com_Printf("%5d channels\n", dma.channels);
@@ -49,11 +190,19 @@ qboolean DMA_Init(void)
 
     s_khz = Cvar_Get("s_khz", "44", CVAR_ARCHIVE | CVAR_SOUND);
     s_mixahead = Cvar_Get("s_mixahead", "0.1", CVAR_ARCHIVE);
+    s_mixthread = Cvar_Get("s_mixthread", "1", CVAR_ARCHIVE | CVAR_SOUND);
+    s_mixthread_ahead = Cvar_Get("s_mixthread_ahead", "0.025", CVAR_ARCHIVE);
     s_testsound = Cvar_Get("s_testsound", "0", 0);
+    s_nulldma = Cvar_Get("s_nulldma", "0", CVAR_SOUND);
+    s_dmafile = Cvar_Get("s_dmafile", "", CVAR_SOUND);
 
+    if (s_nulldma->integer) {
+        NULL_FillAPI(&snddma);
+        ret = snddma.Init();
+    }
 #if USE_DSOUND
     s_direct = Cvar_Get("s_direct", "1", CVAR_SOUND);
-    if (s_direct->integer) {
+    if (ret != SIS_SUCCESS && s_direct->integer) {
         DS_FillAPI(&snddma);
         ret = snddma.Init();
         if (ret != SIS_SUCCESS) {
@@ -80,15 +229,21 @@ qboolean DMA_Init(void)
 
 void DMA_Shutdown(void)
 {
+    DMA_StopMixer();
     snddma.Shutdown();
     s_numchannels = 0;
 }
 
 void DMA_Activate(void)
 {
+    qboolean    running;
+
     if (snddma.Activate) {
+        running = DMA_StopMixer();
         S_StopAllSounds();
         snddma.Activate(s_active);
+        if (running)
+            DMA_StartMixer();
     }
 }
 
@@ -97,19 +252,21 @@ int DMA_DriftBeginofs(float timeofs)
     static int  s_beginofs;
     int         start;
 
+    int         painted = DMA_PaintedTime();
+
     // drift s_beginofs
     start = cl.serverTime * 0.001 * dma.speed + s_beginofs;
-    if (start < paintedtime) {
-        start = paintedtime;
+    if (start < painted) {
+        start = painted;
         s_beginofs = start - (cl.serverTime * 0.001 * dma.speed);
-    } else if (start > paintedtime + 0.3 * dma.speed) {
-        start = paintedtime + 0.1 * dma.speed;
+    } else if (start > painted + 0.3 * dma.speed) {
+        start = painted + 0.1 * dma.speed;
         s_beginofs = start - (cl.serverTime * 0.001 * dma.speed);
     } else {
         s_beginofs -= 10;
     }
 
-    return timeofs ? start + timeofs * dma.speed : paintedtime;
+    return timeofs ? start + timeofs * dma.speed : painted;
 }
 
 void DMA_ClearBuffer(void)
@@ -141,7 +298,8 @@ static int DMA_GetTime(void)
             // time to chop things off to avoid 32 bit limits
             buffers = 0;
             paintedtime = fullsamples;
-            S_StopAllSounds();
+            S_ClearChannels();
+            S_ResetStreamTimes();
         }
     }
     oldsamplepos = dma.samplepos;
@@ -149,7 +307,7 @@ static int DMA_GetTime(void)
     return buffers * fullsamples + dma.samplepos / dma.channels;
 }
 
-void DMA_Update(void)
+static void DMA_Mix(float mixahead)
 {
     int soundtime, endTime;
     int samps;
@@ -164,12 +322,12 @@ void DMA_Update(void)
 
 // check to make sure that we haven't overshot
     if (paintedtime < soundtime) {
-        Com_DPrintf("S_Update_ : overflow\n");
+        dma_mixer.overflows++;
         paintedtime = soundtime;
     }
 
 // mix ahead of current position
-    endTime = soundtime + s_mixahead->value * dma.speed;
+    endTime = soundtime + mixahead * dma.speed;
 //endTime = (soundtime + 4096) & ~4095;
 
     // mix to an even submission block size
@@ -182,6 +340,154 @@ void DMA_Update(void)
     S_PaintChannels(endTime);
 
     snddma.Submit();
+
+    dma_mixer.paintedtime.store(paintedtime, std::memory_order_release);
+}
+
+static void DMA_RunCommands(void)
+{
+    unsigned tail = dma_mixer.tail.load(std::memory_order_relaxed);
+
+    while (tail != dma_mixer.head.load(std::memory_order_acquire)) {
+        S_RunCommand(&dma_mixer.commands[tail & (MIXER_COMMANDS - 1)]);
+        dma_mixer.tail.store(++tail, std::memory_order_release);
+    }
+}
+
+static void DMA_MixerThread(float mixahead)
+{
+    while (!dma_mixer.quit.load(std::memory_order_acquire)) {
+        DMA_RunCommands();
+        DMA_Mix(mixahead);
+        std::this_thread::sleep_for(std::chrono::milliseconds(MIXER_SLEEP_MSEC));
+    }
+}
+
+/*
+============
+DMA_Update
+
+Mixes on the main thread, unless the mixer thread is doing it.
+============
+*/
+void DMA_Update(void)
+{
+    int overflows = dma_mixer.overflows.exchange(0);
+
+    if (overflows)
+        Com_DPrintf("S_Update_ : %d overflows\n", overflows);
+
+    if (!dma_mixer.running)
+        DMA_Mix(s_mixahead->value);
+}
+
+/*
+============
+DMA_StartMixer
+
+Moves mixing to its own thread. It keeps a much shorter lead over the
+play position than the main thread could, since it is never held up by
+a slow frame.
+============
+*/
+void DMA_StartMixer(void)
+{
+    float   mixahead;
+
+    if (dma_mixer.running || !s_mixthread->integer)
+        return;
+
+    mixahead = Cvar_ClampValue(s_mixthread_ahead, 0.005f, 0.5f);
+
+    dma_mixer.quit = false;
+    dma_mixer.head = 0;
+    dma_mixer.tail = 0;
+    dma_mixer.paintedtime = paintedtime;
+    dma_mixer.thread = std::thread(DMA_MixerThread, mixahead);
+    dma_mixer.running = true;
+}
+
+/*
+============
+DMA_StopMixer
+
+Hands the channels back to the main thread. Returns true if the mixer
+thread was running.
+============
+*/
+qboolean DMA_StopMixer(void)
+{
+    if (!dma_mixer.running)
+        return false;
+
+    dma_mixer.quit = true;
+    dma_mixer.thread.join();
+    dma_mixer.running = false;
+
+    // commands queued after the last pass still need to run
+    DMA_RunCommands();
+
+    return true;
+}
+
+/*
+============
+DMA_Command
+
+Queues a command for the mixer thread, or runs it right away if there is
+none. Only waits when the mixer has fallen a full ring behind.
+============
+*/
+void DMA_Command(const s_command_t *cmd)
+{
+    unsigned head;
+
+    if (!dma_mixer.running) {
+        S_RunCommand(cmd);
+        return;
+    }
+
+    head = dma_mixer.head.load(std::memory_order_relaxed);
+    while (head - dma_mixer.tail.load(std::memory_order_acquire) >= MIXER_COMMANDS)
+        std::this_thread::yield();
+
+    dma_mixer.commands[head & (MIXER_COMMANDS - 1)] = *cmd;
+    dma_mixer.head.store(head + 1, std::memory_order_release);
+}
+
+/*
+============
+DMA_Flush
+
+Waits until the mixer has run every queued command.
+============
+*/
+void DMA_Flush(void)
+{
+    unsigned head;
+
+    if (!dma_mixer.running)
+        return;
+
+    head = dma_mixer.head.load(std::memory_order_relaxed);
+    while (dma_mixer.tail.load(std::memory_order_acquire) != head)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+/*
+============
+DMA_PaintedTime
+
+paintedtime as last published by the mixer, safe to read from the main
+thread.
+============
+*/
+int DMA_PaintedTime(void)
+{
+    if (dma_mixer.running)
+        return dma_mixer.paintedtime.load(std::memory_order_acquire);
+
+    return paintedtime;
 }
 
 
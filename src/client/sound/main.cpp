@@ -56,6 +56,36 @@ playsound_t s_playsounds[MAX_PLAYSOUNDS];
 playsound_t s_freeplays;
 playsound_t s_pendingplays;
 
+#if USE_SNDDMA
+// frames handed to the mixer, reused once it has moved past them
+#define     S_MAX_FRAMES    4       // must be a power of two
+static s_frame_t            s_frames[S_MAX_FRAMES];
+static unsigned             s_framesequence;    // last frame sent
+static std::atomic<unsigned> s_frameconsumed;   // frame the mixer is using
+static const s_frame_t      *s_mixframe = &s_frames[0];
+
+// Spatialization results are kept, and only recomputed once the listener
+// or the source has moved further than this, or the listener has turned.
+#define     SPATIAL_MOVE_EPSILON    1.0f
+#define     SPATIAL_TURN_EPSILON    0.9998f     // cosine, about one degree
+
+// listener the cached results are valid for, bumping the stamp drops them
+static vec3_t       s_spatialorigin;
+static vec3_t       s_spatialright;
+static qboolean     s_spatialactive;
+static qboolean     s_spatialswap;
+static unsigned     s_spatialstamp = 1;
+
+// last loop sound spatialization of each entity
+typedef struct {
+    vec3_t      origin;
+    unsigned    stamp;
+    int         left, right;
+} s_loopcache_t;
+
+static s_loopcache_t    s_loopcache[MAX_EDICTS];
+#endif
+
 cvar_t      *s_volume;
 cvar_t		*s_underwater;
 cvar_t		*s_underwater_gain_hf;
@@ -102,8 +132,10 @@ static void S_SoundInfo_f(void)
 #endif
 
 #if USE_SNDDMA
-    if (s_started == SS_DMA)
+    if (s_started == SS_DMA) {
         DMA_SoundInfo();
+        S_StreamInfo();
+    }
 #endif
 }
 
@@ -125,12 +157,22 @@ static void S_SoundList_f(void)
                 size = sc->size;
             else
 #endif
+#if USE_SNDDMA
+                size = ((sc->stream ? STREAM_CHUNK_SAMPLES : sc->samples) + 1) * sc->width;
+#else
                 size = sc->length * sc->width;
+#endif
             total += size;
             if (sc->loopstart >= 0)
                 Com_Printf("L");
             else
                 Com_Printf(" ");
+#if USE_SNDDMA
+            if (sc->stream)
+                Com_Printf("S");
+            else
+                Com_Printf(" ");
+#endif
             Com_Printf("(%2db) %6i : %s\n", sc->width * 8,  size, sfx->name) ;
         } else {
             if (sfx->name[0] == '*')
@@ -147,6 +189,9 @@ static const cmdreg_t c_sound[] = {
     { "stopsound", S_StopAllSounds },
     { "soundlist", S_SoundList_f },
     { "soundinfo", S_SoundInfo_f },
+#if USE_SNDDMA
+    { "mixbench", S_MixBenchmark_f },
+#endif
 
     { NULL }
 };
@@ -298,6 +343,18 @@ void S_Init(void)
     paintedtime = 0;
 
     s_registration_sequence = 1;
+
+#if USE_SNDDMA
+    if (s_started == SS_DMA) {
+        s_frames[0] = {};
+        s_frames[0].entnum = -1;
+        s_framesequence = 0;
+        s_frameconsumed = 0;
+        s_mixframe = &s_frames[0];
+        S_InitStreams();
+        DMA_StartMixer();
+    }
+#endif
     
 	OGG_Init();
 	OGG_InitTrackList();
@@ -318,6 +375,10 @@ static void S_FreeSound(sfx_t *sfx)
 #if USE_OPENAL
     if (s_started == SS_OAL)
         AL_DeleteSfx(sfx);
+#endif
+#if USE_SNDDMA
+    if (s_started == SS_DMA && sfx->cache && sfx->cache->stream)
+        S_FreeStream(sfx->cache);
 #endif
     if (sfx->cache)
         Z_Free(sfx->cache);
@@ -358,8 +419,10 @@ void S_Shutdown(void)
 #endif
 
 #if USE_SNDDMA
-    if (s_started == SS_DMA)
+    if (s_started == SS_DMA) {
+        S_ShutdownStreams();
         DMA_Shutdown();
+    }
 #endif
 
     s_started = SS_NOT;
@@ -654,7 +717,7 @@ void S_EndRegistration(void)
         // make sure it is paged in
         sc = sfx->cache;
         if (sc) {
-            size = sc->length * sc->width;
+            size = ((sc->stream ? STREAM_CHUNK_SAMPLES : sc->samples) + 1) * sc->width;
             Com_PageInMemory(sc, size);
         }
 #endif
@@ -685,11 +748,19 @@ channel_t *S_PickChannel(int entnum, int entchannel)
     int         ch_idx;
     int         first_to_die;
     int         life_left;
+    int         listener;
     channel_t   *ch;
 
     if (entchannel < 0)
         Com_Error(ERR_DROP, "S_PickChannel: entchannel < 0");
 
+    listener = listener_entnum;
+#if USE_SNDDMA
+    // the mixer may be a frame behind the main thread
+    if (s_started == SS_DMA)
+        listener = s_mixframe->entnum;
+#endif
+
 // Check for replacement sound, or find the best one to replace
     first_to_die = -1;
     life_left = 0x7fffffff;
@@ -706,7 +777,7 @@ channel_t *S_PickChannel(int entnum, int entchannel)
         }
 
         // don't let monster sounds override player sounds
-        if (ch->entnum == listener_entnum && entnum != listener_entnum && ch->sfx)
+        if (ch->entnum == listener && entnum != listener && ch->sfx)
             continue;
 
         if (ch->end - paintedtime < life_left) {
@@ -730,6 +801,34 @@ channel_t *S_PickChannel(int entnum, int entchannel)
 
 #if USE_SNDDMA
 
+/*
+=================
+S_FindEntity
+
+Looks up an entity in the mixer's frame
+=================
+*/
+static const s_entity_t *S_FindEntity(int number)
+{
+    const s_entity_t *ent;
+    int     lo, hi, mid;
+
+    lo = 0;
+    hi = s_mixframe->numentities - 1;
+    while (lo <= hi) {
+        mid = (lo + hi) / 2;
+        ent = &s_mixframe->entities[mid];
+        if (ent->number == number)
+            return ent;
+        if (ent->number < number)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+
+    return NULL;
+}
+
 /*
 =================
 S_SpatializeOrigin
@@ -744,13 +843,13 @@ void S_SpatializeOrigin(const vec3_t &origin, float master_vol, float dist_mult,
     vec_t       lscale, rscale, scale;
     vec3_t      source_vec;
 
-    if (cls.connectionState != ClientConnectionState::Active) {
+    if (!s_mixframe->active) {
         *left_vol = *right_vol = 255;
         return;
     }
 
 // calculate stereo seperation and distance attenuation
-    VectorSubtract(origin, listener_origin, source_vec);
+    VectorSubtract(origin, s_mixframe->origin, source_vec);
 
     dist = VectorNormalize(source_vec);
     dist -= SOUND_FULLVOLUME;
@@ -758,8 +857,8 @@ void S_SpatializeOrigin(const vec3_t &origin, float master_vol, float dist_mult,
         dist = 0;           // close enough to be at full volume
     dist *= dist_mult;      // different attenuation levels
 
-    dot = DotProduct(listener_right, source_vec);
-    if (s_swapstereo->integer)
+    dot = DotProduct(s_mixframe->right, source_vec);
+    if (s_mixframe->swapstereo)
         dot = -dot;
 
     if (dma.channels == 1 || !dist_mult) {
@@ -792,22 +891,54 @@ S_Spatialize
 */
 static void S_Spatialize(channel_t *ch)
 {
-    vec3_t      origin;
+    const s_entity_t *ent;
 
     // anything coming from the view entity will always be full volume
-    if (ch->entnum == -1 || ch->entnum == listener_entnum) {
+    if (ch->entnum == -1 || ch->entnum == s_mixframe->entnum) {
         ch->leftvol = ch->master_vol * 255;
         ch->rightvol = ch->master_vol * 255;
         return;
     }
 
-    if (ch->fixed_origin) {
-        VectorCopy(ch->origin, origin);
-    } else {
-        origin = CL_GetEntitySoundOrigin(ch->entnum);
-    }
+    // entities that left the frame keep their last known origin
+    if (!ch->fixed_origin && (ent = S_FindEntity(ch->entnum)))
+        VectorCopy(ent->origin, ch->origin);
+
+    // keep the previous result if neither end has moved noticeably
+    if (ch->spatial_stamp == s_spatialstamp &&
+        DistanceSquared(ch->origin, ch->spatial_origin) <= SPATIAL_MOVE_EPSILON * SPATIAL_MOVE_EPSILON)
+        return;
+
+    ch->spatial_stamp = s_spatialstamp;
+    VectorCopy(ch->origin, ch->spatial_origin);
 
-    S_SpatializeOrigin(origin, ch->master_vol, ch->dist_mult, &ch->leftvol, &ch->rightvol);
+    S_SpatializeOrigin(ch->origin, ch->master_vol, ch->dist_mult, &ch->leftvol, &ch->rightvol);
+}
+
+/*
+=================
+S_UpdateListener
+
+Drops the cached spatialization once the listener of the mixer's frame has
+moved or turned past the thresholds.
+=================
+*/
+static void S_UpdateListener(void)
+{
+    const s_frame_t *frame = s_mixframe;
+
+    if (frame->active == s_spatialactive && frame->swapstereo == s_spatialswap &&
+        DistanceSquared(frame->origin, s_spatialorigin) <= SPATIAL_MOVE_EPSILON * SPATIAL_MOVE_EPSILON &&
+        DotProduct(frame->right, s_spatialright) >= SPATIAL_TURN_EPSILON)
+        return;
+
+    s_spatialactive = frame->active;
+    s_spatialswap = frame->swapstereo;
+    VectorCopy(frame->origin, s_spatialorigin);
+    VectorCopy(frame->right, s_spatialright);
+
+    if (!++s_spatialstamp)
+        s_spatialstamp = 1;
 }
 
 #endif
@@ -851,6 +982,32 @@ static void S_FreePlaysound(playsound_t *ps)
     s_freeplays.next = ps;
 }
 
+/*
+=================
+S_QueuePlaysound
+=================
+*/
+static void S_QueuePlaysound(const playsound_t *play)
+{
+    playsound_t *ps, *sort;
+
+    ps = S_AllocPlaysound();
+    if (!ps)
+        return;
+
+    *ps = *play;
+
+    // sort into the pending sound list
+    for (sort = s_pendingplays.next; sort != &s_pendingplays && sort->begin < ps->begin; sort = sort->next)
+        ;
+
+    ps->next = sort;
+    ps->prev = sort->prev;
+
+    ps->next->prev = ps;
+    ps->prev->next = ps;
+}
+
 /*
 ===============
 S_IssuePlaysound
@@ -876,6 +1033,12 @@ void S_IssuePlaysound(playsound_t *ps)
         return;
     }
 
+#if USE_SNDDMA
+    // loaded by S_StartSound, the mixer thread can't load anything
+    if (s_started == SS_DMA)
+        sc = ps->sfx->cache;
+    else
+#endif
     sc = S_LoadSound(ps->sfx);
     if (!sc) {
         Com_Printf("S_IssuePlaysound: couldn't load %s\n", ps->sfx->name);
@@ -928,8 +1091,11 @@ Entchannel 0 will never override a playing sound
 void S_StartSound(const vec3_t *origin, int entnum, int entchannel, qhandle_t hSfx, float vol, float attenuation, float timeofs)
 {
     sfxcache_t  *sc;
-    playsound_t *ps, *sort;
+    playsound_t ps;
     sfx_t       *sfx;
+#if USE_SNDDMA
+    s_command_t cmd;
+#endif
 
     if (!s_started)
         return;
@@ -955,42 +1121,40 @@ void S_StartSound(const vec3_t *origin, int entnum, int entchannel, qhandle_t hS
         return;     // couldn't load the sound's data
 
     // make the playsound_t
-    ps = S_AllocPlaysound();
-    if (!ps)
-        return;
+    ps = {};
 
     if (origin) {
-        VectorCopy(*origin, ps->origin);
-        ps->fixed_origin = true;
+        VectorCopy(*origin, ps.origin);
+        ps.fixed_origin = true;
     } else {
-        ps->fixed_origin = false;
+        ps.fixed_origin = false;
     }
 
-    ps->entnum = entnum;
-    ps->entchannel = entchannel;
-    ps->attenuation = attenuation;
-    ps->volume = vol;
-    ps->sfx = sfx;
+    ps.entnum = entnum;
+    ps.entchannel = entchannel;
+    ps.attenuation = attenuation;
+    ps.volume = vol;
+    ps.sfx = sfx;
 
 #if USE_OPENAL
-    if (s_started == SS_OAL)
-        ps->begin = paintedtime + timeofs * 1000;
+    if (s_started == SS_OAL) {
+        ps.begin = paintedtime + timeofs * 1000;
+        S_QueuePlaysound(&ps);
+    }
 #endif
 
 #if USE_SNDDMA
-    if (s_started == SS_DMA)
-        ps->begin = DMA_DriftBeginofs(timeofs);
+    if (s_started == SS_DMA) {
+        // the mixer has no access to the client entities
+        if (!origin)
+            ps.origin = CL_GetEntitySoundOrigin(entnum);
+        ps.begin = DMA_DriftBeginofs(timeofs);
+
+        cmd.type = S_CMD_PLAY;
+        cmd.play = ps;
+        DMA_Command(&cmd);
+    }
 #endif
-
-    // sort into the pending sound list
-    for (sort = s_pendingplays.next; sort != &s_pendingplays && sort->begin < ps->begin; sort = sort->next)
-        ;
-
-    ps->next = sort;
-    ps->prev = sort->prev;
-
-    ps->next->prev = ps;
-    ps->prev->next = ps;
 }
 
 void S_ParseStartSound(void)
@@ -1033,16 +1197,16 @@ void S_StartLocalSound_(const char *sound)
 
 /*
 ==================
-S_StopAllSounds
+S_ClearChannels
+
+Stops the channels and pending playsounds. With the software mixer this
+runs on the mixer thread.
 ==================
 */
-void S_StopAllSounds(void)
+void S_ClearChannels(void)
 {
     int     i;
 
-    if (!s_started)
-        return;
-
     // clear all the playsounds
     memset(s_playsounds, 0, sizeof(s_playsounds));
     s_freeplays.next = s_freeplays.prev = &s_freeplays;
@@ -1063,12 +1227,43 @@ void S_StopAllSounds(void)
 #if USE_SNDDMA
     if (s_started == SS_DMA)
         DMA_ClearBuffer();
+
+    // the output may have changed, respatialize everything
+    if (!++s_spatialstamp)
+        s_spatialstamp = 1;
 #endif
 
     // clear all the channels
     memset(channels, 0, sizeof(channels));
 }
 
+/*
+==================
+S_StopAllSounds
+==================
+*/
+void S_StopAllSounds(void)
+{
+#if USE_SNDDMA
+    s_command_t cmd;
+#endif
+
+    if (!s_started)
+        return;
+
+#if USE_SNDDMA
+    if (s_started == SS_DMA) {
+        // callers go on to free sfx, so wait for the mixer
+        cmd.type = S_CMD_STOP;
+        DMA_Command(&cmd);
+        DMA_Flush();
+        return;
+    }
+#endif
+
+    S_ClearChannels();
+}
+
 // =======================================================================
 // Update sound buffer
 // =======================================================================
@@ -1105,69 +1300,70 @@ as the entities are sent to the client
 */
 static void S_AddLoopSounds(void)
 {
-    int         i, j;
-    int         sounds[MAX_EDICTS];
-    int         left, right, left_total, right_total;
+    // summed volumes of each sfx, indexed like known_sfx
+    static int  left_total[MAX_SFX], right_total[MAX_SFX];
+    sfx_t       *audible[MAX_SFX];
+    int         i, n, numaudible;
+    int         left, right;
     channel_t   *ch;
     sfx_t       *sfx;
     sfxcache_t  *sc;
-    int         num;
-    EntityState  *ent;
-    vec3_t      origin;
+    s_loopcache_t *cache;
+    const s_entity_t *ent;
+    const s_frame_t *frame = s_mixframe;
+    // loop sounds are fully attenuated past this distance
+    const float cull = SOUND_FULLVOLUME + 1.0f / SOUND_LOOPATTENUATE;
 
-    if (cls.connectionState != ClientConnectionState::Active || !s_active || sv_paused->integer || !s_ambient->integer) {
+    if (!frame->loopsounds) {
         return;
     }
 
-    S_BuildSoundList(sounds);
-
-    for (i = 0; i < cl.frame.numEntities; i++) {
-        if (!sounds[i])
-            continue;
-
-        sfx = S_SfxForHandle(cl.precaches.sounds[sounds[i]]);
-        if (!sfx)
-            continue;       // bad sound effect
-        sc = sfx->cache;
-        if (!sc)
+    numaudible = 0;
+    for (i = 0, ent = frame->entities; i < frame->numentities; i++, ent++) {
+        sfx = ent->sound;
+        if (!sfx || !sfx->cache)
             continue;
 
-        num = (cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK;
-        ent = &cl.entityStates[num];
+        cache = &s_loopcache[ent->number];
+        if (cache->stamp != s_spatialstamp ||
+            DistanceSquared(ent->origin, cache->origin) > SPATIAL_MOVE_EPSILON * SPATIAL_MOVE_EPSILON) {
+            cache->stamp = s_spatialstamp;
+            VectorCopy(ent->origin, cache->origin);
 
-        // find the total contribution of all sounds of this type
-        origin = CL_GetEntitySoundOrigin(ent->number);
-        S_SpatializeOrigin(origin, 1.0, SOUND_LOOPATTENUATE,
-                           &left_total, &right_total);
-        for (j = i + 1; j < cl.frame.numEntities; j++) {
-            if (sounds[j] != sounds[i])
-                continue;
-            sounds[j] = 0;  // don't check this again later
-
-            num = (cl.frame.firstEntity + j) & PARSE_ENTITIES_MASK;
-            ent = &cl.entityStates[num];
-
-            origin = CL_GetEntitySoundOrigin(ent->number);
-            S_SpatializeOrigin(origin, 1.0, SOUND_LOOPATTENUATE,
-                               &left, &right);
-            left_total += left;
-            right_total += right;
+            if (frame->active && DistanceSquared(ent->origin, frame->origin) >= cull * cull)
+                cache->left = cache->right = 0;
+            else
+                S_SpatializeOrigin(ent->origin, 1.0, SOUND_LOOPATTENUATE, &cache->left, &cache->right);
         }
 
-        if (left_total == 0 && right_total == 0)
+        left = cache->left;
+        right = cache->right;
+        if (!left && !right)
             continue;       // not audible
 
+        // find the total contribution of all sounds of this type
+        n = sfx - known_sfx;
+        if (!left_total[n] && !right_total[n])
+            audible[numaudible++] = sfx;
+        left_total[n] += left;
+        right_total[n] += right;
+    }
+
+    for (i = 0; i < numaudible; i++) {
+        sfx = audible[i];
+        sc = sfx->cache;
+        n = sfx - known_sfx;
+        left = min(left_total[n], 255);
+        right = min(right_total[n], 255);
+        left_total[n] = right_total[n] = 0;
+
         // allocate a channel
         ch = S_PickChannel(0, 0);
         if (!ch)
-            return;
+            continue;
 
-        if (left_total > 255)
-            left_total = 255;
-        if (right_total > 255)
-            right_total = 255;
-        ch->leftvol = left_total;
-        ch->rightvol = right_total;
+        ch->leftvol = left;
+        ch->rightvol = right;
         ch->autosound = true;  // remove next frame
         ch->sfx = sfx;
         ch->pos = paintedtime % sc->length;
@@ -1175,6 +1371,119 @@ static void S_AddLoopSounds(void)
     }
 }
 
+/*
+==================
+S_RunFrame
+
+Respatializes the channels and adds loop sounds from a frame sent by
+S_SendFrame. Runs on the mixer thread.
+==================
+*/
+static void S_RunFrame(unsigned sequence)
+{
+    int         i;
+    channel_t   *ch;
+
+    s_mixframe = &s_frames[sequence & (S_MAX_FRAMES - 1)];
+    S_UpdateListener();
+
+    // update spatialization for dynamic sounds
+    ch = channels;
+    for (i = 0; i < s_numchannels; i++, ch++) {
+        if (!ch->sfx)
+            continue;
+        if (ch->autosound) {
+            // autosounds are regenerated fresh each frame
+            memset(ch, 0, sizeof(*ch));
+            continue;
+        }
+        S_Spatialize(ch);         // respatialize channel
+        if (!ch->leftvol && !ch->rightvol) {
+            memset(ch, 0, sizeof(*ch));
+            continue;
+        }
+    }
+
+    // add loopsounds
+    S_AddLoopSounds();
+
+    // older frames may be reused now
+    s_frameconsumed.store(sequence, std::memory_order_release);
+}
+
+/*
+==================
+S_SendFrame
+
+Copies what the mixer needs to know about the listener and the entities
+in the current frame, and queues it for the mixer.
+==================
+*/
+static void S_SendFrame(void)
+{
+    unsigned    sequence = s_framesequence + 1;
+    int         sounds[MAX_PACKET_ENTITIES];
+    s_frame_t   *frame;
+    s_entity_t  *ent;
+    EntityState *state;
+    s_command_t cmd;
+    int         i;
+
+    // all frames are still in use, the mixer will catch up next time
+    if (sequence - s_frameconsumed.load(std::memory_order_acquire) >= S_MAX_FRAMES)
+        return;
+
+    frame = &s_frames[sequence & (S_MAX_FRAMES - 1)];
+    frame->active = cls.connectionState == ClientConnectionState::Active;
+    frame->loopsounds = frame->active && s_active && !sv_paused->integer && s_ambient->integer;
+    frame->swapstereo = !!s_swapstereo->integer;
+    frame->entnum = listener_entnum;
+    VectorCopy(listener_origin, frame->origin);
+    VectorCopy(listener_right, frame->right);
+    frame->numentities = 0;
+
+    if (frame->active) {
+        S_BuildSoundList(sounds);
+
+        for (i = 0; i < cl.frame.numEntities; i++) {
+            state = &cl.entityStates[(cl.frame.firstEntity + i) & PARSE_ENTITIES_MASK];
+            ent = &frame->entities[i];
+            ent->number = state->number;
+            ent->sound = sounds[i] ? S_SfxForHandle(cl.precaches.sounds[sounds[i]]) : NULL;
+            ent->origin = CL_GetEntitySoundOrigin(state->number);
+        }
+        frame->numentities = cl.frame.numEntities;
+    }
+
+    s_framesequence = sequence;
+
+    cmd.type = S_CMD_FRAME;
+    cmd.frame = sequence;
+    DMA_Command(&cmd);
+}
+
+/*
+==================
+S_RunCommand
+
+Runs a command queued by DMA_Command.
+==================
+*/
+void S_RunCommand(const s_command_t *cmd)
+{
+    switch (cmd->type) {
+    case S_CMD_PLAY:
+        S_QueuePlaysound(&cmd->play);
+        break;
+    case S_CMD_STOP:
+        S_ClearChannels();
+        break;
+    case S_CMD_FRAME:
+        S_RunFrame(cmd->frame);
+        break;
+    }
+}
+
 #endif
 
 /*
@@ -1186,7 +1495,7 @@ Called once each time through the main loop
 */
 void S_Update(void)
 {
-#if USE_SNDDMA
+#if USE_SNDDMA && defined _DEBUG
     int         i;
     channel_t   *ch;
 #endif
@@ -1229,31 +1538,17 @@ void S_Update(void)
     if (s_volume->modified)
         S_InitScaletable();
 
-    // update spatialization for dynamic sounds
-    ch = channels;
-    for (i = 0; i < s_numchannels; i++, ch++) {
-        if (!ch->sfx)
-            continue;
-        if (ch->autosound) {
-            // autosounds are regenerated fresh each frame
-            memset(ch, 0, sizeof(*ch));
-            continue;
-        }
-        S_Spatialize(ch);         // respatialize channel
-        if (!ch->leftvol && !ch->rightvol) {
-            memset(ch, 0, sizeof(*ch));
-            continue;
-        }
-    }
+    // respatialize channels and add loopsounds
+    S_SendFrame();
 
-    // add loopsounds
-    S_AddLoopSounds();
+    // read the chunks of streamed sounds the mixer needs next
+    S_UpdateStreams();
 
     OGG_Stream();
 
 #ifdef _DEBUG
     //
-    // debugging output
+    // debugging output, racy with the mixer thread
     //
     if (s_show->integer) {
         int total = 0;
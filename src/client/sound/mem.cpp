@@ -17,75 +17,646 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 // snd_mem.c: sound caching
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+
 #include "sound.h"
 
 wavinfo_t s_info;
 
 #if USE_SNDDMA
+/*
+===============================================================================
+
+STREAMED SOUNDS
+
+Long sounds keep only their first chunk resident. The rest is read on
+demand by a background thread into a fixed pool of chunk slots, whose
+size is the s_streamcache budget. The mixer asks for the chunks it is
+about to play through a lock-free request ring. The main thread assigns
+slots, evicting the least recently mixed chunks, and queues the reads.
+
+A chunk that hasn't arrived in time plays as silence. Chunks are asked
+for one ahead of the one playing, so this only happens if the disk can't
+keep up.
+
+===============================================================================
+*/
+
+#define STREAM_MIN_CHUNKS   4       // shorter sounds stay resident
+#define STREAM_REQUESTS     64      // must be a power of two
+#define STREAM_JOBS         64
+#define STREAM_MAX_FILES    8
+#define STREAM_IDLE_MSEC    2000
+
+#define CHUNK_NONE          -1
+#define CHUNK_REQUESTED     -2
+
+typedef enum {
+    SLOT_FREE,
+    SLOT_LOADING,
+    SLOT_READY
+} slotstate_t;
+
+typedef struct sndstream_s {
+    const char  *name;          // owned by the sfx
+    int64_t     dataofs;        // file offset of the samples
+    int         width;          // of the samples in the file
+    int         samples;
+    int         numchunks;
+    int         loopchunk;      // chunk to read ahead at the end, -1 if none
+    int16_t     guard;          // interpolated towards after the last sample
+    qhandle_t   file;           // main thread
+    unsigned    lastread;       // msec, main thread
+    std::atomic<int> busy;      // reads in flight
+    std::atomic<int> *chunks;   // slot of each chunk, or CHUNK_NONE / CHUNK_REQUESTED
+} sndstream_t;
+
+typedef struct {
+    sndstream_t         *stream;    // main thread
+    int                 chunk;
+    std::atomic<int>    state;
+    std::atomic<int>    lastused;   // paintedtime of the last mix
+    int16_t             *data;      // STREAM_CHUNK_SAMPLES plus guard sample
+} sndslot_t;
+
+typedef struct {
+    sndstream_t *stream;
+    int         chunk;
+    int         slot;
+} sndjob_t;
+
+static cvar_t   *s_streamcache;
+
+static struct {
+    sndslot_t               *slots;
+    int                     numslots;
+    int16_t                 *pool;
+
+    // mixer to main thread
+    sndjob_t                requests[STREAM_REQUESTS];
+    std::atomic<unsigned>   reqhead;
+    std::atomic<unsigned>   reqtail;
+
+    // main thread to reader
+    std::thread             thread;
+    std::mutex              mutex;
+    std::condition_variable work;
+    sndjob_t                jobs[STREAM_JOBS];
+    unsigned                jobhead;
+    unsigned                jobtail;
+    bool                    quit;
+
+    sndstream_t             *files[STREAM_MAX_FILES];
+    int                     numfiles;
+
+    std::atomic<int>        reads;
+    std::atomic<int>        misses;
+} s_stream;
+
+static void S_ReadChunk(const sndjob_t *job)
+{
+    static byte buffer[(STREAM_CHUNK_SAMPLES + 1) * 2];
+    sndstream_t *st = job->stream;
+    sndslot_t   *slot = &s_stream.slots[job->slot];
+    int         first = job->chunk * STREAM_CHUNK_SAMPLES;
+    int         count = min(STREAM_CHUNK_SAMPLES + 1, st->samples - first);
+    size_t      len = count * st->width;
+    int         i;
+
+    if (FS_Seek(st->file, st->dataofs + first * st->width) || FS_Read(buffer, len, st->file) != (ssize_t)len) {
+        memset(slot->data, 0, (STREAM_CHUNK_SAMPLES + 1) * sizeof(int16_t));
+    } else if (st->width == 1) {
+        for (i = 0; i < count; i++)
+            slot->data[i] = (buffer[i] - 128) << 8;
+    } else {
+        for (i = 0; i < count; i++)
+            slot->data[i] = LittleShortMem(buffer + i * 2);
+    }
+
+    if (count <= STREAM_CHUNK_SAMPLES)
+        slot->data[count] = st->guard;
+
+    slot->state.store(SLOT_READY, std::memory_order_release);
+    st->chunks[job->chunk].store(job->slot, std::memory_order_release);
+    st->busy--;
+    s_stream.reads++;
+}
+
+static void S_StreamReader(void)
+{
+    std::unique_lock<std::mutex> lock(s_stream.mutex);
+    sndjob_t    job;
+
+    while (1) {
+        if (s_stream.jobtail == s_stream.jobhead) {
+            if (s_stream.quit)
+                return;
+            s_stream.work.wait(lock);
+            continue;
+        }
+
+        job = s_stream.jobs[s_stream.jobtail++ % STREAM_JOBS];
+        lock.unlock();
+
+        S_ReadChunk(&job);
+
+        lock.lock();
+    }
+}
+
+void S_InitStreams(void)
+{
+    int     i;
+
+    s_streamcache = Cvar_Get("s_streamcache", "8", CVAR_ARCHIVE | CVAR_SOUND);
+
+    s_stream.numslots = Cvar_ClampInteger(s_streamcache, 0, 256) * 0x100000 /
+                        ((STREAM_CHUNK_SAMPLES + 1) * sizeof(int16_t));
+    if (!s_stream.numslots)
+        return;
+
+    // CPP: WARNING: Casts
+    s_stream.pool = (int16_t *)S_Malloc(s_stream.numslots * (STREAM_CHUNK_SAMPLES + 1) * sizeof(int16_t));
+    s_stream.slots = (sndslot_t *)S_Malloc(s_stream.numslots * sizeof(sndslot_t));
+    for (i = 0; i < s_stream.numslots; i++) {
+        new (&s_stream.slots[i]) sndslot_t();
+        s_stream.slots[i].stream = NULL;
+        s_stream.slots[i].state = SLOT_FREE;
+        s_stream.slots[i].data = s_stream.pool + i * (STREAM_CHUNK_SAMPLES + 1);
+    }
+
+    s_stream.reqhead = 0;
+    s_stream.reqtail = 0;
+    s_stream.jobhead = 0;
+    s_stream.jobtail = 0;
+    s_stream.quit = false;
+    s_stream.numfiles = 0;
+    s_stream.reads = 0;
+    s_stream.misses = 0;
+    s_stream.thread = std::thread(S_StreamReader);
+}
+
+void S_ShutdownStreams(void)
+{
+    if (!s_stream.numslots)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(s_stream.mutex);
+        s_stream.quit = true;
+    }
+    s_stream.work.notify_one();
+    s_stream.thread.join();
+
+    Z_Free(s_stream.slots);
+    Z_Free(s_stream.pool);
+    s_stream.slots = NULL;
+    s_stream.pool = NULL;
+    s_stream.numslots = 0;
+}
+
+static void S_CloseStreamFile(int index)
+{
+    sndstream_t *st = s_stream.files[index];
+
+    FS_FCloseFile(st->file);
+    st->file = 0;
+    s_stream.files[index] = s_stream.files[--s_stream.numfiles];
+}
+
+static qboolean S_OpenStreamFile(sndstream_t *st)
+{
+    int     i, oldest;
+
+    if (st->file)
+        return true;
+
+    // make room by closing the longest idle file
+    if (s_stream.numfiles == STREAM_MAX_FILES) {
+        oldest = -1;
+        for (i = 0; i < s_stream.numfiles; i++) {
+            if (s_stream.files[i]->busy)
+                continue;
+            if (oldest == -1 || s_stream.files[i]->lastread < s_stream.files[oldest]->lastread)
+                oldest = i;
+        }
+        if (oldest == -1)
+            return false;
+        S_CloseStreamFile(oldest);
+    }
+
+    FS_FOpenFile(st->name, &st->file, FS_MODE_READ);
+    if (!st->file)
+        return false;
+
+    s_stream.files[s_stream.numfiles++] = st;
+    return true;
+}
+
 /*
 ================
-ResampleSfx
+S_SlotInUse
+
+The mixer stamps chunks with its own paintedtime, which runs up to a
+buffer ahead of the published one. A stamp further ahead than that was
+queued just before paintedtime wrapped, and is stale.
 ================
 */
-static sfxcache_t *ResampleSfx(sfx_t *sfx)
+static inline qboolean S_SlotInUse(const sndslot_t *slot, int painted)
 {
-    int         outcount;
-    int         srcsample;
-    float       stepscale;
+    int age = painted - slot->lastused;
+
+    if (age < -(dma.samples / dma.channels))
+        return false;
+
+    return age < dma.speed;
+}
+
+/*
+================
+S_AllocSlot
+
+Finds a free slot, or evicts the chunk mixed longest ago. Chunks mixed
+within the last second are left alone, the mixer may still be reading
+them. The mixer marks a chunk used before checking that it is still
+mapped, and eviction unmaps before checking that it is unused, so one of
+the two always sees the other.
+================
+*/
+static int S_AllocSlot(int painted)
+{
+    sndslot_t   *slot;
+    int         i, oldest, tries;
+
+    for (i = 0, slot = s_stream.slots; i < s_stream.numslots; i++, slot++) {
+        if (slot->state == SLOT_FREE)
+            return i;
+    }
+
+    for (tries = 0; tries < 4; tries++) {
+        oldest = -1;
+        for (i = 0, slot = s_stream.slots; i < s_stream.numslots; i++, slot++) {
+            if (slot->state != SLOT_READY || S_SlotInUse(slot, painted))
+                continue;
+            if (oldest == -1 || slot->lastused - s_stream.slots[oldest].lastused < 0)
+                oldest = i;
+        }
+        if (oldest == -1)
+            return -1;
+
+        slot = &s_stream.slots[oldest];
+        slot->stream->chunks[slot->chunk] = CHUNK_NONE;
+        if (S_SlotInUse(slot, painted)) {
+            // mixed after all, put it back
+            slot->stream->chunks[slot->chunk] = oldest;
+            continue;
+        }
+
+        slot->stream = NULL;
+        slot->state = SLOT_FREE;
+        return oldest;
+    }
+
+    return -1;
+}
+
+static qboolean S_QueueRead(sndstream_t *st, int chunk, int painted, unsigned now)
+{
+    sndslot_t   *slot;
+    int         index;
+
+    if (s_stream.jobhead - s_stream.jobtail >= STREAM_JOBS)
+        return false;
+    if (!S_OpenStreamFile(st))
+        return false;
+    if ((index = S_AllocSlot(painted)) == -1)
+        return false;
+
+    slot = &s_stream.slots[index];
+    slot->stream = st;
+    slot->chunk = chunk;
+    slot->lastused = painted;
+    slot->state = SLOT_LOADING;
+
+    st->busy++;
+    st->lastread = now;
+
+    {
+        std::lock_guard<std::mutex> lock(s_stream.mutex);
+        s_stream.jobs[s_stream.jobhead++ % STREAM_JOBS] = { st, chunk, index };
+    }
+    s_stream.work.notify_one();
+
+    return true;
+}
+
+/*
+================
+S_UpdateStreams
+
+Queues reads for the chunks the mixer asked for, and closes files that
+haven't been read from in a while. Called each frame.
+================
+*/
+void S_UpdateStreams(void)
+{
+    unsigned    tail, now;
+    int         i, painted;
+    sndjob_t    *req;
+
+    if (!s_stream.numslots)
+        return;
+
+    painted = DMA_PaintedTime();
+    now = Sys_Milliseconds();
+
+    tail = s_stream.reqtail.load(std::memory_order_relaxed);
+    while (tail != s_stream.reqhead.load(std::memory_order_acquire)) {
+        req = &s_stream.requests[tail & (STREAM_REQUESTS - 1)];
+        // asked again once this is dropped
+        if (req->stream->chunks[req->chunk] == CHUNK_REQUESTED &&
+            !S_QueueRead(req->stream, req->chunk, painted, now))
+            req->stream->chunks[req->chunk] = CHUNK_NONE;
+        s_stream.reqtail.store(++tail, std::memory_order_release);
+    }
+
+    for (i = s_stream.numfiles - 1; i >= 0; i--) {
+        if (!s_stream.files[i]->busy && now - s_stream.files[i]->lastread > STREAM_IDLE_MSEC)
+            S_CloseStreamFile(i);
+    }
+}
+
+static void S_RequestChunk(sndstream_t *st, int chunk)
+{
+    unsigned    head = s_stream.reqhead.load(std::memory_order_relaxed);
+    int         expected = CHUNK_NONE;
+
+    // full, asked again on the next mix
+    if (head - s_stream.reqtail.load(std::memory_order_acquire) >= STREAM_REQUESTS)
+        return;
+
+    if (!st->chunks[chunk].compare_exchange_strong(expected, CHUNK_REQUESTED))
+        return;
+
+    s_stream.requests[head & (STREAM_REQUESTS - 1)] = { st, chunk, -1 };
+    s_stream.reqhead.store(head + 1, std::memory_order_release);
+}
+
+/*
+================
+S_StreamChunk
+
+Returns the samples of a chunk of a streamed sound, plus the guard sample,
+or NULL if it isn't in memory yet. In that case it is asked for, as is
+the chunk after it. Called by the mixer.
+================
+*/
+const int16_t *S_StreamChunk(const sfxcache_t *sc, int chunk)
+{
+    sndstream_t *st = sc->stream;
+    int         next, index;
+
+    // read ahead
+    next = chunk + 1 < st->numchunks ? chunk + 1 : st->loopchunk;
+    if (next > 0 && st->chunks[next].load(std::memory_order_relaxed) == CHUNK_NONE)
+        S_RequestChunk(st, next);
+
+    if (!chunk)
+        return (const int16_t *)sc->data;
+
+    index = st->chunks[chunk];
+    if (index < 0) {
+        if (index == CHUNK_NONE)
+            S_RequestChunk(st, chunk);
+        s_stream.misses++;
+        return NULL;
+    }
+
+    s_stream.slots[index].lastused = paintedtime;
+    if (st->chunks[chunk] != index) {
+        s_stream.misses++;
+        return NULL;        // just evicted
+    }
+
+    return s_stream.slots[index].data;
+}
+
+/*
+================
+S_ResetStreamTimes
+
+Called by the mixer when paintedtime is chopped back. Channels are
+cleared at the same time, so every chunk is marked as mixed long enough
+ago to be evicted.
+================
+*/
+void S_ResetStreamTimes(void)
+{
+    int     i;
+
+    for (i = 0; i < s_stream.numslots; i++)
+        s_stream.slots[i].lastused = paintedtime - dma.speed;
+}
+
+/*
+================
+S_CreateStream
+
+Sets up streaming for the sound being loaded if it is long enough and
+its file can be read from at random, returning how many samples to keep
+resident.
+================
+*/
+static int S_CreateStream(sfx_t *sfx, int64_t dataofs, sndstream_t **stream)
+{
+    const char  *name = sfx->truename ? sfx->truename : sfx->name;
+    const byte  *guard;
+    sndstream_t *st;
+    qhandle_t   f;
+    int         i, numchunks;
+
+    *stream = NULL;
+
+    if (!s_stream.numslots)
+        return s_info.samples;
+
+    numchunks = (s_info.samples + STREAM_CHUNK_SAMPLES - 1) / STREAM_CHUNK_SAMPLES;
+    if (numchunks < STREAM_MIN_CHUNKS)
+        return s_info.samples;
+
+    FS_FOpenFile(name, &f, FS_MODE_READ);
+    if (!f)
+        return s_info.samples;
+    i = FS_Seek(f, dataofs + STREAM_CHUNK_SAMPLES * s_info.width);
+    FS_FCloseFile(f);
+    if (i)
+        return s_info.samples;
+
+    // CPP: WARNING: Casts
+    st = (sndstream_t *)S_Malloc(sizeof(*st));
+    new (st) sndstream_t();
+    st->chunks = (std::atomic<int> *)S_Malloc(numchunks * sizeof(st->chunks[0]));
+    for (i = 0; i < numchunks; i++)
+        new (&st->chunks[i]) std::atomic<int>(CHUNK_NONE);
+
+    st->name = name;
+    st->dataofs = dataofs;
+    st->width = s_info.width;
+    st->samples = s_info.samples;
+    st->numchunks = numchunks;
+    st->loopchunk = s_info.loopstart >= 0 ? s_info.loopstart / STREAM_CHUNK_SAMPLES : -1;
+    st->file = 0;
+    st->lastread = 0;
+    st->busy = 0;
+
+    if (s_info.loopstart >= 0 && s_info.loopstart < s_info.samples)
+        guard = s_info.data + s_info.loopstart * s_info.width;
+    else
+        guard = s_info.data + (s_info.samples - 1) * s_info.width;
+    st->guard = s_info.width == 1 ? (*guard - 128) << 8 : LittleShortMem(guard);
+
+    *stream = st;
+    return STREAM_CHUNK_SAMPLES;
+}
+
+/*
+================
+S_FreeStream
+
+Called once no channel plays the sound any more.
+================
+*/
+void S_FreeStream(sfxcache_t *sc)
+{
+    sndstream_t *st = sc->stream;
+    unsigned    tail;
+    sndjob_t    *req;
     int         i;
-    int         samplefrac, fracstep;
+
+    while (st->busy)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // drop the outstanding requests, others are asked for again
+    tail = s_stream.reqtail.load(std::memory_order_relaxed);
+    while (tail != s_stream.reqhead.load(std::memory_order_acquire)) {
+        req = &s_stream.requests[tail & (STREAM_REQUESTS - 1)];
+        if (req->stream != st)
+            req->stream->chunks[req->chunk] = CHUNK_NONE;
+        s_stream.reqtail.store(++tail, std::memory_order_release);
+    }
+
+    for (i = 0; i < s_stream.numslots; i++) {
+        if (s_stream.slots[i].stream == st) {
+            s_stream.slots[i].stream = NULL;
+            s_stream.slots[i].state = SLOT_FREE;
+        }
+    }
+
+    for (i = 0; i < s_stream.numfiles; i++) {
+        if (s_stream.files[i] == st) {
+            S_CloseStreamFile(i);
+            break;
+        }
+    }
+
+    Z_Free(st->chunks);
+    Z_Free(st);
+    sc->stream = NULL;
+}
+
+void S_StreamInfo(void)
+{
+    int     i, used = 0;
+
+    if (!s_stream.numslots) {
+        Com_Printf("Sound streaming disabled.\n");
+        return;
+    }
+
+    for (i = 0; i < s_stream.numslots; i++) {
+        if (s_stream.slots[i].state != SLOT_FREE)
+            used++;
+    }
+
+    Com_Printf("%5d of %d stream chunks used\n", used, s_stream.numslots);
+    Com_Printf("%5d stream files open\n", s_stream.numfiles);
+    Com_Printf("%5d chunks read\n", s_stream.reads.load());
+    Com_Printf("%5d chunks missed\n", s_stream.misses.load());
+}
+
+/*
+================
+ConvertSfx
+
+Keeps the sound at its own rate, the mixer resamples it while painting.
+Length and loop start are still in output samples. 8 bit sounds are
+widened to 16 bit, so the mixer has only one format to deal with.
+Long sounds only convert the part that stays resident.
+================
+*/
+static sfxcache_t *ConvertSfx(sfx_t *sfx, int64_t dataofs)
+{
+    int         outcount;
+    int64_t     step;
+    int         i, samples, resident, count;
+    int16_t     *out;
     sfxcache_t  *sc;
+    sndstream_t *stream;
 
-    stepscale = (float)s_info.rate / dma.speed;      // this is usually 0.5, 1, or 2
+    // source samples per output sample, 16.16 fixed point
+    step = ((int64_t)s_info.rate << 16) / dma.speed;
+    samples = s_info.samples;
 
-    outcount = s_info.samples / stepscale;
+    outcount = ((int64_t)samples << 16) / step;
     if (!outcount) {
         Com_DPrintf("%s resampled to zero length\n", s_info.name);
         sfx->error = Q_ERR_TOO_FEW;
         return NULL;
     }
 
+    resident = S_CreateStream(sfx, dataofs, &stream);
+
     // CPP: WARNING: Cast to sfxcache_t*
-    sc = sfx->cache = (sfxcache_t*)S_Malloc(outcount * s_info.width + sizeof(sfxcache_t) - 1);
+    sc = sfx->cache = (sfxcache_t*)S_Malloc((resident + 1) * sizeof(int16_t) + sizeof(sfxcache_t) - 1);
 
     sc->length = outcount;
-    sc->loopstart = s_info.loopstart == -1 ? -1 : s_info.loopstart / stepscale;
-    sc->width = s_info.width;
-
-// resample / decimate to the current source rate
-//Com_Printf("%s: %f, %d\n",sfx->name,stepscale,sc->width);
-    if (stepscale == 1) {
-// fast special case
-        if (sc->width == 1) {
-            memcpy(sc->data, s_info.data, outcount);
-        } else {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-            memcpy(sc->data, s_info.data, outcount << 1);
-#else
-            for (i = 0; i < outcount; i++) {
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[i]);
-            }
-#endif
+    sc->loopstart = s_info.loopstart == -1 ? -1 : ((int64_t)s_info.loopstart << 16) / step;
+    sc->width = 2;
+    sc->samples = samples;
+    sc->rate = s_info.rate;
+    sc->stream = stream;
+
+    // a stream's guard sample is simply the next one
+    count = stream ? resident + 1 : samples;
+
+    out = (int16_t *)sc->data;
+    if (s_info.width == 1) {
+        for (i = 0; i < count; i++) {
+            out[i] = (s_info.data[i] - 128) << 8;
         }
     } else {
-// general case
-        samplefrac = 0;
-        fracstep = stepscale * 256;
-        if (sc->width == 1) {
-            for (i = 0; i < outcount; i++) {
-                srcsample = samplefrac >> 8;
-                samplefrac += fracstep;
-                sc->data[i] = s_info.data[srcsample];
-            }
-        } else {
-            for (i = 0; i < outcount; i++) {
-                srcsample = samplefrac >> 8;
-                samplefrac += fracstep;
-                ((uint16_t *)sc->data)[i] = LittleShort(((uint16_t *)s_info.data)[srcsample]);
-            }
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+        memcpy(out, s_info.data, count << 1);
+#else
+        for (i = 0; i < count; i++) {
+            out[i] = LittleShort(((uint16_t *)s_info.data)[i]);
         }
+#endif
     }
 
+    if (stream)
+        return sc;
+
+    // the last sample interpolates towards the loop start
+    if (s_info.loopstart >= 0 && s_info.loopstart < samples)
+        out[samples] = out[s_info.loopstart];
+    else
+        out[samples] = out[samples - 1];
+
     return sc;
 }
 #endif
@@ -334,7 +905,7 @@ sfxcache_t *S_LoadSound(sfx_t *s)
 
 #if USE_SNDDMA
     if (s_started == SS_DMA)
-        sc = ResampleSfx(s);
+        sc = ConvertSfx(s, s_info.data - data);
 #endif
 
 fail:
@@ -17,15 +17,20 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 // snd_mix.c -- portable code to mix sounds for snd_dma.c
 
+#include <algorithm>
+#include <chrono>
+
 #include "sound.h"
 
 #define    PAINTBUFFER_SIZE    2048
 
-static int snd_scaletable[32][256];
-static int snd_vol;
+static std::atomic<int> snd_vol;   // set by the main thread
+
+// channel data resampled to the output rate, one paint buffer worth
+static int16_t s_resamplebuffer[PAINTBUFFER_SIZE];
 
 samplepair_t s_rawsamples[S_MAX_RAW_SAMPLES];
-int          s_rawend = 0;
+std::atomic<int> s_rawend;
 
 static void WriteLinearBlast(int16_t *out, samplepair_t *samp, int count)
 {
@@ -125,65 +130,228 @@ static void TransferPaintBuffer(samplepair_t *samp, int endTime)
 
 CHANNEL MIXING
 
+The loops below are kept free of branches and calls, so that the compiler
+turns them into SIMD code, widening 16 bit samples to 32 bit accumulators.
+
 ===============================================================================
 */
 
-static void Paint8(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp)
+// accumulates count samples with the given gains
+static void PaintSamples(samplepair_t *samp, const int16_t *sfx, int count, int leftvol, int rightvol)
 {
-    int data;
-    int *lscale, *rscale;
-    uint8_t *sfx;
     int i;
 
-    if (ch->leftvol > 255)
-        ch->leftvol = 255;
-    if (ch->rightvol > 255)
-        ch->rightvol = 255;
+    for (i = 0; i < count; i++) {
+        const int data = sfx[i];
+
+        samp[i].left += (data * leftvol) >> 8;
+        samp[i].right += (data * rightvol) >> 8;
+    }
+}
+
+// adds count samples of the raw stream
+static void PaintRawSamples(samplepair_t *samp, const samplepair_t *raw, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        samp[i].left += raw[i].left;
+        samp[i].right += raw[i].right;
+    }
+}
+
+/*
+================
+Resample
 
-    lscale = snd_scaletable[ch->leftvol >> 3];
-    rscale = snd_scaletable[ch->rightvol >> 3];
-    sfx = (uint8_t *)sc->data + ch->pos;
+Linearly interpolates count output samples from the sound, starting at
+the 16.16 fixed point position pos and advancing by step. The fraction is
+taken down to 15 bits to keep the products within 32 bits.
+================
+*/
+static void Resample(int16_t *out, const int16_t *sfx, int64_t pos, int step, int count)
+{
+    const int16_t *base = sfx + (pos >> 16);
+    const int frac = pos & 0xffff;
+    int i;
 
-    for (i = 0; i < count; i++, samp++) {
-        data = *sfx++;
-        samp->left += lscale[data];
-        samp->right += rscale[data];
+    for (i = 0; i < count; i++) {
+        const int p = frac + i * step;
+        const int a = base[p >> 16];
+        const int b = base[(p >> 16) + 1];
+
+        out[i] = a + (((b - a) * ((p & 0xffff) >> 1)) >> 15);
     }
+}
+
+/*
+================
+PaintChannel
+
+Paints count samples of the channel from its current position. Sounds are
+kept at their own rate and resampled here, unless it matches the output.
+Streamed sounds are painted a chunk at a time, each chunk carries the
+sample after it for interpolation.
+================
+*/
+static void PaintStreamChannel(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp, int leftvol, int rightvol)
+{
+    const int step = ((int64_t)sc->rate << 16) / dma.speed;
+    const int vol = snd_vol.load(std::memory_order_relaxed);
+    int64_t pos = (int64_t)ch->pos * step;
+    const int16_t *sfx;
+    int64_t first;
+    int chunk, n;
 
     ch->pos += count;
+
+    while (count > 0) {
+        chunk = (pos >> 16) / STREAM_CHUNK_SAMPLES;
+        first = (int64_t)chunk * STREAM_CHUNK_SAMPLES << 16;
+
+        // output samples starting within this chunk
+        n = (first + ((int64_t)STREAM_CHUNK_SAMPLES << 16) - pos + step - 1) / step;
+        n = min(n, count);
+
+        // silence until the chunk is read in
+        sfx = S_StreamChunk(sc, chunk);
+        if (sfx) {
+            if (step == 1 << 16) {
+                sfx += (pos - first) >> 16;
+            } else {
+                Resample(s_resamplebuffer, sfx, pos - first, step, n);
+                sfx = s_resamplebuffer;
+            }
+            PaintSamples(samp, sfx, n, leftvol * vol, rightvol * vol);
+        }
+
+        samp += n;
+        count -= n;
+        pos += (int64_t)n * step;
+    }
 }
 
-static void Paint16(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp)
+static void PaintChannel(channel_t *ch, sfxcache_t *sc, int count, samplepair_t *samp, int leftvol, int rightvol)
 {
-    int data;
-    int left, right;
-    int leftvol, rightvol;
-    int16_t *sfx;
-    int i;
+    const int16_t *sfx = (const int16_t *)sc->data;
+    const int step = ((int64_t)sc->rate << 16) / dma.speed;
+    const int vol = snd_vol.load(std::memory_order_relaxed);
 
-    leftvol = ch->leftvol * snd_vol;
-    rightvol = ch->rightvol * snd_vol;
-    sfx = (int16_t *)sc->data + ch->pos;
+    if (sc->stream) {
+        PaintStreamChannel(ch, sc, count, samp, leftvol, rightvol);
+        return;
+    }
 
-    for (i = 0; i < count; i++, samp++) {
-        data = *sfx++;
-        left = (data * leftvol) >> 8;
-        right = (data * rightvol) >> 8;
-        samp->left += left;
-        samp->right += right;
+    if (step == 1 << 16) {
+        sfx += ch->pos;
+    } else {
+        Resample(s_resamplebuffer, sfx, (int64_t)ch->pos * step, step, count);
+        sfx = s_resamplebuffer;
     }
 
+    PaintSamples(samp, sfx, count, leftvol * vol, rightvol * vol);
+
     ch->pos += count;
 }
 
-void S_PaintChannels(int endTime)
+/*
+================
+MixChannels
+
+Paints all channels into the paint buffer from paintedtime up to end.
+
+Channels playing the same sound in step with an earlier one, like the
+same impact sound started by several entities at once, are mixed once
+with their gains added, the way S_AddLoopSounds merges entity sounds.
+This keeps busy scenes from costing one pass per channel.
+================
+*/
+static void MixChannels(samplepair_t *paintbuffer, int end)
 {
-    samplepair_t paintbuffer[PAINTBUFFER_SIZE];
-    int i;
-    int end;
-    channel_t *ch;
+    int leftvol[MAX_CHANNELS], rightvol[MAX_CHANNELS];
+    int leader[MAX_CHANNELS];
+    int i, j;
+    channel_t *ch, *other;
     sfxcache_t *sc;
     int ltime, count;
+
+    // find the channels that can be merged
+    for (i = 0, ch = channels; i < s_numchannels; i++, ch++) {
+        leftvol[i] = ch->leftvol;
+        rightvol[i] = ch->rightvol;
+        leader[i] = -1;
+
+        if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
+            continue;
+
+        for (j = 0, other = channels; j < i; j++, other++) {
+            if (leader[j] == -1 && other->sfx == ch->sfx && other->pos == ch->pos &&
+                other->end == ch->end && other->autosound == ch->autosound &&
+                (other->leftvol || other->rightvol)) {
+                leftvol[j] = min(leftvol[j] + ch->leftvol, 255);
+                rightvol[j] = min(rightvol[j] + ch->rightvol, 255);
+                leader[i] = j;
+                break;
+            }
+        }
+    }
+
+    // paint in the channels.
+    for (i = 0, ch = channels; i < s_numchannels; i++, ch++) {
+        if (leader[i] != -1) {
+            // already painted, just follow along
+            other = &channels[leader[i]];
+            ch->sfx = other->sfx;
+            ch->pos = other->pos;
+            ch->end = other->end;
+            continue;
+        }
+
+        ltime = paintedtime;
+
+        while (ltime < end) {
+            if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
+                break;
+
+            // max painting is to the end of the buffer
+            count = end - ltime;
+
+            // might be stopped by running out of data
+            if (ch->end - ltime < count)
+                count = ch->end - ltime;
+
+            sc = ch->sfx->cache;
+            if (!sc)
+                break;
+
+            if (count > 0) {
+                PaintChannel(ch, sc, count, &paintbuffer[ltime - paintedtime], leftvol[i], rightvol[i]);
+                ltime += count;
+            }
+
+            // if at end of loop, restart
+            if (ltime >= ch->end) {
+                if (ch->autosound) {
+                    // autolooping sounds always go back to start
+                    ch->pos = 0;
+                    ch->end = ltime + sc->length;
+                } else if (sc->loopstart >= 0) {
+                    ch->pos = sc->loopstart;
+                    ch->end = ltime + sc->length - ch->pos;
+                } else {
+                    // channel just stopped
+                    ch->sfx = NULL;
+                }
+            }
+        }
+    }
+}
+
+void S_PaintChannels(int endTime)
+{
+    samplepair_t paintbuffer[PAINTBUFFER_SIZE];
+    int i, s;
+    int end, stop, count, rawend;
     playsound_t *ps;
 
     while (paintedtime < endTime) {
@@ -210,65 +378,17 @@ void S_PaintChannels(int endTime)
         // clear the paint buffer
         memset(paintbuffer, 0, (end - paintedtime) * sizeof(samplepair_t));
 
-        // paint in the channels.
-        ch = channels;
-        for (i = 0; i < s_numchannels; i++, ch++) {
-            ltime = paintedtime;
-
-            while (ltime < end) {
-                if (!ch->sfx || (!ch->leftvol && !ch->rightvol))
-                    break;
-
-                // max painting is to the end of the buffer
-                count = end - ltime;
+        MixChannels(paintbuffer, end);
 
-                // might be stopped by running out of data
-                if (ch->end - ltime < count)
-                    count = ch->end - ltime;
-
-                sc = S_LoadSound(ch->sfx);
-                if (!sc)
-                    break;
-
-                if (count > 0 && ch->sfx) {
-                    samplepair_t *samp = &paintbuffer[ltime - paintedtime];
-                    if (sc->width == 1)
-                        Paint8(ch, sc, count, samp);
-                    else
-                        Paint16(ch, sc, count, samp);
-
-                    ltime += count;
-                }
-
-                // if at end of loop, restart
-                if (ltime >= ch->end) {
-                    if (ch->autosound) {
-                        // autolooping sounds always go back to start
-                        ch->pos = 0;
-                        ch->end = ltime + sc->length;
-                    } else if (sc->loopstart >= 0) {
-                        ch->pos = sc->loopstart;
-                        ch->end = ltime + sc->length - ch->pos;
-                    } else {
-                        // channel just stopped
-                        ch->sfx = NULL;
-                    }
-                }
+        rawend = s_rawend.load(std::memory_order_acquire);
+        if (rawend >= paintedtime) {
+            // add from the streaming sound source, in contiguous runs
+            stop = min(end, rawend);
+            for (i = paintedtime; i < stop; i += count) {
+                s = i & (S_MAX_RAW_SAMPLES - 1);
+                count = min(stop - i, S_MAX_RAW_SAMPLES - s);
+                PaintRawSamples(&paintbuffer[i - paintedtime], &s_rawsamples[s], count);
             }
-
-        }
-
-        if (s_rawend >= paintedtime)
-        {
-          /* add from the streaming sound source */
-          int stop = (end < s_rawend) ? end : s_rawend;
-
-          for (int i = paintedtime; i < stop; i++)
-          {
-            int s = i & (S_MAX_RAW_SAMPLES - 1);
-            paintbuffer[i - paintedtime].left += s_rawsamples[s].left;
-            paintbuffer[i - paintedtime].right += s_rawsamples[s].right;
-          }
         }
 
         // transfer out according to DMA format
@@ -280,20 +400,95 @@ void S_PaintChannels(int endTime)
 
 void S_InitScaletable(void)
 {
-    int        i, j;
-    int        scale;
-
     snd_vol = S_GetLinearVolume(s_volume->value) * 256;
-    for (i = 0; i < 32; i++) {
-        scale = i * 8 * snd_vol;
-        for (j = 0; j < 256; j++) {
-            snd_scaletable[i][j] = (j - 128) * scale;
-        }
-    }
 
     s_volume->modified = false;
 }
 
+/*
+===============
+S_MixBenchmark_f
+
+mixbench [channels] [seconds]
+
+Mixes the given number of channels, playing the sounds of the current map,
+into a scratch buffer without touching the DMA buffer. Every other channel
+plays in step with the one before it, so merged channels are covered too.
+The channels are restored afterwards.
+===============
+*/
+void S_MixBenchmark_f(void)
+{
+    using clock = std::chrono::steady_clock;
+    static channel_t saved[MAX_CHANNELS];
+    samplepair_t paintbuffer[PAINTBUFFER_SIZE];
+    sfx_t *sfxlist[MAX_SOUNDS];
+    int i, numsfx, numchannels, savedtime, total, end;
+    float seconds;
+    qboolean running;
+    channel_t *ch;
+    sfx_t *sfx;
+
+    if (s_started != SS_DMA) {
+        Com_Printf("Software mixer is not running.\n");
+        return;
+    }
+
+    numsfx = 0;
+    for (i = 1; i < MAX_SOUNDS; i++) {
+        sfx = S_SfxForHandle(cl.precaches.sounds[i]);
+        if (sfx && (sfx->cache || S_LoadSound(sfx)))
+            sfxlist[numsfx++] = sfx;
+    }
+
+    if (!numsfx) {
+        Com_Printf("No sounds loaded.\n");
+        return;
+    }
+
+    numchannels = Cmd_Argc() > 1 ? atoi(Cmd_Argv(1)) : MAX_CHANNELS;
+    clamp(numchannels, 1, MAX_CHANNELS);
+    seconds = Cmd_Argc() > 2 ? atof(Cmd_Argv(2)) : 10;
+    clamp(seconds, 0.1f, 600.f);
+
+    // take the channels away from the mixer thread
+    running = DMA_StopMixer();
+
+    memcpy(saved, channels, sizeof(saved));
+    savedtime = paintedtime;
+    paintedtime = 0;
+
+    std::fill(std::begin(channels), std::end(channels), channel_t{});
+    for (i = 0, ch = channels; i < numchannels; i++, ch++) {
+        ch->sfx = sfxlist[(i >> 1) % numsfx];
+        ch->leftvol = 64 + ((i * 37) & 127);
+        ch->rightvol = 64 + ((i * 91) & 127);
+        ch->autosound = true;
+        ch->pos = (i & 1) ? ch[-1].pos : (i * 997) % ch->sfx->cache->length;
+        ch->end = ch->sfx->cache->length - ch->pos;
+    }
+
+    total = seconds * dma.speed;
+
+    auto start = clock::now();
+    while (paintedtime < total) {
+        end = min(paintedtime + PAINTBUFFER_SIZE, total);
+        memset(paintbuffer, 0, (end - paintedtime) * sizeof(samplepair_t));
+        MixChannels(paintbuffer, end);
+        paintedtime = end;
+    }
+    double msec = std::chrono::duration<double, std::milli>(clock::now() - start).count();
+
+    Com_Printf("%d channels, %.1f s at %d Hz: %.3f ms, %.3f%% of real time\n",
+               numchannels, seconds, dma.speed, msec, msec / (seconds * 10));
+
+    memcpy(channels, saved, sizeof(saved));
+    paintedtime = savedtime;
+
+    if (running)
+        DMA_StartMixer();
+}
+
 /*
  * Cinematic streaming and voice over network.
  * This could be used for chat over network, but
@@ -311,8 +506,11 @@ S_RawSamples(int samples, int rate, int width,
 	  return;
   }
 
-  if (s_rawend < paintedtime)
-    s_rawend = paintedtime;
+  int rawend = s_rawend.load(std::memory_order_relaxed);
+  int painted = DMA_PaintedTime();
+
+  if (rawend < painted)
+    rawend = painted;
 
   // mimic the OpenAL behavior: s_volume is master volume
   volume *= s_volume->value;
@@ -332,8 +530,8 @@ S_RawSamples(int samples, int rate, int width,
         break;
       }
 
-      int dst = s_rawend & (S_MAX_RAW_SAMPLES - 1);
-      s_rawend++;
+      int dst = rawend & (S_MAX_RAW_SAMPLES - 1);
+      rawend++;
       s_rawsamples[dst].left = ((short *)data)[src * 2] * intVolume;
       s_rawsamples[dst].right = ((short *)data)[src * 2 + 1] * intVolume;
     }
@@ -349,8 +547,8 @@ S_RawSamples(int samples, int rate, int width,
         break;
       }
 
-      int dst = s_rawend & (S_MAX_RAW_SAMPLES - 1);
-      s_rawend++;
+      int dst = rawend & (S_MAX_RAW_SAMPLES - 1);
+      rawend++;
       s_rawsamples[dst].left = ((short *)data)[src] * intVolume;
       s_rawsamples[dst].right = ((short *)data)[src] * intVolume;
     }
@@ -368,8 +566,8 @@ S_RawSamples(int samples, int rate, int width,
         break;
       }
 
-      int dst = s_rawend & (S_MAX_RAW_SAMPLES - 1);
-      s_rawend++;
+      int dst = rawend & (S_MAX_RAW_SAMPLES - 1);
+      rawend++;
       s_rawsamples[dst].left =
         (((byte *)data)[src * 2] - 128) * intVolume;
       s_rawsamples[dst].right =
@@ -389,12 +587,15 @@ S_RawSamples(int samples, int rate, int width,
         break;
       }
 
-      int dst = s_rawend & (S_MAX_RAW_SAMPLES - 1);
-      s_rawend++;
+      int dst = rawend & (S_MAX_RAW_SAMPLES - 1);
+      rawend++;
       s_rawsamples[dst].left = (((byte *)data)[src] - 128) * intVolume;
       s_rawsamples[dst].right = (((byte *)data)[src] - 128) * intVolume;
     }
   }
+
+  // hand the new samples to the mixer
+  s_rawend.store(rawend, std::memory_order_release);
 }
 
 void S_UnqueueRawSamples()
@@ -36,6 +36,10 @@
 
 #include <errno.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
 #include "shared/shared.h"
 #include "sound.h"
 #include "client/sound/vorbis.h"
@@ -54,6 +58,21 @@ static ogg_status_t ogg_status;   /* Status indicator. */
 static stb_vorbis *ogg_file;      /* Ogg Vorbis file. */
 static qboolean ogg_started;      /* Initialization flag. */
 
+/* Decoded samples waiting to be played. The decoder thread keeps this
+   ring filled ahead of playback, so Vorbis decoding never runs on the
+   main thread. */
+enum { OGG_RING_SAMPLES = 1 << 17 }; /* interleaved, a power of two */
+
+static struct {
+	std::thread thread;
+	std::atomic<bool> quit;
+	std::atomic<bool> eof;
+	std::atomic<unsigned> head; /* written by the decoder thread */
+	std::atomic<unsigned> tail; /* written by the main thread */
+	qboolean running;
+	short samples[OGG_RING_SAMPLES];
+} ogg_decoder;
+
 enum { MAX_NUM_OGGTRACKS = 32 };
 static char* ogg_tracks[MAX_NUM_OGGTRACKS];
 static int ogg_maxfileindex;
@@ -228,38 +247,133 @@ OGG_InitTrackList(void)
 
 // --------
 
+/*
+ * Decode the currently opened file into the ring,
+ * until it ends or the decoder is stopped.
+ */
+static void
+OGG_Decode(void)
+{
+	short samples[4096];
+	const int channels = ogg_file->channels;
+
+	while (!ogg_decoder.quit)
+	{
+		unsigned head = ogg_decoder.head.load(std::memory_order_relaxed);
+		unsigned used = head - ogg_decoder.tail.load(std::memory_order_acquire);
+
+		/* Wait for the main thread to play some. */
+		if (OGG_RING_SAMPLES - used < Q_COUNTOF(samples))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			continue;
+		}
+
+		int read_samples = stb_vorbis_get_samples_short_interleaved(ogg_file, channels, samples,
+			Q_COUNTOF(samples));
+
+		if (read_samples <= 0)
+		{
+			ogg_decoder.eof = true;
+			return;
+		}
+
+		int count = read_samples * channels;
+		int start = head & (OGG_RING_SAMPLES - 1);
+		int first = min(count, OGG_RING_SAMPLES - start);
+
+		memcpy(ogg_decoder.samples + start, samples, first * sizeof(short));
+		memcpy(ogg_decoder.samples, samples + first, (count - first) * sizeof(short));
+
+		ogg_decoder.head.store(head + count, std::memory_order_release);
+	}
+}
+
+static void
+OGG_StartDecoder(void)
+{
+	ogg_decoder.quit = false;
+	ogg_decoder.eof = false;
+	ogg_decoder.head = 0;
+	ogg_decoder.tail = 0;
+	ogg_decoder.thread = std::thread(OGG_Decode);
+	ogg_decoder.running = true;
+}
+
+/*
+ * Must be called before touching ogg_file.
+ */
+static void
+OGG_StopDecoder(void)
+{
+	if (!ogg_decoder.running)
+	{
+		return;
+	}
+
+	ogg_decoder.quit = true;
+	ogg_decoder.thread.join();
+	ogg_decoder.running = false;
+}
+
 /*
  * Play a portion of the currently opened file.
+ * Returns false if there is nothing to play yet.
  */
-void
-static OGG_Read(void)
+static qboolean
+OGG_Read(void)
 {
-	short samples[4096] = {0};
+	short samples[4096];
 
-	int read_samples = stb_vorbis_get_samples_short_interleaved(ogg_file, ogg_file->channels, samples,
-		sizeof(samples) / ogg_file->channels);
+	if (!ogg_decoder.running)
+	{
+		OGG_StartDecoder();
+	}
 
-	if (read_samples > 0)
+	unsigned tail = ogg_decoder.tail.load(std::memory_order_relaxed);
+	unsigned avail = ogg_decoder.head.load(std::memory_order_acquire) - tail;
+
+	if (avail > 0)
 	{
+		// the decoder writes whole frames, so this does too
+		int count = min(avail, Q_COUNTOF(samples));
+		int start = tail & (OGG_RING_SAMPLES - 1);
+		int first = min(count, OGG_RING_SAMPLES - start);
+
+		memcpy(samples, ogg_decoder.samples + start, first * sizeof(short));
+		memcpy(samples + first, ogg_decoder.samples, (count - first) * sizeof(short));
+
+		ogg_decoder.tail.store(tail + count, std::memory_order_release);
+
+		int read_samples = count / ogg_file->channels;
 		ogg_numsamples += read_samples;
 
 		S_RawSamples(read_samples, ogg_file->sample_rate, ogg_file->channels, ogg_file->channels,
 			(byte *)samples, S_GetLinearVolume(ogg_volume->value));
+
+		return true;
 	}
-	else
-	{
-		// We cannot call OGG_Stop() here. It flushes the OpenAL sample
-		// queue, thus about 12 seconds of music are lost. Instead we
-		// just set the OGG state to stop and open a new file. The new
-		// files content is added to the sample queue after the remaining
-		// samples from the old file.
-		stb_vorbis_close(ogg_file);
-		ogg_status = STOP;
-		ogg_numbufs = 0;
-		ogg_numsamples = 0;
 
-		OGG_PlayTrack(ogg_curfile);
+	if (!ogg_decoder.eof)
+	{
+		// decoder fell behind, try again next frame
+		return false;
 	}
+
+	// We cannot call OGG_Stop() here. It flushes the OpenAL sample
+	// queue, thus about 12 seconds of music are lost. Instead we
+	// just set the OGG state to stop and open a new file. The new
+	// files content is added to the sample queue after the remaining
+	// samples from the old file.
+	OGG_StopDecoder();
+	stb_vorbis_close(ogg_file);
+	ogg_status = STOP;
+	ogg_numbufs = 0;
+	ogg_numsamples = 0;
+
+	OGG_PlayTrack(ogg_curfile);
+
+	return ogg_status == PLAY;
 }
 
 /*
@@ -293,23 +407,31 @@ OGG_Stream(void)
 			   buffering normal sfx _and_ ogg/vorbis samples. */
 			while (active_buffers <= ogg_numbufs)
 			{
-				OGG_Read();
+				if (!OGG_Read())
+				{
+					break;
+				}
 			}
 		}
 		else /* using SDL */
 #endif
 		{
+#if USE_SNDDMA
 			if (s_started == SS_DMA)
 			{
 				/* Read that number samples into the buffer, that
 				   were played since the last call to this function.
 				   This keeps the buffer at all times at an "optimal"
 				   fill level. */
-				while (paintedtime + S_MAX_RAW_SAMPLES - 2048 > s_rawend)
+				while (DMA_PaintedTime() + S_MAX_RAW_SAMPLES - 2048 > s_rawend)
 				{
-					OGG_Read();
+					if (!OGG_Read())
+					{
+						break;
+					}
 				}
 			}
+#endif
 		}
 	}
 }
@@ -459,12 +581,12 @@ OGG_Info(void)
 	{
 		case PLAY:
 			Com_Printf("State: Playing file %d (%s) at %i samples.\n",
-			           ogg_curfile, ogg_tracks[ogg_curfile], stb_vorbis_get_sample_offset(ogg_file));
+			           ogg_curfile, ogg_tracks[ogg_curfile], ogg_numsamples);
 			break;
 
 		case PAUSE:
 			Com_Printf("State: Paused file %d (%s) at %i samples.\n",
-			           ogg_curfile, ogg_tracks[ogg_curfile], stb_vorbis_get_sample_offset(ogg_file));
+			           ogg_curfile, ogg_tracks[ogg_curfile], ogg_numsamples);
 			break;
 
 		case STOP:
@@ -499,6 +621,7 @@ OGG_Stop(void)
 	}
 #endif
 
+	OGG_StopDecoder();
 	stb_vorbis_close(ogg_file);
 	ogg_status = STOP;
 	ogg_numbufs = 0;
@@ -628,6 +751,7 @@ OGG_RecoverState(void)
 	Cvar_SetValue(ogg_shuffle, 0, FROM_CODE);
 
 	OGG_PlayTrack(ogg_saved_state.curfile);
+	OGG_StopDecoder();
 	stb_vorbis_seek_frame(ogg_file, ogg_saved_state.numsamples);
 	ogg_numsamples = ogg_saved_state.numsamples;
 
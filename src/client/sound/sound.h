@@ -18,6 +18,8 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 // sound.h -- private sound functions
 
+#include <atomic>
+
 #include "../client.h"
 
 #if USE_SNDDMA
@@ -34,6 +36,11 @@ typedef struct sfxcache_s {
     int         length;
     int         loopstart;
     int         width;
+#if USE_SNDDMA
+    int         samples;        // 16 bit samples in data, plus one for interpolation
+    int         rate;           // resampled to dma.speed by the mixer
+    struct sndstream_s *stream; // only the first chunk is in data if set
+#endif
 #if USE_OPENAL
     int         size;
     int         bufnum;
@@ -41,6 +48,10 @@ typedef struct sfxcache_s {
     byte        data[1];        // variable sized
 } sfxcache_t;
 
+#if USE_SNDDMA
+#define STREAM_CHUNK_SAMPLES    16384   // streamed sounds are read in these
+#endif
+
 typedef struct sfx_s {
     char        name[MAX_QPATH];
     int         registration_sequence;
@@ -79,12 +90,53 @@ typedef struct channel_s {
     float       master_vol;     // 0.0-1.0 master volume
     qboolean    fixed_origin;   // use origin instead of fetching entnum's origin
     qboolean    autosound;      // from an entity->sound, cleared each frame
+#if USE_SNDDMA
+    vec3_t      spatial_origin; // origin leftvol/rightvol were computed for
+    unsigned    spatial_stamp;  // s_spatialstamp at that time, 0 if never
+#endif
 #if USE_OPENAL
     int         autoframe;
     int         srcnum;
 #endif
 } channel_t;
 
+#if USE_SNDDMA
+
+// entity as seen by the mixer, in the ascending number order of the frame
+typedef struct {
+    int         number;
+    sfx_t       *sound;         // looping sound, NULL if none
+    vec3_t      origin;
+} s_entity_t;
+
+// client state the mixer needs to spatialize channels and add loop
+// sounds, copied once per frame on the main thread
+typedef struct {
+    qboolean    active;         // connection is active
+    qboolean    loopsounds;     // entity loop sounds are audible
+    qboolean    swapstereo;
+    int         entnum;         // listener entity
+    vec3_t      origin;         // listener origin
+    vec3_t      right;
+    int         numentities;
+    s_entity_t  entities[MAX_PACKET_ENTITIES];
+} s_frame_t;
+
+typedef enum {
+    S_CMD_PLAY,                 // add playsound to the pending list
+    S_CMD_STOP,                 // stop all sounds and clear the buffer
+    S_CMD_FRAME                 // respatialize from a new frame
+} s_cmdtype_t;
+
+// the main thread talks to the mixer only through these
+typedef struct {
+    s_cmdtype_t type;
+    unsigned    frame;          // S_CMD_FRAME sequence
+    playsound_t play;           // S_CMD_PLAY
+} s_command_t;
+
+#endif
+
 typedef struct {
     char    *name;
     int     rate;
@@ -110,6 +162,11 @@ void DMA_Activate(void);
 int DMA_DriftBeginofs(float timeofs);
 void DMA_ClearBuffer(void);
 void DMA_Update(void);
+void DMA_StartMixer(void);
+qboolean DMA_StopMixer(void);
+void DMA_Command(const s_command_t *cmd);
+void DMA_Flush(void);
+int DMA_PaintedTime(void);
 #endif
 
 #if USE_OPENAL
@@ -139,7 +196,7 @@ extern int active_buffers;
 
 extern qboolean s_active;
 
-#define MAX_CHANNELS            64
+#define MAX_CHANNELS            128
 extern  channel_t   channels[MAX_CHANNELS];
 extern  int         s_numchannels;
 
@@ -154,7 +211,7 @@ extern  int         listener_entnum;
 
 #define S_MAX_RAW_SAMPLES 8192
 extern samplepair_t s_rawsamples[S_MAX_RAW_SAMPLES];
-extern int          s_rawend;
+extern std::atomic<int> s_rawend;  // written by the main thread only
 
 extern  wavinfo_t   s_info;
 
@@ -187,7 +244,17 @@ channel_t *S_PickChannel(int entnum, int entchannel);
 void S_IssuePlaysound(playsound_t *ps);
 void S_BuildSoundList(int *sounds);
 #if USE_SNDDMA
+void S_InitStreams(void);
+void S_ShutdownStreams(void);
+void S_UpdateStreams(void);
+void S_FreeStream(sfxcache_t *sc);
+void S_StreamInfo(void);
+const int16_t *S_StreamChunk(const sfxcache_t *sc, int chunk);
+void S_ResetStreamTimes(void);
+void S_RunCommand(const s_command_t *cmd);
+void S_ClearChannels(void);
 void S_InitScaletable(void);
 void S_PaintChannels(int endTime);
+void S_MixBenchmark_f(void);
 #endif
 
@@ -1573,7 +1573,8 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
     //
     // load the file
     //
-    filelen = FS_LoadFile(name, (void **)&buf);
+    // parsed in place, lumps are copied to the hunk below
+    filelen = FS_MapFile(name, (const void **)&buf, 0);
     if (!buf) {
         return filelen;
     }
@@ -1679,7 +1680,7 @@ qerror_t BSP_Load(const char *name, bsp_t **bsp_p)
 
     List_Append(&bsp_cache, &bsp->entry);
 
-    FS_FreeFile(buf);
+    FS_UnmapFile(buf);
 
     *bsp_p = bsp;
     return Q_ERR_SUCCESS;
@@ -1688,7 +1689,7 @@ fail1:
     Hunk_Free(&bsp->hunk);
     Z_Free(bsp);
 fail2:
-    FS_FreeFile(buf);
+    FS_UnmapFile(buf);
     return ret;
 }
 
@@ -1149,6 +1149,9 @@ void Qcommon_Frame(void)
     // run system console
     Sys_RunConsole();
 
+    // hand completed asynchronous file loads to their callbacks
+    FS_RunAsyncLoads();
+
     NET_UpdateStats();
 
     remaining = SV_Frame(msec);
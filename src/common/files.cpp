@@ -17,6 +17,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+// standard headers go first, shared.h defines min/max macros
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "shared/shared.h"
 #include "shared/list.h"
 #include "common/common.h"
@@ -27,6 +35,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include "system/system.h"
 #include "client/client.h"
 #include "format/pak.h"
+#include "format/pkx.h"
 
 #include <fcntl.h>
 
@@ -34,10 +43,18 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #include <sys/stat.h>
 #ifndef WIN32
     #include <unistd.h>
+    #include <sys/mman.h>
 #else
     #define stat _stat
 #endif
 
+#ifdef __linux__
+    #define USE_INOTIFY 1
+    #include <sys/inotify.h>
+#else
+    #define USE_INOTIFY 0
+#endif
+
 #if USE_ZLIB
 #include <zlib.h>
 #endif
@@ -119,6 +136,7 @@ typedef struct packfile_s {
 #if USE_ZLIB
     size_t      complen;
     unsigned    compmtd;    // compression method, 0 (stored) or Z_DEFLATED
+    unsigned    crc;        // crc32 of uncompressed data, from central directory
     qboolean    coherent;   // true if local file header has been checked
 #endif
 
@@ -135,6 +153,9 @@ typedef struct {
     unsigned    hash_size;
     char        *names;
     char        *filename;
+    byte        *map_base;  // entire pack mapped by FS_MapFile or pkx loader, if any
+    size_t      map_size;
+    unsigned    *ext_order; // file indices sorted by extension, built on demand
 } pack_t;
 
 typedef struct searchpath_s {
@@ -179,21 +200,19 @@ static list_t       fs_soft_links;
 
 static file_t       fs_files[MAX_FILE_HANDLES];
 
-#ifdef _DEBUG
+// lookup statistics, reported by fs_stats
 static int          fs_count_read;
 static int          fs_count_open;
 static int          fs_count_strcmp;
 static int          fs_count_strlwr;
+static int          fs_count_probe;
+static int          fs_count_negative;
 #define FS_COUNT_READ       fs_count_read++
 #define FS_COUNT_OPEN       fs_count_open++
 #define FS_COUNT_STRCMP     fs_count_strcmp++
 #define FS_COUNT_STRLWR     fs_count_strlwr++
-#else
-#define FS_COUNT_READ       (void)0
-#define FS_COUNT_OPEN       (void)0
-#define FS_COUNT_STRCMP     (void)0
-#define FS_COUNT_STRLWR     (void)0
-#endif
+#define FS_COUNT_PROBE      fs_count_probe++
+#define FS_COUNT_NEGATIVE   fs_count_negative++
 
 #ifdef _DEBUG
 static cvar_t       *fs_debug;
@@ -218,6 +237,36 @@ static ssize_t read_zip_file(file_t *file, void *buf, size_t len);
 static pack_t *pack_get(pack_t *pack);
 static void pack_put(pack_t *pack);
 
+static void fs_listings_flush(void);
+static void fs_watch_close(void);
+
+// asset classes timed by FS_LoadTimes_f
+typedef enum {
+    FS_LOAD_WORLD,
+    FS_LOAD_MODELS,
+    FS_LOAD_IMAGES,
+    FS_LOAD_SOUNDS,
+    FS_LOAD_OTHER,
+
+    FS_LOAD_CLASSES
+} fs_load_class_t;
+
+typedef struct {
+    unsigned    count;
+    unsigned    prefetched;
+    size_t      bytes;
+    uint64_t    usec;
+} fs_load_stats_t;
+
+static fs_load_stats_t fs_load_classes[FS_LOAD_CLASSES];
+
+static fs_load_class_t fs_load_class(const char *path);
+static uint64_t fs_load_clock(void);
+static void fs_load_record(const char *path, ssize_t len, uint64_t start);
+
+// takes over a file prefetched by the I/O threads
+static qboolean fs_async_claim(const char *path, unsigned flags, void **buffer, ssize_t *len_p);
+
 /*
 
 All of Quake's data access is through a hierchal file system,
@@ -1057,6 +1106,9 @@ static ssize_t open_file_write(file_t *file, const char *name)
 
     FS_DPrintf("%s: %s: %lu bytes\n", __func__, fullpath, pos);
 
+    // directory listings and failed lookups may be stale now
+    FS_InvalidatePathCache();
+
     file->type = FS_REAL;
     file->fp = fp;
     file->unique = true;
@@ -1180,6 +1232,79 @@ static ssize_t tell_zip_file(file_t *file)
     return s->stream.total_out;
 }
 
+// inflates an entire deflated entry in one call and checks its crc.
+// uses a private stream with default allocators, safe to call from any thread.
+static qerror_t inflate_zip_entry(const byte *in, size_t inlen, void *out, size_t outlen, unsigned crc)
+{
+    z_stream z;
+    int ret;
+
+    if (inlen > UINT_MAX || outlen > UINT_MAX) {
+        return Q_ERR_INVAL;
+    }
+
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -MAX_WBITS) != Z_OK) {
+        return Q_ERR_INFLATE_FAILED;
+    }
+
+    z.next_in = (Bytef *)in; // CPP: Cast
+    z.avail_in = (uInt)inlen;
+    z.next_out = (Bytef *)out; // CPP: Cast
+    z.avail_out = (uInt)outlen;
+
+    // with the whole input and output available inflate stays in its fast
+    // loop instead of returning to the caller after every window
+    ret = inflate(&z, Z_FINISH);
+    inflateEnd(&z);
+
+    if (ret != Z_STREAM_END || z.total_out != outlen) {
+        return Q_ERR_INFLATE_FAILED;
+    }
+
+    if (crc32(0, (const Bytef *)out, (uInt)outlen) != crc) {
+        return Q_ERR_INFLATE_FAILED;
+    }
+
+    return Q_ERR_SUCCESS;
+}
+
+// reads the whole entry at once, called when the caller wants the entire
+// file and nothing has been read yet
+static ssize_t read_zip_file_whole(file_t *file, void *buf, size_t len)
+{
+    zipstream_t *s = (zipstream_t*)file->zfp; // CPP: Cast
+    packfile_t *entry = file->entry;
+    const byte *in;
+    byte *temp = NULL;
+    qerror_t ret;
+
+    if (file->pack->map_base && entry->filepos + entry->complen <= file->pack->map_size) {
+        in = file->pack->map_base + entry->filepos;
+    } else {
+        temp = (byte*)FS_AllocTempMem(entry->complen); // CPP: Cast
+        if (fread(temp, 1, entry->complen, file->fp) != entry->complen) {
+            FS_FreeTempMem(temp);
+            file->error = FS_ERR_READ(file->fp);
+            return file->error;
+        }
+        in = temp;
+    }
+
+    ret = inflate_zip_entry(in, entry->complen, buf, len, entry->crc);
+    FS_FreeTempMem(temp);
+
+    if (ret) {
+        file->error = ret;
+        return ret;
+    }
+
+    s->rest_in = 0;
+    s->stream.total_out = len;
+    file->rest_out = 0;
+    return len;
+}
+
 static ssize_t read_zip_file(file_t *file, void *buf, size_t len)
 {
     zipstream_t *s = (zipstream_t*)file->zfp; // CPP: Cast
@@ -1194,6 +1319,10 @@ static ssize_t read_zip_file(file_t *file, void *buf, size_t len)
         return 0;
     }
 
+    if (len == file->length && s->rest_in == file->entry->complen && !z->total_out) {
+        return read_zip_file_whole(file, buf, len);
+    }
+
     z->next_out = (Bytef*)buf; // CPP: Cast
     z->avail_out = (uInt)len;
 
@@ -1402,575 +1531,1885 @@ qerror_t FS_LastModified(char const * file, uint64_t * last_modified)
     return Q_ERR_INVALID_PATH;
 }
 
-// Finds the file in the search path.
-// Fills file_t and returns file length.
-// Used for streaming data out of either a pak file or a seperate file.
-static ssize_t open_file_read(file_t *file, const char *normalized, size_t namelen, qboolean unique)
-{
-    char            fullpath[MAX_OSPATH];
-    searchpath_t    *search;
-    pack_t          *pak;
-    unsigned        hash;
-    packfile_t      *entry;
-    ssize_t         ret;
-    int             valid;
-    size_t          len;
+/*
+=============================================================================
 
-    FS_COUNT_READ;
+MERGED PATH INDEX
 
-    hash = FS_HashPath(normalized, 0);
+Pack entries of all search paths are merged into a single hash table,
+chained in search path order, so that a lookup only has to walk one
+bucket instead of probing every pack. Loose directories are scanned
+lazily, one directory listing at a time, and files that couldn't be
+found are remembered until something gets written to the filesystem.
 
-    valid = PATH_NOT_CHECKED;
+=============================================================================
+*/
 
-// search through the path, one element at a time
-    for (search = fs_searchpaths; search; search = search->next) {
-        if (file->mode & FS_PATH_MASK) {
-            if ((file->mode & search->mode & FS_PATH_MASK) == 0) {
-                continue;
-            }
-        }
+#define FS_DIRLIST_HASH_SIZE    256
+#define FS_NEGATIVE_HASH_SIZE   1024
+#define FS_NEGATIVE_MAX         4096
 
-        // is the element a pak file?
-        if (search->pack) {
-            if ((file->mode & FS_TYPE_MASK) == FS_TYPE_REAL) {
-                continue;
-            }
-            // don't bother searching in paks if length exceedes MAX_QPATH
-            if (namelen >= MAX_QPATH) {
-                continue;
-            }
-            pak = search->pack;
-#if USE_ZLIB
-            if ((file->mode & FS_FLAG_DEFLATE) && pak->type != FS_ZIP) {
-                continue;
-            }
-#endif
-            // look through all the pak file elements
-            entry = pak->file_hash[hash & (pak->hash_size - 1)];
-            for (; entry; entry = entry->hash_next) {
-                if (entry->namelen != namelen) {
-                    continue;
-                }
-#if USE_ZLIB
-                if ((file->mode & FS_FLAG_DEFLATE) && entry->compmtd != Z_DEFLATED) {
-                    continue;
-                }
-#endif
-                FS_COUNT_STRCMP;
-                if (!FS_pathcmp(entry->name, normalized)) {
-                    // found it!
-                    return open_from_pak(file, pak, entry, unique);
-                }
-            }
-        } else {
-            if ((file->mode & FS_TYPE_MASK) == FS_TYPE_PAK) {
-                continue;
-            }
+// mode bits that affect the outcome of a lookup
 #if USE_ZLIB
-            if (file->mode & FS_FLAG_DEFLATE) {
-                continue;
-            }
+#define FS_INDEX_MODE_MASK  (FS_TYPE_MASK | FS_PATH_MASK | FS_FLAG_DEFLATE)
+#else
+#define FS_INDEX_MODE_MASK  (FS_TYPE_MASK | FS_PATH_MASK)
 #endif
-            // don't error out immediately if the path is found to be invalid,
-            // just stop looking for it in directory tree but continue to search
-            // for it in packs, to give broken maps or mods a chance to work
-            if (valid == PATH_NOT_CHECKED) {
-                valid = FS_ValidatePath(normalized);
-            }
-            if (valid == PATH_INVALID) {
-                continue;
-            }
-            // check a file in the directory tree
-            len = Q_concat(fullpath, sizeof(fullpath),
-                           search->filename, "/", normalized, NULL);
-            if (len >= sizeof(fullpath)) {
-                ret = Q_ERR_NAMETOOLONG;
-                goto fail;
-            }
 
-            ret = open_from_disk(file, fullpath);
-            if (ret != Q_ERR_NOENT)
-                return ret;
+// single pack entry, chained in search path order
+typedef struct fs_index_entry_s {
+    struct fs_index_entry_s *hash_next;
+    searchpath_t    *search;
+    packfile_t      *entry;
+    unsigned        order;      // position of search path, lower takes priority
+} fs_index_entry_t;
 
-#ifndef _WIN32
-            if (valid == PATH_MIXED_CASE) {
-                // convert to lower case and retry
-                FS_COUNT_STRLWR;
-                Q_strlwr(fullpath + strlen(search->filename) + 1);
-                ret = open_from_disk(file, fullpath);
-                if (ret != Q_ERR_NOENT)
-                    return ret;
+// loose directory, in search path order
+typedef struct {
+    searchpath_t    *search;
+    unsigned        order;      // position of search path, lower takes priority
+} fs_index_loose_t;
+
+// cached listing of a single directory within a loose search path
+typedef struct fs_dirlist_s {
+    struct fs_dirlist_s *hash_next;
+    unsigned    loose;      // index into fs_path_index.loose
+    int         count;      // number of files, -1 if listing was truncated
+    char        **files;    // sorted file names
+    size_t      pathlen;
+    char        path[1];    // directory relative to search path
+} fs_dirlist_t;
+
+// path that couldn't be found with the given mode
+typedef struct fs_negative_s {
+    struct fs_negative_s *hash_next;
+    unsigned    mode;
+    size_t      namelen;
+    char        name[1];
+} fs_negative_t;
+
+typedef struct {
+    qboolean            dirty;      // search paths changed, rebuild before use
+
+    fs_index_entry_t    *entries;
+    fs_index_entry_t    **hash;
+    unsigned            hash_size;
+    unsigned            num_entries;
+
+    fs_index_loose_t    *loose;
+    unsigned            num_loose;
+
+    fs_dirlist_t        *dirlists[FS_DIRLIST_HASH_SIZE];
+    unsigned            num_dirlists;
+
+    fs_negative_t       *negatives[FS_NEGATIVE_HASH_SIZE];
+    unsigned            num_negatives;
+} fs_path_index_t;
+
+static fs_path_index_t  fs_path_index = { true };
+
+static cvar_t           *fs_index;
+
+static void fs_index_flush_dirlists(void)
+{
+    fs_dirlist_t *list, *next;
+    int i, j;
+
+    for (i = 0; i < FS_DIRLIST_HASH_SIZE; i++) {
+        for (list = fs_path_index.dirlists[i]; list; list = next) {
+            next = list->hash_next;
+            for (j = 0; j < list->count; j++) {
+                Z_Free(list->files[j]);
             }
-#endif
+            Z_Free(list->files);
+            Z_Free(list);
         }
+        fs_path_index.dirlists[i] = NULL;
     }
 
-    // return error if path was checked and found to be invalid
-    ret = valid ? Q_ERR_NOENT : Q_ERR_INVALID_PATH;
-
-fail:
-    FS_DPrintf("%s: %s: %s\n", __func__, normalized, Q_ErrorString(ret));
-    return ret;
+    fs_path_index.num_dirlists = 0;
 }
 
-// Normalizes quake path, expands symlinks
-static ssize_t expand_open_file_read(file_t *file, const char *name, qboolean unique)
+static void fs_index_flush_negatives(void)
 {
-    char        normalized[MAX_OSPATH];
-    ssize_t     ret;
-    size_t      namelen;
+    fs_negative_t *neg, *next;
+    int i;
 
-// normalize path
-    namelen = FS_NormalizePathBuffer(normalized, name, MAX_OSPATH);
-    if (namelen >= MAX_OSPATH) {
-        return Q_ERR_NAMETOOLONG;
+    for (i = 0; i < FS_NEGATIVE_HASH_SIZE; i++) {
+        for (neg = fs_path_index.negatives[i]; neg; neg = next) {
+            next = neg->hash_next;
+            Z_Free(neg);
+        }
+        fs_path_index.negatives[i] = NULL;
     }
 
-// expand hard symlinks
-    if (expand_links(&fs_hard_links, normalized, &namelen) && namelen >= MAX_OSPATH) {
-        return Q_ERR_NAMETOOLONG;
-    }
+    fs_path_index.num_negatives = 0;
+}
 
-// reject empty paths
-    if (namelen == 0) {
-        return Q_ERR_NAMETOOSHORT;
-    }
+// frees everything and schedules a rebuild on next lookup
+static void fs_index_free(void)
+{
+    fs_index_flush_dirlists();
+    fs_index_flush_negatives();
+    fs_listings_flush();
+    fs_watch_close();
+
+    Z_Free(fs_path_index.entries);
+    fs_path_index.entries = NULL;
+    fs_path_index.hash = NULL;
+    fs_path_index.loose = NULL;
+    fs_path_index.hash_size = 0;
+    fs_path_index.num_entries = 0;
+    fs_path_index.num_loose = 0;
+    fs_path_index.dirty = true;
+}
 
-    ret = open_file_read(file, normalized, namelen, unique);
-    if (ret == Q_ERR_NOENT) {
-// expand soft symlinks
-        if (expand_links(&fs_soft_links, normalized, &namelen)) {
-            if (namelen >= MAX_OSPATH) {
-                return Q_ERR_NAMETOOLONG;
-            }
-            ret = open_file_read(file, normalized, namelen, unique);
-        }
-    }
+/*
+================
+FS_InvalidatePathCache
 
-    return ret;
+Forgets cached directory listings and failed lookups. Must be called
+whenever a file is created in a search path outside of FS_FOpenFile.
+================
+*/
+void FS_InvalidatePathCache(void)
+{
+    fs_index_flush_dirlists();
+    fs_index_flush_negatives();
+    fs_listings_flush();
 }
 
-static ssize_t read_pak_file(file_t *file, void *buf, size_t len)
+static void fs_index_changed(cvar_t *self)
 {
-    size_t result;
+    fs_index_free();
+}
 
-    if (len > file->rest_out) {
-        len = file->rest_out;
-    }
-    if (!len) {
-        return 0;
+static void fs_index_build(void)
+{
+    searchpath_t        *search;
+    fs_index_entry_t    *e;
+    pack_t              *pack;
+    unsigned            total, numloose, order, hash;
+    int                 i;
+
+    fs_index_free();
+
+    total = numloose = 0;
+    for (search = fs_searchpaths; search; search = search->next) {
+        if (search->pack) {
+            total += search->pack->num_files;
+        } else {
+            numloose++;
+        }
     }
 
-    result = fread(buf, 1, len, file->fp);
-    if (result != len) {
-        file->error = FS_ERR_READ(file->fp);
-        if (!result) {
-            return file->error;
+    fs_path_index.hash_size = npot32(total ? total : 1);
+    fs_path_index.entries = (fs_index_entry_t *)FS_Malloc(total * sizeof(fs_index_entry_t) + // CPP: Cast
+                                                          fs_path_index.hash_size * sizeof(fs_index_entry_t *) +
+                                                          numloose * sizeof(fs_index_loose_t));
+    fs_path_index.hash = (fs_index_entry_t **)(fs_path_index.entries + total);
+    fs_path_index.loose = (fs_index_loose_t *)(fs_path_index.hash + fs_path_index.hash_size);
+    memset(fs_path_index.hash, 0, fs_path_index.hash_size * sizeof(fs_index_entry_t *));
+
+    // fill entries in search order, mirroring pack hash chain order
+    e = fs_path_index.entries;
+    for (search = fs_searchpaths, order = 0; search; search = search->next, order++) {
+        if (!search->pack) {
+            fs_path_index.loose[fs_path_index.num_loose].search = search;
+            fs_path_index.loose[fs_path_index.num_loose].order = order;
+            fs_path_index.num_loose++;
+            continue;
+        }
+        pack = search->pack;
+        for (i = pack->num_files - 1; i >= 0; i--, e++) {
+            e->search = search;
+            e->entry = &pack->files[i];
+            e->order = order;
         }
     }
+    fs_path_index.num_entries = e - fs_path_index.entries;
 
-    file->rest_out -= result;
-    return result;
+    // insert backwards so that chains end up in search order
+    for (e = fs_path_index.entries + fs_path_index.num_entries - 1; e >= fs_path_index.entries; e--) {
+        hash = FS_HashPath(e->entry->name, fs_path_index.hash_size);
+        e->hash_next = fs_path_index.hash[hash];
+        fs_path_index.hash[hash] = e;
+    }
+
+    fs_path_index.dirty = false;
+
+    FS_DPrintf("%s: %u pack entries, %u loose directories\n",
+               __func__, fs_path_index.num_entries, fs_path_index.num_loose);
 }
 
-static ssize_t read_phys_file(file_t *file, void *buf, size_t len)
+static qboolean fs_index_find_negative(const char *normalized, size_t namelen, unsigned hash, unsigned mode)
 {
-    size_t result;
+    fs_negative_t *neg;
 
-    result = fread(buf, 1, len, file->fp);
-    if (result != len && ferror(file->fp)) {
-        file->error = Q_Errno();
-        if (!result) {
-            return file->error;
+    for (neg = fs_path_index.negatives[hash & (FS_NEGATIVE_HASH_SIZE - 1)]; neg; neg = neg->hash_next) {
+        if (neg->mode == mode && neg->namelen == namelen && !strcmp(neg->name, normalized)) {
+            return true;
         }
     }
 
-    return result;
+    return false;
 }
 
-/*
-=================
-FS_Read
-=================
-*/
-ssize_t FS_Read(void *buf, size_t len, qhandle_t f)
+static void fs_index_add_negative(const char *normalized, size_t namelen, unsigned hash, unsigned mode)
 {
-    file_t *file = file_for_handle(f);
-#if USE_ZLIB
-    int ret;
-#endif
+    fs_negative_t *neg;
 
-    if (!file)
-        return Q_ERR_BADF;
+    if (fs_path_index.num_negatives >= FS_NEGATIVE_MAX) {
+        fs_index_flush_negatives();
+    }
 
-    if ((file->mode & FS_MODE_MASK) != FS_MODE_READ)
-        return Q_ERR_INVAL;
+    neg = (fs_negative_t *)FS_Malloc(sizeof(*neg) + namelen); // CPP: Cast
+    neg->mode = mode;
+    neg->namelen = namelen;
+    memcpy(neg->name, normalized, namelen + 1);
+    neg->hash_next = fs_path_index.negatives[hash & (FS_NEGATIVE_HASH_SIZE - 1)];
+    fs_path_index.negatives[hash & (FS_NEGATIVE_HASH_SIZE - 1)] = neg;
+    fs_path_index.num_negatives++;
+}
 
-    // can't continue after error
-    if (file->error)
-        return file->error;
+// listings are compared the same way the host filesystem does
+static int fs_dirlist_cmp(const void *p1, const void *p2)
+{
+#ifdef _WIN32
+    return FS_pathcmp(*(const char **)p1, *(const char **)p2);
+#else
+    return strcmp(*(const char **)p1, *(const char **)p2);
+#endif
+}
+
+// returns listing of the directory, reading it on first use
+static fs_dirlist_t *fs_dirlist_get(unsigned loose, const char *dir, size_t dirlen)
+{
+    char            fullpath[MAX_OSPATH];
+    void            *files[MAX_LISTED_FILES];
+    searchpath_t    *search;
+    fs_dirlist_t    *list;
+    unsigned        hash;
+    size_t          len;
+    int             i, count;
+
+    hash = (Com_HashStringLen(dir, dirlen, FS_DIRLIST_HASH_SIZE) + loose) & (FS_DIRLIST_HASH_SIZE - 1);
+    for (list = fs_path_index.dirlists[hash]; list; list = list->hash_next) {
+        if (list->loose == loose && list->pathlen == dirlen && !strncmp(list->path, dir, dirlen)) {
+            return list;
+        }
+    }
+
+    search = fs_path_index.loose[loose].search;
+    if (dirlen) {
+        len = Q_snprintf(fullpath, sizeof(fullpath), "%s/%.*s", search->filename, (int)dirlen, dir);
+    } else {
+        len = Q_strlcpy(fullpath, search->filename, sizeof(fullpath));
+    }
+
+    count = 0;
+    if (len < sizeof(fullpath)) {
+        Sys_ListFiles_r(fullpath, NULL, 0, len + 1, &count, files, 0);
+    }
+
+    list = (fs_dirlist_t *)FS_Malloc(sizeof(*list) + dirlen); // CPP: Cast
+    list->loose = loose;
+    list->pathlen = dirlen;
+    memcpy(list->path, dir, dirlen);
+    list->path[dirlen] = 0;
+    list->files = NULL;
+    list->count = count;
+
+    if (count >= MAX_LISTED_FILES || len >= sizeof(fullpath)) {
+        // too many files to be sure, these directories get probed as usual
+        for (i = 0; i < count; i++) {
+            Z_Free(files[i]);
+        }
+        list->count = -1;
+    } else if (count) {
+        list->files = (char **)FS_Malloc(count * sizeof(char *)); // CPP: Cast
+        memcpy(list->files, files, count * sizeof(char *));
+        qsort(list->files, count, sizeof(char *), fs_dirlist_cmp);
+    }
+
+    list->hash_next = fs_path_index.dirlists[hash];
+    fs_path_index.dirlists[hash] = list;
+    fs_path_index.num_dirlists++;
+
+    return list;
+}
+
+// returns false if the directory listing proves the file doesn't exist
+static qboolean fs_dirlist_may_contain(unsigned loose, const char *normalized)
+{
+    fs_dirlist_t *list;
+    const char *base;
+    size_t dirlen;
+
+    base = strrchr(normalized, '/');
+    if (base) {
+        dirlen = base - normalized;
+        base++;
+    } else {
+        dirlen = 0;
+        base = normalized;
+    }
+
+    // dotfiles are never listed
+    if (*base == '.') {
+        return true;
+    }
+
+    list = fs_dirlist_get(loose, normalized, dirlen);
+    if (list->count < 0) {
+        return true;
+    }
+
+    FS_COUNT_PROBE;
+    return bsearch(&base, list->files, list->count, sizeof(char *), fs_dirlist_cmp) != NULL;
+}
+
+// opens a file from the directory tree of a loose search path,
+// retrying in lower case if the path is mixed case
+static ssize_t open_from_dir(file_t *file, searchpath_t *search, const char *normalized, int valid)
+{
+    char    fullpath[MAX_OSPATH];
+    ssize_t ret;
+    size_t  len;
+
+    len = Q_concat(fullpath, sizeof(fullpath),
+                   search->filename, "/", normalized, NULL);
+    if (len >= sizeof(fullpath)) {
+        return Q_ERR_NAMETOOLONG;
+    }
+
+    FS_COUNT_PROBE;
+    ret = open_from_disk(file, fullpath);
+    if (ret != Q_ERR_NOENT)
+        return ret;
+
+#ifndef _WIN32
+    if (valid == PATH_MIXED_CASE) {
+        // convert to lower case and retry
+        FS_COUNT_STRLWR;
+        FS_COUNT_PROBE;
+        Q_strlwr(fullpath + strlen(search->filename) + 1);
+        ret = open_from_disk(file, fullpath);
+    }
+#endif
+
+    return ret;
+}
+
+// checks a loose search path of the merged index,
+// consulting the directory listing before touching the disk
+static ssize_t open_from_loose(file_t *file, unsigned loose, const char *normalized, int *valid)
+{
+    searchpath_t *search = fs_path_index.loose[loose].search;
+
+    if (file->mode & FS_PATH_MASK) {
+        if ((file->mode & search->mode & FS_PATH_MASK) == 0) {
+            return Q_ERR_NOENT;
+        }
+    }
+    if ((file->mode & FS_TYPE_MASK) == FS_TYPE_PAK) {
+        return Q_ERR_NOENT;
+    }
+#if USE_ZLIB
+    if (file->mode & FS_FLAG_DEFLATE) {
+        return Q_ERR_NOENT;
+    }
+#endif
+
+    if (*valid == PATH_NOT_CHECKED) {
+        *valid = FS_ValidatePath(normalized);
+    }
+    if (*valid == PATH_INVALID) {
+        return Q_ERR_NOENT;
+    }
+
+    // mixed case paths may match in lower case, which listings can't tell
+    if (*valid == PATH_VALID && !fs_dirlist_may_contain(loose, normalized)) {
+        return Q_ERR_NOENT;
+    }
+
+    return open_from_dir(file, search, normalized, *valid);
+}
+
+// Finds the file using the merged path index.
+// Walks a single hash bucket of pack entries in search order, trying
+// loose directories that precede each candidate first.
+static ssize_t open_file_read_indexed(file_t *file, const char *normalized, size_t namelen, qboolean unique)
+{
+    fs_index_entry_t    *e;
+    unsigned            hash, mode, loose;
+    ssize_t             ret;
+    int                 valid;
+
+    if (fs_path_index.dirty) {
+        fs_index_build();
+    }
+
+    hash = FS_HashPath(normalized, 0);
+    mode = file->mode & FS_INDEX_MODE_MASK;
+
+    if (fs_index_find_negative(normalized, namelen, hash, mode)) {
+        FS_COUNT_NEGATIVE;
+        return Q_ERR_NOENT;
+    }
+
+    valid = PATH_NOT_CHECKED;
+    loose = 0;
+
+    // don't bother searching in paks if length exceedes MAX_QPATH
+    e = NULL;
+    if (namelen < MAX_QPATH && (file->mode & FS_TYPE_MASK) != FS_TYPE_REAL) {
+        e = fs_path_index.hash[hash & (fs_path_index.hash_size - 1)];
+    }
+
+    while (1) {
+        // find the next pack entry matching name and mode
+        for (; e; e = e->hash_next) {
+            if (e->entry->namelen != namelen) {
+                continue;
+            }
+            if (file->mode & FS_PATH_MASK) {
+                if ((file->mode & e->search->mode & FS_PATH_MASK) == 0) {
+                    continue;
+                }
+            }
+#if USE_ZLIB
+            if (file->mode & FS_FLAG_DEFLATE) {
+                if (e->search->pack->type != FS_ZIP || e->entry->compmtd != Z_DEFLATED) {
+                    continue;
+                }
+            }
+#endif
+            FS_COUNT_STRCMP;
+            FS_COUNT_PROBE;
+            if (!FS_pathcmp(e->entry->name, normalized)) {
+                break;
+            }
+        }
+
+        // loose directories higher up in the search path take priority
+        for (; loose < fs_path_index.num_loose; loose++) {
+            if (e && fs_path_index.loose[loose].order > e->order) {
+                break;
+            }
+            ret = open_from_loose(file, loose, normalized, &valid);
+            if (ret != Q_ERR_NOENT) {
+                return ret;
+            }
+        }
+
+        if (!e) {
+            break;
+        }
+
+        // found it!
+        return open_from_pak(file, e->search->pack, e->entry, unique);
+    }
+
+    // return error if path was checked and found to be invalid
+    if (!valid) {
+        ret = Q_ERR_INVALID_PATH;
+    } else {
+        ret = Q_ERR_NOENT;
+        fs_index_add_negative(normalized, namelen, hash, mode);
+    }
+
+    FS_DPrintf("%s: %s: %s\n", __func__, normalized, Q_ErrorString(ret));
+    return ret;
+}
+
+// Finds the file in the search path.
+// Fills file_t and returns file length.
+// Used for streaming data out of either a pak file or a seperate file.
+static ssize_t open_file_read(file_t *file, const char *normalized, size_t namelen, qboolean unique)
+{
+    searchpath_t    *search;
+    pack_t          *pak;
+    unsigned        hash;
+    packfile_t      *entry;
+    ssize_t         ret;
+    int             valid;
+
+    FS_COUNT_READ;
+
+    // real files are usually written by ourselves, never cache these
+    if (fs_index->integer && (file->mode & FS_TYPE_MASK) != FS_TYPE_REAL) {
+        return open_file_read_indexed(file, normalized, namelen, unique);
+    }
+
+    hash = FS_HashPath(normalized, 0);
+
+    valid = PATH_NOT_CHECKED;
+
+// search through the path, one element at a time
+    for (search = fs_searchpaths; search; search = search->next) {
+        if (file->mode & FS_PATH_MASK) {
+            if ((file->mode & search->mode & FS_PATH_MASK) == 0) {
+                continue;
+            }
+        }
+
+        // is the element a pak file?
+        if (search->pack) {
+            if ((file->mode & FS_TYPE_MASK) == FS_TYPE_REAL) {
+                continue;
+            }
+            // don't bother searching in paks if length exceedes MAX_QPATH
+            if (namelen >= MAX_QPATH) {
+                continue;
+            }
+            pak = search->pack;
+#if USE_ZLIB
+            if ((file->mode & FS_FLAG_DEFLATE) && pak->type != FS_ZIP) {
+                continue;
+            }
+#endif
+            // look through all the pak file elements
+            entry = pak->file_hash[hash & (pak->hash_size - 1)];
+            for (; entry; entry = entry->hash_next) {
+                if (entry->namelen != namelen) {
+                    continue;
+                }
+#if USE_ZLIB
+                if ((file->mode & FS_FLAG_DEFLATE) && entry->compmtd != Z_DEFLATED) {
+                    continue;
+                }
+#endif
+                FS_COUNT_STRCMP;
+                FS_COUNT_PROBE;
+                if (!FS_pathcmp(entry->name, normalized)) {
+                    // found it!
+                    return open_from_pak(file, pak, entry, unique);
+                }
+            }
+        } else {
+            if ((file->mode & FS_TYPE_MASK) == FS_TYPE_PAK) {
+                continue;
+            }
+#if USE_ZLIB
+            if (file->mode & FS_FLAG_DEFLATE) {
+                continue;
+            }
+#endif
+            // don't error out immediately if the path is found to be invalid,
+            // just stop looking for it in directory tree but continue to search
+            // for it in packs, to give broken maps or mods a chance to work
+            if (valid == PATH_NOT_CHECKED) {
+                valid = FS_ValidatePath(normalized);
+            }
+            if (valid == PATH_INVALID) {
+                continue;
+            }
+            // check a file in the directory tree
+            ret = open_from_dir(file, search, normalized, valid);
+            if (ret == Q_ERR_NAMETOOLONG)
+                goto fail;
+            if (ret != Q_ERR_NOENT)
+                return ret;
+        }
+    }
+
+    // return error if path was checked and found to be invalid
+    ret = valid ? Q_ERR_NOENT : Q_ERR_INVALID_PATH;
+
+fail:
+    FS_DPrintf("%s: %s: %s\n", __func__, normalized, Q_ErrorString(ret));
+    return ret;
+}
+
+// Normalizes quake path, expands symlinks
+static ssize_t expand_open_file_read(file_t *file, const char *name, qboolean unique)
+{
+    char        normalized[MAX_OSPATH];
+    ssize_t     ret;
+    size_t      namelen;
+
+// normalize path
+    namelen = FS_NormalizePathBuffer(normalized, name, MAX_OSPATH);
+    if (namelen >= MAX_OSPATH) {
+        return Q_ERR_NAMETOOLONG;
+    }
+
+// expand hard symlinks
+    if (expand_links(&fs_hard_links, normalized, &namelen) && namelen >= MAX_OSPATH) {
+        return Q_ERR_NAMETOOLONG;
+    }
+
+// reject empty paths
+    if (namelen == 0) {
+        return Q_ERR_NAMETOOSHORT;
+    }
+
+    ret = open_file_read(file, normalized, namelen, unique);
+    if (ret == Q_ERR_NOENT) {
+// expand soft symlinks
+        if (expand_links(&fs_soft_links, normalized, &namelen)) {
+            if (namelen >= MAX_OSPATH) {
+                return Q_ERR_NAMETOOLONG;
+            }
+            ret = open_file_read(file, normalized, namelen, unique);
+        }
+    }
+
+    return ret;
+}
+
+static ssize_t read_pak_file(file_t *file, void *buf, size_t len)
+{
+    size_t result;
+
+    if (len > file->rest_out) {
+        len = file->rest_out;
+    }
+    if (!len) {
+        return 0;
+    }
+
+    result = fread(buf, 1, len, file->fp);
+    if (result != len) {
+        file->error = FS_ERR_READ(file->fp);
+        if (!result) {
+            return file->error;
+        }
+    }
+
+    file->rest_out -= result;
+    return result;
+}
+
+static ssize_t read_phys_file(file_t *file, void *buf, size_t len)
+{
+    size_t result;
+
+    result = fread(buf, 1, len, file->fp);
+    if (result != len && ferror(file->fp)) {
+        file->error = Q_Errno();
+        if (!result) {
+            return file->error;
+        }
+    }
+
+    return result;
+}
+
+/*
+=================
+FS_Read
+=================
+*/
+ssize_t FS_Read(void *buf, size_t len, qhandle_t f)
+{
+    file_t *file = file_for_handle(f);
+#if USE_ZLIB
+    int ret;
+#endif
+
+    if (!file)
+        return Q_ERR_BADF;
+
+    if ((file->mode & FS_MODE_MASK) != FS_MODE_READ)
+        return Q_ERR_INVAL;
+
+    // can't continue after error
+    if (file->error)
+        return file->error;
+
+    if (len > SSIZE_MAX)
+        return Q_ERR_INVAL;
+
+    if (len == 0)
+        return 0;
+
+    switch (file->type) {
+    case FS_REAL:
+        return read_phys_file(file, buf, len);
+    case FS_PAK:
+        return read_pak_file(file, buf, len);
+#if USE_ZLIB
+    case FS_GZ:
+        ret = gzread((gzFile)file->zfp, buf, len); // CPP: Cast
+        if (ret < 0) {
+            return Q_ERR_LIBRARY_ERROR;
+        }
+        return ret;
+    case FS_ZIP:
+        return read_zip_file(file, buf, len);
+#endif
+    default:
+        return Q_ERR_NOSYS;
+    }
+}
+
+ssize_t FS_ReadLine(qhandle_t f, char *buffer, size_t size)
+{
+    file_t *file = file_for_handle(f);
+    char *s;
+    size_t len;
+
+    if (!file)
+        return Q_ERR_BADF;
+
+    if ((file->mode & FS_MODE_MASK) != FS_MODE_READ)
+        return Q_ERR_INVAL;
+
+    if (file->type != FS_REAL)
+        return Q_ERR_NOSYS;
+
+    do {
+        s = fgets(buffer, size, file->fp);
+        if (!s) {
+            return ferror(file->fp) ? Q_Errno() : 0;
+        }
+        len = strlen(s);
+    } while (len < 2);
+
+    s[len - 1] = 0;
+    return len - 1;
+}
+
+void FS_Flush(qhandle_t f)
+{
+    file_t *file = file_for_handle(f);
+
+    if (!file)
+        return;
+
+    switch (file->type) {
+    case FS_REAL:
+        fflush(file->fp);
+        break;
+#if USE_ZLIB
+    case FS_GZ:
+        gzflush((gzFile)file->zfp, Z_SYNC_FLUSH); // CPP: Cast
+        break;
+#endif
+    default:
+        break;
+    }
+}
+
+/*
+=================
+FS_Write
+=================
+*/
+ssize_t FS_Write(const void *buf, size_t len, qhandle_t f)
+{
+    file_t  *file = file_for_handle(f);
+    size_t  result;
+
+    if (!file)
+        return Q_ERR_BADF;
+
+    if ((file->mode & FS_MODE_MASK) == FS_MODE_READ)
+        return Q_ERR_INVAL;
+
+    // can't continue after error
+    if (file->error)
+        return file->error;
+
+    if (len > SSIZE_MAX)
+        return Q_ERR_INVAL;
+
+    if (len == 0)
+        return 0;
+
+    switch (file->type) {
+    case FS_REAL:
+        result = fwrite(buf, 1, len, file->fp);
+        if (result != len) {
+            file->error = FS_ERR_WRITE(file->fp);
+            return file->error;
+        }
+        break;
+#if USE_ZLIB
+    case FS_GZ:
+        if (gzwrite((gzFile)file->zfp, buf, len) == 0) { // CPP: Cast
+            file->error = Q_ERR_LIBRARY_ERROR;
+            return file->error;
+        }
+        break;
+#endif
+    default:
+        Com_Error(ERR_FATAL, "%s: bad file type", __func__);
+    }
+
+    return len;
+}
+
+/*
+============
+FS_FOpenFile
+============
+*/
+ssize_t FS_FOpenFile(const char *name, qhandle_t *f, unsigned mode)
+{
+    file_t *file;
+    qhandle_t handle;
+    ssize_t ret;
+
+    if (!name || !f) {
+        Com_Error(ERR_FATAL, "%s: NULL", __func__);
+    }
+
+    *f = 0;
+
+    if (!fs_searchpaths) {
+        return Q_ERR_AGAIN; // not yet initialized
+    }
+
+    // allocate new file handle
+    file = alloc_handle(&handle);
+    if (!file) {
+        return Q_ERR_MFILE;
+    }
+
+    file->mode = mode;
+
+    if ((mode & FS_MODE_MASK) == FS_MODE_READ) {
+        ret = expand_open_file_read(file, name, true);
+    } else {
+        ret = open_file_write(file, name);
+    }
+
+    if (ret >= 0) {
+        *f = handle;
+    }
+
+    return ret;
+}
+
+// reading from outside of source directory is allowed, extension is optional
+static qhandle_t easy_open_read(char *buf, size_t size, unsigned mode,
+                                const char *dir, const char *name, const char *ext)
+{
+    ssize_t len;
+    qhandle_t f;
+
+    if (*name == '/') {
+        // full path is given, ignore directory and extension
+        len = Q_strlcpy(buf, name + 1, size);
+    } else {
+        // first try without extension
+        len = Q_concat(buf, size, dir, name, NULL);
+        if (len >= size) {
+            Q_PrintError("open", Q_ERR_NAMETOOLONG);
+            return 0;
+        }
+
+        // print normalized path in case of error
+        FS_NormalizePath(buf, buf);
+
+        len = FS_FOpenFile(buf, &f, mode);
+        if (f) {
+            return f; // succeeded
+        }
+        if (len != Q_ERR_NOENT) {
+            goto fail; // fatal error
+        }
+        if (!COM_CompareExtension(buf, ext)) {
+            goto fail; // name already has the extension
+        }
+
+        // now try to append extension
+        len = Q_strlcat(buf, ext, size);
+    }
+
+    if (len >= size) {
+        Q_PrintError("open", Q_ERR_NAMETOOLONG);
+        return 0;
+    }
+
+    len = FS_FOpenFile(buf, &f, mode);
+    if (f) {
+        return f;
+    }
+
+fail:
+    Com_Printf("Couldn't open %s: %s\n", buf, Q_ErrorString(len));
+    return 0;
+}
+
+// writing to outside of destination directory is disallowed, extension is forced
+static qhandle_t easy_open_write(char *buf, size_t size, unsigned mode,
+                                 const char *dir, const char *name, const char *ext)
+{
+    char normalized[MAX_OSPATH];
+    ssize_t len;
+    qhandle_t f;
+
+    // make it impossible to escape the destination directory when writing files
+    len = FS_NormalizePathBuffer(normalized, name, sizeof(normalized));
+    if (len >= sizeof(normalized)) {
+        Q_PrintError("open", Q_ERR_NAMETOOLONG);
+        return 0;
+    }
+
+    // reject empty filenames
+    if (len == 0) {
+        Q_PrintError("open", Q_ERR_NAMETOOSHORT);
+        return 0;
+    }
+
+    // replace any bad characters with underscores to make automatic commands happy
+    cleanup_path(normalized);
+
+    // don't append the extension if name already has it
+    if (!COM_CompareExtension(normalized, ext)) {
+        ext = (mode & FS_FLAG_GZIP) ? "" : NULL;
+    }
+
+    len = Q_concat(buf, size, dir, normalized, ext,
+                   (mode & FS_FLAG_GZIP) ? ".gz" : NULL, NULL);
+    if (len >= size) {
+        Q_PrintError("open", Q_ERR_NAMETOOLONG);
+        return 0;
+    }
+
+    len = FS_FOpenFile(buf, &f, mode);
+    if (!f) {
+        goto fail1;
+    }
+
+    if (mode & FS_FLAG_GZIP) {
+        len = FS_FilterFile(f);
+        if (len) {
+            goto fail2;
+        }
+    }
+
+    return f;
+
+fail2:
+    FS_FCloseFile(f);
+fail1:
+    Com_EPrintf("Couldn't open %s: %s\n", buf, Q_ErrorString(len));
+    return 0;
+}
+
+/*
+============
+FS_EasyOpenFile
+
+Helper function for various console commands. Concatenates
+the arguments, checks for path buffer overflow, and attempts
+to open the file, printing an error message in case of failure.
+============
+*/
+qhandle_t FS_EasyOpenFile(char *buf, size_t size, unsigned mode,
+                          const char *dir, const char *name, const char *ext)
+{
+    if ((mode & FS_MODE_MASK) == FS_MODE_READ) {
+        return easy_open_read(buf, size, mode, dir, name, ext);
+    }
+
+    return easy_open_write(buf, size, mode, dir, name, ext);
+}
+
+/*
+============
+FS_LoadFile
+
+opens non-unique file handle as an optimization
+a NULL buffer will just return the file length without loading
+============
+*/
+static ssize_t load_file(const char *path, void **buffer, unsigned flags, memtag_t tag)
+{
+    file_t *file;
+    qhandle_t f;
+    byte *buf;
+    ssize_t len, read;
+
+    if (!path) {
+        Com_Error(ERR_FATAL, "%s: NULL", __func__);
+    }
+
+    if (buffer) {
+        *buffer = NULL;
+    }
+
+    if (!fs_searchpaths) {
+        return Q_ERR_AGAIN; // not yet initialized
+    }
+
+    // take over the buffer if the file has been prefetched
+    if (buffer && tag == TAG_FILESYSTEM && fs_async_claim(path, flags, buffer, &len)) {
+        return len;
+    }
+
+    // allocate new file handle
+    file = alloc_handle(&f);
+    if (!file) {
+        return Q_ERR_MFILE;
+    }
+
+    file->mode = (flags & ~FS_MODE_MASK) | FS_MODE_READ;
+
+    // look for it in the filesystem or pack files
+    len = expand_open_file_read(file, path, false);
+    if (len < 0) {
+        return len;
+    }
+
+    // NULL buffer just checks for file existence
+    if (!buffer) {
+        goto done;
+    }
+
+    // sanity check file size
+    if (len > MAX_LOADFILE) {
+        len = Q_ERR_FBIG;
+        goto done;
+    }
+
+    // allocate chunk of memory, +1 for NUL
+    buf = (byte*)Z_TagMalloc(len + 1, tag); // CPP: Cast
+
+    // read entire file
+    read = FS_Read(buf, len, f);
+    if (read != len) {
+        len = read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
+        Z_Free(buf);
+        goto done;
+    }
+
+    *buffer = buf;
+    buf[len] = 0;
+
+done:
+    FS_FCloseFile(f);
+    return len;
+}
+
+ssize_t FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t tag)
+{
+    uint64_t start;
+    ssize_t len;
+
+    // existence checks aren't worth timing
+    if (!buffer) {
+        return load_file(path, buffer, flags, tag);
+    }
+
+    start = fs_load_clock();
+    len = load_file(path, buffer, flags, tag);
+    fs_load_record(path, len, start);
+
+    return len;
+}
+
+/*
+=============================================================================
+
+MAPPED FILE LOADING
+
+Binary assets are handed out as read-only views into memory mapped packs
+and files, so that they can be parsed in place without an intermediate
+copy. Packs are mapped once, on first use, and stay mapped for as long as
+they are referenced. Anything that can't be mapped, like deflated zip
+entries, is transparently loaded into a buffer instead.
+
+=============================================================================
+*/
+
+#define MAX_MAPPED_FILES    32
+
+// Loaders cast views to structures, so pack entries are only viewed in place
+// when suitably aligned, otherwise they get an aligned copy.
+#define MAP_VIEW_ALIGN      8
+
+typedef enum {
+    FS_MAP_FREE,
+    FS_MAP_PACK,    // view into a mapped pack, holds a pack reference
+    FS_MAP_FILE,    // loose file mapped on its own
+    FS_MAP_COPY     // fallback buffer
+} fs_maptype_t;
+
+typedef struct {
+    fs_maptype_t    type;
+    const void      *data;  // pointer handed out to the caller
+    void            *base;  // start of the mapping or buffer
+    size_t          size;   // length of the mapping
+    pack_t          *pack;
+} fs_mapping_t;
 
-    if (len > SSIZE_MAX)
-        return Q_ERR_INVAL;
+static fs_mapping_t fs_mappings[MAX_MAPPED_FILES];
 
-    if (len == 0)
-        return 0;
+static cvar_t       *fs_mmap;
 
-    switch (file->type) {
-    case FS_REAL:
-        return read_phys_file(file, buf, len);
-    case FS_PAK:
-        return read_pak_file(file, buf, len);
-#if USE_ZLIB
-    case FS_GZ:
-        ret = gzread((gzFile)file->zfp, buf, len); // CPP: Cast
-        if (ret < 0) {
-            return Q_ERR_LIBRARY_ERROR;
-        }
-        return ret;
-    case FS_ZIP:
-        return read_zip_file(file, buf, len);
+#ifndef _WIN32
+// maps the entire pack file, unmapped by pack_put once unreferenced
+static qboolean pack_map(pack_t *pack)
+{
+    file_info_t info;
+    void *base;
+
+    if (pack->map_base) {
+        return true;
+    }
+
+    if (get_fp_info(pack->fp, &info) || !info.size) {
+        return false;
+    }
+
+    // a file truncated by another process while mapped still raises SIGBUS
+    // on access to the missing pages; that risk is accepted, as for any
+    // memory mapped data file
+    base = mmap(NULL, info.size, PROT_READ, MAP_PRIVATE, fileno(pack->fp), 0);
+    if (base == MAP_FAILED) {
+        FS_DPrintf("%s: %s: %s\n", __func__, pack->filename, Q_ErrorString(Q_Errno()));
+        return false;
+    }
+
+    pack->map_base = (byte *)base; // CPP: Cast
+    pack->map_size = info.size;
+    return true;
+}
 #endif
-    default:
-        return Q_ERR_NOSYS;
+
+static fs_mapping_t *alloc_mapping(void)
+{
+    fs_mapping_t *map;
+    int i;
+
+    for (i = 0, map = fs_mappings; i < MAX_MAPPED_FILES; i++, map++) {
+        if (map->type == FS_MAP_FREE) {
+            return map;
+        }
     }
+
+    return NULL;
 }
 
-ssize_t FS_ReadLine(qhandle_t f, char *buffer, size_t size)
+/*
+================
+FS_MapFile
+
+Returns a read-only view of the file contents, which must be released
+with FS_UnmapFile. Unlike FS_LoadFile, the view is not NUL terminated,
+so this is meant for binary formats only.
+================
+*/
+static ssize_t map_file(const char *path, const void **buffer, unsigned flags)
 {
-    file_t *file = file_for_handle(f);
-    char *s;
-    size_t len;
+    fs_mapping_t *map;
+    file_t *file;
+    qhandle_t f;
+    byte *buf;
+    ssize_t len, read;
 
-    if (!file)
-        return Q_ERR_BADF;
+    if (!path || !buffer) {
+        Com_Error(ERR_FATAL, "%s: NULL", __func__);
+    }
 
-    if ((file->mode & FS_MODE_MASK) != FS_MODE_READ)
-        return Q_ERR_INVAL;
+    *buffer = NULL;
 
-    if (file->type != FS_REAL)
-        return Q_ERR_NOSYS;
+    if (!fs_searchpaths) {
+        return Q_ERR_AGAIN; // not yet initialized
+    }
 
-    do {
-        s = fgets(buffer, size, file->fp);
-        if (!s) {
-            return ferror(file->fp) ? Q_Errno() : 0;
+    map = alloc_mapping();
+    if (!map) {
+        return Q_ERR_MFILE;
+    }
+
+    // prefetched files have been read already, that beats mapping
+    if (fs_async_claim(path, flags, (void **)&buf, &len)) {
+        if (buf) {
+            map->type = FS_MAP_COPY;
+            map->base = buf;
+            map->size = len;
+            map->data = buf;
+            *buffer = map->data;
         }
-        len = strlen(s);
-    } while (len < 2);
+        return len;
+    }
 
-    s[len - 1] = 0;
-    return len - 1;
+    // allocate new file handle
+    file = alloc_handle(&f);
+    if (!file) {
+        return Q_ERR_MFILE;
+    }
+
+    file->mode = (flags & ~FS_MODE_MASK) | FS_MODE_READ;
+
+    // look for it in the filesystem or pack files
+    len = expand_open_file_read(file, path, false);
+    if (len < 0) {
+        return len;
+    }
+
+    // sanity check file size
+    if (len > MAX_LOADFILE) {
+        len = Q_ERR_FBIG;
+        goto done;
+    }
+
+#ifndef _WIN32
+    if (fs_mmap->integer && len > 0) {
+        // stored pack entries are viewed directly in the mapped pack, as
+        // long as they are aligned and really lie within the pack file
+        if (file->type == FS_PAK && !(file->entry->filepos & (MAP_VIEW_ALIGN - 1))
+            && pack_map(file->pack) && file->entry->filepos + len <= file->pack->map_size) {
+            map->type = FS_MAP_PACK;
+            map->base = file->pack->map_base;
+            map->size = file->pack->map_size;
+            map->data = file->pack->map_base + file->entry->filepos;
+            map->pack = pack_get(file->pack);
+            *buffer = map->data;
+            goto done;
+        }
+
+        // loose files get a mapping of their own, which outlives the handle
+        if (file->type == FS_REAL) {
+            void *base = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fileno(file->fp), 0);
+            if (base != MAP_FAILED) {
+                map->type = FS_MAP_FILE;
+                map->base = base;
+                map->size = len;
+                map->data = base;
+                *buffer = map->data;
+                goto done;
+            }
+        }
+    }
+#endif
+
+    // read entire file, +1 for NUL
+    buf = (byte *)FS_Malloc(len + 1); // CPP: Cast
+
+    read = FS_Read(buf, len, f);
+    if (read != len) {
+        len = read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
+        Z_Free(buf);
+        goto done;
+    }
+
+    buf[len] = 0;
+
+    map->type = FS_MAP_COPY;
+    map->base = buf;
+    map->size = len;
+    map->data = buf;
+    *buffer = map->data;
+
+done:
+    FS_FCloseFile(f);
+    return len;
 }
 
-void FS_Flush(qhandle_t f)
+ssize_t FS_MapFile(const char *path, const void **buffer, unsigned flags)
 {
-    file_t *file = file_for_handle(f);
+    uint64_t start;
+    ssize_t len;
 
-    if (!file)
+    start = fs_load_clock();
+    len = map_file(path, buffer, flags);
+    fs_load_record(path, len, start);
+
+    return len;
+}
+
+/*
+================
+FS_UnmapFile
+================
+*/
+void FS_UnmapFile(const void *buffer)
+{
+    fs_mapping_t *map;
+    int i;
+
+    if (!buffer) {
         return;
+    }
 
-    switch (file->type) {
-    case FS_REAL:
-        fflush(file->fp);
+    for (i = 0, map = fs_mappings; i < MAX_MAPPED_FILES; i++, map++) {
+        if (map->type != FS_MAP_FREE && map->data == buffer) {
+            break;
+        }
+    }
+
+    if (i == MAX_MAPPED_FILES) {
+        Com_Error(ERR_FATAL, "%s: buffer not mapped", __func__);
+    }
+
+    switch (map->type) {
+    case FS_MAP_PACK:
+        pack_put(map->pack);
         break;
-#if USE_ZLIB
-    case FS_GZ:
-        gzflush((gzFile)file->zfp, Z_SYNC_FLUSH); // CPP: Cast
+#ifndef _WIN32
+    case FS_MAP_FILE:
+        munmap(map->base, map->size);
         break;
 #endif
+    case FS_MAP_COPY:
+        Z_Free(map->base);
+        break;
     default:
         break;
     }
+
+    memset(map, 0, sizeof(*map));
 }
 
 /*
-=================
-FS_Write
-=================
+=============================================================================
+
+ASYNCHRONOUS FILE LOADING
+
+Files are located and opened on the main thread, then read (and inflated)
+by a small pool of I/O threads, highest priority class first. Jobs either
+complete through a callback run by FS_RunAsyncLoads on the main thread, or
+are prefetches without a callback, which FS_LoadFileEx and FS_MapFile take
+over once the same file is requested.
+
+Worker threads only ever touch the stream and buffer of their own job, all
+allocation and pack reference counting stays on the main thread.
+
+=============================================================================
 */
-ssize_t FS_Write(const void *buf, size_t len, qhandle_t f)
+
+#define MAX_ASYNC_LOADS     128
+#define MAX_ASYNC_THREADS   8
+
+typedef enum {
+    ASYNC_FREE,
+    ASYNC_QUEUED,
+    ASYNC_RUNNING,
+    ASYNC_DONE
+} async_state_t;
+
+typedef struct fs_async_s {
+    struct fs_async_s   *next;      // next in priority queue
+    std::atomic<async_state_t> state;   // read without the lock by the main thread
+    fs_priority_t       priority;
+    unsigned            flags;
+    char                path[MAX_QPATH];    // normalized
+    FILE                *fp;        // owned by job, positioned at file data
+    pack_t              *pack;      // referenced if file is from a pack
+    size_t              filelen;
+    size_t              complen;    // deflated length, 0 if stored
+    unsigned            crc;        // crc32 of deflated entry
+    byte                *buffer;
+    ssize_t             result;
+    fs_async_callback_t callback;
+    void                *arg;
+} fs_async_t;
+
+static struct {
+    std::mutex              mutex;
+    std::condition_variable work;       // signaled when jobs are queued
+    std::condition_variable done;       // signaled when jobs complete
+    std::thread             *threads[MAX_ASYNC_THREADS];
+    int                     num_threads;    // number of threads started
+    qboolean                quit;
+
+    fs_async_t              jobs[MAX_ASYNC_LOADS];
+    fs_async_t              *queue_head[FS_PRIORITY_MAX];
+    fs_async_t              *queue_tail[FS_PRIORITY_MAX];
+    int                     num_pending;    // jobs not yet released
+} fs_async;
+
+static cvar_t   *fs_async_threads;
+
+// reads the job's file into its buffer, runs on worker threads
+static ssize_t fs_async_read(fs_async_t *job)
 {
-    file_t  *file = file_for_handle(f);
-    size_t  result;
+    ssize_t ret = job->filelen;
 
-    if (!file)
-        return Q_ERR_BADF;
+#if USE_ZLIB
+    if (job->complen) {
+        // read the compressed span once and inflate it in one call
+        byte *in = (byte *)malloc(job->complen); // CPP: Cast
+        qerror_t err;
+
+        if (!in) {
+            ret = Q_ERR(ENOMEM);
+        } else if (fread(in, 1, job->complen, job->fp) != job->complen) {
+            ret = ferror(job->fp) ? Q_ERR(EIO) : Q_ERR_UNEXPECTED_EOF;
+        } else if ((err = inflate_zip_entry(in, job->complen, job->buffer, job->filelen, job->crc)) != Q_ERR_SUCCESS) {
+            ret = err;
+        }
 
-    if ((file->mode & FS_MODE_MASK) == FS_MODE_READ)
-        return Q_ERR_INVAL;
+        free(in);
+    } else
+#endif
+    if (fread(job->buffer, 1, job->filelen, job->fp) != job->filelen) {
+        ret = ferror(job->fp) ? Q_ERR(EIO) : Q_ERR_UNEXPECTED_EOF;
+    }
 
-    // can't continue after error
-    if (file->error)
-        return file->error;
+    fclose(job->fp);
+    job->fp = NULL;
 
-    if (len > SSIZE_MAX)
-        return Q_ERR_INVAL;
+    if (ret >= 0) {
+        job->buffer[job->filelen] = 0;
+    }
 
-    if (len == 0)
+    return ret;
+}
+
+static void fs_async_worker(void)
+{
+    std::unique_lock<std::mutex> lock(fs_async.mutex);
+    fs_async_t *job;
+    int i;
+
+    while (1) {
+        // pick the oldest job of the highest priority class
+        job = NULL;
+        for (i = 0; i < FS_PRIORITY_MAX; i++) {
+            if ((job = fs_async.queue_head[i]) != NULL) {
+                fs_async.queue_head[i] = job->next;
+                if (!job->next) {
+                    fs_async.queue_tail[i] = NULL;
+                }
+                break;
+            }
+        }
+
+        if (!job) {
+            if (fs_async.quit) {
+                return;
+            }
+            fs_async.work.wait(lock);
+            continue;
+        }
+
+        job->state.store(ASYNC_RUNNING, std::memory_order_relaxed);
+        lock.unlock();
+
+        job->result = fs_async_read(job);
+
+        lock.lock();
+        job->state.store(ASYNC_DONE, std::memory_order_release);
+        fs_async.done.notify_all();
+    }
+}
+
+// waits for the job to complete, main thread only
+static void fs_async_wait(fs_async_t *job)
+{
+    std::unique_lock<std::mutex> lock(fs_async.mutex);
+
+    while (job->state.load(std::memory_order_acquire) != ASYNC_DONE) {
+        fs_async.done.wait(lock);
+    }
+}
+
+// frees a completed job, along with its buffer unless taken over
+static void fs_async_release(fs_async_t *job)
+{
+    Z_Free(job->buffer);
+    pack_put(job->pack);
+
+    job->next = NULL;
+    job->priority = (fs_priority_t)0;
+    job->flags = 0;
+    job->path[0] = 0;
+    job->fp = NULL;
+    job->pack = NULL;
+    job->filelen = 0;
+    job->complen = 0;
+    job->crc = 0;
+    job->buffer = NULL;
+    job->result = 0;
+    job->callback = NULL;
+    job->arg = NULL;
+    job->state.store(ASYNC_FREE, std::memory_order_relaxed);
+
+    fs_async.num_pending--;
+}
+
+/*
+================
+FS_LoadFileAsync
+
+Locates and opens the file right away and queues it for reading by the
+I/O threads. Returns 0 if the file couldn't be opened or nothing can be
+queued, in which case callers should load it the usual way. A NULL
+callback prefetches the file for a later FS_LoadFileEx or FS_MapFile.
+================
+*/
+qhandle_t FS_LoadFileAsync(const char *path, unsigned flags, fs_priority_t priority,
+                           fs_async_callback_t callback, void *arg)
+{
+    fs_async_t *job;
+    file_t *file;
+    qhandle_t f;
+    ssize_t len;
+    int i;
+
+    if (!path) {
+        Com_Error(ERR_FATAL, "%s: NULL", __func__);
+    }
+
+    if (!fs_async.num_threads || !fs_searchpaths) {
         return 0;
+    }
 
-    switch (file->type) {
-    case FS_REAL:
-        result = fwrite(buf, 1, len, file->fp);
-        if (result != len) {
-            file->error = FS_ERR_WRITE(file->fp);
-            return file->error;
+    for (i = 0, job = fs_async.jobs; i < MAX_ASYNC_LOADS; i++, job++) {
+        if (job->state.load(std::memory_order_relaxed) == ASYNC_FREE) {
+            break;
         }
+    }
+    if (i == MAX_ASYNC_LOADS) {
+        return 0;
+    }
+
+    if (FS_NormalizePathBuffer(job->path, path, MAX_QPATH) >= MAX_QPATH) {
+        return 0;
+    }
+
+    // allocate new file handle, only for the duration of opening
+    file = alloc_handle(&f);
+    if (!file) {
+        return 0;
+    }
+
+    file->mode = (flags & ~FS_MODE_MASK) | FS_MODE_READ;
+
+    // open a private stream, references the pack if needed
+    len = expand_open_file_read(file, path, true);
+    if (len < 0) {
+        return 0;
+    }
+
+    if (len > MAX_LOADFILE) {
+        FS_FCloseFile(f);
+        return 0;
+    }
+
+    switch (file->type) {
+    case FS_REAL:
+    case FS_PAK:
         break;
 #if USE_ZLIB
-    case FS_GZ:
-        if (gzwrite((gzFile)file->zfp, buf, len) == 0) { // CPP: Cast
-            file->error = Q_ERR_LIBRARY_ERROR;
-            return file->error;
-        }
+    case FS_ZIP:
+        // inflated by the worker with a stream of its own
+        inflateEnd(&((zipstream_t *)file->zfp)->stream);
+        Z_Free(file->zfp);
+        job->complen = file->entry->complen;
+        job->crc = file->entry->crc;
         break;
 #endif
     default:
-        Com_Error(ERR_FATAL, "%s: bad file type", __func__);
+        FS_FCloseFile(f);
+        return 0;
     }
 
-    return len;
+    // take over stream and pack reference from the handle
+    job->fp = file->fp;
+    job->pack = file->pack;
+    memset(file, 0, sizeof(*file));
+
+    job->flags = flags;
+    job->priority = priority;
+    job->filelen = len;
+    job->buffer = (byte *)FS_Malloc(len + 1); // CPP: Cast
+    job->result = Q_ERR_AGAIN;
+    job->callback = callback;
+    job->arg = arg;
+    job->next = NULL;
+    fs_async.num_pending++;
+
+    {
+        std::lock_guard<std::mutex> lock(fs_async.mutex);
+
+        job->state.store(ASYNC_QUEUED, std::memory_order_relaxed);
+        if (fs_async.queue_tail[priority]) {
+            fs_async.queue_tail[priority]->next = job;
+        } else {
+            fs_async.queue_head[priority] = job;
+        }
+        fs_async.queue_tail[priority] = job;
+    }
+
+    fs_async.work.notify_one();
+
+    return (job - fs_async.jobs) + 1;
 }
 
 /*
-============
-FS_FOpenFile
-============
+================
+FS_PrefetchFile
+================
 */
-ssize_t FS_FOpenFile(const char *name, qhandle_t *f, unsigned mode)
+qboolean FS_PrefetchFile(const char *path, fs_priority_t priority)
 {
-    file_t *file;
-    qhandle_t handle;
-    ssize_t ret;
+    return FS_LoadFileAsync(path, 0, priority, NULL, NULL) != 0;
+}
 
-    if (!name || !f) {
-        Com_Error(ERR_FATAL, "%s: NULL", __func__);
-    }
+/*
+================
+FS_WaitFileAsync
 
-    *f = 0;
+Blocks until the load completes and hands over the buffer, which is
+freed with FS_FreeFile. Must not be used for loads with a callback.
+================
+*/
+ssize_t FS_WaitFileAsync(qhandle_t handle, void **buffer)
+{
+    fs_async_t *job;
+    ssize_t ret;
 
-    if (!fs_searchpaths) {
-        return Q_ERR_AGAIN; // not yet initialized
-    }
+    *buffer = NULL;
 
-    // allocate new file handle
-    file = alloc_handle(&handle);
-    if (!file) {
-        return Q_ERR_MFILE;
+    if (handle < 1 || handle > MAX_ASYNC_LOADS) {
+        Com_Error(ERR_FATAL, "%s: bad handle", __func__);
     }
 
-    file->mode = mode;
-
-    if ((mode & FS_MODE_MASK) == FS_MODE_READ) {
-        ret = expand_open_file_read(file, name, true);
-    } else {
-        ret = open_file_write(file, name);
+    job = &fs_async.jobs[handle - 1];
+    if (job->state.load(std::memory_order_relaxed) == ASYNC_FREE || job->callback) {
+        Com_Error(ERR_FATAL, "%s: bad handle", __func__);
     }
 
+    fs_async_wait(job);
+
+    ret = job->result;
     if (ret >= 0) {
-        *f = handle;
+        *buffer = job->buffer;
+        job->buffer = NULL;
     }
 
+    fs_async_release(job);
     return ret;
 }
 
-// reading from outside of source directory is allowed, extension is optional
-static qhandle_t easy_open_read(char *buf, size_t size, unsigned mode,
-                                const char *dir, const char *name, const char *ext)
+// takes over a prefetched file, returns false if there is none
+static qboolean fs_async_claim(const char *path, unsigned flags, void **buffer, ssize_t *len_p)
 {
-    ssize_t len;
-    qhandle_t f;
+    char normalized[MAX_QPATH];
+    fs_async_t *job;
+    int i;
 
-    if (*name == '/') {
-        // full path is given, ignore directory and extension
-        len = Q_strlcpy(buf, name + 1, size);
-    } else {
-        // first try without extension
-        len = Q_concat(buf, size, dir, name, NULL);
-        if (len >= size) {
-            Q_PrintError("open", Q_ERR_NAMETOOLONG);
-            return 0;
-        }
+    if (!fs_async.num_pending) {
+        return false;
+    }
 
-        // print normalized path in case of error
-        FS_NormalizePath(buf, buf);
+    if (FS_NormalizePathBuffer(normalized, path, MAX_QPATH) >= MAX_QPATH) {
+        return false;
+    }
 
-        len = FS_FOpenFile(buf, &f, mode);
-        if (f) {
-            return f; // succeeded
-        }
-        if (len != Q_ERR_NOENT) {
-            goto fail; // fatal error
+    for (i = 0, job = fs_async.jobs; i < MAX_ASYNC_LOADS; i++, job++) {
+        if (job->state.load(std::memory_order_relaxed) == ASYNC_FREE || job->callback || job->flags != flags) {
+            continue;
         }
-        if (!COM_CompareExtension(buf, ext)) {
-            goto fail; // name already has the extension
+        if (!strcmp(job->path, normalized)) {
+            break;
         }
-
-        // now try to append extension
-        len = Q_strlcat(buf, ext, size);
     }
 
-    if (len >= size) {
-        Q_PrintError("open", Q_ERR_NAMETOOLONG);
-        return 0;
+    if (i == MAX_ASYNC_LOADS) {
+        return false;
     }
 
-    len = FS_FOpenFile(buf, &f, mode);
-    if (f) {
-        return f;
-    }
+    fs_load_classes[fs_load_class(normalized)].prefetched++;
 
-fail:
-    Com_Printf("Couldn't open %s: %s\n", buf, Q_ErrorString(len));
-    return 0;
+    *len_p = FS_WaitFileAsync(i + 1, buffer);
+    return true;
 }
 
-// writing to outside of destination directory is disallowed, extension is forced
-static qhandle_t easy_open_write(char *buf, size_t size, unsigned mode,
-                                 const char *dir, const char *name, const char *ext)
+/*
+================
+FS_RunAsyncLoads
+
+Runs callbacks of completed loads, called once per frame.
+================
+*/
+void FS_RunAsyncLoads(void)
 {
-    char normalized[MAX_OSPATH];
-    ssize_t len;
-    qhandle_t f;
+    fs_async_t *job;
+    void *buffer;
+    int i;
 
-    // make it impossible to escape the destination directory when writing files
-    len = FS_NormalizePathBuffer(normalized, name, sizeof(normalized));
-    if (len >= sizeof(normalized)) {
-        Q_PrintError("open", Q_ERR_NAMETOOLONG);
-        return 0;
+    if (!fs_async.num_pending) {
+        return;
     }
 
-    // reject empty filenames
-    if (len == 0) {
-        Q_PrintError("open", Q_ERR_NAMETOOSHORT);
-        return 0;
-    }
+    for (i = 0, job = fs_async.jobs; i < MAX_ASYNC_LOADS; i++, job++) {
+        if (!job->callback) {
+            continue;
+        }
 
-    // replace any bad characters with underscores to make automatic commands happy
-    cleanup_path(normalized);
+        if (job->state.load(std::memory_order_acquire) != ASYNC_DONE) {
+            continue;
+        }
 
-    // don't append the extension if name already has it
-    if (!COM_CompareExtension(normalized, ext)) {
-        ext = (mode & FS_FLAG_GZIP) ? "" : NULL;
-    }
+        // callback owns the buffer from here on
+        buffer = NULL;
+        if (job->result >= 0) {
+            buffer = job->buffer;
+            job->buffer = NULL;
+        }
 
-    len = Q_concat(buf, size, dir, normalized, ext,
-                   (mode & FS_FLAG_GZIP) ? ".gz" : NULL, NULL);
-    if (len >= size) {
-        Q_PrintError("open", Q_ERR_NAMETOOLONG);
-        return 0;
+        job->callback(job->path, buffer, job->result, job->arg);
+        fs_async_release(job);
     }
+}
 
-    len = FS_FOpenFile(buf, &f, mode);
-    if (!f) {
-        goto fail1;
+/*
+================
+FS_FlushAsyncLoads
+
+Waits for all loads to complete, runs their callbacks and discards
+prefetched files nobody asked for.
+================
+*/
+void FS_FlushAsyncLoads(void)
+{
+    fs_async_t *job;
+    int i;
+
+    if (!fs_async.num_pending) {
+        return;
     }
 
-    if (mode & FS_FLAG_GZIP) {
-        len = FS_FilterFile(f);
-        if (len) {
-            goto fail2;
+    for (i = 0, job = fs_async.jobs; i < MAX_ASYNC_LOADS; i++, job++) {
+        if (job->state.load(std::memory_order_relaxed) != ASYNC_FREE) {
+            fs_async_wait(job);
         }
     }
 
-    return f;
+    FS_RunAsyncLoads();
 
-fail2:
-    FS_FCloseFile(f);
-fail1:
-    Com_EPrintf("Couldn't open %s: %s\n", buf, Q_ErrorString(len));
-    return 0;
+    for (i = 0, job = fs_async.jobs; i < MAX_ASYNC_LOADS; i++, job++) {
+        if (job->state.load(std::memory_order_relaxed) != ASYNC_FREE) {
+            FS_DPrintf("%s: %s was never claimed\n", __func__, job->path);
+            fs_async_release(job);
+        }
+    }
 }
 
-/*
-============
-FS_EasyOpenFile
+static void fs_async_init(void)
+{
+    int i;
 
-Helper function for various console commands. Concatenates
-the arguments, checks for path buffer overflow, and attempts
-to open the file, printing an error message in case of failure.
-============
-*/
-qhandle_t FS_EasyOpenFile(char *buf, size_t size, unsigned mode,
-                          const char *dir, const char *name, const char *ext)
+    fs_async_threads = Cvar_Get("fs_async_threads", "2", CVAR_NOSET);
+    Cvar_ClampInteger(fs_async_threads, 0, MAX_ASYNC_THREADS);
+
+    // allocated, so that exiting without FS_Shutdown doesn't destroy
+    // joinable threads and abort
+    fs_async.quit = false;
+    for (i = 0; i < fs_async_threads->integer; i++) {
+        fs_async.threads[i] = new std::thread(fs_async_worker);
+    }
+    fs_async.num_threads = fs_async_threads->integer;
+}
+
+static void fs_async_shutdown(void)
 {
-    if ((mode & FS_MODE_MASK) == FS_MODE_READ) {
-        return easy_open_read(buf, size, mode, dir, name, ext);
+    int i;
+
+    FS_FlushAsyncLoads();
+
+    {
+        std::lock_guard<std::mutex> lock(fs_async.mutex);
+        fs_async.quit = true;
     }
+    fs_async.work.notify_all();
 
-    return easy_open_write(buf, size, mode, dir, name, ext);
+    // workers only exit once their queue is empty
+    for (i = 0; i < fs_async.num_threads; i++) {
+        fs_async.threads[i]->join();
+        delete fs_async.threads[i];
+        fs_async.threads[i] = NULL;
+    }
+    fs_async.num_threads = 0;
 }
 
 /*
-============
-FS_LoadFile
+=============================================================================
 
-opens non-unique file handle as an optimization
-a NULL buffer will just return the file length without loading
-============
+LOAD TIMES
+
+=============================================================================
 */
-ssize_t FS_LoadFileEx(const char *path, void **buffer, unsigned flags, memtag_t tag)
-{
-    file_t *file;
-    qhandle_t f;
-    byte *buf;
-    ssize_t len, read;
 
-    if (!path) {
-        Com_Error(ERR_FATAL, "%s: NULL", __func__);
-    }
+static const char *const fs_load_class_names[FS_LOAD_CLASSES] = {
+    "world", "models", "images", "sounds", "other"
+};
 
-    if (buffer) {
-        *buffer = NULL;
-    }
+// buckets the file by extension
+static fs_load_class_t fs_load_class(const char *path)
+{
+    static const char *const extensions[FS_LOAD_CLASSES - 1] = {
+        ".bsp",
+        ".md2;.md3;.iqm;.sp2",
+        ".pcx;.wal;.tga;.jpg;.png",
+        ".wav;.ogg"
+    };
+    int i;
 
-    if (!fs_searchpaths) {
-        return Q_ERR_AGAIN; // not yet initialized
+    for (i = 0; i < FS_LOAD_CLASSES - 1; i++) {
+        if (FS_ExtCmp(extensions[i], path)) {
+            return (fs_load_class_t)i;
+        }
     }
 
-    // allocate new file handle
-    file = alloc_handle(&f);
-    if (!file) {
-        return Q_ERR_MFILE;
-    }
+    return FS_LOAD_OTHER;
+}
 
-    file->mode = (flags & ~FS_MODE_MASK) | FS_MODE_READ;
+static uint64_t fs_load_clock(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void fs_load_record(const char *path, ssize_t len, uint64_t start)
+{
+    fs_load_stats_t *stats;
 
-    // look for it in the filesystem or pack files
-    len = expand_open_file_read(file, path, false);
     if (len < 0) {
-        return len;
+        return;
     }
 
-    // NULL buffer just checks for file existence
-    if (!buffer) {
-        goto done;
-    }
+    stats = &fs_load_classes[fs_load_class(path)];
+    stats->count++;
+    stats->bytes += len;
+    stats->usec += fs_load_clock() - start;
+}
 
-    // sanity check file size
-    if (len > MAX_LOADFILE) {
-        len = Q_ERR_FBIG;
-        goto done;
-    }
+/*
+================
+FS_LoadTimes_f
 
-    // allocate chunk of memory, +1 for NUL
-    buf = (byte*)Z_TagMalloc(len + 1, tag); // CPP: Cast
+Prints time spent waiting on file loads per asset class, e.g. to compare
+level loads with and without fs_async_threads. "reset" clears the counters.
+================
+*/
+static void FS_LoadTimes_f(void)
+{
+    fs_load_stats_t *stats, total;
+    int i;
 
-    // read entire file
-    read = FS_Read(buf, len, f);
-    if (read != len) {
-        len = read < 0 ? read : Q_ERR_UNEXPECTED_EOF;
-        Z_Free(buf);
-        goto done;
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "reset")) {
+        memset(fs_load_classes, 0, sizeof(fs_load_classes));
+        Com_Printf("Load times reset\n");
+        return;
     }
 
-    *buffer = buf;
-    buf[len] = 0;
+    memset(&total, 0, sizeof(total));
 
-done:
-    FS_FCloseFile(f);
-    return len;
+    Com_Printf("class   files prefetched       kbytes      msec\n"
+               "------- ----- ---------- ------------ ---------\n");
+    for (i = 0; i < FS_LOAD_CLASSES; i++) {
+        stats = &fs_load_classes[i];
+        Com_Printf("%-7s %5u %10u %12" PRIz " %9.1f\n", fs_load_class_names[i],
+                   stats->count, stats->prefetched, stats->bytes / 1024, stats->usec / 1000.0);
+        total.count += stats->count;
+        total.prefetched += stats->prefetched;
+        total.bytes += stats->bytes;
+        total.usec += stats->usec;
+    }
+    Com_Printf("%-7s %5u %10u %12" PRIz " %9.1f\n", "total",
+               total.count, total.prefetched, total.bytes / 1024, total.usec / 1000.0);
 }
 
 /*
@@ -2075,6 +3514,8 @@ qerror_t FS_RenameFile(const char *from, const char *to)
     if (rename(frompath, topath))
         return Q_Errno();
 
+    FS_InvalidatePathCache();
+
     return Q_ERR_SUCCESS;
 }
 
@@ -2120,7 +3561,13 @@ static void pack_put(pack_t *pack)
     }
     if (!--pack->refcount) {
         FS_DPrintf("Freeing packfile %s\n", pack->filename);
+#ifndef _WIN32
+        if (pack->map_base) {
+            munmap(pack->map_base, pack->map_size);
+        }
+#endif
         fclose(pack->fp);
+        Z_Free(pack->ext_order);
         Z_Free(pack);
     }
 }
@@ -2149,6 +3596,9 @@ static pack_t *pack_alloc(FILE *fp, filetype_t type, const char *name,
     pack->file_hash = (packfile_t **)(pack->files + num_files);
     pack->filename = (char *)(pack->file_hash + hash_size);
     pack->names = pack->filename + len;
+    pack->map_base = NULL;
+    pack->map_size = 0;
+    pack->ext_order = NULL;
     memcpy(pack->filename, name, len);
     memset(pack->file_hash, 0, hash_size * sizeof(packfile_t *));
 
@@ -2327,7 +3777,7 @@ static size_t get_file_info(FILE *fp, size_t pos, packfile_t *file, size_t *len,
 {
     size_t name_size, xtra_size, comm_size;
     size_t comp_len, file_len, file_pos;
-    unsigned comp_mtd;
+    unsigned comp_mtd, crc;
     byte header[ZIP_SIZECENTRALDIRITEM]; // we can't use a struct here because of packing
 
     *len = 0;
@@ -2344,6 +3794,7 @@ static size_t get_file_info(FILE *fp, size_t pos, packfile_t *file, size_t *len,
         return 0;
 
     comp_mtd = LittleShortMem(&header[10]);
+    crc = LittleLongMem(&header[16]);
     comp_len = LittleLongMem(&header[20]);
     file_len = LittleLongMem(&header[24]);
     name_size = LittleShortMem(&header[28]);
@@ -2383,6 +3834,7 @@ static size_t get_file_info(FILE *fp, size_t pos, packfile_t *file, size_t *len,
             return 0; // directory changed on disk?
         file->compmtd = comp_mtd;
         file->complen = comp_len;
+        file->crc = crc;
         file->filelen = file_len;
         file->filepos = file_pos;
         if (fread(file->name, 1, name_size, fp) != name_size)
@@ -2472,63 +3924,545 @@ static pack_t *load_zip_file(const char *packfile)
         }
         header_pos += ofs;
 
-        if (len) {
-            names_len += len;
-            num_files++;
-        }
+        if (len) {
+            names_len += len;
+            num_files++;
+        }
+    }
+
+    if (!num_files) {
+        Com_Printf("%s has no valid files\n", packfile);
+        goto fail2;
+    }
+
+// allocate the pack
+    pack = pack_alloc(fp, FS_ZIP, packfile, num_files, names_len);
+
+// parse the directory
+    file = pack->files;
+    name = pack->names;
+    header_pos = central_ofs + extra_bytes;
+    for (i = 0; i < num_files_cd; i++) {
+        if (!num_files)
+            break;
+        file->name = name;
+        ofs = get_file_info(fp, header_pos, file, &len, names_len);
+        if (!ofs) {
+            Com_Printf("%s has bad central directory structure (pass %d)\n", packfile, 2);
+            goto fail1; // directory changed on disk?
+        }
+        header_pos += ofs;
+
+        if (len) {
+            // fix absolute position
+            file->filepos += extra_bytes;
+            file->coherent = false;
+
+            pack_hash_file(pack, file);
+
+            // advance pointers, decrement counters
+            file++;
+            num_files--;
+
+            name += len;
+            names_len -= len;
+        }
+    }
+
+    FS_DPrintf("%s: %u files, %u skipped, %u hash\n",
+               packfile, pack->num_files, num_files_cd - pack->num_files, pack->hash_size);
+
+    return pack;
+
+fail1:
+    Z_Free(pack);
+fail2:
+    fclose(fp);
+    return NULL;
+}
+#endif
+
+// Maps an indexed pack. The directory is used as stored: names are already
+// normalized and hash chains are precomputed, entries are only linked into
+// the pack with a bounds check.
+static pack_t *load_pkx_file(const char *packfile)
+{
+    dpkxheader_t        header;
+    const dpkxfile_t    *dfile;
+    const uint32_t      *dhash;
+    const char          *names;
+    packfile_t          *file;
+    file_info_t         info;
+    size_t              dir_ofs, dir_len, filepos, datalen;
+    unsigned            i, num_files, hash_size, names_len, nameofs, namelen, next;
+    filetype_t          type;
+    pack_t              *pack;
+    byte                *dir;
+    FILE                *fp;
+
+    fp = fopen(packfile, "rb");
+    if (!fp) {
+        Com_Printf("Couldn't open %s: %s\n", packfile, strerror(errno));
+        return NULL;
+    }
+
+    if (fread(&header, 1, sizeof(header), fp) != sizeof(header)) {
+        Com_Printf("Reading header failed on %s\n", packfile);
+        goto fail2;
+    }
+
+    if (LittleLong(header.ident) != IDPKXHEADER) {
+        Com_Printf("%s is not a 'IPKX' file\n", packfile);
+        goto fail2;
+    }
+
+    if (LittleLong(header.version) != PKX_VERSION) {
+        Com_Printf("%s has unsupported version %u\n", packfile, LittleLong(header.version));
+        goto fail2;
+    }
+
+    num_files = LittleLong(header.numfiles);
+    if (num_files < 1) {
+        Com_Printf("%s has no files\n", packfile);
+        goto fail2;
+    }
+    if (num_files > MAX_FILES_IN_PKX) {
+        Com_Printf("%s has too many files: %u > %u\n", packfile, num_files, MAX_FILES_IN_PKX);
+        goto fail2;
+    }
+
+    // must match what pack_alloc allocates
+    hash_size = LittleLong(header.hashsize);
+    if (hash_size != npot32(num_files / 3)) {
+        Com_Printf("%s has bad hash size\n", packfile);
+        goto fail2;
+    }
+
+    if (get_fp_info(fp, &info)) {
+        Com_Printf("Couldn't stat %s\n", packfile);
+        goto fail2;
+    }
+
+    names_len = LittleLong(header.nameslen);
+    dir_ofs = (size_t)LittleLong(header.dirpage) * PKX_PAGESIZE;
+    dir_len = num_files * sizeof(*dfile) + hash_size * sizeof(*dhash) + names_len;
+    if (!names_len || dir_ofs > info.size || dir_len > info.size - dir_ofs) {
+        Com_Printf("%s has bad directory extent\n", packfile);
+        goto fail2;
+    }
+
+#if USE_ZLIB
+    type = FS_ZIP;
+#else
+    type = FS_PAK;
+#endif
+
+#ifndef _WIN32
+    dir = (byte *)mmap(NULL, info.size, PROT_READ, MAP_SHARED, fileno(fp), 0); // CPP: Cast
+    if (dir == MAP_FAILED) {
+        Com_Printf("Couldn't map %s: %s\n", packfile, strerror(errno));
+        goto fail2;
+    }
+
+    pack = pack_alloc(fp, type, packfile, num_files, 0);
+    pack->map_base = dir;
+    pack->map_size = info.size;
+    dir += dir_ofs;
+    names = (const char *)dir + dir_len - names_len;
+#else
+    pack = pack_alloc(fp, type, packfile, num_files, names_len);
+    dir = (byte *)FS_AllocTempMem(dir_len); // CPP: Cast
+    if (fseek(fp, (long)dir_ofs, SEEK_SET) == -1 || fread(dir, 1, dir_len, fp) != dir_len) {
+        Com_Printf("Reading directory failed on %s\n", packfile);
+        FS_FreeTempMem(dir);
+        goto fail1;
+    }
+    memcpy(pack->names, dir + dir_len - names_len, names_len);
+    names = pack->names;
+#endif
+
+    dfile = (const dpkxfile_t *)dir;
+    dhash = (const uint32_t *)(dfile + num_files);
+
+    for (i = 0, file = pack->files; i < num_files; i++, file++, dfile++) {
+        nameofs = LittleLong(dfile->nameofs);
+        namelen = LittleLong(dfile->namelen);
+        next = LittleLong(dfile->hashnext);
+        filepos = (size_t)LittleLong(dfile->filepage) * PKX_PAGESIZE;
+        file->filelen = LittleLong(dfile->filelen);
+        datalen = LittleLong(dfile->complen);
+#if USE_ZLIB
+        file->compmtd = datalen ? Z_DEFLATED : 0;
+        file->complen = datalen ? datalen : file->filelen;
+        file->crc = LittleLong(dfile->crc);
+        file->coherent = true;
+#else
+        if (datalen) {
+            Com_Printf("%s has compressed files\n", packfile);
+            goto fail;
+        }
+#endif
+        if (!datalen) {
+            datalen = file->filelen;
+        }
+
+        if (nameofs >= names_len || namelen >= MAX_QPATH || namelen >= names_len - nameofs ||
+            names[nameofs + namelen] || next > num_files || (next && next <= i + 1) ||
+            filepos > info.size || datalen > info.size - filepos) {
+            Com_Printf("%s has bad directory entry %u\n", packfile, i);
+            goto fail;
+        }
+
+        file->name = (char *)names + nameofs; // CPP: Cast
+        file->namelen = namelen;
+        file->filepos = filepos;
+        // chains only ever point forward, so they can't loop
+        file->hash_next = next ? &pack->files[next - 1] : NULL;
+    }
+
+    for (i = 0; i < hash_size; i++) {
+        next = LittleLong(dhash[i]);
+        if (next > num_files) {
+            Com_Printf("%s has bad hash table\n", packfile);
+            goto fail;
+        }
+        pack->file_hash[i] = next ? &pack->files[next - 1] : NULL;
+    }
+
+#ifdef _WIN32
+    FS_FreeTempMem(dir);
+#endif
+
+    FS_DPrintf("%s: %u files, %u hash\n",
+               packfile, pack->num_files, pack->hash_size);
+
+    return pack;
+
+fail:
+#ifdef _WIN32
+    FS_FreeTempMem(dir);
+fail1:
+#else
+    munmap(pack->map_base, pack->map_size);
+#endif
+    Z_Free(pack);
+fail2:
+    fclose(fp);
+    return NULL;
+}
+
+static int pkxfile_cmp(const void *p1, const void *p2)
+{
+    const packfile_t *f1 = *(const packfile_t **)p1;
+    const packfile_t *f2 = *(const packfile_t **)p2;
+
+    return strcmp(f1->name, f2->name);
+}
+
+// returns the entry a lookup of this name finds, which is not
+// necessarily the given one if the pack has duplicates
+static packfile_t *pack_lookup(pack_t *pack, packfile_t *entry)
+{
+    packfile_t *e;
+
+    e = pack->file_hash[FS_HashPath(entry->name, pack->hash_size)];
+    for (; e; e = e->hash_next) {
+        if (e->namelen == entry->namelen && !FS_pathcmp(e->name, entry->name)) {
+            break;
+        }
+    }
+
+    return e;
+}
+
+// reads an entire pack entry into a temporary buffer
+static ssize_t read_pack_entry(pack_t *pack, packfile_t *entry, byte **buffer)
+{
+    file_t *file;
+    qhandle_t f;
+    ssize_t len, ret;
+
+    *buffer = NULL;
+
+    file = alloc_handle(&f);
+    if (!file) {
+        return Q_ERR_MFILE;
+    }
+
+    file->mode = FS_MODE_READ;
+    len = open_from_pak(file, pack, entry, true);
+    if (len < 0) {
+        return len;
+    }
+
+    if (len) {
+        *buffer = (byte *)FS_AllocTempMem(len); // CPP: Cast
+        ret = FS_Read(*buffer, len, f);
+        if (ret != len) {
+            FS_FreeTempMem(*buffer);
+            *buffer = NULL;
+            len = ret < 0 ? ret : Q_ERR_UNEXPECTED_EOF;
+        }
+    }
+
+    FS_FCloseFile(f);
+    return len;
+}
+
+#if USE_ZLIB
+// deflates with the fastest level, returns 0 if it doesn't pay off
+static size_t deflate_pack_entry(const byte *in, size_t inlen, byte **out)
+{
+    z_stream z;
+    size_t outlen = 0;
+
+    *out = NULL;
+
+    // don't bother with tiny files
+    if (inlen < 256) {
+        return 0;
+    }
+
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return 0;
+    }
+
+    *out = (byte *)FS_AllocTempMem(deflateBound(&z, inlen)); // CPP: Cast
+    z.next_in = (Bytef *)in; // CPP: Cast
+    z.avail_in = (uInt)inlen;
+    z.next_out = *out;
+    z.avail_out = (uInt)deflateBound(&z, inlen);
+
+    // must save at least 1/8 to be worth inflating on load
+    if (deflate(&z, Z_FINISH) == Z_STREAM_END && z.total_out < inlen - inlen / 8) {
+        outlen = z.total_out;
+    }
+
+    deflateEnd(&z);
+
+    if (!outlen) {
+        FS_FreeTempMem(*out);
+        *out = NULL;
+    }
+
+    return outlen;
+}
+#endif
+
+static const byte pkx_zeros[PKX_PAGESIZE] = {};
+
+static qboolean write_pkx_pad(FILE *fp, size_t *pos)
+{
+    size_t pad = (PKX_PAGESIZE - (*pos & (PKX_PAGESIZE - 1))) & (PKX_PAGESIZE - 1);
+
+    *pos += pad;
+    return fwrite(pkx_zeros, 1, pad, fp) == pad;
+}
+
+// writes the indexed pack, returns number of files written
+static ssize_t write_pkx_file(FILE *fp, pack_t *pack, packfile_t **entries,
+                              unsigned num_files, qboolean compress)
+{
+    dpkxheader_t header;
+    dpkxfile_t *dir;
+    uint32_t *hash;
+    char *names;
+    byte *data, *comp;
+    size_t pos, names_len, complen;
+    unsigned i, hash_size;
+    ssize_t datalen, ret = num_files;
+
+    dir = (dpkxfile_t *)FS_Mallocz(num_files * sizeof(*dir)); // CPP: Cast
+    names = (char *)FS_Malloc(num_files * MAX_QPATH); // CPP: Cast
+    hash_size = npot32(num_files / 3);
+    hash = (uint32_t *)FS_Mallocz(hash_size * sizeof(*hash)); // CPP: Cast
+
+    // header goes into the first page, written last
+    if (fwrite(pkx_zeros, 1, PKX_PAGESIZE, fp) != PKX_PAGESIZE) {
+        ret = Q_ERR_FAILURE;
+    }
+    pos = PKX_PAGESIZE;
+
+    names_len = 0;
+    for (i = 0; i < num_files && ret >= 0; i++) {
+        packfile_t *entry = entries[i];
+
+        datalen = read_pack_entry(pack, entry, &data);
+        if (datalen < 0) {
+            Com_Printf("Couldn't read %s: %s\n", entry->name, Q_ErrorString(datalen));
+            ret = datalen;
+            break;
+        }
+
+        comp = NULL;
+        complen = 0;
+#if USE_ZLIB
+        if (compress) {
+            complen = deflate_pack_entry(data, datalen, &comp);
+        }
+        dir[i].crc = LittleLong(crc32(0, data, datalen));
+#endif
+
+        dir[i].nameofs = LittleLong(names_len);
+        dir[i].namelen = LittleLong(entry->namelen);
+        dir[i].filepage = LittleLong(pos / PKX_PAGESIZE);
+        dir[i].filelen = LittleLong(datalen);
+        dir[i].complen = LittleLong(complen);
+
+        memcpy(names + names_len, entry->name, entry->namelen + 1);
+        names_len += entry->namelen + 1;
+
+        if (complen) {
+            if (fwrite(comp, 1, complen, fp) != complen)
+                ret = Q_ERR_FAILURE;
+            pos += complen;
+        } else {
+            if (fwrite(data, 1, datalen, fp) != (size_t)datalen)
+                ret = Q_ERR_FAILURE;
+            pos += datalen;
+        }
+
+        FS_FreeTempMem(comp);
+        FS_FreeTempMem(data);
+
+        if (!write_pkx_pad(fp, &pos))
+            ret = Q_ERR_FAILURE;
+
+        if (pos / PKX_PAGESIZE > UINT32_MAX) {
+            Com_Printf("Pack is too large\n");
+            ret = Q_ERR_FBIG;
+        }
+    }
+
+    if (ret >= 0) {
+        // insert backwards so that chains end up in directory order, and
+        // every link points forward, as the loader requires
+        for (i = num_files; i-- > 0;) {
+            unsigned h = FS_HashPath(entries[i]->name, hash_size);
+            dir[i].hashnext = LittleLong(hash[h]);
+            hash[h] = i + 1;
+        }
+        for (i = 0; i < hash_size; i++) {
+            hash[i] = LittleLong(hash[i]);
+        }
+
+        header.ident = LittleLong(IDPKXHEADER);
+        header.version = LittleLong(PKX_VERSION);
+        header.numfiles = LittleLong(num_files);
+        header.hashsize = LittleLong(hash_size);
+        header.dirpage = LittleLong(pos / PKX_PAGESIZE);
+        header.nameslen = LittleLong(names_len);
+
+        if (fwrite(dir, sizeof(*dir), num_files, fp) != num_files ||
+            fwrite(hash, sizeof(*hash), hash_size, fp) != hash_size ||
+            fwrite(names, 1, names_len, fp) != names_len ||
+            fseek(fp, 0, SEEK_SET) == -1 ||
+            fwrite(&header, 1, sizeof(header), fp) != sizeof(header)) {
+            ret = Q_ERR_FAILURE;
+        }
+    }
+
+    Z_Free(hash);
+    Z_Free(names);
+    Z_Free(dir);
+    return ret;
+}
+
+/*
+============
+FS_MakePkx_f
+
+Converts a pack file in the current game directory into an indexed
+pack with the same base name.
+============
+*/
+static void FS_MakePkx_f(void)
+{
+    char src[MAX_OSPATH], dst[MAX_OSPATH], tmp[MAX_OSPATH];
+    packfile_t **entries;
+    unsigned i, num_files;
+    qboolean compress;
+    pack_t *pack;
+    ssize_t ret;
+    size_t len;
+    FILE *fp;
+
+    if (Cmd_Argc() < 2) {
+        Com_Printf("Usage: %s <pakfile> [compress]\n"
+                   "Converts a .pak or .pkz in the game directory into a .pkx.\n", Cmd_Argv(0));
+        return;
     }
 
-    if (!num_files) {
-        Com_Printf("%s has no valid files\n", packfile);
-        goto fail2;
+    len = Q_concat(src, sizeof(src), fs_gamedir, "/", Cmd_Argv(1), NULL);
+    if (len >= sizeof(src) || len < 5) {
+        Com_Printf("Bad pack file name.\n");
+        return;
     }
 
-// allocate the pack
-    pack = pack_alloc(fp, FS_ZIP, packfile, num_files, names_len);
-
-// parse the directory
-    file = pack->files;
-    name = pack->names;
-    header_pos = central_ofs + extra_bytes;
-    for (i = 0; i < num_files_cd; i++) {
-        if (!num_files)
-            break;
-        file->name = name;
-        ofs = get_file_info(fp, header_pos, file, &len, names_len);
-        if (!ofs) {
-            Com_Printf("%s has bad central directory structure (pass %d)\n", packfile, 2);
-            goto fail1; // directory changed on disk?
-        }
-        header_pos += ofs;
+    compress = Cmd_Argc() > 2 && atoi(Cmd_Argv(2));
 
-        if (len) {
-            // fix absolute position
-            file->filepos += extra_bytes;
-            file->coherent = false;
+#if USE_ZLIB
+    if (!Q_stricmp(src + len - 4, ".pkz"))
+        pack = load_zip_file(src);
+    else
+#endif
+    if (!Q_stricmp(src + len - 4, ".pak"))
+        pack = load_pak_file(src);
+    else {
+        Com_Printf("%s is not a .pak or .pkz file.\n", src);
+        return;
+    }
 
-            pack_hash_file(pack, file);
+    if (!pack) {
+        return;
+    }
 
-            // advance pointers, decrement counters
-            file++;
-            num_files--;
+    pack_get(pack);
 
-            name += len;
-            names_len -= len;
+    // drop duplicates shadowed within the pack and sort by name
+    entries = (packfile_t **)FS_Malloc(pack->num_files * sizeof(*entries)); // CPP: Cast
+    num_files = 0;
+    for (i = 0; i < pack->num_files; i++) {
+        if (pack_lookup(pack, &pack->files[i]) == &pack->files[i]) {
+            entries[num_files++] = &pack->files[i];
         }
     }
+    qsort(entries, num_files, sizeof(entries[0]), pkxfile_cmp);
 
-    FS_DPrintf("%s: %u files, %u skipped, %u hash\n",
-               packfile, pack->num_files, num_files_cd - pack->num_files, pack->hash_size);
+    memcpy(dst, src, len - 4);
+    memcpy(dst + len - 4, ".pkx", 5);
+    Q_concat(tmp, sizeof(tmp), dst, ".tmp", NULL);
 
-    return pack;
+    fp = fopen(tmp, "wb");
+    if (!fp) {
+        Com_Printf("Couldn't open %s: %s\n", tmp, strerror(errno));
+        ret = Q_ERR_FAILURE;
+    } else {
+        ret = write_pkx_file(fp, pack, entries, num_files, compress);
+        if (fclose(fp) && ret >= 0) {
+            ret = Q_Errno();
+        }
+        if (ret >= 0) {
+            remove(dst);
+            if (rename(tmp, dst)) {
+                ret = Q_Errno();
+            }
+        }
+        if (ret < 0) {
+            Com_Printf("Couldn't write %s: %s\n", dst, Q_ErrorString(ret));
+            remove(tmp);
+        }
+    }
 
-fail1:
-    Z_Free(pack);
-fail2:
-    fclose(fp);
-    return NULL;
+    if (ret >= 0) {
+        Com_Printf("Wrote %u files to %s. Remove %s and restart the file system to use it.\n",
+                   num_files, dst, Cmd_Argv(1));
+    }
+
+    Z_Free(entries);
+    pack_put(pack);
 }
-#endif
 
 // this is complicated as we need pakXX.pak loaded first,
 // sorted in numerical order, then the rest of the paks in
@@ -2586,9 +4520,9 @@ static void q_printf(2, 3) add_game_dir(unsigned mode, const char *fmt, ...)
 #endif
 
 #if USE_ZLIB
-#define PAK_EXT  ".pak;.pkz"
+#define PAK_EXT  ".pak;.pkz;.pkx"
 #else
-#define PAK_EXT  ".pak"
+#define PAK_EXT  ".pak;.pkx"
 #endif
 
     // add any pack files
@@ -2614,6 +4548,9 @@ static void q_printf(2, 3) add_game_dir(unsigned mode, const char *fmt, ...)
             pack = load_zip_file(path);
         else
 #endif
+        if (len > 4 && !Q_stricmp(path + len - 4, ".pkx"))
+            pack = load_pkx_file(path);
+        else
             pack = load_pak_file(path);
         if (!pack)
             continue;
@@ -2623,6 +4560,7 @@ static void q_printf(2, 3) add_game_dir(unsigned mode, const char *fmt, ...)
         search->pack = pack_get(pack);
         search->next = fs_searchpaths;
         fs_searchpaths = search;
+        fs_path_index.dirty = true;
     }
 
     for (i = 0; i < count; i++) {
@@ -2637,7 +4575,7 @@ static void q_printf(2, 3) add_game_dir(unsigned mode, const char *fmt, ...)
 	memcpy(search->filename, fs_gamedir, len + 1);
 	search->next = fs_searchpaths;
 	fs_searchpaths = search;
-
+	fs_path_index.dirty = true;
 }
 
 /*
@@ -2684,119 +4622,431 @@ void **FS_CopyList(void **list, int count)
 
 qboolean FS_WildCmp(const char *filter, const char *string)
 {
-    do {
-        if (Com_WildCmpEx(filter, string, ';', true)) {
+    do {
+        if (Com_WildCmpEx(filter, string, ';', true)) {
+            return true;
+        }
+        filter = strchr(filter, ';');
+        if (filter) filter++;
+    } while (filter);
+
+    return false;
+}
+
+qboolean FS_ExtCmp(const char *ext, const char *name)
+{
+    int        c1, c2;
+    const char *e, *n, *l;
+
+    if (!name[0] || !ext[0]) {
+        return false;
+    }
+
+    for (l = name; l[1]; l++)
+        ;
+
+    for (e = ext; e[1]; e++)
+        ;
+
+rescan:
+    n = l;
+    do {
+        c1 = *e--;
+        c2 = *n--;
+
+        if (c1 == ';') {
+            break; // matched
+        }
+
+        if (c1 != c2) {
+            c1 = Q_tolower(c1);
+            c2 = Q_tolower(c2);
+            if (c1 != c2) {
+                while (e > ext) {
+                    c1 = *e--;
+                    if (c1 == ';') {
+                        goto rescan;
+                    }
+                }
+                return false;
+            }
+        }
+        if (n < name) {
+            return false;
+        }
+    } while (e >= ext);
+
+    return true;
+}
+
+static int infocmp(const void *p1, const void *p2)
+{
+    file_info_t *n1 = *(file_info_t **)p1;
+    file_info_t *n2 = *(file_info_t **)p2;
+
+    return FS_pathcmp(n1->name, n2->name);
+}
+
+static int alphacmp(const void *p1, const void *p2)
+{
+    char *s1 = *(char **)p1;
+    char *s2 = *(char **)p2;
+
+    return FS_pathcmp(s1, s2);
+}
+
+/*
+=============================================================================
+
+DIRECTORY LISTING CACHE
+
+Results of FS_ListFiles are cached by path, filter and flags, sorted and
+free of duplicates, so that browsers and completion generators calling it
+over and over don't rescan every search path. Views of cached listings are
+reference counted and stay valid until released, even if the cache gets
+flushed in the meantime.
+
+Listings that include loose directories only stay valid as long as nothing
+changes on disk. On Linux the scanned directories are watched with inotify,
+and any change flushes the cache. Elsewhere, and for recursive searches,
+these listings are not cached at all.
+
+Extension filters are looked up in a per pack index of files sorted by
+extension, instead of checking every file in the pack.
+
+=============================================================================
+*/
+
+#define FS_LISTING_HASH_SIZE    64
+#define FS_LISTING_MAX          256
+#define FS_MAX_PARALLEL_SCANS   16
+
+typedef struct fs_listing_s {
+    struct fs_listing_s *hash_next;
+    unsigned    hash;
+    unsigned    flags;
+    unsigned    refcount;   // views handed out, plus one while cached
+    int         count;
+    char        *path;      // normalized, NULL if listing the whole tree
+    char        *filter;    // NULL if unfiltered
+    void        *files[1];  // sorted, NULL terminated
+} fs_listing_t;
+
+// scan of a single loose directory, possibly run on another thread
+typedef struct {
+    char        path[MAX_OSPATH];
+    size_t      baselen;
+    int         count;
+    void        *files[MAX_LISTED_FILES];
+} fs_scan_t;
+
+static struct {
+    fs_listing_t    *hash[FS_LISTING_HASH_SIZE];
+    unsigned        count;
+#if USE_INOTIFY
+    int             watch_fd;
+    qboolean        watching;
+#endif
+} fs_listings;
+
+static void fs_listing_put(fs_listing_t *listing)
+{
+    int i;
+
+    if (--listing->refcount) {
+        return;
+    }
+
+    for (i = 0; i < listing->count; i++) {
+        Z_Free(listing->files[i]);
+    }
+    Z_Free(listing);
+}
+
+static void fs_listings_flush(void)
+{
+    fs_listing_t *listing, *next;
+    int i;
+
+    for (i = 0; i < FS_LISTING_HASH_SIZE; i++) {
+        for (listing = fs_listings.hash[i]; listing; listing = next) {
+            next = listing->hash_next;
+            fs_listing_put(listing);
+        }
+        fs_listings.hash[i] = NULL;
+    }
+
+    fs_listings.count = 0;
+}
+
+#if USE_INOTIFY
+// starts watching the directory, returns false if it can't be watched
+static qboolean fs_watch_dir(const char *path)
+{
+    if (!fs_listings.watching) {
+        fs_listings.watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fs_listings.watch_fd == -1) {
+            return false;
+        }
+        fs_listings.watching = true;
+    }
+
+    return inotify_add_watch(fs_listings.watch_fd, path, IN_ONLYDIR |
+                             IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+                             IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF) != -1;
+}
+
+// forgets everything cached about loose directories if any of them changed
+static void fs_watch_poll(void)
+{
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    qboolean changed = false;
+
+    if (!fs_listings.watching) {
+        return;
+    }
+
+    while (read(fs_listings.watch_fd, buffer, sizeof(buffer)) > 0) {
+        changed = true;
+    }
+
+    if (changed) {
+        FS_InvalidatePathCache();
+    }
+}
+
+static void fs_watch_close(void)
+{
+    if (fs_listings.watching) {
+        close(fs_listings.watch_fd);
+        fs_listings.watching = false;
+    }
+}
+#else
+static void fs_watch_close(void)
+{
+}
+#endif
+
+// returns file indices of the pack sorted by extension, building it on first use
+static unsigned *pack_ext_index(pack_t *pack)
+{
+    unsigned i;
+
+    if (!pack->ext_order) {
+        pack->ext_order = (unsigned *)FS_Malloc(pack->num_files * sizeof(unsigned)); // CPP: Cast
+        for (i = 0; i < pack->num_files; i++) {
+            pack->ext_order[i] = i;
+        }
+        std::sort(pack->ext_order, pack->ext_order + pack->num_files, [pack](unsigned a, unsigned b) {
+            return FS_pathcmp(COM_FileExtension(pack->files[a].name),
+                              COM_FileExtension(pack->files[b].name)) < 0;
+        });
+    }
+
+    return pack->ext_order;
+}
+
+// checks if every token of the filter is a plain extension the index can look up
+static qboolean filter_is_extensions(const char *filter)
+{
+    const char *s;
+
+    for (s = filter; *s; s++) {
+        if (*s == '.' && (s == filter || s[-1] != ';')) {
+            return false;   // dot inside of a token
+        }
+        if (*s == '*' || *s == '?' || *s == '[' || *s == '/' || *s == '\\') {
+            return false;
+        }
+    }
+
+    return *filter == '.';
+}
+
+// adds the pack entry to the listing if it passes the path and filter checks
+static void list_pack_file(packfile_t *file, const char *path, size_t pathlen, qboolean rooted,
+                           const char *filter, unsigned flags, void **files, int *count_p)
+{
+    char    buffer[MAX_OSPATH];
+    char    *s, *p;
+    void    *info;
+    int     j;
+
+    s = file->name;
+
+    // check path
+    if (pathlen) {
+        if (file->namelen < pathlen) {
+            return;
+        }
+        if (FS_pathcmpn(s, path, pathlen)) {
+            return;
+        }
+        if (s[pathlen] != '/') {
+            return;     // matched prefix must be a directory
+        }
+        if (flags & FS_SEARCH_BYFILTER) {
+            s += pathlen + 1;
+        }
+    } else if (rooted) {
+        if (!(flags & FS_SEARCH_DIRSONLY) && strchr(s, '/')) {
+            return;     // must be a file in the root directory
+        }
+    }
+
+    // check filter
+    if (filter) {
+        if (flags & FS_SEARCH_BYFILTER) {
+            if (!FS_WildCmp(filter, s)) {
+                return;
+            }
+        } else {
+            if (!FS_ExtCmp(filter, s)) {
+                return;
+            }
+        }
+    }
+
+    // copy name off
+    if (flags & (FS_SEARCH_DIRSONLY | FS_SEARCH_STRIPEXT)) {
+        s = strcpy(buffer, s);
+    }
+
+    // hacky directory search support for pak files
+    if (flags & FS_SEARCH_DIRSONLY) {
+        p = s;
+        if (pathlen) {
+            p += pathlen + 1;
+        }
+        p = strchr(p, '/');
+        if (!p) {
+            return;     // does not have directory component
+        }
+        *p = 0;
+        for (j = 0; j < *count_p; j++) {
+            if (!FS_pathcmp((const char*)files[j], s)) {// CPP: Cast
+                return;     // already listed this directory
+            }
+        }
+    }
+
+    // strip path
+    if (!(flags & FS_SEARCH_SAVEPATH)) {
+        s = COM_SkipPath(s);
+    }
+
+    // strip extension
+    if (flags & FS_SEARCH_STRIPEXT) {
+        *COM_FileExtension(s) = 0;
+    }
+
+    if (!*s) {
+        return;
+    }
+
+    // copy info off
+    if (flags & FS_SEARCH_EXTRAINFO) {
+        info = FS_CopyInfo(s, file->filelen, 0, 0);
+    } else {
+        info = FS_CopyString(s);
+    }
+
+    files[(*count_p)++] = info;
+}
+
+// checks if the token already appeared in the filter before the given position
+static qboolean filter_has_token(const char *filter, const char *end, const char *token, size_t len)
+{
+    const char *s, *e;
+
+    for (s = filter; s < end; s = e + 1) {
+        e = strchr(s, ';');
+        if ((size_t)(e - s) == len && !Q_strncasecmp(s, token, len)) {
             return true;
         }
-        filter = strchr(filter, ';');
-        if (filter) filter++;
-    } while (filter);
+    }
 
     return false;
 }
 
-qboolean FS_ExtCmp(const char *ext, const char *name)
+static void list_pack_files(pack_t *pack, const char *path, size_t pathlen, qboolean rooted,
+                            const char *filter, unsigned flags, void **files, int *count_p)
 {
-    int        c1, c2;
-    const char *e, *n, *l;
-
-    if (!name[0] || !ext[0]) {
-        return false;
+    char        ext[MAX_QPATH];
+    const char  *s, *e;
+    unsigned    *order, lo, hi, mid;
+    size_t      len;
+    unsigned    i;
+
+    if (!filter || (flags & FS_SEARCH_BYFILTER) || !filter_is_extensions(filter)) {
+        for (i = 0; i < pack->num_files && *count_p < MAX_LISTED_FILES; i++) {
+            list_pack_file(&pack->files[i], path, pathlen, rooted, filter, flags, files, count_p);
+        }
+        return;
     }
 
-    for (l = name; l[1]; l++)
-        ;
-
-    for (e = ext; e[1]; e++)
-        ;
+    order = pack_ext_index(pack);
 
-rescan:
-    n = l;
-    do {
-        c1 = *e--;
-        c2 = *n--;
+    for (s = filter; s; s = e ? e + 1 : NULL) {
+        e = strchr(s, ';');
+        len = e ? e - s : strlen(s);
+        if (len >= sizeof(ext)) {
+            continue;
+        }
+        memcpy(ext, s, len);
+        ext[len] = 0;
 
-        if (c1 == ';') {
-            break; // matched
+        if (!len || filter_has_token(filter, s, ext, len)) {
+            continue;   // empty or repeated extension
         }
 
-        if (c1 != c2) {
-            c1 = Q_tolower(c1);
-            c2 = Q_tolower(c2);
-            if (c1 != c2) {
-                while (e > ext) {
-                    c1 = *e--;
-                    if (c1 == ';') {
-                        goto rescan;
-                    }
-                }
-                return false;
+        // find the first file with this extension
+        lo = 0;
+        hi = pack->num_files;
+        while (lo < hi) {
+            mid = (lo + hi) / 2;
+            if (FS_pathcmp(COM_FileExtension(pack->files[order[mid]].name), ext) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
             }
         }
-        if (n < name) {
-            return false;
-        }
-    } while (e >= ext);
-
-    return true;
-}
 
-static int infocmp(const void *p1, const void *p2)
-{
-    file_info_t *n1 = *(file_info_t **)p1;
-    file_info_t *n2 = *(file_info_t **)p2;
-
-    return FS_pathcmp(n1->name, n2->name);
+        for (i = lo; i < pack->num_files && *count_p < MAX_LISTED_FILES; i++) {
+            packfile_t *file = &pack->files[order[i]];
+            if (FS_pathcmp(COM_FileExtension(file->name), ext)) {
+                break;
+            }
+            list_pack_file(file, path, pathlen, rooted, NULL, flags, files, count_p);
+        }
+    }
 }
 
-static int alphacmp(const void *p1, const void *p2)
+static void run_scan(fs_scan_t *scan, const char *filter, unsigned flags)
 {
-    char *s1 = *(char **)p1;
-    char *s2 = *(char **)p2;
-
-    return FS_pathcmp(s1, s2);
+    scan->count = 0;
+    Sys_ListFiles_r(scan->path, filter, flags, scan->baselen, &scan->count, scan->files, 0);
 }
 
-/*
-=================
-FS_ListFiles
-=================
-*/
-void **FS_ListFiles(const char *path,
-                    const char *filter,
-                    unsigned   flags,
-                    int        *count_p)
+// Scans all search paths and returns the number of files found, unsorted.
+// Loose directories are scanned in parallel. Sets cacheable to false if
+// the result can't be trusted to stay valid.
+static int scan_files(const char *path, size_t pathlen, qboolean rooted, const char *filter,
+                      unsigned flags, void **files, qboolean *cacheable)
 {
     searchpath_t    *search;
-    packfile_t      *file;
-    void            *files[MAX_LISTED_FILES], *info;
-    int             i, j, count, total;
-    char            normalized[MAX_OSPATH], buffer[MAX_OSPATH];
-    void            **list;
-    size_t          len, pathlen;
-    char            *s, *p;
+    fs_scan_t       *scans[FS_MAX_PARALLEL_SCANS];
+    std::thread     threads[FS_MAX_PARALLEL_SCANS];
+    fs_scan_t       *scan;
+    int             i, j, count, num_scans;
+    size_t          len;
     int             valid;
 
     count = 0;
+    num_scans = 0;
     valid = PATH_NOT_CHECKED;
-
-    if (!path) {
-        path = "";
-        pathlen = 0;
-    } else {
-        // normalize the path
-        pathlen = FS_NormalizePathBuffer(normalized, path, sizeof(normalized));
-        if (pathlen >= sizeof(normalized)) {
-            goto fail;
-        }
-
-        path = normalized;
-    }
-
-    // can't mix directory search with other flags
-    if ((flags & FS_SEARCH_DIRSONLY) && (flags & FS_SEARCH_MASK & ~FS_SEARCH_DIRSONLY)) {
-        goto fail;
-    }
+    *cacheable = true;
 
     for (search = fs_searchpaths; search; search = search->next) {
         if (flags & FS_PATH_MASK) {
@@ -2809,96 +5059,7 @@ void **FS_ListFiles(const char *path,
                 continue; // don't search in paks
             }
 
-            for (i = 0; i < search->pack->num_files; i++) {
-                file = &search->pack->files[i];
-                s = file->name;
-
-                // check path
-                if (pathlen) {
-                    if (file->namelen < pathlen) {
-                        continue;
-                    }
-                    if (FS_pathcmpn(s, path, pathlen)) {
-                        continue;
-                    }
-                    if (s[pathlen] != '/') {
-                        continue;   // matched prefix must be a directory
-                    }
-                    if (flags & FS_SEARCH_BYFILTER) {
-                        s += pathlen + 1;
-                    }
-                } else if (path == normalized) {
-                    if (!(flags & FS_SEARCH_DIRSONLY) && strchr(s, '/')) {
-                        continue;   // must be a file in the root directory
-                    }
-                }
-
-                // check filter
-                if (filter) {
-                    if (flags & FS_SEARCH_BYFILTER) {
-                        if (!FS_WildCmp(filter, s)) {
-                            continue;
-                        }
-                    } else {
-                        if (!FS_ExtCmp(filter, s)) {
-                            continue;
-                        }
-                    }
-                }
-
-                // copy name off
-                if (flags & (FS_SEARCH_DIRSONLY | FS_SEARCH_STRIPEXT)) {
-                    s = strcpy(buffer, s);
-                }
-
-                // hacky directory search support for pak files
-                if (flags & FS_SEARCH_DIRSONLY) {
-                    p = s;
-                    if (pathlen) {
-                        p += pathlen + 1;
-                    }
-                    p = strchr(p, '/');
-                    if (!p) {
-                        continue;   // does not have directory component
-                    }
-                    *p = 0;
-                    for (j = 0; j < count; j++) {
-                        if (!FS_pathcmp((const char*)files[j], s)) {// CPP: Cast
-                            break;
-                        }
-                    }
-                    if (j != count) {
-                        continue;   // already listed this directory
-                    }
-                }
-
-                // strip path
-                if (!(flags & FS_SEARCH_SAVEPATH)) {
-                    s = COM_SkipPath(s);
-                }
-
-                // strip extension
-                if (flags & FS_SEARCH_STRIPEXT) {
-                    *COM_FileExtension(s) = 0;
-                }
-
-                if (!*s) {
-                    continue;
-                }
-
-                // copy info off
-                if (flags & FS_SEARCH_EXTRAINFO) {
-                    info = FS_CopyInfo(s, file->filelen, 0, 0);
-                } else {
-                    info = FS_CopyString(s);
-                }
-
-                files[count++] = info;
-
-                if (count >= MAX_LISTED_FILES) {
-                    break;
-                }
-            }
+            list_pack_files(search->pack, path, pathlen, rooted, filter, flags, files, &count);
         } else {
             if ((flags & FS_TYPE_MASK) == FS_TYPE_PAK) {
                 continue; // don't search in filesystem
@@ -2916,18 +5077,35 @@ void **FS_ListFiles(const char *path,
                 if (valid == PATH_INVALID) {
                     continue;
                 }
-                s = (char*)memcpy(buffer, search->filename, len); // CPP: Cast
-                s[len++] = '/';
-                memcpy(s + len, path, pathlen + 1);
+            }
+
+            if (num_scans == FS_MAX_PARALLEL_SCANS) {
+                *cacheable = false;
+                continue;
+            }
+
+            scan = scans[num_scans++] = (fs_scan_t *)FS_Malloc(sizeof(*scan)); // CPP: Cast
+            if (pathlen) {
+                memcpy(scan->path, search->filename, len);
+                scan->path[len++] = '/';
+                memcpy(scan->path + len, path, pathlen + 1);
             } else {
-                s = search->filename;
+                memcpy(scan->path, search->filename, len + 1);
             }
 
             if (flags & FS_SEARCH_BYFILTER) {
                 len += pathlen + 1;
             }
+            scan->baselen = len;
 
-            Sys_ListFiles_r(s, filter, flags, len, &count, files, 0);
+#if USE_INOTIFY
+            // recursive searches would need the whole subtree watched
+            if ((flags & FS_SEARCH_BYFILTER) || !fs_watch_dir(scan->path)) {
+                *cacheable = false;
+            }
+#else
+            *cacheable = false;
+#endif
         }
 
         if (count >= MAX_LISTED_FILES) {
@@ -2935,14 +5113,111 @@ void **FS_ListFiles(const char *path,
         }
     }
 
-    if (!count) {
-fail:
-        if (count_p) {
-            *count_p = 0;
+    // scan loose directories, the first one on this thread
+    for (i = 1; i < num_scans; i++) {
+        threads[i] = std::thread(run_scan, scans[i], filter, flags);
+    }
+    if (num_scans) {
+        run_scan(scans[0], filter, flags);
+    }
+
+    for (i = 0; i < num_scans; i++) {
+        if (i) {
+            threads[i].join();
+        }
+
+        scan = scans[i];
+        for (j = 0; j < scan->count; j++) {
+            if (count < MAX_LISTED_FILES) {
+                files[count++] = scan->files[j];
+            } else {
+                Z_Free(scan->files[j]);
+            }
+        }
+        Z_Free(scan);
+    }
+
+    return count;
+}
+
+/*
+=================
+FS_ListFilesView
+
+Returns a sorted listing owned by the file system, or NULL if nothing was
+found. The listing stays valid until released with FS_ReleaseListing.
+Entries are file_info_t with FS_SEARCH_EXTRAINFO, and strings otherwise.
+=================
+*/
+void **FS_ListFilesView(const char *path,
+                        const char *filter,
+                        unsigned   flags,
+                        int        *count_p)
+{
+    fs_listing_t    *listing;
+    void            *files[MAX_LISTED_FILES];
+    char            normalized[MAX_OSPATH];
+    size_t          pathlen, filterlen, size;
+    unsigned        hash;
+    int             i, count, total;
+    qboolean        cacheable;
+
+    if (count_p) {
+        *count_p = 0;
+    }
+
+    if (path) {
+        // normalize the path
+        pathlen = FS_NormalizePathBuffer(normalized, path, sizeof(normalized));
+        if (pathlen >= sizeof(normalized)) {
+            return NULL;
         }
+
+        path = normalized;
+    } else {
+        pathlen = 0;
+    }
+
+    // can't mix directory search with other flags
+    if ((flags & FS_SEARCH_DIRSONLY) && (flags & FS_SEARCH_MASK & ~FS_SEARCH_DIRSONLY)) {
         return NULL;
     }
 
+#if USE_INOTIFY
+    fs_watch_poll();
+#endif
+
+    hash = flags;
+    if (path) {
+        hash += Com_HashString(path, FS_LISTING_HASH_SIZE);
+    }
+    if (filter) {
+        hash += Com_HashString(filter, FS_LISTING_HASH_SIZE) * 3;
+    }
+    hash &= FS_LISTING_HASH_SIZE - 1;
+
+    for (listing = fs_listings.hash[hash]; listing; listing = listing->hash_next) {
+        if (listing->flags != flags) {
+            continue;
+        }
+        if (path ? !listing->path || strcmp(listing->path, path) : !!listing->path) {
+            continue;
+        }
+        if (filter ? !listing->filter || strcmp(listing->filter, filter) : !!listing->filter) {
+            continue;
+        }
+        if (!listing->count) {
+            return NULL;
+        }
+        listing->refcount++;
+        if (count_p) {
+            *count_p = listing->count;
+        }
+        return listing->files;
+    }
+
+    count = scan_files(path, pathlen, path != NULL, filter, flags, files, &cacheable);
+
     if (flags & FS_SEARCH_EXTRAINFO) {
         // TODO
         qsort(files, count, sizeof(files[0]), infocmp);
@@ -2952,7 +5227,7 @@ fail:
         qsort(files, count, sizeof(files[0]), alphacmp);
 
         // remove duplicates
-        total = 1;
+        total = count ? 1 : 0;
         for (i = 1; i < count; i++) {
             if (!FS_pathcmp((const char*)files[i - 1], (const char*)files[i])) { // CPP: Cast
                 Z_Free(files[i - 1]);
@@ -2963,20 +5238,107 @@ fail:
         }
     }
 
-    list = (void**)FS_Malloc(sizeof(void *) * (total + 1)); // CPP: Cast
+    filterlen = filter ? strlen(filter) + 1 : 0;
+    size = sizeof(*listing) + total * sizeof(void *);
+    listing = (fs_listing_t *)FS_Malloc(size + (path ? pathlen + 1 : 0) + filterlen); // CPP: Cast
+    listing->hash = hash;
+    listing->flags = flags;
+    listing->refcount = 1;
+    listing->path = NULL;
+    listing->filter = NULL;
+    if (path) {
+        listing->path = (char *)listing + size;
+        memcpy(listing->path, path, pathlen + 1);
+    }
+    if (filter) {
+        listing->filter = (char *)listing + size + (path ? pathlen + 1 : 0);
+        memcpy(listing->filter, filter, filterlen);
+    }
 
     total = 0;
     for (i = 0; i < count; i++) {
         if (files[i]) {
-            list[total++] = files[i];
+            listing->files[total++] = files[i];
+        }
+    }
+    listing->files[total] = NULL;
+    listing->count = total;
+
+    if (cacheable) {
+        if (fs_listings.count >= FS_LISTING_MAX) {
+            fs_listings_flush();
         }
+        listing->refcount++;
+        listing->hash_next = fs_listings.hash[hash];
+        fs_listings.hash[hash] = listing;
+        fs_listings.count++;
+    }
+
+    if (!total) {
+        fs_listing_put(listing);
+        return NULL;
     }
-    list[total] = NULL;
 
     if (count_p) {
         *count_p = total;
     }
 
+    return listing->files;
+}
+
+/*
+=================
+FS_ReleaseListing
+=================
+*/
+void FS_ReleaseListing(void **view)
+{
+    if (view) {
+        fs_listing_put((fs_listing_t *)((byte *)view - offsetof(fs_listing_t, files)));
+    }
+}
+
+/*
+=================
+FS_ListFiles
+
+Same as FS_ListFilesView, but returns a copy the caller owns.
+=================
+*/
+void **FS_ListFiles(const char *path,
+                    const char *filter,
+                    unsigned   flags,
+                    int        *count_p)
+{
+    void        **view, **list;
+    file_info_t *info;
+    int         i, count;
+
+    view = FS_ListFilesView(path, filter, flags, &count);
+    if (!view) {
+        if (count_p) {
+            *count_p = 0;
+        }
+        return NULL;
+    }
+
+    list = (void**)FS_Malloc(sizeof(void *) * (count + 1)); // CPP: Cast
+    for (i = 0; i < count; i++) {
+        if (flags & FS_SEARCH_EXTRAINFO) {
+            info = (file_info_t *)view[i]; // CPP: Cast
+            list[i] = FS_CopyInfo(info->name, info->size, info->ctime, info->mtime);
+        } else {
+            list[i] = FS_CopyString((char *)view[i]); // CPP: Cast
+        }
+    }
+    list[count] = NULL;
+
+    FS_ReleaseListing(view);
+
+    if (count_p) {
+        *count_p = count;
+    }
+
     return list;
 }
 
@@ -3002,25 +5364,38 @@ void FS_FreeList(void **list)
 
 void FS_File_g(const char *path, const char *ext, unsigned flags, genctx_t *ctx)
 {
-    int i, numFiles;
-    void **list;
+    int i, lo, hi, mid, numFiles;
+    void **view;
     char *s;
 
-    list = FS_ListFiles(path, ext, flags, &numFiles);
-    if (!list) {
+    view = FS_ListFilesView(path, ext, flags, &numFiles);
+    if (!view) {
         return;
     }
 
-    for (i = 0; i < numFiles; i++) {
-        s = (char*)list[i]; // CPP: Cast
-        if (ctx->count < ctx->size && !strncmp(s, ctx->partial, ctx->length)) {
-            ctx->matches[ctx->count++] = s;
+    // the listing is sorted, so names matching the partial one are adjacent
+    lo = 0;
+    hi = numFiles;
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (FS_pathcmpn((char *)view[mid], ctx->partial, ctx->length) < 0) {
+            lo = mid + 1;
         } else {
-            Z_Free(s);
+            hi = mid;
         }
     }
 
-    Z_Free(list);
+    for (i = lo; i < numFiles && ctx->count < ctx->size; i++) {
+        s = (char*)view[i]; // CPP: Cast
+        if (FS_pathcmpn(s, ctx->partial, ctx->length)) {
+            break;
+        }
+        if (!strncmp(s, ctx->partial, ctx->length)) {
+            ctx->matches[ctx->count++] = FS_CopyString(s);
+        }
+    }
+
+    FS_ReleaseListing(view);
 }
 
 static void print_file_list(const char *path, const char *ext, unsigned flags)
@@ -3302,10 +5677,12 @@ static void FS_Path_f(void)
 #endif
 }
 
-#ifdef _DEBUG
 /*
 ================
 FS_Stats_f
+
+Prints lookup statistics. Use "fs_stats reset" to start measuring
+afresh, e.g. to compare probes per open with fs_index on and off.
 ================
 */
 static void FS_Stats_f(void)
@@ -3317,6 +5694,13 @@ static void FS_Stats_f(void)
     int len, maxLen = 0;
     int totalHashSize, totalLen;
 
+    if (Cmd_Argc() > 1 && !strcmp(Cmd_Argv(1), "reset")) {
+        fs_count_read = fs_count_open = fs_count_strcmp = fs_count_strlwr = 0;
+        fs_count_probe = fs_count_negative = 0;
+        Com_Printf("Filesystem statistics reset\n");
+        return;
+    }
+
     totalHashSize = totalLen = 0;
     for (path = fs_searchpaths; path; path = path->next) {
         if (!(pack = path->pack)) {
@@ -3345,6 +5729,11 @@ static void FS_Stats_f(void)
     Com_Printf("Total path comparsions: %d\n", fs_count_strcmp);
     Com_Printf("Total calls to open_from_disk: %d\n", fs_count_open);
     Com_Printf("Total mixed-case reopens: %d\n", fs_count_strlwr);
+    Com_Printf("Total probes: %d, %.2f per open (fs_index %d)\n", fs_count_probe,
+               fs_count_read ? (float)fs_count_probe / fs_count_read : 0.0f, fs_index->integer);
+    Com_Printf("Negative cache hits: %d, %u entries\n", fs_count_negative, fs_path_index.num_negatives);
+    Com_Printf("Index: %u pack entries, %u loose directories, %u cached listings\n",
+               fs_path_index.num_entries, fs_path_index.num_loose, fs_path_index.num_dirlists);
 
     if (!totalHashSize) {
         Com_Printf("No stats to display\n");
@@ -3359,7 +5748,6 @@ static void FS_Stats_f(void)
         }
     }
 }
-#endif // _DEBUG
 
 static void FS_Link_g(genctx_t *ctx)
 {
@@ -3531,6 +5919,9 @@ static void free_all_paths(void)
     }
 
     fs_searchpaths = NULL;
+
+    // index references the freed search paths
+    fs_index_free();
 }
 
 static void free_game_paths(void)
@@ -3543,6 +5934,9 @@ static void free_game_paths(void)
     }
 
     fs_searchpaths = fs_base_searchpaths;
+
+    // index references the freed search paths
+    fs_index_free();
 }
 
 static void setup_base_paths(void)
@@ -3606,6 +6000,9 @@ void FS_Restart(qboolean total)
 {
     Com_Printf("----- FS_Restart -----\n");
 
+    // prefetched files may no longer be the ones found
+    FS_FlushAsyncLoads();
+
     if (total) {
         // perform full reset
         free_all_paths();
@@ -3642,9 +6039,9 @@ static const cmdreg_t c_fs[] = {
     { "path", FS_Path_f },
     { "fdir", FS_FDir_f },
     { "dir", FS_Dir_f },
-#ifdef _DEBUG
     { "fs_stats", FS_Stats_f },
-#endif
+    { "fs_loadtimes", FS_LoadTimes_f },
+    { "fs_makepkx", FS_MakePkx_f },
     { "whereis", FS_WhereIs_f },
     { "link", FS_Link_f, FS_Link_c },
     { "unlink", FS_UnLink_f, FS_Link_c },
@@ -3677,6 +6074,9 @@ void FS_Shutdown(void)
         }
     }
 
+    // stop I/O threads
+    fs_async_shutdown();
+
     // free symbolic links
     free_all_links(&fs_hard_links);
     free_all_links(&fs_soft_links);
@@ -3775,6 +6175,12 @@ void FS_Init(void)
     fs_debug = Cvar_Get("fs_debug", "0", 0);
 #endif
 
+    fs_index = Cvar_Get("fs_index", "1", 0);
+    fs_mmap = Cvar_Get("fs_mmap", "1", 0);
+
+    fs_async_init();
+    fs_index->changed = fs_index_changed;
+
 	fs_shareware = Cvar_Get("fs_shareware", "0", CVAR_ROM);
 
     // get the game cvar and start the filesystem
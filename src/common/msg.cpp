@@ -1148,6 +1148,212 @@ void MSG_ParseDeltaEntity(const EntityState* from, EntityState* to, int number,
     }
 }
 
+/*
+==============================================================================
+
+            UNCHECKED ENTITY READING
+
+Used by the client while at least MAX_ENTITY_DELTA_BYTES of the message are
+left, so an entity header and its delta can never run past the end. Fields
+are read through a local cursor and the read position is stored once per
+call, instead of going through MSG_ReadData for every field.
+
+==============================================================================
+*/
+
+static inline uint64_t MSG_LoadWord64(const byte *p)
+{
+    uint64_t w;
+
+    memcpy(&w, p, sizeof(w));
+#if __BYTE_ORDER == __BIG_ENDIAN
+    w = __builtin_bswap64(w);
+#endif
+    return w;
+}
+
+static inline int MSG_TakeByte(const byte *&p)
+{
+    return *p++;
+}
+
+static inline int MSG_TakeShort(const byte *&p)
+{
+    int c = (int16_t)LittleShortMem(p);
+    p += 2;
+    return c;
+}
+
+static inline int MSG_TakeWord(const byte *&p)
+{
+    int c = (uint16_t)LittleShortMem(p);
+    p += 2;
+    return c;
+}
+
+static inline int MSG_TakeLong(const byte *&p)
+{
+    int c = LittleLongMem(p);
+    p += 4;
+    return c;
+}
+
+static inline float MSG_TakeFloat(const byte *&p)
+{
+    msg_float vec;
+    vec.i = MSG_TakeLong(p);
+    return vec.f;
+}
+
+static inline void MSG_AdvanceTo(const byte *p)
+{
+    msg_read.readCount = p - msg_read.data;
+    msg_read.bitPosition = msg_read.readCount << 3;
+}
+
+/*
+=================
+MSG_ParseEntityBitsUnchecked
+
+Same as MSG_ParseEntityBits, decoding the whole header from one 64 bit load.
+=================
+*/
+int MSG_ParseEntityBitsUnchecked(int *bits)
+{
+    const byte  *p = msg_read.data + msg_read.readCount;
+    uint64_t    w = MSG_LoadWord64(p);
+    uint32_t    total;
+    int         len, number;
+
+    // each header byte flags the presence of the next one
+    total = w & 0xff;
+    len = 1;
+    if (total & U_MOREBITS1) {
+        total |= w & 0xff00;
+        len = 2;
+    }
+    if (total & U_MOREBITS2) {
+        total |= w & 0xff0000;
+        len = 3;
+    }
+    if (total & U_MOREBITS3) {
+        total |= w & 0xff000000;
+        len = 4;
+    }
+
+    w >>= len * 8;
+    if (total & U_NUMBER16) {
+        number = (int16_t)(w & 0xffff);
+        len += 2;
+    } else {
+        number = w & 0xff;
+        len += 1;
+    }
+
+    MSG_AdvanceTo(p + len);
+
+    *bits = (int)total;
+
+    return number;
+}
+
+/*
+==================
+MSG_ParseDeltaEntityUnchecked
+
+Same as MSG_ParseDeltaEntity, without per field bounds checks.
+==================
+*/
+void MSG_ParseDeltaEntityUnchecked(const EntityState *from, EntityState *to, int number, int bits, EntityStateMessageFlags flags)
+{
+    const byte *p;
+
+    if (number < 1 || number >= MAX_EDICTS) {
+        Com_Error(ERR_DROP, "%s: bad entity number: %d", __func__, number);
+    }
+
+    if (!from) {
+        memset(to, 0, sizeof(*to));
+    } else if (to != from) {
+        memcpy(to, from, sizeof(*to));
+    }
+
+    to->number = number;
+    to->eventID = 0;
+
+    if (!bits) {
+        return;
+    }
+
+    p = msg_read.data + msg_read.readCount;
+
+    if (bits & U_MODEL)
+        to->modelIndex = MSG_TakeByte(p);
+    if (bits & U_MODEL2)
+        to->modelIndex2 = MSG_TakeByte(p);
+    if (bits & U_MODEL3)
+        to->modelIndex3 = MSG_TakeByte(p);
+    if (bits & U_MODEL4)
+        to->modelIndex4 = MSG_TakeByte(p);
+
+    if (bits & U_FRAME8)
+        to->frame = MSG_TakeByte(p);
+    if (bits & U_FRAME16)
+        to->frame = MSG_TakeShort(p);
+
+    if ((bits & (U_SKIN8 | U_SKIN16)) == (U_SKIN8 | U_SKIN16))
+        to->skinNumber = MSG_TakeLong(p);
+    else if (bits & U_SKIN8)
+        to->skinNumber = MSG_TakeByte(p);
+    else if (bits & U_SKIN16)
+        to->skinNumber = MSG_TakeWord(p);
+
+    if ((bits & (U_EFFECTS8 | U_EFFECTS16)) == (U_EFFECTS8 | U_EFFECTS16))
+        to->effects = MSG_TakeLong(p);
+    else if (bits & U_EFFECTS8)
+        to->effects = MSG_TakeByte(p);
+    else if (bits & U_EFFECTS16)
+        to->effects = MSG_TakeWord(p);
+
+    if ((bits & (U_RENDERFX8 | U_RENDERFX16)) == (U_RENDERFX8 | U_RENDERFX16))
+        to->renderEffects = MSG_TakeLong(p);
+    else if (bits & U_RENDERFX8)
+        to->renderEffects = MSG_TakeByte(p);
+    else if (bits & U_RENDERFX16)
+        to->renderEffects = MSG_TakeWord(p);
+
+    if (bits & U_ORIGIN_X)
+        to->origin[0] = MSG_TakeFloat(p);
+    if (bits & U_ORIGIN_Y)
+        to->origin[1] = MSG_TakeFloat(p);
+    if (bits & U_ORIGIN_Z)
+        to->origin[2] = MSG_TakeFloat(p);
+
+    if (bits & U_ANGLE_X)
+        to->angles[0] = MSG_TakeFloat(p);
+    if (bits & U_ANGLE_Y)
+        to->angles[1] = MSG_TakeFloat(p);
+    if (bits & U_ANGLE_Z)
+        to->angles[2] = MSG_TakeFloat(p);
+
+    if (bits & U_OLDORIGIN) {
+        to->oldOrigin[0] = MSG_TakeFloat(p);
+        to->oldOrigin[1] = MSG_TakeFloat(p);
+        to->oldOrigin[2] = MSG_TakeFloat(p);
+    }
+
+    if (bits & U_SOUND)
+        to->sound = MSG_TakeByte(p);
+
+    if (bits & U_EVENT)
+        to->eventID = MSG_TakeByte(p);
+
+    if (bits & U_SOLID)
+        to->solid = MSG_TakeLong(p);
+
+    MSG_AdvanceTo(p);
+}
+
 /*
 ===================
 MSG_ParseDeltaPlayerstate_Default
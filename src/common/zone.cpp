@@ -18,6 +18,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 // CPP: Required include for _ReturnAddress();
 #include <intrin.h>
+#include <mutex>
 
 #include "shared/shared.h"
 #include "common/common.h"
@@ -51,6 +52,10 @@ typedef struct zhead_s {
 
 static zhead_t      z_chain;
 
+// zone chain and stats are shared with renderer and file system worker
+// threads, so every mutation goes through this lock
+static std::recursive_mutex z_lock;
+
 typedef struct {
     zhead_t     z;
     char        data[2];
@@ -160,6 +165,8 @@ void Z_Free(void *ptr)
 
     Z_Validate(z, __func__);
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     s = &z_stats[z->tag < TAG_MAX ? z->tag : TAG_FREE];
     s->count--;
     s->bytes -= z->size;
@@ -200,6 +207,8 @@ void *Z_Realloc(void *ptr, size_t size)
         Com_Error(ERR_FATAL, "%s: couldn't realloc static memory", __func__);
     }
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     s = &z_stats[z->tag < TAG_MAX ? z->tag : TAG_FREE];
     s->bytes -= z->size;
 
@@ -261,6 +270,8 @@ void Z_FreeTags(memtag_t tag)
 {
     zhead_t *z, *n;
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     Z_FOR_EACH_SAFE(z, n) {
         Z_Validate(z, __func__);
         n = z->next;
@@ -312,6 +323,8 @@ void *Z_TagMalloc(size_t size, memtag_t tag)
     z->time = time(NULL);
 #endif
 
+    std::lock_guard<std::recursive_mutex> lock(z_lock);
+
     z->next = z_chain.next;
     z->prev = &z_chain;
     z_chain.next->prev = z;
@@ -22,10 +22,21 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 // images.c -- image reading and writing functions
 //
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "shared/shared.h"
 #include "common/common.h"
 #include "common/cvar.h"
 #include "common/files.h"
+#include "system/system.h"
 #include "refresh/images.h"
 #include "format/pcx.h"
 #include "format/wal.h"
@@ -673,6 +684,760 @@ static int              img_total;
 static cvar_t   *r_override_textures;
 static cvar_t   *r_texture_formats;
 
+/*
+=========================================================
+
+BATCHED IMAGE DECODING
+
+Between IMG_BeginBatch and IMG_EndBatch 32-bit images are not decoded
+when they are found. Only the header is parsed, so that dimensions are
+known right away, and the compressed file is kept in a job that is
+decoded on worker threads when the batch ends. Post-processing passes
+queued with IMG_QueuePostProcess run on the same worker, in the order
+they were queued. Each job only writes to its own image, so the result
+is identical to decoding the images one by one.
+
+Final pixels and derived light info of batched images are kept in the
+texture cache, keyed by a hash of the source file, the passes applied
+and r_texture_formats. Warm loads copy them from the mapped cache file
+and skip decoding and post-processing.
+
+=========================================================
+*/
+
+#if USE_REF == REF_VKPT
+
+#define MAX_IMG_POSTPROCESS     4
+#define MAX_IMG_DECODE_THREADS  16
+
+#define IMG_CACHE_IDENT         (('1' << 24) + ('C' << 16) + ('X' << 8) + 'T')
+
+typedef struct {
+    image_t         *image;
+    image_t         *source;    // copy pixels from this image instead of decoding
+    int             phase;      // clones run after their source is complete
+    byte            *rawdata;
+    size_t          rawlen;
+    qerror_t        ret;
+    uint64_t        key;        // texture cache key
+    qboolean        cached;     // pixels came from the texture cache
+    int             numpost;
+    imgpostfunc_t   post[MAX_IMG_POSTPROCESS];
+    int             postarg[MAX_IMG_POSTPROCESS];
+    const char      *postname[MAX_IMG_POSTPROCESS];
+} imgjob_t;
+
+typedef struct {
+    uint32_t    ident;
+    uint32_t    version;
+    uint64_t    key;
+    int32_t     width, height;
+    vec3_t      light_color;
+    vec2_t      min_light_texcoord;
+    vec2_t      max_light_texcoord;
+    int32_t     entire_texture_emissive;
+    int32_t     processing_complete;
+} imgcache_t;
+
+static imgjob_t     img_jobs[MAX_RIMAGES];
+static int          img_numjobs;
+static int          img_numphases;
+static int          img_jobindex[MAX_RIMAGES]; // job number + 1, by image slot
+static qboolean     img_batch_active;
+
+static cvar_t       *r_decode_threads;
+static cvar_t       *r_texture_cache;
+static cvar_t       *r_texture_cache_size;
+
+static uint32_t     img_cache_version;
+
+static imgjob_t *img_job_for_image(const image_t *image)
+{
+    int index = img_jobindex[image - r_images];
+
+    return index ? &img_jobs[index - 1] : NULL;
+}
+
+static imgjob_t *img_alloc_job(image_t *image)
+{
+    imgjob_t *job;
+
+    if (img_numjobs == MAX_RIMAGES) {
+        return NULL;
+    }
+
+    job = &img_jobs[img_numjobs++];
+    memset(job, 0, sizeof(*job));
+    job->image = image;
+    img_jobindex[image - r_images] = img_numjobs;
+    return job;
+}
+
+static void img_discard_jobs(void)
+{
+    imgjob_t *job;
+    int i;
+
+    for (i = 0, job = img_jobs; i < img_numjobs; i++, job++) {
+        FS_FreeFile(job->rawdata);
+        img_jobindex[job->image - r_images] = 0;
+    }
+
+    img_numjobs = 0;
+    img_numphases = 0;
+}
+
+// parses the header of a 32-bit image and queues the decode when a batch
+// is active. takes ownership of rawdata on success.
+static qboolean img_defer_decode(byte *rawdata, size_t rawlen, image_t *image)
+{
+    imgjob_t *job;
+    int w, h, channels;
+
+    if (!img_batch_active) {
+        return false;
+    }
+
+    if (rawlen > INT_MAX || !stbi_info_from_memory(rawdata, (int)rawlen, &w, &h, &channels)) {
+        return false;
+    }
+
+    job = img_alloc_job(image);
+    if (!job) {
+        return false;
+    }
+
+    job->rawdata = rawdata;
+    job->rawlen = rawlen;
+    if (img_numphases < 1) {
+        img_numphases = 1;
+    }
+
+    image->upload_width = image->width = w;
+    image->upload_height = image->height = h;
+
+    if (channels == 3)
+        image->flags = (imageflags_t)(image->flags | IF_OPAQUE);
+
+    return true;
+}
+
+// queues a copy of a pending image, made once the source is complete
+static qboolean img_defer_clone(image_t *source, image_t *image)
+{
+    imgjob_t *source_job, *job;
+
+    source_job = img_job_for_image(source);
+    if (!source_job) {
+        return false;
+    }
+
+    job = img_alloc_job(image);
+    if (!job) {
+        return false;
+    }
+
+    job->source = source;
+    job->phase = source_job->phase + 1;
+    if (img_numphases < job->phase + 1) {
+        img_numphases = job->phase + 1;
+    }
+
+    return true;
+}
+
+static void img_run_job(imgjob_t *job)
+{
+    image_t *image = job->image;
+    int i, w, h, channels;
+
+    if (job->source) {
+        image_t *source = job->source;
+        size_t size = source->upload_width * source->upload_height * 4;
+
+        if (!source->pix_data) {
+            job->ret = Q_ERR_INVALID_FORMAT;
+            return;
+        }
+
+        image->pix_data = (byte *)IMG_AllocPixels(size);
+        memcpy(image->pix_data, source->pix_data, size);
+        image->upload_width = source->upload_width;
+        image->upload_height = source->upload_height;
+    } else {
+        image->pix_data = stbi_load_from_memory(job->rawdata, (int)job->rawlen, &w, &h, &channels, 4);
+        if (!image->pix_data) {
+            job->ret = Q_ERR_LIBRARY_ERROR;
+            return;
+        }
+
+        // header and pixel data disagree, don't upload garbage
+        if (w != image->upload_width || h != image->upload_height) {
+            Z_Free(image->pix_data);
+            image->pix_data = NULL;
+            job->ret = Q_ERR_INVALID_FORMAT;
+            return;
+        }
+    }
+
+    for (i = 0; i < job->numpost; i++) {
+        job->post[i](image, job->postarg[i]);
+    }
+}
+
+// 64-bit FNV-1a
+static uint64_t img_hash(uint64_t hash, const void *data, size_t len)
+{
+    const byte *p = (const byte *)data;
+
+    while (len--) {
+        hash ^= *p++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+static void img_hash_job(imgjob_t *job)
+{
+    job->key = img_hash(14695981039346656037ULL, job->rawdata, job->rawlen);
+}
+
+// mixes everything that affects the final pixels into the hash of the source
+static void img_finish_key(imgjob_t *job)
+{
+    uint64_t key;
+    int i;
+
+    if (job->source) {
+        key = img_job_for_image(job->source)->key;
+        key = img_hash(key, "clone", 5);
+    } else {
+        key = job->key;
+        key = img_hash(key, r_texture_formats->string, strlen(r_texture_formats->string));
+    }
+
+    key = img_hash(key, &job->image->is_srgb, sizeof(job->image->is_srgb));
+
+    for (i = 0; i < job->numpost; i++) {
+        key = img_hash(key, job->postname[i], strlen(job->postname[i]));
+        key = img_hash(key, &job->postarg[i], sizeof(job->postarg[i]));
+    }
+
+    job->key = key;
+}
+
+// derived from the cache file layout and the decoder, so that changing
+// either of them leaves old entries unmatched
+static uint32_t img_cache_format_version(void)
+{
+    const uint32_t format[] = {
+        sizeof(imgcache_t),
+        offsetof(imgcache_t, key),
+        offsetof(imgcache_t, width),
+        offsetof(imgcache_t, light_color),
+        offsetof(imgcache_t, min_light_texcoord),
+        offsetof(imgcache_t, max_light_texcoord),
+        offsetof(imgcache_t, entire_texture_emissive),
+        offsetof(imgcache_t, processing_complete),
+        STBI_VERSION,
+        4,  // channels of the stored pixels
+    };
+    uint64_t hash = img_hash(14695981039346656037ULL, format, sizeof(format));
+
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static void img_cache_path(char *buffer, size_t size, uint64_t key)
+{
+    Q_snprintf(buffer, size, "texcache/%08x%08x.tc",
+               (uint32_t)(key >> 32), (uint32_t)key);
+}
+
+static qboolean img_cache_read(imgjob_t *job)
+{
+    image_t *image = job->image;
+    char path[MAX_OSPATH];
+    const void *data;
+    const imgcache_t *header;
+    ssize_t len;
+    size_t size;
+
+    img_cache_path(path, sizeof(path), job->key);
+    len = FS_MapFile(path, &data, 0);
+    if (!data) {
+        return false;
+    }
+
+    header = (const imgcache_t *)data;
+    if (len < (ssize_t)sizeof(*header) || header->ident != IMG_CACHE_IDENT ||
+        header->version != img_cache_version || header->key != job->key ||
+        header->width < 1 || header->height < 1) {
+        FS_UnmapFile(data);
+        return false;
+    }
+
+    size = (size_t)header->width * header->height * 4;
+    if ((size_t)len - sizeof(*header) != size) {
+        FS_UnmapFile(data);
+        return false;
+    }
+
+    image->pix_data = (byte *)IMG_AllocPixels(size);
+    memcpy(image->pix_data, header + 1, size);
+    image->upload_width = header->width;
+    image->upload_height = header->height;
+    VectorCopy(header->light_color, image->light_color);
+    image->min_light_texcoord = header->min_light_texcoord;
+    image->max_light_texcoord = header->max_light_texcoord;
+    image->entire_texture_emissive = header->entire_texture_emissive;
+    image->processing_complete = header->processing_complete;
+
+    FS_UnmapFile(data);
+    return true;
+}
+
+/*
+Cache files are written, marked used and evicted by a background thread,
+so a cold load doesn't pay for the writes. The thread keeps an index of
+the cache directory, and once it exceeds r_texture_cache_size, removes
+the entries least recently used, as told by their modification times.
+The files are written behind the back of the file system, which is told
+to forget its failed lookups before the cache is read again.
+*/
+
+#define IMG_CACHE_MAX_QUEUED    (256 << 20)     // bytes waiting to be written
+
+typedef struct imgwrite_s {
+    struct imgwrite_s   *next;
+    char                dir[MAX_OSPATH];
+    uint64_t            key;
+    uint64_t            limit;      // size limit of the cache directory
+    byte                *data;      // header and pixels, NULL to mark used
+    size_t              size;
+} imgwrite_t;
+
+typedef struct {
+    uint64_t                        size;
+    std::filesystem::file_time_type lastused;
+} imgcacheentry_t;
+
+static struct {
+    std::thread             *thread;
+    std::mutex              mutex;
+    std::condition_variable work;
+    imgwrite_t              *head, *tail;
+    size_t                  queued;
+    qboolean                quit;
+    std::atomic<int>        written;    // files created since last checked
+
+    // owned by the writer thread
+    std::unordered_map<uint64_t, imgcacheentry_t> entries;
+    std::string             dir;        // directory the index is for
+    uint64_t                total;
+} img_writer;
+
+static std::filesystem::path img_writer_path(const char *dir, uint64_t key, const char *ext)
+{
+    char name[MAX_QPATH];
+
+    Q_snprintf(name, sizeof(name), "%08x%08x%s", (uint32_t)(key >> 32), (uint32_t)key, ext);
+    return std::filesystem::path(dir) / name;
+}
+
+static void img_writer_scan(const char *dir)
+{
+    std::error_code ec;
+
+    img_writer.entries.clear();
+    img_writer.dir = dir;
+    img_writer.total = 0;
+
+    std::filesystem::create_directories(dir, ec);
+
+    for (auto it = std::filesystem::directory_iterator(dir, ec);
+         !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        const std::filesystem::path &path = it->path();
+        imgcacheentry_t entry;
+
+        if (path.extension() != ".tc") {
+            continue;
+        }
+
+        entry.size = it->file_size(ec);
+        entry.lastused = it->last_write_time(ec);
+        if (ec) {
+            ec.clear();
+            continue;
+        }
+
+        img_writer.entries[strtoull(path.stem().string().c_str(), NULL, 16)] = entry;
+        img_writer.total += entry.size;
+    }
+}
+
+// removes the least recently used entries until well below the limit
+static void img_writer_evict(const char *dir, uint64_t limit)
+{
+    std::vector<std::pair<std::filesystem::file_time_type, uint64_t>> order;
+    std::error_code ec;
+
+    if (img_writer.total <= limit) {
+        return;
+    }
+
+    for (auto &it : img_writer.entries) {
+        order.emplace_back(it.second.lastused, it.first);
+    }
+    std::sort(order.begin(), order.end());
+
+    for (auto &it : order) {
+        if (img_writer.total <= limit - limit / 8) {
+            break;
+        }
+        std::filesystem::remove(img_writer_path(dir, it.second, ".tc"), ec);
+        img_writer.total -= img_writer.entries[it.second].size;
+        img_writer.entries.erase(it.second);
+    }
+}
+
+static void img_writer_run(imgwrite_t *cmd)
+{
+    std::filesystem::path path = img_writer_path(cmd->dir, cmd->key, ".tc");
+    std::error_code ec;
+
+    if (img_writer.dir != cmd->dir) {
+        img_writer_scan(cmd->dir);
+    }
+
+    auto it = img_writer.entries.find(cmd->key);
+
+    if (!cmd->data) {
+        if (it != img_writer.entries.end()) {
+            it->second.lastused = std::filesystem::file_time_type::clock::now();
+            std::filesystem::last_write_time(path, it->second.lastused, ec);
+        }
+        return;
+    }
+
+    // write under a temporary name, readers never see partial files
+    std::filesystem::path temp = img_writer_path(cmd->dir, cmd->key, ".tmp");
+    FILE *fp = fopen(temp.string().c_str(), "wb");
+    if (!fp) {
+        return;
+    }
+
+    qboolean ok = fwrite(cmd->data, 1, cmd->size, fp) == cmd->size;
+    ok = !fclose(fp) && ok;
+    if (ok) {
+        std::filesystem::rename(temp, path, ec);
+    }
+    if (!ok || ec) {
+        std::filesystem::remove(temp, ec);
+        return;
+    }
+
+    if (it != img_writer.entries.end()) {
+        img_writer.total -= it->second.size;
+    }
+    img_writer.entries[cmd->key] = { cmd->size, std::filesystem::file_time_type::clock::now() };
+    img_writer.total += cmd->size;
+    img_writer.written++;
+
+    img_writer_evict(cmd->dir, cmd->limit);
+}
+
+static void img_writer_worker(void)
+{
+    std::unique_lock<std::mutex> lock(img_writer.mutex);
+    imgwrite_t *cmd;
+
+    while (1) {
+        cmd = img_writer.head;
+        if (!cmd) {
+            if (img_writer.quit) {
+                return;
+            }
+            img_writer.work.wait(lock);
+            continue;
+        }
+
+        img_writer.head = cmd->next;
+        if (!img_writer.head) {
+            img_writer.tail = NULL;
+        }
+        lock.unlock();
+
+        img_writer_run(cmd);
+
+        lock.lock();
+        img_writer.queued -= cmd->size;
+        free(cmd->data);
+        free(cmd);
+    }
+}
+
+// hands a command over to the writer thread, takes ownership of data
+static void img_writer_queue(uint64_t key, byte *data, size_t size)
+{
+    imgwrite_t *cmd = (imgwrite_t *)malloc(sizeof(*cmd));
+
+    if (!cmd) {
+        free(data);
+        return;
+    }
+
+    Q_concat(cmd->dir, sizeof(cmd->dir), fs_gamedir, "/texcache", NULL);
+    cmd->next = NULL;
+    cmd->key = key;
+    cmd->limit = (uint64_t)max(r_texture_cache_size->integer, 1) << 20;
+    cmd->data = data;
+    cmd->size = size;
+
+    if (!img_writer.thread) {
+        img_writer.quit = false;
+        img_writer.thread = new std::thread(img_writer_worker);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(img_writer.mutex);
+
+        if (img_writer.tail) {
+            img_writer.tail->next = cmd;
+        } else {
+            img_writer.head = cmd;
+        }
+        img_writer.tail = cmd;
+        img_writer.queued += size;
+    }
+
+    img_writer.work.notify_one();
+}
+
+// makes the files written so far visible to FS_MapFile, main thread only
+static void img_writer_sync(void)
+{
+    if (img_writer.written.exchange(0)) {
+        FS_InvalidatePathCache();
+    }
+}
+
+// finishes all queued writes
+static void img_writer_shutdown(void)
+{
+    if (!img_writer.thread) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(img_writer.mutex);
+        img_writer.quit = true;
+    }
+    img_writer.work.notify_one();
+
+    img_writer.thread->join();
+    delete img_writer.thread;
+    img_writer.thread = NULL;
+
+    img_writer_sync();
+}
+
+static void img_cache_touch(imgjob_t *job)
+{
+    img_writer_queue(job->key, NULL, 0);
+}
+
+static void img_cache_write(imgjob_t *job)
+{
+    image_t *image = job->image;
+    size_t pixels = (size_t)image->upload_width * image->upload_height * 4;
+    size_t queued;
+    imgcache_t *header;
+    byte *data;
+
+    {
+        std::lock_guard<std::mutex> lock(img_writer.mutex);
+        queued = img_writer.queued;
+    }
+
+    // the writer is behind, this one gets cached on a later load
+    if (queued + sizeof(*header) + pixels > IMG_CACHE_MAX_QUEUED) {
+        return;
+    }
+
+    data = (byte *)malloc(sizeof(*header) + pixels);
+    if (!data) {
+        return;
+    }
+
+    memset(data, 0, sizeof(*header));
+    header = (imgcache_t *)data;
+    header->ident = IMG_CACHE_IDENT;
+    header->version = img_cache_version;
+    header->key = job->key;
+    header->width = image->upload_width;
+    header->height = image->upload_height;
+    VectorCopy(image->light_color, header->light_color);
+    header->min_light_texcoord = image->min_light_texcoord;
+    header->max_light_texcoord = image->max_light_texcoord;
+    header->entire_texture_emissive = image->entire_texture_emissive;
+    header->processing_complete = image->processing_complete;
+    memcpy(header + 1, image->pix_data, pixels);
+
+    img_writer_queue(job->key, data, sizeof(*header) + pixels);
+}
+
+// runs func on all jobs using numthreads threads, calling thread included
+template<typename F>
+static void img_run_parallel(F func, int numthreads)
+{
+    std::thread threads[MAX_IMG_DECODE_THREADS];
+    std::atomic<int> next(0);
+    int i;
+
+    auto worker = [&func, &next]() {
+        int j;
+
+        while ((j = next++) < img_numjobs) {
+            func(&img_jobs[j]);
+        }
+    };
+
+    for (i = 1; i < numthreads; i++) {
+        threads[i] = std::thread(worker);
+    }
+
+    worker();
+
+    for (i = 1; i < numthreads; i++) {
+        threads[i].join();
+    }
+}
+
+/*
+===============
+IMG_BeginBatch
+
+Defers decoding of images found until IMG_EndBatch.
+===============
+*/
+void IMG_BeginBatch(void)
+{
+    // a previous batch may have been interrupted by an error
+    img_discard_jobs();
+
+    img_batch_active = true;
+}
+
+/*
+===============
+IMG_EndBatch
+
+Decodes and post-processes all images queued since IMG_BeginBatch.
+===============
+*/
+void IMG_EndBatch(void)
+{
+    imgjob_t *job;
+    unsigned start;
+    int i, numthreads, numjobs, numcached = 0;
+
+    if (!img_batch_active) {
+        return;
+    }
+
+    img_batch_active = false;
+
+    numjobs = img_numjobs;
+    if (!numjobs) {
+        return;
+    }
+
+    start = Sys_Milliseconds();
+
+    numthreads = r_decode_threads->integer;
+    if (numthreads < 1) {
+        numthreads = std::thread::hardware_concurrency();
+    }
+    clamp(numthreads, 1, MAX_IMG_DECODE_THREADS);
+    if (numthreads > numjobs) {
+        numthreads = numjobs;
+    }
+
+    if (r_texture_cache->integer) {
+        // hashing reads every source file, spread it over the workers
+        img_run_parallel([](imgjob_t *job) {
+            if (!job->source) {
+                img_hash_job(job);
+            }
+        }, numthreads);
+
+        img_writer_sync();
+
+        // sources come before their clones, so their keys are final
+        for (i = 0, job = img_jobs; i < img_numjobs; i++, job++) {
+            img_finish_key(job);
+            job->cached = img_cache_read(job);
+            if (job->cached) {
+                img_cache_touch(job);
+                numcached++;
+            }
+        }
+    }
+
+    for (i = 0; i < img_numphases; i++) {
+        img_run_parallel([i](imgjob_t *job) {
+            if (job->phase == i && !job->cached) {
+                img_run_job(job);
+            }
+        }, numthreads);
+    }
+
+    for (i = 0, job = img_jobs; i < img_numjobs; i++, job++) {
+        if (job->ret < 0) {
+            Com_EPrintf("Couldn't decode %s: %s\n", job->image->name, Q_ErrorString(job->ret));
+        } else if (r_texture_cache->integer && !job->cached && job->image->pix_data) {
+            img_cache_write(job);
+        }
+    }
+
+    img_discard_jobs();
+
+    Com_DPrintf("%s: %d images (%d cached) in %u ms on %d threads\n", __func__,
+                numjobs, numcached, Sys_Milliseconds() - start, numthreads);
+}
+
+/*
+===============
+IMG_QueuePostProcess
+
+Appends a pass to be run on the image pixels once they are decoded.
+The name identifies the pass in the texture cache key. Returns false
+if the image is not pending, in which case the caller should run the
+pass immediately.
+===============
+*/
+qboolean IMG_QueuePostProcess(image_t *image, const char *name, imgpostfunc_t func, int arg)
+{
+    imgjob_t *job = img_job_for_image(image);
+
+    if (!job) {
+        return false;
+    }
+
+    if (job->numpost == MAX_IMG_POSTPROCESS) {
+        Com_Error(ERR_FATAL, "%s: too many passes for %s", __func__, image->name);
+    }
+
+    job->post[job->numpost] = func;
+    job->postarg[job->numpost] = arg;
+    job->postname[job->numpost] = name;
+    job->numpost++;
+    return true;
+}
+
+#endif // USE_REF == REF_VKPT
+
 /*
 ===============
 IMG_List_f
@@ -824,9 +1589,17 @@ static int _try_image_format(imageformat_t fmt, image_t* image, int try_src, byt
     }
 
     // decompress the image
-    ret = img_loaders[fmt].load(data, len, image, pic);
+#if USE_REF == REF_VKPT
+    if (fmt >= IM_TGA && img_defer_decode(data, len, image)) {
+        *pic = NULL;
+        ret = Q_ERR_SUCCESS;
+    } else
+#endif
+    {
+        ret = img_loaders[fmt].load(data, len, image, pic);
 
-    FS_FreeFile(data);
+        FS_FreeFile(data);
+    }
 
     image->filepath[0] = 0;
     if (ret >= 0) {
@@ -1277,7 +2050,10 @@ image_t* IMG_Clone(image_t* image, const char* new_name) {
 
 #if USE_REF == REF_VKPT
     size_t image_size = image->upload_width * image->upload_height * 4;
-    if (image->pix_data != NULL)     {
+    if (img_defer_clone(image, new_image))     {
+        new_image->pix_data = NULL;
+    }
+    else if (image->pix_data != NULL)     {
         new_image->pix_data = (byte*)IMG_AllocPixels(image_size);
         memcpy(new_image->pix_data, image->pix_data, image_size);
     }
@@ -1498,6 +2274,11 @@ void IMG_FreeAll(void)
     image_t *image;
     int i, count = 0;
 
+#if USE_REF == REF_VKPT
+    img_discard_jobs();
+    img_batch_active = false;
+#endif
+
     for (i = 1, image = r_images + 1; i < r_numImages; i++, image++) {
         if (!image->registration_sequence)
             continue;        // free image_t slot
@@ -1582,6 +2363,12 @@ void IMG_Init(void)
     r_texture_formats = Cvar_Get("r_texture_formats", "pjt", 0);
     r_texture_formats->changed = r_texture_formats_changed;
     r_texture_formats_changed(r_texture_formats);
+#if USE_REF == REF_VKPT
+    r_decode_threads = Cvar_Get("r_decode_threads", "0", 0);
+    r_texture_cache = Cvar_Get("r_texture_cache", "1", 0);
+    r_texture_cache_size = Cvar_Get("r_texture_cache_size", "2048", 0);
+    img_cache_version = img_cache_format_version();
+#endif
 
     r_screenshot_format = Cvar_Get("gl_screenshot_format", "jpg", CVAR_ARCHIVE);
     r_screenshot_format = Cvar_Get("gl_screenshot_format", "png", CVAR_ARCHIVE);
@@ -1601,6 +2388,10 @@ void IMG_Init(void)
 
 void IMG_Shutdown(void)
 {
+#if USE_REF == REF_VKPT
+    img_writer_shutdown();
+#endif
+
     Cmd_Unregister(img_cmd);
     r_numImages = 0;
 }
@@ -377,14 +377,14 @@ qhandle_t R_RegisterModel(const char *name)
 	{
 		memcpy(extension, ".md3", 4);
 
-		filelen = FS_LoadFile(normalized, (void **)&rawdata);
+		filelen = FS_MapFile(normalized, (const void **)&rawdata, 0);
 
 		memcpy(extension, ".md2", 4);
 	}
 
 	if (!rawdata)
 	{
-		filelen = FS_LoadFile(normalized, (void **)&rawdata);
+		filelen = FS_MapFile(normalized, (const void **)&rawdata, 0);
 		if (!rawdata) {
 			// don't spam about missing models
 			if (filelen == Q_ERR_NOENT) {
@@ -434,7 +434,7 @@ qhandle_t R_RegisterModel(const char *name)
 
 	ret = load(model, rawdata, filelen, name);
 
-	FS_FreeFile(rawdata);
+	FS_UnmapFile(rawdata);
 
 	if (ret) {
 		memset(model, 0, sizeof(*model));
@@ -452,7 +452,7 @@ done:
 	return index;
 
 fail2:
-	FS_FreeFile(rawdata);
+	FS_UnmapFile(rawdata);
 fail1:
 	Com_EPrintf("Couldn't load %s: %s\n", normalized, Q_ErrorString(ret));
 	return 0;
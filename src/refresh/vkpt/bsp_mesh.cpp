@@ -1846,6 +1846,9 @@ void
 bsp_mesh_register_textures(bsp_t* bsp) {
 	MAT_ChangeMap(bsp->name);
 
+	// decode all world textures at once, light extraction needs them below
+	IMG_BeginBatch();
+
 	for (int i = 0; i < bsp->numtexinfo; i++) {
 		mtexinfo_t* info = bsp->texinfo + i;
 		imageflags_t flags;
@@ -1885,6 +1888,8 @@ bsp_mesh_register_textures(bsp_t* bsp) {
 		info->material = mat;
 	}
 
+	IMG_EndBatch();
+
 	// link the animation sequences
 	for (int i = 0; i < bsp->numtexinfo; i++) 	{
 		mtexinfo_t* texinfo = bsp->texinfo + i;
@@ -869,13 +869,14 @@ image_t* vkpt_fake_emissive_texture(image_t* image, int bright_threshold_int) {
 
 	#define CLAMP(a, m, M) MIN(MAX(a, m), M)
 	new_image->flags = (imageflags_t)(new_image->flags | IF_FAKE_EMISSIVE | (CLAMP(bright_threshold_int, 0, 255) << IF_FAKE_EMISSIVE_THRESH_SHIFT));
-	apply_fake_emissive_threshold(new_image, bright_threshold_int);
+	if (!IMG_QueuePostProcess(new_image, "fake_emissive", apply_fake_emissive_threshold, bright_threshold_int))
+		apply_fake_emissive_threshold(new_image, bright_threshold_int);
 
 	return new_image;
 }
 
-void
-vkpt_extract_emissive_texture_info(image_t *image)
+static void
+extract_emissive_texture_info(image_t *image, int arg)
 {
 	int w = image->upload_width;
 	int h = image->upload_height;
@@ -935,7 +936,19 @@ vkpt_extract_emissive_texture_info(image_t *image)
 }
 
 void
-vkpt_normalize_normal_map(image_t *image)
+vkpt_extract_emissive_texture_info(image_t *image)
+{
+	// pixels of images found during a batch are not decoded yet
+	if (IMG_QueuePostProcess(image, "emissive_info", extract_emissive_texture_info, 0)) {
+		image->processing_complete = true;
+		return;
+	}
+
+	extract_emissive_texture_info(image, 0);
+}
+
+static void
+normalize_normal_map(image_t *image, int arg)
 {
     int w = image->upload_width;
     int h = image->upload_height;
@@ -974,6 +987,17 @@ vkpt_normalize_normal_map(image_t *image)
     image->processing_complete = true;
 }
 
+void
+vkpt_normalize_normal_map(image_t *image)
+{
+    if (IMG_QueuePostProcess(image, "normalize", normalize_normal_map, 0)) {
+        image->processing_complete = true;
+        return;
+    }
+
+    normalize_normal_map(image, 0);
+}
+
 void
 IMG_Load_RTX(image_t *image, byte *pic)
 {
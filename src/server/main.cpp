@@ -2088,6 +2088,9 @@ void SV_Shutdown(const char *finalmsg, ErrorType type)
     SV_MasterShutdown();
     SV_ShutdownGameProgs();
 
+    // make sure pending savegames are on disk
+    SV_FlushSaves();
+
     // free current level
     CM_FreeMap(&sv.cm);
     SV_FreeFile(sv.entityString);
@@ -16,6 +16,10 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include "server.h"
 
 #define SAVE_MAGIC1     (('2'<<24)|('V'<<16)|('S'<<8)|'S')  // "SSV2"
@@ -25,15 +29,460 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 #define SAVE_CURRENT    ".current"
 #define SAVE_AUTO       "save0"
 
+#define SAVE_FILES      ".ssv;.sav;.sv2"
+#define MAX_SAVE_SIZE   0x4000000   // sanity limit for inflated files
+
 cvar_t *sv_savedir = NULL;
+static cvar_t *sv_savecompress;
+
+/*
+==============================================================================
+
+BACKGROUND SAVE WRITER
+
+Savegames are serialized into memory on the main thread and queued for the
+save thread, which compresses them and writes them out through a temporary
+file that is then renamed over the target. Directory wipes and copies are
+queued in the same order, so the main thread never waits on the disk unless
+it is about to read a savegame back.
+
+Because every file is replaced by a rename rather than rewritten in place,
+directories are snapshotted by hard linking the files. A later write to the
+source directory gets a new inode and leaves the snapshot untouched.
+
+==============================================================================
+*/
+
+typedef enum {
+    SAVE_JOB_WRITE,     // compress and write out a buffer
+    SAVE_JOB_WIPE,      // remove all savegame files from a directory
+    SAVE_JOB_COPY       // snapshot a directory into another one
+} save_job_type_t;
+
+typedef struct save_job_s {
+    struct save_job_s   *next;
+    save_job_type_t     type;
+    char                path[MAX_OSPATH];   // file or source directory
+    char                dest[MAX_OSPATH];   // destination directory
+    byte                *data;
+    size_t              len;
+    qboolean            compress;
+} save_job_t;
+
+static struct {
+    std::mutex              mutex;
+    std::condition_variable work;       // signaled when jobs are queued
+    std::condition_variable done;       // signaled when the queue drains
+    save_job_t              *head, *tail;
+    int                     pending;    // jobs queued or running
+    qboolean                started;
+    qboolean                queued;     // jobs queued since the last flush
+
+    int                     errors;     // failed jobs not yet reported
+    char                    failed[MAX_OSPATH];
+} sv_save;
+
+#if USE_ZLIB
+// deflates the buffer with a gzip header, returns malloc'ed data or NULL
+static byte *gzip_buffer(const byte *in, size_t inlen, size_t *outlen)
+{
+    z_stream z;
+    byte *out;
+    size_t len;
+
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, Z_BEST_SPEED, Z_DEFLATED, MAX_WBITS + 16,
+                     8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+
+    len = deflateBound(&z, inlen);
+    out = (byte *)malloc(len); // CPP: Cast
+    if (!out) {
+        deflateEnd(&z);
+        return NULL;
+    }
+
+    z.next_in = (Bytef *)in;
+    z.avail_in = inlen;
+    z.next_out = out;
+    z.avail_out = len;
+
+    if (deflate(&z, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&z);
+        free(out);
+        return NULL;
+    }
+
+    *outlen = z.total_out;
+    deflateEnd(&z);
+    return out;
+}
+#endif
+
+static int write_file_atomic(char *path, const byte *data, size_t len, qboolean compress)
+{
+    char    tmp[MAX_OSPATH];
+    byte    *out = NULL;
+    FILE    *fp;
+    int     ret = -1;
+
+    if (Q_concat(tmp, sizeof(tmp), path, ".tmp", NULL) >= sizeof(tmp))
+        return -1;
+
+    if (FS_CreatePath(path))
+        return -1;
 
+#if USE_ZLIB
+    if (compress && (out = gzip_buffer(data, len, &len)) != NULL)
+        data = out;
+#endif
+
+    fp = fopen(tmp, "wb");
+    if (fp) {
+        if (fwrite(data, 1, len, fp) == len)
+            ret = 0;
+        if (fclose(fp))
+            ret = -1;
+    }
+
+    if (!ret) {
+#ifdef _WIN32
+        remove(path);
+#endif
+        if (rename(tmp, path))
+            ret = -1;
+    }
+
+    if (ret)
+        remove(tmp);
+
+    free(out);
+    return ret;
+}
+
+static int copy_file(const char *src, char *dst)
+{
+    byte    buf[0x10000];
+    FILE    *ifp, *ofp;
+    size_t  len, res;
+    int     ret = -1;
+
+    ifp = fopen(src, "rb");
+    if (!ifp)
+        goto fail0;
+
+    if (FS_CreatePath(dst))
+        goto fail1;
+
+    ofp = fopen(dst, "wb");
+    if (!ofp)
+        goto fail1;
+
+    do {
+        len = fread(buf, 1, sizeof(buf), ifp);
+        res = fwrite(buf, 1, len, ofp);
+    } while (len == sizeof(buf) && res == len);
+
+    if (ferror(ifp))
+        goto fail2;
+
+    if (ferror(ofp))
+        goto fail2;
+
+    ret = 0;
+fail2:
+    fclose(ofp);
+fail1:
+    fclose(ifp);
+fail0:
+    return ret;
+}
+
+// makes dst refer to the same data as src, falls back to copying
+static int link_file(const char *src, char *dst)
+{
+    remove(dst);
+
+#ifndef _WIN32
+    if (FS_CreatePath(dst))
+        return -1;
+
+    if (!link(src, dst))
+        return 0;
+#endif
+
+    return copy_file(src, dst);
+}
+
+static int list_save_files(const char *dir, void **files)
+{
+    int count = 0;
+
+    Sys_ListFiles_r(dir, SAVE_FILES, 0, strlen(dir) + 1, &count, files, 0);
+    return count;
+}
+
+static int run_save_job(save_job_t *job)
+{
+    char    src[MAX_OSPATH], dst[MAX_OSPATH];
+    void    *files[MAX_LISTED_FILES];
+    int     i, count, ret = 0;
+
+    switch (job->type) {
+    case SAVE_JOB_WRITE:
+        return write_file_atomic(job->path, job->data, job->len, job->compress);
+
+    case SAVE_JOB_WIPE:
+        count = list_save_files(job->path, files);
+        for (i = 0; i < count; i++) {
+            if (Q_concat(src, sizeof(src), job->path, "/", (char *)files[i], NULL) >= sizeof(src) ||
+                os_unlink(src))
+                ret = -1;
+            Z_Free(files[i]);
+        }
+        return ret;
+
+    case SAVE_JOB_COPY:
+        count = list_save_files(job->path, files);
+        if (!count)
+            return -1;
+        for (i = 0; i < count; i++) {
+            if (Q_concat(src, sizeof(src), job->path, "/", (char *)files[i], NULL) >= sizeof(src) ||
+                Q_concat(dst, sizeof(dst), job->dest, "/", (char *)files[i], NULL) >= sizeof(dst) ||
+                link_file(src, dst))
+                ret = -1;
+            Z_Free(files[i]);
+        }
+        return ret;
+    }
+
+    return -1;
+}
+
+static void save_worker(void)
+{
+    std::unique_lock<std::mutex> lock(sv_save.mutex);
+    save_job_t *job;
+
+    while (1) {
+        if (!(job = sv_save.head)) {
+            sv_save.work.wait(lock);
+            continue;
+        }
+
+        lock.unlock();
+
+        if (run_save_job(job)) {
+            lock.lock();
+            sv_save.errors++;
+            Q_strlcpy(sv_save.failed, job->type == SAVE_JOB_COPY ? job->dest : job->path, sizeof(sv_save.failed));
+            lock.unlock();
+        }
+
+        Z_Free(job->data);
+
+        lock.lock();
+        sv_save.head = job->next;
+        if (!sv_save.head)
+            sv_save.tail = NULL;
+        Z_Free(job);
+
+        if (!--sv_save.pending)
+            sv_save.done.notify_all();
+    }
+}
+
+// prints errors from jobs completed since the last call, main thread only
+static void report_save_errors(void)
+{
+    std::lock_guard<std::mutex> lock(sv_save.mutex);
+
+    if (sv_save.errors) {
+        Com_EPrintf("Couldn't write savegame: %s%s\n", sv_save.failed,
+                    sv_save.errors > 1 ? va(" (and %d more)", sv_save.errors - 1) : "");
+        sv_save.errors = 0;
+    }
+}
+
+static save_job_t *alloc_save_job(save_job_type_t type, const char *dir)
+{
+    save_job_t *job = (save_job_t *)Z_Mallocz(sizeof(*job)); // CPP: Cast
+
+    job->type = type;
+    if (Q_snprintf(job->path, sizeof(job->path), "%s/%s/%s",
+                   fs_gamedir, sv_savedir->string, dir) >= sizeof(job->path)) {
+        Z_Free(job);
+        return NULL;
+    }
+
+    return job;
+}
+
+static void queue_save_job(save_job_t *job)
+{
+    report_save_errors();
+
+    std::lock_guard<std::mutex> lock(sv_save.mutex);
+
+    // detached, so that exiting without a flush doesn't abort
+    if (!sv_save.started) {
+        std::thread(save_worker).detach();
+        sv_save.started = true;
+    }
+
+    if (sv_save.tail)
+        sv_save.tail->next = job;
+    else
+        sv_save.head = job;
+    sv_save.tail = job;
+    sv_save.pending++;
+    sv_save.queued = true;
+    sv_save.work.notify_one();
+}
+
+/*
+==================
+SV_FlushSaves
+
+Waits for all queued savegame writes to hit the disk. Must be called
+before reading anything from the save directory.
+==================
+*/
+void SV_FlushSaves(void)
+{
+    qboolean queued;
+
+    {
+        std::unique_lock<std::mutex> lock(sv_save.mutex);
+
+        while (sv_save.pending)
+            sv_save.done.wait(lock);
+
+        queued = sv_save.queued;
+        sv_save.queued = false;
+    }
+
+    // files were written behind the back of the file system
+    if (queued)
+        FS_InvalidatePathCache();
+
+    report_save_errors();
+}
+
+/*
+==================
+SV_WriteSaveFile
+
+Queues a copy of the buffer to be written to the given system path.
+==================
+*/
+void SV_WriteSaveFile(const char *path, const void *data, size_t len)
+{
+    save_job_t *job = (save_job_t *)Z_Mallocz(sizeof(*job)); // CPP: Cast
+
+    if (Q_strlcpy(job->path, path, sizeof(job->path)) >= sizeof(job->path)) {
+        Com_EPrintf("Savegame path too long: %s\n", path);
+        Z_Free(job);
+        return;
+    }
+
+    job->type = SAVE_JOB_WRITE;
+    job->data = (byte *)Z_Malloc(len); // CPP: Cast
+    memcpy(job->data, data, len);
+    job->len = len;
+    job->compress = sv_savecompress->integer;
+
+    queue_save_job(job);
+}
+
+/*
+==================
+SV_ReadSaveFile
+
+Loads the file at the given system path into a Z_Malloc'ed buffer,
+transparently inflating compressed savegames. Waits for pending writes.
+==================
+*/
+ssize_t SV_ReadSaveFile(const char *path, void **data)
+{
+    FILE    *fp;
+    byte    *buf;
+    long    len;
+
+    *data = NULL;
+
+    SV_FlushSaves();
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return Q_ERR_NOENT;
+
+    if (fseek(fp, 0, SEEK_END) || (len = ftell(fp)) < 0 || len > MAX_SAVE_SIZE || fseek(fp, 0, SEEK_SET)) {
+        fclose(fp);
+        return Q_ERR_FAILURE;
+    }
+
+    buf = (byte *)Z_Malloc(len + 1); // CPP: Cast
+    if (fread(buf, 1, len, fp) != (size_t)len) {
+        fclose(fp);
+        Z_Free(buf);
+        return Q_ERR_UNEXPECTED_EOF;
+    }
+    fclose(fp);
+
+#if USE_ZLIB
+    if (len >= 18 && buf[0] == 0x1f && buf[1] == 0x8b) {
+        // uncompressed length is stored in the gzip trailer
+        size_t outlen = buf[len - 4] | (buf[len - 3] << 8) | (buf[len - 2] << 16) | ((size_t)buf[len - 1] << 24);
+        byte *out;
+        z_stream z;
+        int ret;
+
+        if (outlen > MAX_SAVE_SIZE) {
+            Z_Free(buf);
+            return Q_ERR_INVALID_FORMAT;
+        }
+
+        out = (byte *)Z_Malloc(outlen + 1); // CPP: Cast
+
+        memset(&z, 0, sizeof(z));
+        if (inflateInit2(&z, MAX_WBITS + 16) != Z_OK) {
+            Z_Free(out);
+            Z_Free(buf);
+            return Q_ERR_FAILURE;
+        }
+
+        z.next_in = buf;
+        z.avail_in = len;
+        z.next_out = out;
+        z.avail_out = outlen;
+        ret = inflate(&z, Z_FINISH);
+        inflateEnd(&z);
+        Z_Free(buf);
+
+        if (ret != Z_STREAM_END || z.total_out != outlen) {
+            Z_Free(out);
+            return Q_ERR_INFLATE_FAILED;
+        }
+
+        buf = out;
+        len = outlen;
+    }
+#endif
+
+    buf[len] = 0;
+    *data = buf;
+    return len;
+}
+
+//==============================================================================
 
 static int write_server_file(qboolean autosave)
 {
     char        name[MAX_OSPATH];
     cvar_t      *var;
     size_t      len;
-    qerror_t    ret;
     uint64_t    timeStamp;
 
     // write magic
@@ -64,12 +513,14 @@ static int write_server_file(qboolean autosave)
     MSG_WriteString(NULL);
 
     // write server state
-	Q_snprintf(name, MAX_OSPATH, "%s/%s/server.ssv", sv_savedir->string, SAVE_CURRENT);
-    ret = FS_WriteFile(name, msg_write.data, msg_write.currentSize);
+    len = Q_snprintf(name, MAX_OSPATH,
+                     "%s/%s/%s/server.ssv", fs_gamedir, sv_savedir->string, SAVE_CURRENT);
+    if (len < MAX_OSPATH)
+        SV_WriteSaveFile(name, msg_write.data, msg_write.currentSize);
 
     SZ_Clear(&msg_write);
 
-    if (ret < 0)
+    if (len >= MAX_OSPATH)
         return -1;
 
     // write game state
@@ -89,7 +540,6 @@ static int write_level_file(void)
     char        *s;
     size_t      len;
     byte        portalbits[MAX_MAP_PORTAL_BYTES];
-    qerror_t    ret;
 
     // write magic
     MSG_WriteLong(SAVE_MAGIC2);
@@ -115,15 +565,14 @@ static int write_level_file(void)
     MSG_WriteByte(len);
     MSG_WriteData(portalbits, len);
 
-    len = Q_snprintf(name, MAX_QPATH, "%s/%s/%s.sv2", sv_savedir->string, SAVE_CURRENT, sv.name);
-    if (len >= MAX_QPATH)
-        ret = -1;
-    else
-        ret = FS_WriteFile(name, msg_write.data, msg_write.currentSize);
+    len = Q_snprintf(name, MAX_OSPATH,
+                     "%s/%s/%s/%s.sv2", fs_gamedir, sv_savedir->string, SAVE_CURRENT, sv.name);
+    if (len < MAX_OSPATH)
+        SV_WriteSaveFile(name, msg_write.data, msg_write.currentSize);
 
     SZ_Clear(&msg_write);
 
-    if (ret < 0)
+    if (len >= MAX_OSPATH)
         return -1;
 
     // write game level
@@ -136,141 +585,70 @@ static int write_level_file(void)
     return 0;
 }
 
-static int copy_file(const char *src, const char *dst, const char *name)
-{
-    char    path[MAX_OSPATH];
-    byte    buf[0x10000];
-    FILE    *ifp, *ofp;
-    size_t  len, res;
-    int     ret = -1;
-
-    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, src, name);
-    if (len >= MAX_OSPATH)
-        goto fail0;
-
-    ifp = fopen(path, "rb");
-    if (!ifp)
-        goto fail0;
-
-    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dst, name);
-    if (len >= MAX_OSPATH)
-        goto fail1;
-
-    if (FS_CreatePath(path))
-        goto fail1;
-
-    ofp = fopen(path, "wb");
-    if (!ofp)
-        goto fail1;
-
-    do {
-        len = fread(buf, 1, sizeof(buf), ifp);
-        res = fwrite(buf, 1, len, ofp);
-    } while (len == sizeof(buf) && res == len);
-
-    if (ferror(ifp))
-        goto fail2;
-
-    if (ferror(ofp))
-        goto fail2;
-
-    ret = 0;
-fail2:
-    fclose(ofp);
-fail1:
-    fclose(ifp);
-fail0:
-    return ret;
-}
-
-static int remove_file(const char *dir, const char *name)
-{
-    char path[MAX_OSPATH];
-    size_t len;
-
-    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/%s", fs_gamedir, sv_savedir->string, dir, name);
-    if (len >= MAX_OSPATH)
-        return -1;
-
-    return remove(path);
-}
-
-static void **list_save_dir(const char *dir, int *count)
-{
-    return FS_ListFiles(va("%s/%s", sv_savedir->string, dir), ".ssv;.sav;.sv2",
-        FS_TYPE_REAL | FS_PATH_GAME, count);
-}
-
 static int wipe_save_dir(const char *dir)
 {
-    void **list;
-    int i, count, ret = 0;
+    save_job_t *job = alloc_save_job(SAVE_JOB_WIPE, dir);
 
-    if ((list = list_save_dir(dir, &count)) == NULL)
-        return 0;
-
-    for (i = 0; i < count; i++)
-        ret |= remove_file(dir, (const char*)list[i]); // CPP: Cast
+    if (!job)
+        return -1;
 
-    FS_FreeList(list);
-    return ret;
+    queue_save_job(job);
+    return 0;
 }
 
 static int copy_save_dir(const char *src, const char *dst)
 {
-    void **list;
-    int i, count, ret = 0;
+    save_job_t *job = alloc_save_job(SAVE_JOB_COPY, src);
 
-    if ((list = list_save_dir(src, &count)) == NULL)
+    if (!job)
         return -1;
 
-    for (i = 0; i < count; i++)
-        ret |= copy_file(src, dst, (const char*)list[i]); // CPP: Cast
+    if (Q_snprintf(job->dest, sizeof(job->dest), "%s/%s/%s",
+                   fs_gamedir, sv_savedir->string, dst) >= sizeof(job->dest)) {
+        Z_Free(job);
+        return -1;
+    }
 
-    FS_FreeList(list);
-    return ret;
+    queue_save_job(job);
+    return 0;
 }
 
 static int read_binary_file(const char *name)
 {
-    qhandle_t f;
-    size_t len;
+    void *data;
+    ssize_t len;
 
-    len = FS_FOpenFile(name, &f, FS_MODE_READ | FS_TYPE_REAL | FS_PATH_GAME);
-    if (!f)
+    len = SV_ReadSaveFile(name, &data);
+    if (len < 0)
         return -1;
 
-    if (len > MAX_MSGLEN)
-        goto fail;
+    if (len > MAX_MSGLEN) {
+        Z_Free(data);
+        return -1;
+    }
 
-    if (FS_Read(msg_read_buffer, len, f) != len)
-        goto fail;
+    memcpy(msg_read_buffer, data, len);
+    Z_Free(data);
 
     SZ_Init(&msg_read, msg_read_buffer, len);
     msg_read.currentSize = len;
-
-    FS_FCloseFile(f);
     return 0;
-
-fail:
-    FS_FCloseFile(f);
-    return -1;
 }
 
 char *SV_GetSaveInfo(const char *dir)
 {
-    char        name[MAX_QPATH], date[MAX_QPATH];
+    char        path[MAX_OSPATH], name[MAX_QPATH], date[MAX_QPATH];
     size_t      len;
     uint64_t    timeStamp;
     int         autosave, year;
     time_t      t;
     struct tm   *tm;
 
-    len = Q_snprintf(name, MAX_QPATH, "%s/%s/server.ssv", sv_savedir->string, dir);
-    if (len >= MAX_QPATH)
+    len = Q_snprintf(path, MAX_OSPATH, "%s/%s/%s/server.ssv", fs_gamedir, sv_savedir->string, dir);
+    if (len >= MAX_OSPATH)
         return NULL;
 
-    if (read_binary_file(name))
+    if (read_binary_file(path))
         return NULL;
 
     if (MSG_ReadLong() != SAVE_MAGIC1)
@@ -322,7 +700,11 @@ static int read_server_file(void)
     // errors like missing file, bad version, etc are
     // non-fatal and just return to the command handler
 
-	Q_snprintf(name, MAX_OSPATH, "%s/%s/server.ssv", sv_savedir->string, SAVE_CURRENT);
+    len = Q_snprintf(name, MAX_OSPATH,
+                     "%s/%s/%s/server.ssv", fs_gamedir, sv_savedir->string, SAVE_CURRENT);
+    if (len >= MAX_OSPATH)
+        return -1;
+
     if (read_binary_file(name))
         return -1;
 
@@ -402,8 +784,9 @@ static int read_level_file(void)
     size_t  len, maxlen;
     int     index;
 
-    len = Q_snprintf(name, MAX_QPATH, "%s/%s/%s.sv2", sv_savedir->string, SAVE_CURRENT, sv.name);
-    if (len >= MAX_QPATH)
+    len = Q_snprintf(name, MAX_OSPATH,
+                     "%s/%s/%s/%s.sv2", fs_gamedir, sv_savedir->string, SAVE_CURRENT, sv.name);
+    if (len >= MAX_OSPATH)
         return -1;
 
     if (read_binary_file(name))
@@ -595,6 +978,7 @@ static void SV_Loadgame_f(void)
     }
 
     // make sure the server files exist
+    SV_FlushSaves();
     if (!FS_FileExistsEx(va("%s/%s/server.ssv", sv_savedir->string, dir), FS_TYPE_REAL | FS_PATH_GAME) ||
         !FS_FileExistsEx(va("%s/%s/game.ssv", sv_savedir->string, dir), FS_TYPE_REAL | FS_PATH_GAME)) {
         Com_Printf ("No such savegame: %s\n", dir);
@@ -694,4 +1078,5 @@ void SV_RegisterSavegames(void)
 {
     Cmd_Register(c_savegames);
 	sv_savedir = Cvar_Get("sv_savedir", "save", 0);
+    sv_savecompress = Cvar_Get("sv_savecompress", "1", 0);
 }
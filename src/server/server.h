@@ -607,6 +607,9 @@ void SV_AutoSaveEnd(void);
 void SV_CheckForSavegame(MapCommand *cmd);
 void SV_RegisterSavegames(void);
 int SV_NoSaveGames(void);
+void SV_FlushSaves(void);
+void SV_WriteSaveFile(const char *path, const void *data, size_t len);
+ssize_t SV_ReadSaveFile(const char *path, void **data);
 
 //============================================================
 
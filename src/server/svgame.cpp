@@ -920,6 +920,8 @@ void SV_InitGameProgs(void)
     importAPI.StuffCmd = PF_stuffcmd;
 
     importAPI.DebugGraph = PF_DebugGraph;
+    importAPI.WriteSaveFile = SV_WriteSaveFile;
+    importAPI.ReadSaveFile = SV_ReadSaveFile;
     importAPI.SetAreaPortalState = PF_SetAreaPortalState;
     importAPI.AreasConnected = PF_AreasConnected;
 
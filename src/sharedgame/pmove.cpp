@@ -21,10 +21,11 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 //
 // Implements the player movement logic for both client and server game modules
 // 
-// The playerMoveLocals_t structure is used locally when processing the movement. Consider it
-// a temporary structure. The prev origin and velocity are copied in there for storage.
+// The PlayerMoveContext structure is used locally when processing the movement. Consider it
+// a temporary structure. The prev origin and velocity are copied in there for storage. It is
+// passed along explicitly, so PMove is reentrant and may run on several threads at once.
 // 
-// At the start of pmove we initialize certain pm-> variables, and the playerMoveLocals.
+// At the start of pmove we initialize certain pm-> variables, and the context locals.
 // 
 // After that, we check for whether we are on a ladder, ducking, on-ground, in-water,
 // and/or in air. We execute the right movement according to that.
@@ -115,31 +116,36 @@ constexpr float PM_STEP_HEIGHT_MIN = 4.f;  // The smallest step that will be int
 constexpr float PM_STEP_NORMAL = 0.7f; // The minimum Z plane normal component required for standing.
 
 //--------------------------------------------------
-// Pointer to the actual (client-/npc-)entity PlayerMove(PM) structure.
+// Working state of a single PMove run. It lives on the stack of PMove and is
+// handed to every movement function explicitly, so that any number of moves
+// can run at the same time, as long as their collision callbacks allow it.
 //--------------------------------------------------
-static PlayerMove* pm;
+struct PlayerMoveContext {
+    // Pointer to the actual (client-/npc-)entity PlayerMove(PM) structure.
+    PlayerMove *pm;
 
-//--------------------------------------------------
-// all of the locals will be zeroed before each
-// pmove, just to make damn sure we don't have
-// any differences when running on client or server
-//--------------------------------------------------
-static struct {
-    vec3_t      origin;
-    vec3_t      velocity;
+    //--------------------------------------------------
+    // all of the locals will be zeroed before each
+    // pmove, just to make damn sure we don't have
+    // any differences when running on client or server
+    //--------------------------------------------------
+    struct {
+        vec3_t      origin;
+        vec3_t      velocity;
 
-    vec3_t      forward, right, up;
-    vec3_t      forwardXY, rightXY;
+        vec3_t      forward, right, up;
+        vec3_t      forwardXY, rightXY;
 
-    float       frameTime;
+        float       frameTime;
 
-    vec3_t      previousOrigin;
-    vec3_t      previousVelocity;
-    qboolean    isClimbingLadder;
+        vec3_t      previousOrigin;
+        vec3_t      previousVelocity;
+        qboolean    isClimbingLadder;
 
-    // Ground trace results.
-    trace_t groundTrace;
-} playerMoveLocals;
+        // Ground trace results.
+        trace_t groundTrace;
+    } locals;
+};
 
 //
 // PM_MINS and PM_MAXS are the default bounding box, scaled by PM_SCALE
@@ -264,7 +270,7 @@ static vec3_t PM_ClipVelocity(const vec3_t in, const vec3_t normal, float bounce
 // Marks the specified entity as touched.
 //===============
 //
-static void PM_TouchEntity(struct entity_s* ent) {
+static void PM_TouchEntity(PlayerMoveContext &ctx, struct entity_s* ent) {
     // Ensure it is valid.
     if (ent == NULL) {
         PM_Debug("ent = NULL");
@@ -272,9 +278,9 @@ static void PM_TouchEntity(struct entity_s* ent) {
     }
 
     // Only touch entity if we aren't at the maximum limit yet.
-    if (pm->numTouchedEntities < PM_MAX_TOUCH_ENTS && ent) {
-        pm->touchedEntities[pm->numTouchedEntities] = ent;
-        pm->numTouchedEntities++;
+    if (ctx.pm->numTouchedEntities < PM_MAX_TOUCH_ENTS && ent) {
+        ctx.pm->touchedEntities[ctx.pm->numTouchedEntities] = ent;
+        ctx.pm->numTouchedEntities++;
     }
     else {
         // Developer print.
@@ -297,11 +303,11 @@ static void PM_TouchEntity(struct entity_s* ent) {
 // Check whether the player just stepped off of something, or not.
 //===============
 //
-static bool PM_CheckStep(const trace_t * trace) {
+static bool PM_CheckStep(PlayerMoveContext &ctx, const trace_t * trace) {
 
     if (!trace->allSolid) {
         if (trace->ent && trace->plane.normal.z >= PM_STEP_NORMAL) {
-            if (trace->ent != pm->groundEntityPtr || trace->plane.dist != playerMoveLocals.groundTrace.plane.dist) {
+            if (trace->ent != ctx.pm->groundEntityPtr || trace->plane.dist != ctx.locals.groundTrace.plane.dist) {
                 return true;
 
                 PM_Debug("PM_CheckStep: true");
@@ -319,10 +325,10 @@ static bool PM_CheckStep(const trace_t * trace) {
 // Steps the player down, for slope/stair handling.
 //===============
 //
-static void PM_StepDown(const trace_t * trace) {
+static void PM_StepDown(PlayerMoveContext &ctx, const trace_t * trace) {
     // Calculate step height.
-    pm->state.origin = trace->endPosition;
-    pm->step = pm->state.origin.z - playerMoveLocals.previousOrigin.z;
+    ctx.pm->state.origin = trace->endPosition;
+    ctx.pm->step = ctx.pm->state.origin.z - ctx.locals.previousOrigin.z;
 
     PM_Debug("PM_StepDown");
 }
@@ -336,7 +342,7 @@ static void PM_StepDown(const trace_t * trace) {
 // Returns the actual trace.
 //===============
 //
-const trace_t PM_TraceCorrectAllSolid(const vec3_t & start, const vec3_t & mins, const vec3_t & maxs, const vec3_t & end) {
+static const trace_t PM_TraceCorrectAllSolid(PlayerMoveContext &ctx, const vec3_t & start, const vec3_t & mins, const vec3_t & maxs, const vec3_t & end) {
     // Disabled, for this we have no need. It seems to work fine at this moment without it.
     // Not getting stuck into rotating objects or what have we....
     //
@@ -345,7 +351,7 @@ const trace_t PM_TraceCorrectAllSolid(const vec3_t & start, const vec3_t & mins,
     // 
     // And otherwise, we got this solution below, which... is seemingly slow in certain cases...
 #if 0
-    return pm->Trace(start, mins, maxs, end);
+    return ctx.pm->Trace(start, mins, maxs, end);
 #else
     const vec3_t offsets = { 0.f, 1.f, -1.f };
 
@@ -361,7 +367,7 @@ const trace_t PM_TraceCorrectAllSolid(const vec3_t & start, const vec3_t & mins,
                 };
 
                 // Execute trace.
-                const trace_t trace = pm->Trace(point, mins, maxs, end);
+                const trace_t trace = ctx.pm->Trace(point, mins, maxs, end);
 
                 if (!trace.allSolid) {
 
@@ -378,7 +384,7 @@ const trace_t PM_TraceCorrectAllSolid(const vec3_t & start, const vec3_t & mins,
     }
 
     PM_Debug("No good position");
-    return pm->Trace(start, mins, maxs, end);
+    return ctx.pm->Trace(start, mins, maxs, end);
 #endif
 }
 
@@ -413,25 +419,25 @@ static bool PM_ImpactPlane(vec3_t * planes, int32_t num_planes, const vec3_t & p
 //
 #define MIN_STEP_NORMAL 0.7     // can't step up onto very steep slopes
 #define MAX_CLIP_PLANES 6
-static qboolean PM_StepSlideMove_(void)
+static qboolean PM_StepSlideMove_(PlayerMoveContext &ctx)
 {
     const int32_t numBumps = MAX_CLIP_PLANES - 2;
     vec3_t planes[MAX_CLIP_PLANES];
     int32_t bump;
 
-    float timeRemaining = playerMoveLocals.frameTime;
+    float timeRemaining = ctx.locals.frameTime;
     int32_t numPlanes = 0;
 
     // never turn against our ground plane
-    if (pm->state.flags & PMF_ON_GROUND) {
-        planes[numPlanes] = playerMoveLocals.groundTrace.plane.normal;
+    if (ctx.pm->state.flags & PMF_ON_GROUND) {
+        planes[numPlanes] = ctx.locals.groundTrace.plane.normal;
         numPlanes++;
     }
 
-    vec3_t primal_velocity = pm->state.velocity;
+    vec3_t primal_velocity = ctx.pm->state.velocity;
 
     // or our original velocity
-    planes[numPlanes] = vec3_normalize(pm->state.velocity);
+    planes[numPlanes] = vec3_normalize(ctx.pm->state.velocity);
     numPlanes++;
 
     for (bump = 0; bump < numBumps; bump++) {
@@ -440,20 +446,20 @@ static qboolean PM_StepSlideMove_(void)
         }
 
         // project desired destination
-        vec3_t pos = vec3_fmaf(pm->state.origin, timeRemaining, pm->state.velocity);
+        vec3_t pos = vec3_fmaf(ctx.pm->state.origin, timeRemaining, ctx.pm->state.velocity);
 
         // trace to it
-        const trace_t trace = PM_TraceCorrectAllSolid(pm->state.origin, pm->mins, pm->maxs, pos);
+        const trace_t trace = PM_TraceCorrectAllSolid(ctx, ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, pos);
 
         // if the player is trapped in a solid, don't build up Z
         if (trace.allSolid) {
-            pm->state.velocity.z = 0.0f;
+            ctx.pm->state.velocity.z = 0.0f;
             return true;
         }
 
         // if the trace succeeded, move some distance
         if (trace.fraction > (FLT_EPSILON - 1.0f)) {
-            pm->state.origin = trace.endPosition;
+            ctx.pm->state.origin = trace.endPosition;
 
             // if the trace didn't hit anything, we're done
             if (trace.fraction == 1.0f) {
@@ -465,7 +471,7 @@ static qboolean PM_StepSlideMove_(void)
         }
 
         // store a reference to the entity for firing game events
-        PM_TouchEntity(trace.ent);
+        PM_TouchEntity(ctx, trace.ent);
 
         // record the impacted plane, or nudge velocity out along it
         if (PM_ImpactPlane(planes, numPlanes, trace.plane.normal)) {
@@ -474,7 +480,7 @@ static qboolean PM_StepSlideMove_(void)
         }
         else {
             // if we've seen this plane before, nudge our velocity out along it
-            pm->state.velocity += trace.plane.normal;
+            ctx.pm->state.velocity += trace.plane.normal;
             continue;
         }
 
@@ -483,12 +489,12 @@ static qboolean PM_StepSlideMove_(void)
             vec3_t vel;
 
             // if velocity doesn't impact this plane, skip it
-            if (vec3_dot(pm->state.velocity, planes[i]) > (FLT_EPSILON - 1.0f)) {
+            if (vec3_dot(ctx.pm->state.velocity, planes[i]) > (FLT_EPSILON - 1.0f)) {
                 continue;
             }
 
             // slide along the plane
-            vel = PM_ClipVelocity(pm->state.velocity, planes[i], PM_CLIP_BOUNCE);
+            vel = PM_ClipVelocity(ctx.pm->state.velocity, planes[i], PM_CLIP_BOUNCE);
 
             // see if there is a second plane that the new move enters
             for (int32_t j = 0; j < numPlanes; j++) {
@@ -515,7 +521,7 @@ static qboolean PM_StepSlideMove_(void)
                 cross = vec3_cross(planes[i], planes[j]);
                 cross = vec3_normalize(cross);
 
-                const float scale = vec3_dot(cross, pm->state.velocity);
+                const float scale = vec3_dot(cross, ctx.pm->state.velocity);
                 vel = vec3_scale(cross, scale);
 
                 // see if there is a third plane the the new move enters
@@ -530,13 +536,13 @@ static qboolean PM_StepSlideMove_(void)
                     }
 
                     // stop dead at a triple plane interaction
-                    pm->state.velocity = vec3_zero();
+                    ctx.pm->state.velocity = vec3_zero();
                     return true;
                 }
             }
 
             // if we have fixed all interactions, try another move
-            pm->state.velocity = vel;
+            ctx.pm->state.velocity = vel;
             break;
         }
     }
@@ -551,50 +557,50 @@ static qboolean PM_StepSlideMove_(void)
 // Executes the slide movement.
 //===============
 //
-static void PM_StepSlideMove(void)
+static void PM_StepSlideMove(PlayerMoveContext &ctx)
 {
     // Store pre-move parameters
-    const vec3_t org0 = pm->state.origin;
-    const vec3_t vel0 = pm->state.velocity;
+    const vec3_t org0 = ctx.pm->state.origin;
+    const vec3_t vel0 = ctx.pm->state.velocity;
 
     // Attempt to move; if nothing blocks us, we're done
-    PM_StepSlideMove_();
+    PM_StepSlideMove_(ctx);
 
     // Attempt to step down to remain on ground
-    if ((pm->state.flags & PMF_ON_GROUND) && pm->moveCommand.input.upMove <= 0) {
-        const vec3_t down = vec3_fmaf(pm->state.origin, PM_STEP_HEIGHT + PM_GROUND_DIST, vec3_down());
-        const trace_t downTrace = PM_TraceCorrectAllSolid(pm->state.origin, pm->mins, pm->maxs, down);
+    if ((ctx.pm->state.flags & PMF_ON_GROUND) && ctx.pm->moveCommand.input.upMove <= 0) {
+        const vec3_t down = vec3_fmaf(ctx.pm->state.origin, PM_STEP_HEIGHT + PM_GROUND_DIST, vec3_down());
+        const trace_t downTrace = PM_TraceCorrectAllSolid(ctx, ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, down);
 
-        if (PM_CheckStep(&downTrace)) {
-            PM_StepDown(&downTrace);
+        if (PM_CheckStep(ctx, &downTrace)) {
+            PM_StepDown(ctx, &downTrace);
         }
     }
 
     // If we are blocked, we will try to step over the obstacle.
-    const vec3_t org1 = pm->state.origin;
-    const vec3_t vel1 = pm->state.velocity;
+    const vec3_t org1 = ctx.pm->state.origin;
+    const vec3_t vel1 = ctx.pm->state.velocity;
 
     const vec3_t up = vec3_fmaf(org0, PM_STEP_HEIGHT, vec3_up());
-    const trace_t upTrace = PM_TraceCorrectAllSolid(org0, pm->mins, pm->maxs, up);
+    const trace_t upTrace = PM_TraceCorrectAllSolid(ctx, org0, ctx.pm->mins, ctx.pm->maxs, up);
 
     if (!upTrace.allSolid) {
         // Step from the higher position, with the original velocity
-        pm->state.origin = upTrace.endPosition;
-        pm->state.velocity = vel0;
+        ctx.pm->state.origin = upTrace.endPosition;
+        ctx.pm->state.velocity = vel0;
 
-        PM_StepSlideMove_();
+        PM_StepSlideMove_(ctx);
 
         // Settle to the new ground, keeping the step if and only if it was successful
-        const vec3_t down = vec3_fmaf(pm->state.origin, PM_STEP_HEIGHT + PM_GROUND_DIST, vec3_down());
-        const trace_t downTrace = PM_TraceCorrectAllSolid(pm->state.origin, pm->mins, pm->maxs, down);
+        const vec3_t down = vec3_fmaf(ctx.pm->state.origin, PM_STEP_HEIGHT + PM_GROUND_DIST, vec3_down());
+        const trace_t downTrace = PM_TraceCorrectAllSolid(ctx, ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, down);
 
-        if (PM_CheckStep(&downTrace)) {
+        if (PM_CheckStep(ctx, &downTrace)) {
             // Quake2 trick jump secret sauce
-            if ((pm->state.flags & PMF_ON_GROUND) || vel0.z < PM_SPEED_UP) {
-                PM_StepDown(&downTrace);
+            if ((ctx.pm->state.flags & PMF_ON_GROUND) || vel0.z < PM_SPEED_UP) {
+                PM_StepDown(ctx, &downTrace);
             }
             else {
-                pm->step = pm->state.origin.z - playerMoveLocals.previousOrigin.z;
+                ctx.pm->step = ctx.pm->state.origin.z - ctx.locals.previousOrigin.z;
             }
 
             return;
@@ -602,8 +608,8 @@ static void PM_StepSlideMove(void)
     }
 
     // Save end results.
-    pm->state.origin = org1;
-    pm->state.velocity = vel1;
+    ctx.pm->state.origin = org1;
+    ctx.pm->state.velocity = vel1;
 }
 
 //
@@ -621,13 +627,13 @@ static void PM_StepSlideMove(void)
 // impact the ground on this frame, false otherwise.
 //===============
 //
-static qboolean PM_CheckTrickJump(void) {
+static qboolean PM_CheckTrickJump(PlayerMoveContext &ctx) {
     // False in the following conditions.
-    if (pm->groundEntityPtr) { return false; }
-    if (playerMoveLocals.previousVelocity.z < PM_SPEED_UP) { return false; }
-    if (pm->moveCommand.input.upMove < 1) { return false; }
-    if (pm->state.flags & PMF_JUMP_HELD) { return false; }
-    if (pm->state.flags & PMF_TIME_MASK) { return false; }
+    if (ctx.pm->groundEntityPtr) { return false; }
+    if (ctx.locals.previousVelocity.z < PM_SPEED_UP) { return false; }
+    if (ctx.pm->moveCommand.input.upMove < 1) { return false; }
+    if (ctx.pm->state.flags & PMF_JUMP_HELD) { return false; }
+    if (ctx.pm->state.flags & PMF_TIME_MASK) { return false; }
 
     // True otherwise :)
     return true;
@@ -642,24 +648,24 @@ static qboolean PM_CheckTrickJump(void) {
 // Returns true if a jump occurs, false otherwise.
 //===============
 //
-static qboolean PM_CheckJump(void) {
+static qboolean PM_CheckJump(PlayerMoveContext &ctx) {
     PM_Debug("PM_CheckJump");
 
     // Before allowing a new jump:
     // 1. Wait for landing damage to subside.
-    if (pm->state.flags & PMF_TIME_LAND) {
+    if (ctx.pm->state.flags & PMF_TIME_LAND) {
         PM_Debug("PM_CheckJump - PMF_TIME_LAND");
         return false;
     }
 
     // 2. Wait for jump key to be released
-    if (pm->state.flags & PMF_JUMP_HELD) {
+    if (ctx.pm->state.flags & PMF_JUMP_HELD) {
         PM_Debug("PM_CheckJump - PMF_JUMP_HELD");
         return false;
     }
 
     // 3. Check if, they didn't ask to jump.
-    if (pm->moveCommand.input.upMove < 1) {
+    if (ctx.pm->moveCommand.input.upMove < 1) {
         PM_Debug("PM_CheckJump - UPMOVE");
         return false;
     }
@@ -668,38 +674,38 @@ static qboolean PM_CheckJump(void) {
     float jump = PM_SPEED_JUMP;
 
     // Factor in water level, modulate jump force based on that.
-    if (pm->waterLevel > WaterLevel::Feet) {
+    if (ctx.pm->waterLevel > WaterLevel::Feet) {
         jump *= PM_SPEED_JUMP_MOD_WATER;
     }
 
     // Add in the trick jump if eligible
-    if (pm->state.flags & PMF_TIME_TRICK_JUMP) {
+    if (ctx.pm->state.flags & PMF_TIME_TRICK_JUMP) {
         jump += PM_SPEED_TRICK_JUMP;
 
-        pm->state.flags &= ~PMF_TIME_TRICK_JUMP;
-        pm->state.time = 0;
+        ctx.pm->state.flags &= ~PMF_TIME_TRICK_JUMP;
+        ctx.pm->state.time = 0;
 
-        PM_Debug("Trick jump: %i", pm->moveCommand.input.upMove);
+        PM_Debug("Trick jump: %i", ctx.pm->moveCommand.input.upMove);
     } else {
-        PM_Debug("Jump: %i", pm->moveCommand.input.upMove);
+        PM_Debug("Jump: %i", ctx.pm->moveCommand.input.upMove);
     }
 
-    if (pm->state.velocity.z < 0.0f) {
-        pm->state.velocity.z = jump;
+    if (ctx.pm->state.velocity.z < 0.0f) {
+        ctx.pm->state.velocity.z = jump;
     } else {
-        pm->state.velocity.z += jump;
+        ctx.pm->state.velocity.z += jump;
     }
 
     // indicate that jump is currently held
-    pm->state.flags |= (PMF_JUMPED | PMF_JUMP_HELD);
+    ctx.pm->state.flags |= (PMF_JUMPED | PMF_JUMP_HELD);
 
     // clear the ground indicators
-    pm->state.flags &= ~PMF_ON_GROUND;
-    pm->groundEntityPtr = NULL;
+    ctx.pm->state.flags &= ~PMF_ON_GROUND;
+    ctx.pm->groundEntityPtr = NULL;
 
     // we can trick jump soon
-    pm->state.flags |= PMF_TIME_TRICK_START;
-    pm->state.time = 100;
+    ctx.pm->state.flags |= PMF_TIME_TRICK_START;
+    ctx.pm->state.time = 100;
 
     return true;
 }
@@ -709,30 +715,30 @@ static qboolean PM_CheckJump(void) {
 // PM_CheckDuck
 //
 // Sets the wished for values to crouch:
-// pm->mins, pm->maxs, and pm->viewHeight
+// ctx.pm->mins, ctx.pm->maxs, and ctx.pm->viewHeight
 //===============
 //
-static void PM_CheckDuck(void) {
+static void PM_CheckDuck(PlayerMoveContext &ctx) {
     // Any state after dead, can be checked for here.
-    if (pm->state.type >= EnginePlayerMoveType::Dead) {
-        if (pm->state.type == EnginePlayerMoveType::Gib) {
-            pm->state.viewOffset.z = 0.0f;
+    if (ctx.pm->state.type >= EnginePlayerMoveType::Dead) {
+        if (ctx.pm->state.type == EnginePlayerMoveType::Gib) {
+            ctx.pm->state.viewOffset.z = 0.0f;
         } else {
-            pm->state.viewOffset.z = -16.0f;
+            ctx.pm->state.viewOffset.z = -16.0f;
         }
         // Other states go here :)
     } else {
 
-        const qboolean is_ducking = pm->state.flags & PMF_DUCKED;
-        const qboolean wants_ducking = (pm->moveCommand.input.upMove < 0) && !(playerMoveLocals.isClimbingLadder);
+        const qboolean is_ducking = ctx.pm->state.flags & PMF_DUCKED;
+        const qboolean wants_ducking = (ctx.pm->moveCommand.input.upMove < 0) && !(ctx.locals.isClimbingLadder);
 
         if (!is_ducking && wants_ducking) {
-            pm->state.flags |= PMF_DUCKED;
+            ctx.pm->state.flags |= PMF_DUCKED;
         } else if (is_ducking && !wants_ducking) {
-            const trace_t trace = pm->Trace(pm->state.origin, pm->mins, pm->maxs, pm->state.origin);
+            const trace_t trace = ctx.pm->Trace(ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, ctx.pm->state.origin);
 
             if (!trace.allSolid && !trace.startSolid) {
-                pm->state.flags &= ~PMF_DUCKED;
+                ctx.pm->state.flags &= ~PMF_DUCKED;
             }
         }
 
@@ -743,42 +749,42 @@ static void PM_CheckDuck(void) {
         // aren't at the top of your skull either.
         // 
         // Considering games == faking effects to get a nice real feel... Here we go.
-        const float height = pm->maxs.z - pm->mins.z;
+        const float height = ctx.pm->maxs.z - ctx.pm->mins.z;
 
-        if (pm->state.flags & PMF_DUCKED) {
+        if (ctx.pm->state.flags & PMF_DUCKED) {
             // A nice view height value.
-            const float targetViewHeight = pm->mins.z + height * 0.5f;
+            const float targetViewHeight = ctx.pm->mins.z + height * 0.5f;
 
             // LERP it.
-            if (pm->state.viewOffset.z > targetViewHeight) { // go down
-                pm->state.viewOffset.z -= playerMoveLocals.frameTime * PM_SPEED_DUCK_STAND;
+            if (ctx.pm->state.viewOffset.z > targetViewHeight) { // go down
+                ctx.pm->state.viewOffset.z -= ctx.locals.frameTime * PM_SPEED_DUCK_STAND;
             }
 
-            if (pm->state.viewOffset.z < targetViewHeight) {
-                pm->state.viewOffset.z = targetViewHeight;
+            if (ctx.pm->state.viewOffset.z < targetViewHeight) {
+                ctx.pm->state.viewOffset.z = targetViewHeight;
             }
 
             // Change the actual bounding box to reflect ducking
-            pm->maxs.z = pm->maxs.z + pm->mins.z * 0.66f;
+            ctx.pm->maxs.z = ctx.pm->maxs.z + ctx.pm->mins.z * 0.66f;
         }
         else {
             // A nice view height value.
-            const float targetViewHeight = pm->mins.z + (height - 6) * 0.9f;
+            const float targetViewHeight = ctx.pm->mins.z + (height - 6) * 0.9f;
 
             // LERP it.
-            if (pm->state.viewOffset.z < targetViewHeight) { // go up
-                pm->state.viewOffset.z += playerMoveLocals.frameTime * PM_SPEED_DUCK_STAND;
+            if (ctx.pm->state.viewOffset.z < targetViewHeight) { // go up
+                ctx.pm->state.viewOffset.z += ctx.locals.frameTime * PM_SPEED_DUCK_STAND;
             }
 
-            if (pm->state.viewOffset.z > targetViewHeight) {
-                pm->state.viewOffset.z = targetViewHeight;
+            if (ctx.pm->state.viewOffset.z > targetViewHeight) {
+                ctx.pm->state.viewOffset.z = targetViewHeight;
             }
 
             // No need to change the bounding box, it has already been initialized at the start of the frame.
         }
     }
 
-    pm->state.viewOffset = pm->state.viewOffset;
+    ctx.pm->state.viewOffset = ctx.pm->state.viewOffset;
 }
 
 
@@ -790,26 +796,26 @@ static void PM_CheckDuck(void) {
 // Returns true if the player is on a isClimbingLadder.
 //===============
 //
-static qboolean PM_CheckLadder(void) {
+static qboolean PM_CheckLadder(PlayerMoveContext &ctx) {
     // If any time mask flag is set, return.
-    if (pm->state.flags & PMF_TIME_MASK) {
+    if (ctx.pm->state.flags & PMF_TIME_MASK) {
         return false;
     }
 
     // Calculate a trace for determining whether there is a isClimbingLadder in front of us.
-    const vec3_t pos = vec3_fmaf(pm->state.origin, 1, playerMoveLocals.forwardXY);
-    const trace_t trace = pm->Trace(pm->state.origin, pm->mins, pm->maxs, pos);
+    const vec3_t pos = vec3_fmaf(ctx.pm->state.origin, 1, ctx.locals.forwardXY);
+    const trace_t trace = ctx.pm->Trace(ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, pos);
 
     // Found one, engage isClimbingLadder state.
     if ((trace.fraction < 1.0f) && (trace.contents & CONTENTS_LADDER)) {
         // Add isClimbingLadder flag.
-        pm->state.flags |= PMF_ON_LADDER;
+        ctx.pm->state.flags |= PMF_ON_LADDER;
 
         // No ground entity, obviously.
-        pm->groundEntityPtr = NULL;
+        ctx.pm->groundEntityPtr = NULL;
 
         // Remove ducked and possible ON_GROUND flags.
-        pm->state.flags &= ~(PMF_ON_GROUND | PMF_DUCKED);
+        ctx.pm->state.flags &= ~(PMF_ON_GROUND | PMF_DUCKED);
 
         return true;
     }
@@ -827,27 +833,27 @@ static qboolean PM_CheckLadder(void) {
 // Returns true if a water jump has occurred, false otherwise.
 //===============
 //
-static qboolean PM_CheckWaterJump(void) {
-    if (pm->state.flags & PMF_TIME_WATER_JUMP) {
+static qboolean PM_CheckWaterJump(PlayerMoveContext &ctx) {
+    if (ctx.pm->state.flags & PMF_TIME_WATER_JUMP) {
         return false;
     }
 
-    if (pm->waterLevel != WaterLevel::Waist) {
+    if (ctx.pm->waterLevel != WaterLevel::Waist) {
         return false;
     }
 
-    if (pm->moveCommand.input.upMove < 1 && pm->moveCommand.input.forwardMove < 1) {
+    if (ctx.pm->moveCommand.input.upMove < 1 && ctx.pm->moveCommand.input.forwardMove < 1) {
         return false;
     }
 
-    vec3_t pos = vec3_fmaf(pm->state.origin, 16.f, playerMoveLocals.forward);
-    trace_t trace = PM_TraceCorrectAllSolid(pm->state.origin, pm->mins, pm->maxs, pos);
+    vec3_t pos = vec3_fmaf(ctx.pm->state.origin, 16.f, ctx.locals.forward);
+    trace_t trace = PM_TraceCorrectAllSolid(ctx, ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, pos);
 
     if ((trace.fraction < 1.0f) && (trace.contents & CONTENTS_MASK_SOLID)) {
 
-        pos.z += PM_STEP_HEIGHT + pm->maxs.z - pm->mins.z;
+        pos.z += PM_STEP_HEIGHT + ctx.pm->maxs.z - ctx.pm->mins.z;
 
-        trace = PM_TraceCorrectAllSolid(pos, pm->mins, pm->maxs, pos);
+        trace = PM_TraceCorrectAllSolid(ctx, pos, ctx.pm->mins, ctx.pm->maxs, pos);
 
         if (trace.startSolid) {
             PM_Debug("Can't exit water: Blocked");
@@ -857,10 +863,10 @@ static qboolean PM_CheckWaterJump(void) {
         vec3_t position2 = {
             pos.x,
             pos.y,
-            pm->state.origin.z
+            ctx.pm->state.origin.z
         };
 
-        trace = PM_TraceCorrectAllSolid(pos, pm->mins, pm->maxs, position2);
+        trace = PM_TraceCorrectAllSolid(ctx, pos, ctx.pm->mins, ctx.pm->maxs, position2);
 
         if (!(trace.ent && trace.plane.normal.z >= PM_STEP_NORMAL)) {
             PM_Debug("Can't exit water: not a step\n");
@@ -868,11 +874,11 @@ static qboolean PM_CheckWaterJump(void) {
         }
 
         // Set up water velocity.
-        pm->state.velocity.z = PM_SPEED_WATER_JUMP;
+        ctx.pm->state.velocity.z = PM_SPEED_WATER_JUMP;
 
         // Set up the time state, JUMP == HELD, WATER JUMPING == ACTIVE
-        pm->state.flags |= PMF_TIME_WATER_JUMP | PMF_JUMP_HELD;
-        pm->state.time = 2000; // 2 seconds.
+        ctx.pm->state.flags |= PMF_TIME_WATER_JUMP | PMF_JUMP_HELD;
+        ctx.pm->state.time = 2000; // 2 seconds.
 
         return true;
     }
@@ -887,47 +893,47 @@ static qboolean PM_CheckWaterJump(void) {
 // Checks for water interaction, accounting for player ducking, etc.
 //===============
 //
-static void PM_CheckWater(void) {
+static void PM_CheckWater(PlayerMoveContext &ctx) {
     // When checking for water level we first reset all to defaults for this frame.
-    pm->waterLevel = WaterLevel::None;
-    pm->waterType = 0;
+    ctx.pm->waterLevel = WaterLevel::None;
+    ctx.pm->waterType = 0;
 
     // Create the position for testing.
     vec3_t contentPosition = {
-        pm->state.origin.x,
-        pm->state.origin.y,
+        ctx.pm->state.origin.x,
+        ctx.pm->state.origin.y,
         // Pick the mins bounding box Z, PM_GROUND_DIST and add it to our current Z to use for testing.
         // (This should give us about the feet pos)
-        pm->state.origin.z + pm->mins.z + PM_GROUND_DIST
+        ctx.pm->state.origin.z + ctx.pm->mins.z + PM_GROUND_DIST
     };
 
     // Perform the actual test.
-    int32_t contents = pm->PointContents(contentPosition);
+    int32_t contents = ctx.pm->PointContents(contentPosition);
 
     // Are we in liquid? Hallelujah!
     if (contents & CONTENTS_MASK_LIQUID) {
         // Watertype is whichever ocntents type we are in with at least our feet.
-        pm->waterType = contents;
-        pm->waterLevel = WaterLevel::Feet;
+        ctx.pm->waterType = contents;
+        ctx.pm->waterLevel = WaterLevel::Feet;
 
-        contentPosition.z = pm->state.origin.z;
+        contentPosition.z = ctx.pm->state.origin.z;
 
-        contents = pm->PointContents(contentPosition);
+        contents = ctx.pm->PointContents(contentPosition);
 
         if (contents & CONTENTS_MASK_LIQUID) {
 
-            pm->waterType |= contents;
-            pm->waterLevel = WaterLevel::Waist;
+            ctx.pm->waterType |= contents;
+            ctx.pm->waterLevel = WaterLevel::Waist;
 
-            contentPosition.z = pm->state.origin.z + pm->state.viewOffset.z + 1.0f;
+            contentPosition.z = ctx.pm->state.origin.z + ctx.pm->state.viewOffset.z + 1.0f;
 
-            contents = pm->PointContents(contentPosition);
+            contents = ctx.pm->PointContents(contentPosition);
 
             if (contents & CONTENTS_MASK_LIQUID) {
-                pm->waterType |= contents;
-                pm->waterLevel = WaterLevel::Under;
+                ctx.pm->waterType |= contents;
+                ctx.pm->waterLevel = WaterLevel::Under;
 
-                pm->state.flags |= PMF_UNDER_WATER;
+                ctx.pm->state.flags |= PMF_UNDER_WATER;
             }
         }
     }
@@ -940,77 +946,77 @@ static void PM_CheckWater(void) {
 // Checks for ground interaction, enabling trick jumpingand dealing with landings.
 //===============
 //
-static void PM_CheckGround(void) {
+static void PM_CheckGround(PlayerMoveContext &ctx) {
     // If we jumped, or been pushed, do not attempt to seek ground
-    if (pm->state.flags & (PMF_JUMPED | PMF_TIME_PUSHED | PMF_ON_LADDER)) {
+    if (ctx.pm->state.flags & (PMF_JUMPED | PMF_TIME_PUSHED | PMF_ON_LADDER)) {
         return;
     }
 
     // Seek ground eagerly in case the player wishes to trick jump
-    const qboolean trick_jump = PM_CheckTrickJump();
+    const qboolean trick_jump = PM_CheckTrickJump(ctx);
     vec3_t pos;
 
     if (trick_jump) {
-        pos = vec3_fmaf(pm->state.origin, playerMoveLocals.frameTime, pm->state.velocity);
+        pos = vec3_fmaf(ctx.pm->state.origin, ctx.locals.frameTime, ctx.pm->state.velocity);
         pos.z -= PM_GROUND_DIST_TRICK;
     } else {
-        pos = pm->state.origin;
+        pos = ctx.pm->state.origin;
         pos.z -= PM_GROUND_DIST;
     }
 
     // Seek the ground
-    trace_t trace = playerMoveLocals.groundTrace = PM_TraceCorrectAllSolid(pm->state.origin, pm->mins, pm->maxs, pos);
+    trace_t trace = ctx.locals.groundTrace = PM_TraceCorrectAllSolid(ctx, ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, pos);
 
     // If we hit an upward facing plane, make it our ground
     if (trace.ent && trace.plane.normal.z >= PM_STEP_NORMAL) {
 
         // If we had no ground, then handle landing events
-        if (!pm->groundEntityPtr) {
+        if (!ctx.pm->groundEntityPtr) {
 
             // Any landing terminates the water jump
-            if (pm->state.flags & PMF_TIME_WATER_JUMP) {
-                pm->state.flags &= ~PMF_TIME_WATER_JUMP;
-                pm->state.time = 0;
+            if (ctx.pm->state.flags & PMF_TIME_WATER_JUMP) {
+                ctx.pm->state.flags &= ~PMF_TIME_WATER_JUMP;
+                ctx.pm->state.time = 0;
             }
 
             // Hard landings disable jumping briefly
-            if (playerMoveLocals.previousVelocity.z <= PM_SPEED_LAND) {
-                pm->state.flags |= PMF_TIME_LAND;
-                pm->state.time = 1;
+            if (ctx.locals.previousVelocity.z <= PM_SPEED_LAND) {
+                ctx.pm->state.flags |= PMF_TIME_LAND;
+                ctx.pm->state.time = 1;
 
-                if (playerMoveLocals.previousVelocity.z <= PM_SPEED_FALL) {
-                    pm->state.time = 16;
+                if (ctx.locals.previousVelocity.z <= PM_SPEED_FALL) {
+                    ctx.pm->state.time = 16;
 
-                    if (playerMoveLocals.previousVelocity.z <= PM_SPEED_FALL_FAR) {
-                        pm->state.time = 256;
+                    if (ctx.locals.previousVelocity.z <= PM_SPEED_FALL_FAR) {
+                        ctx.pm->state.time = 256;
                     }
                 }
             } else {
                 // Soft landings with upward momentum grant trick jumps
                 if (trick_jump) {
-                    pm->state.flags |= PMF_TIME_TRICK_JUMP;
-                    pm->state.time = 32;
+                    ctx.pm->state.flags |= PMF_TIME_TRICK_JUMP;
+                    ctx.pm->state.time = 32;
                 }
             }
         }
 
         // Save a reference to the ground
-        pm->state.flags |= PMF_ON_GROUND;
-        pm->groundEntityPtr = trace.ent;
+        ctx.pm->state.flags |= PMF_ON_GROUND;
+        ctx.pm->groundEntityPtr = trace.ent;
 
         // Sink down to it if not trick jumping
-        if (!(pm->state.flags & PMF_TIME_TRICK_JUMP)) {
-            pm->state.origin = trace.endPosition;
+        if (!(ctx.pm->state.flags & PMF_TIME_TRICK_JUMP)) {
+            ctx.pm->state.origin = trace.endPosition;
 
-            pm->state.velocity = PM_ClipVelocity(pm->state.velocity, trace.plane.normal, PM_CLIP_BOUNCE);
+            ctx.pm->state.velocity = PM_ClipVelocity(ctx.pm->state.velocity, trace.plane.normal, PM_CLIP_BOUNCE);
         }
     } else {
-        pm->state.flags &= ~PMF_ON_GROUND;
-        pm->groundEntityPtr = NULL;
+        ctx.pm->state.flags &= ~PMF_ON_GROUND;
+        ctx.pm->groundEntityPtr = NULL;
     }
 
     // Always touch the entity, even if we couldn't stand on it
-    PM_TouchEntity(trace.ent);
+    PM_TouchEntity(ctx, trace.ent);
 }
 
 
@@ -1029,17 +1035,17 @@ static void PM_CheckGround(void) {
 // Handles friction against user intentions, and based on contents.
 //===============
 //
-static void PM_Friction(void) {
-    vec3_t vel = pm->state.velocity;
+static void PM_Friction(PlayerMoveContext &ctx) {
+    vec3_t vel = ctx.pm->state.velocity;
 
-    if (pm->state.flags & PMF_ON_GROUND) {
+    if (ctx.pm->state.flags & PMF_ON_GROUND) {
         vel.z = 0.0;
     }
 
     const float speed = vec3_length(vel);
 
     if (speed < 1.0f) {
-        pm->state.velocity.x = pm->state.velocity.y = 0.0f;
+        ctx.pm->state.velocity.x = ctx.pm->state.velocity.y = 0.0f;
         return;
     }
 
@@ -1048,17 +1054,17 @@ static void PM_Friction(void) {
     float friction = 0.0;
 
     // SPECTATOR friction
-    if (pm->state.type == PlayerMoveType::Spectator|| pm->state.type == PlayerMoveType::Noclip) {
+    if (ctx.pm->state.type == PlayerMoveType::Spectator|| ctx.pm->state.type == PlayerMoveType::Noclip) {
         friction = PM_FRICT_SPECTATOR;
         // LADDER friction
-    } else if (pm->state.flags & PMF_ON_LADDER) {
+    } else if (ctx.pm->state.flags & PMF_ON_LADDER) {
         friction = PM_FRICT_LADDER;
         // WATER friction.
-    } else if (pm->waterLevel > WaterLevel::Feet) {
+    } else if (ctx.pm->waterLevel > WaterLevel::Feet) {
         friction = PM_FRICT_WATER;
         // GROUND friction.
-    } else if (pm->state.flags & PMF_ON_GROUND) {
-        if (playerMoveLocals.groundTrace.surface && (playerMoveLocals.groundTrace.surface->flags & SURF_SLICK)) {
+    } else if (ctx.pm->state.flags & PMF_ON_GROUND) {
+        if (ctx.locals.groundTrace.surface && (ctx.locals.groundTrace.surface->flags & SURF_SLICK)) {
             friction = PM_FRICT_GROUND_SLICK;
         } else {
             friction = PM_FRICT_GROUND;
@@ -1069,9 +1075,9 @@ static void PM_Friction(void) {
     }
 
     // scale the velocity, taking care to not reverse direction
-    const float scale = Maxf(0.0, speed - (friction * control * playerMoveLocals.frameTime)) / speed;
+    const float scale = Maxf(0.0, speed - (friction * control * ctx.locals.frameTime)) / speed;
 
-    pm->state.velocity = vec3_scale(pm->state.velocity, scale);
+    ctx.pm->state.velocity = vec3_scale(ctx.pm->state.velocity, scale);
 }
 
 //
@@ -1081,21 +1087,21 @@ static void PM_Friction(void) {
 // Returns the newly user intended velocity
 //===============
 //
-static void PM_Accelerate(const vec3_t & dir, float speed, float acceleration) {
-    const float currentSpeed = vec3_dot(pm->state.velocity, dir);
+static void PM_Accelerate(PlayerMoveContext &ctx, const vec3_t & dir, float speed, float acceleration) {
+    const float currentSpeed = vec3_dot(ctx.pm->state.velocity, dir);
     const float add_speed = speed - currentSpeed;
 
     if (add_speed <= 0.0f) {
         return;
     }
 
-    float accel_speed = acceleration * playerMoveLocals.frameTime * speed;
+    float accel_speed = acceleration * ctx.locals.frameTime * speed;
 
     if (accel_speed > add_speed) {
         accel_speed = add_speed;
     }
 
-    pm->state.velocity = vec3_fmaf(pm->state.velocity, accel_speed, dir);
+    ctx.pm->state.velocity = vec3_fmaf(ctx.pm->state.velocity, accel_speed, dir);
 }
 
 //
@@ -1105,14 +1111,14 @@ static void PM_Accelerate(const vec3_t & dir, float speed, float acceleration) {
 // Applies gravity to the current movement.
 //===============
 //
-static void PM_Gravity(void) {
-    float gravity = pm->state.gravity;
+static void PM_Gravity(PlayerMoveContext &ctx) {
+    float gravity = ctx.pm->state.gravity;
 
-    if (pm->waterLevel > WaterLevel::Waist) {
+    if (ctx.pm->waterLevel > WaterLevel::Waist) {
         gravity *= PM_GRAVITY_WATER;
     }
 
-    pm->state.velocity.z -= gravity * playerMoveLocals.frameTime;
+    ctx.pm->state.velocity.z -= gravity * ctx.locals.frameTime;
 }
 
 
@@ -1124,50 +1130,50 @@ static void PM_Gravity(void) {
 // conveyor belts.
 //===============
 //
-static void PM_ApplyCurrents(void) {
+static void PM_ApplyCurrents(PlayerMoveContext &ctx) {
     // Start off with 0 currents.
     vec3_t current = vec3_zero();
 
     // add water currents
-    if (pm->waterLevel) {
-        if (pm->waterType & CONTENTS_CURRENT_0) {
+    if (ctx.pm->waterLevel) {
+        if (ctx.pm->waterType & CONTENTS_CURRENT_0) {
             current.x += 1.0;
         }
-        if (pm->waterType & CONTENTS_CURRENT_90) {
+        if (ctx.pm->waterType & CONTENTS_CURRENT_90) {
             current.y += 1.0;
         }
-        if (pm->waterType & CONTENTS_CURRENT_180) {
+        if (ctx.pm->waterType & CONTENTS_CURRENT_180) {
             current.x -= 1.0;
         }
-        if (pm->waterType & CONTENTS_CURRENT_270) {
+        if (ctx.pm->waterType & CONTENTS_CURRENT_270) {
             current.y -= 1.0;
         }
-        if (pm->waterType & CONTENTS_CURRENT_UP) {
+        if (ctx.pm->waterType & CONTENTS_CURRENT_UP) {
             current.z += 1.0;
         }
-        if (pm->waterType & CONTENTS_CURRENT_DOWN) {
+        if (ctx.pm->waterType & CONTENTS_CURRENT_DOWN) {
             current.z -= 1.0;
         }
     }
 
     // add conveyer belt velocities
-    if (pm->groundEntityPtr) {
-        if (playerMoveLocals.groundTrace.contents & CONTENTS_CURRENT_0) {
+    if (ctx.pm->groundEntityPtr) {
+        if (ctx.locals.groundTrace.contents & CONTENTS_CURRENT_0) {
             current.x += 1.0;
         }
-        if (playerMoveLocals.groundTrace.contents & CONTENTS_CURRENT_90) {
+        if (ctx.locals.groundTrace.contents & CONTENTS_CURRENT_90) {
             current.y += 1.0;
         }
-        if (playerMoveLocals.groundTrace.contents & CONTENTS_CURRENT_180) {
+        if (ctx.locals.groundTrace.contents & CONTENTS_CURRENT_180) {
             current.x -= 1.0;
         }
-        if (playerMoveLocals.groundTrace.contents & CONTENTS_CURRENT_270) {
+        if (ctx.locals.groundTrace.contents & CONTENTS_CURRENT_270) {
             current.y -= 1.0;
         }
-        if (playerMoveLocals.groundTrace.contents & CONTENTS_CURRENT_UP) {
+        if (ctx.locals.groundTrace.contents & CONTENTS_CURRENT_UP) {
             current.z += 1.0;
         }
-        if (playerMoveLocals.groundTrace.contents & CONTENTS_CURRENT_DOWN) {
+        if (ctx.locals.groundTrace.contents & CONTENTS_CURRENT_DOWN) {
             current.z -= 1.0;
         }
     }
@@ -1176,7 +1182,7 @@ static void PM_ApplyCurrents(void) {
         current = vec3_normalize(current);
     }
 
-    pm->state.velocity = vec3_fmaf(pm->state.velocity, PM_SPEED_CURRENT, current);
+    ctx.pm->state.velocity = vec3_fmaf(ctx.pm->state.velocity, PM_SPEED_CURRENT, current);
 }
 
 
@@ -1194,17 +1200,17 @@ static void PM_ApplyCurrents(void) {
 // Called when the player is climbing a isClimbingLadder.
 //===============
 //
-static void PM_LadderMove(void) {
-    //PM_Debug("%s", Vec3ToString(pm->state.origin));
+static void PM_LadderMove(PlayerMoveContext &ctx) {
+    //PM_Debug("%s", Vec3ToString(ctx.pm->state.origin));
 
-    PM_Friction();
+    PM_Friction(ctx);
 
-    PM_ApplyCurrents();
+    PM_ApplyCurrents(ctx);
 
     // user intentions in X/Y
     vec3_t vel = vec3_zero();
-    vel = vec3_fmaf(vel, pm->moveCommand.input.forwardMove, playerMoveLocals.forwardXY);
-    vel = vec3_fmaf(vel, pm->moveCommand.input.rightMove, playerMoveLocals.rightXY);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.forwardMove, ctx.locals.forwardXY);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.rightMove, ctx.locals.rightXY);
 
     const float s = PM_SPEED_LADDER * 0.125f;
 
@@ -1214,18 +1220,18 @@ static void PM_LadderMove(void) {
     vel.z = 0.f;
 
     // handle Z intentions differently
-    if (std::fabsf(pm->state.velocity.z) < PM_SPEED_LADDER) {
+    if (std::fabsf(ctx.pm->state.velocity.z) < PM_SPEED_LADDER) {
 
-        if ((pm->viewAngles.x <= -15.0f) && (pm->moveCommand.input.forwardMove > 0)) {
+        if ((ctx.pm->viewAngles.x <= -15.0f) && (ctx.pm->moveCommand.input.forwardMove > 0)) {
             vel.z = PM_SPEED_LADDER;
         }
-        else if ((pm->viewAngles.x >= 15.0f) && (pm->moveCommand.input.forwardMove > 0)) {
+        else if ((ctx.pm->viewAngles.x >= 15.0f) && (ctx.pm->moveCommand.input.forwardMove > 0)) {
             vel.z = -PM_SPEED_LADDER;
         }
-        else if (pm->moveCommand.input.upMove > 0) {
+        else if (ctx.pm->moveCommand.input.upMove > 0) {
             vel.z = PM_SPEED_LADDER;
         }
-        else if (pm->moveCommand.input.upMove < 0) {
+        else if (ctx.pm->moveCommand.input.upMove < 0) {
             vel.z = -PM_SPEED_LADDER;
         }
         else {
@@ -1233,8 +1239,8 @@ static void PM_LadderMove(void) {
         }
     }
 
-    if (pm->moveCommand.input.upMove > 0) { // avoid jumps when exiting ladders
-        pm->state.flags |= PMF_JUMP_HELD;
+    if (ctx.pm->moveCommand.input.upMove > 0) { // avoid jumps when exiting ladders
+        ctx.pm->state.flags |= PMF_JUMP_HELD;
     }
 
     float speed;
@@ -1245,9 +1251,9 @@ static void PM_LadderMove(void) {
         speed = 0.0;
     }
 
-    PM_Accelerate(dir, speed, PM_ACCEL_LADDER);
+    PM_Accelerate(ctx, dir, speed, PM_ACCEL_LADDER);
 
-    PM_StepSlideMove();
+    PM_StepSlideMove(ctx);
 }
 
 //
@@ -1257,28 +1263,28 @@ static void PM_LadderMove(void) {
 // Called when the player is jumping out of the water to a solid.
 //===============
 //
-static void PM_WaterJumpMove(void) {
-    //PM_Debug("%s\n", Vec3ToString(pm->state.origin));
+static void PM_WaterJumpMove(PlayerMoveContext &ctx) {
+    //PM_Debug("%s\n", Vec3ToString(ctx.pm->state.origin));
 
-    PM_Friction();
+    PM_Friction(ctx);
 
-    PM_Gravity();
+    PM_Gravity(ctx);
 
     // check for a usable spot directly in front of us
-    const vec3_t pos = vec3_fmaf(pm->state.origin, 30.f, playerMoveLocals.forwardXY);
+    const vec3_t pos = vec3_fmaf(ctx.pm->state.origin, 30.f, ctx.locals.forwardXY);
 
     // if we've reached a usable spot, clamp the jump to avoid launching
-    if (PM_TraceCorrectAllSolid(pm->state.origin, pm->mins, pm->maxs, pos).fraction == 1.0f) {
-        pm->state.velocity.z = Clampf(pm->state.velocity.z, 0.f, PM_SPEED_JUMP);
+    if (PM_TraceCorrectAllSolid(ctx, ctx.pm->state.origin, ctx.pm->mins, ctx.pm->maxs, pos).fraction == 1.0f) {
+        ctx.pm->state.velocity.z = Clampf(ctx.pm->state.velocity.z, 0.f, PM_SPEED_JUMP);
     }
 
     // if we're falling back down, clear the timer to regain control
-    if (pm->state.velocity.z <= 0.0f) {
-        pm->state.flags &= ~PMF_TIME_MASK;
-        pm->state.time = 0;
+    if (ctx.pm->state.velocity.z <= 0.0f) {
+        ctx.pm->state.flags &= ~PMF_TIME_MASK;
+        ctx.pm->state.time = 0;
     }
 
-    PM_StepSlideMove();
+    PM_StepSlideMove(ctx);
 }
 
 //
@@ -1288,47 +1294,47 @@ static void PM_WaterJumpMove(void) {
 // Called for movements where player is in the water
 //===============
 //
-static void PM_WaterMove(void) {
+static void PM_WaterMove(PlayerMoveContext &ctx) {
 
-    if (PM_CheckWaterJump()) {
-        PM_WaterJumpMove();
+    if (PM_CheckWaterJump(ctx)) {
+        PM_WaterJumpMove(ctx);
         return;
     }
 
-    //PM_Debug("%s\n", Vec3ToString(pm->state.origin));
+    //PM_Debug("%s\n", Vec3ToString(ctx.pm->state.origin));
 
     // Apply friction, slowing rapidly when first entering the water
-	float speed = vec3_length(pm->state.velocity);
+	float speed = vec3_length(ctx.pm->state.velocity);
 
 	for (int32_t i = speed / PM_SPEED_WATER; i >= 0; i--) {
-		PM_Friction();
+		PM_Friction(ctx);
 	}
 
     // And sink if idle
-    if (!pm->moveCommand.input.forwardMove && !pm->moveCommand.input.rightMove && !pm->moveCommand.input.upMove) {
-        if (pm->state.velocity.z > PM_SPEED_WATER_SINK) {
-            PM_Gravity();
+    if (!ctx.pm->moveCommand.input.forwardMove && !ctx.pm->moveCommand.input.rightMove && !ctx.pm->moveCommand.input.upMove) {
+        if (ctx.pm->state.velocity.z > PM_SPEED_WATER_SINK) {
+            PM_Gravity(ctx);
         }
     }
 
     // Apply currents.
-    PM_ApplyCurrents();
+    PM_ApplyCurrents(ctx);
 
     // user intentions on X/Y/Z
     vec3_t vel = vec3_zero();
-    vel = vec3_fmaf(vel, pm->moveCommand.input.forwardMove, playerMoveLocals.forward);
-    vel = vec3_fmaf(vel, pm->moveCommand.input.rightMove, playerMoveLocals.right);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.forwardMove, ctx.locals.forward);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.rightMove, ctx.locals.right);
 
     // add explicit Z
-    vel.z += pm->moveCommand.input.upMove;
+    vel.z += ctx.pm->moveCommand.input.upMove;
 
     // disable water skiing
-    if (pm->waterLevel == WaterLevel::Waist) {
-        vec3_t view = pm->state.origin + pm->state.viewOffset;
+    if (ctx.pm->waterLevel == WaterLevel::Waist) {
+        vec3_t view = ctx.pm->state.origin + ctx.pm->state.viewOffset;
         view.z -= 4.0;
 
-        if (!(pm->PointContents(view) & CONTENTS_MASK_LIQUID)) {
-            pm->state.velocity.z = Minf(pm->state.velocity.z, 0.0);
+        if (!(ctx.pm->PointContents(view) & CONTENTS_MASK_LIQUID)) {
+            ctx.pm->state.velocity.z = Minf(ctx.pm->state.velocity.z, 0.0);
             vel.z = Minf(vel.z, 0.0);
         }
     }
@@ -1340,13 +1346,13 @@ static void PM_WaterMove(void) {
         speed = 0.0;
     }
 
-    PM_Accelerate(dir, speed, PM_ACCEL_WATER);
+    PM_Accelerate(ctx, dir, speed, PM_ACCEL_WATER);
 
-    if (pm->moveCommand.input.upMove > 0) {
-        PM_StepSlideMove_();
+    if (ctx.pm->moveCommand.input.upMove > 0) {
+        PM_StepSlideMove_(ctx);
     }
     else {
-        PM_StepSlideMove();
+        PM_StepSlideMove(ctx);
     }
 }
 
@@ -1357,23 +1363,23 @@ static void PM_WaterMove(void) {
 // Called for movements where player is in air.
 //===============
 //
-static void PM_AirMove(void) {
+static void PM_AirMove(PlayerMoveContext &ctx) {
 
-    //PM_Debug("%s", Vec3ToString(pm->state.origin));
+    //PM_Debug("%s", Vec3ToString(ctx.pm->state.origin));
 
-    PM_Friction();
+    PM_Friction(ctx);
 
-    PM_Gravity();
+    PM_Gravity(ctx);
 
     vec3_t vel = vec3_zero();
-    vel = vec3_fmaf(vel, pm->moveCommand.input.forwardMove, playerMoveLocals.forwardXY);
-    vel = vec3_fmaf(vel, pm->moveCommand.input.rightMove, playerMoveLocals.rightXY);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.forwardMove, ctx.locals.forwardXY);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.rightMove, ctx.locals.rightXY);
     vel.z = 0.f;
 
     float max_speed = PM_SPEED_AIR;
 
     // Accounting for walk modulus
-    if (pm->moveCommand.input.buttons & BUTTON_WALK) {
+    if (ctx.pm->moveCommand.input.buttons & BUTTON_WALK) {
         max_speed *= PM_SPEED_MOD_WALK;
     }
 
@@ -1387,13 +1393,13 @@ static void PM_AirMove(void) {
 
     float acceleration = PM_ACCEL_AIR;
 
-    if (pm->state.flags & PMF_DUCKED) {
+    if (ctx.pm->state.flags & PMF_DUCKED) {
         acceleration *= PM_ACCEL_AIR_MOD_DUCKED;
     }
 
-    PM_Accelerate(dir, speed, acceleration);
+    PM_Accelerate(ctx, dir, speed, acceleration);
 
-    PM_StepSlideMove();
+    PM_StepSlideMove(ctx);
 }
 
 //
@@ -1403,32 +1409,32 @@ static void PM_AirMove(void) {
 // Called for movements where player is on ground, regardless of water level.
 //===============
 //
-static void PM_WalkMove(void) {
+static void PM_WalkMove(PlayerMoveContext &ctx) {
     // Check for beginning of a jump
-    if (PM_CheckJump()) {
-        PM_AirMove();
+    if (PM_CheckJump(ctx)) {
+        PM_AirMove(ctx);
         return;
     }
 
-    PM_Friction();
+    PM_Friction(ctx);
 
-    PM_ApplyCurrents();
+    PM_ApplyCurrents(ctx);
 
     // Project the desired movement into the X/Y plane
-    const vec3_t forward = vec3_normalize(PM_ClipVelocity(playerMoveLocals.forwardXY, playerMoveLocals.groundTrace.plane.normal, PM_CLIP_BOUNCE));
-    const vec3_t right = vec3_normalize(PM_ClipVelocity(playerMoveLocals.rightXY, playerMoveLocals.groundTrace.plane.normal, PM_CLIP_BOUNCE));
+    const vec3_t forward = vec3_normalize(PM_ClipVelocity(ctx.locals.forwardXY, ctx.locals.groundTrace.plane.normal, PM_CLIP_BOUNCE));
+    const vec3_t right = vec3_normalize(PM_ClipVelocity(ctx.locals.rightXY, ctx.locals.groundTrace.plane.normal, PM_CLIP_BOUNCE));
 
     vec3_t vel = vec3_zero();
-    vel = vec3_fmaf(vel, pm->moveCommand.input.forwardMove, forward);
-    vel = vec3_fmaf(vel, pm->moveCommand.input.rightMove, right);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.forwardMove, forward);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.rightMove, right);
 
     float max_speed;
 
     // Clamp to max speed
-    if (pm->waterLevel > WaterLevel::Feet) {
+    if (ctx.pm->waterLevel > WaterLevel::Feet) {
         max_speed = PM_SPEED_WATER;
     }
-    else if (pm->state.flags & PMF_DUCKED) {
+    else if (ctx.pm->state.flags & PMF_DUCKED) {
         max_speed = PM_SPEED_DUCKED;
     }
     else {
@@ -1436,7 +1442,7 @@ static void PM_WalkMove(void) {
     }
 
     // Accounting for walk modulus
-    if (pm->moveCommand.input.buttons & BUTTON_WALK) {
+    if (ctx.pm->moveCommand.input.buttons & BUTTON_WALK) {
         max_speed *= PM_SPEED_MOD_WALK;
     }
 
@@ -1450,23 +1456,23 @@ static void PM_WalkMove(void) {
     }
 
     // Accelerate based on slickness of ground surface
-    const float acceleration = (playerMoveLocals.groundTrace.surface->flags & SURF_SLICK) ? PM_ACCEL_GROUND_SLICK : PM_ACCEL_GROUND;
+    const float acceleration = (ctx.locals.groundTrace.surface->flags & SURF_SLICK) ? PM_ACCEL_GROUND_SLICK : PM_ACCEL_GROUND;
 
-    PM_Accelerate(dir, speed, acceleration);
+    PM_Accelerate(ctx, dir, speed, acceleration);
 
     // Determine the speed after acceleration
-    speed = vec3_length(pm->state.velocity);
+    speed = vec3_length(ctx.pm->state.velocity);
 
     // Clip to the ground
-    pm->state.velocity = PM_ClipVelocity(pm->state.velocity, playerMoveLocals.groundTrace.plane.normal, PM_CLIP_BOUNCE);
+    ctx.pm->state.velocity = PM_ClipVelocity(ctx.pm->state.velocity, ctx.locals.groundTrace.plane.normal, PM_CLIP_BOUNCE);
 
     // And now scale by the speed to avoid slowing down on slopes
-    pm->state.velocity = vec3_normalize(pm->state.velocity);
-    pm->state.velocity = vec3_scale(pm->state.velocity, speed);
+    ctx.pm->state.velocity = vec3_normalize(ctx.pm->state.velocity);
+    ctx.pm->state.velocity = vec3_scale(ctx.pm->state.velocity, speed);
 
     // And finally, step if moving in X/Y
-    if (pm->state.velocity.x || pm->state.velocity.y) {
-        PM_StepSlideMove();
+    if (ctx.pm->state.velocity.x || ctx.pm->state.velocity.y) {
+        PM_StepSlideMove(ctx);
     }
 }
 
@@ -1477,18 +1483,18 @@ static void PM_WalkMove(void) {
 // Handles special isSpectator movement.
 //===============
 //
-static void PM_SpectatorMove(void) {
-    //PM_Debug("%s", Vec3ToString(pm->state.origin));
+static void PM_SpectatorMove(PlayerMoveContext &ctx) {
+    //PM_Debug("%s", Vec3ToString(ctx.pm->state.origin));
 
-    PM_Friction();
+    PM_Friction(ctx);
 
     // User intentions on X/Y/Z
     vec3_t vel = vec3_zero();
-    vel = vec3_fmaf(vel, pm->moveCommand.input.forwardMove, playerMoveLocals.forward);
-    vel = vec3_fmaf(vel, pm->moveCommand.input.rightMove, playerMoveLocals.right);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.forwardMove, ctx.locals.forward);
+    vel = vec3_fmaf(vel, ctx.pm->moveCommand.input.rightMove, ctx.locals.right);
 
     // Add explicit Z
-    vel.z += pm->moveCommand.input.upMove;
+    vel.z += ctx.pm->moveCommand.input.upMove;
 
     float speed;
     vel = vec3_normalize_length(vel, speed);
@@ -1499,10 +1505,10 @@ static void PM_SpectatorMove(void) {
     }
 
     // Accelerate
-    PM_Accelerate(vel, speed, PM_ACCEL_SPECTATOR);
+    PM_Accelerate(ctx, vel, speed, PM_ACCEL_SPECTATOR);
 
     // Do the move
-    PM_StepSlideMove();
+    PM_StepSlideMove(ctx);
 }
 
 //
@@ -1512,16 +1518,16 @@ static void PM_SpectatorMove(void) {
 // Handles special noclip movement.
 //===============
 //
-static void PM_NoclipMove() {
-    PM_Friction();
+static void PM_NoclipMove(PlayerMoveContext &ctx) {
+    PM_Friction(ctx);
 
     // User intentions on X/Y/Z
     vec3_t vel = vec3_zero();
-    vel = vec3_fmaf( vel, pm->moveCommand.input.forwardMove, playerMoveLocals.forward );
-    vel = vec3_fmaf( vel, pm->moveCommand.input.rightMove, playerMoveLocals.right );
+    vel = vec3_fmaf( vel, ctx.pm->moveCommand.input.forwardMove, ctx.locals.forward );
+    vel = vec3_fmaf( vel, ctx.pm->moveCommand.input.rightMove, ctx.locals.right );
 
     // Add explicit Z
-    vel.z += pm->moveCommand.input.upMove;
+    vel.z += ctx.pm->moveCommand.input.upMove;
 
     float speed;
     vel = vec3_normalize_length( vel, speed );
@@ -1532,10 +1538,10 @@ static void PM_NoclipMove() {
     }
 
     // Accelerate
-    PM_Accelerate( vel, speed, PM_ACCEL_SPECTATOR );
+    PM_Accelerate(ctx,  vel, speed, PM_ACCEL_SPECTATOR );
 
     // Do the move
-    pm->state.origin += vec3_scale( pm->state.velocity, playerMoveLocals.frameTime );
+    ctx.pm->state.origin += vec3_scale( ctx.pm->state.velocity, ctx.locals.frameTime );
 }
 
 //
@@ -1545,8 +1551,8 @@ static void PM_NoclipMove() {
 // Freeze Player movement/
 //===============
 //
-static void PM_FreezeMove(void) {
-    //PM_Debug("%s", Vec3ToString(pm->state.origin));
+static void PM_FreezeMove(PlayerMoveContext &ctx) {
+    //PM_Debug("%s", Vec3ToString(ctx.pm->state.origin));
          
     // Wait wut? An empty functions?
     //
@@ -1562,55 +1568,55 @@ static void PM_FreezeMove(void) {
 // Initializes the current set PMove pointer for another frame iteration.
 //===============
 //
-static void PM_Init(PlayerMove * pmove) {
+static void PM_Init(PlayerMoveContext &ctx, PlayerMove * pmove) {
     // Store pmove ptr.
-    pm = pmove;
+    ctx.pm = pmove;
 
     // Set the default bounding box
-    if (pm->state.type >= EnginePlayerMoveType::Dead) {
-        if (pm->state.type == EnginePlayerMoveType::Gib) {
-            pm->mins = PM_GIBLET_MINS;
-            pm->maxs = PM_GIBLET_MAXS;
+    if (ctx.pm->state.type >= EnginePlayerMoveType::Dead) {
+        if (ctx.pm->state.type == EnginePlayerMoveType::Gib) {
+            ctx.pm->mins = PM_GIBLET_MINS;
+            ctx.pm->maxs = PM_GIBLET_MAXS;
         }
         else {
-            pm->mins = vec3_scale(PM_DEAD_MINS, PM_SCALE);
-            pm->maxs = vec3_scale(PM_DEAD_MAXS, PM_SCALE);
+            ctx.pm->mins = vec3_scale(PM_DEAD_MINS, PM_SCALE);
+            ctx.pm->maxs = vec3_scale(PM_DEAD_MAXS, PM_SCALE);
         }
     }
     else {
-        pm->mins = vec3_scale(PM_MINS, PM_SCALE);
-        pm->maxs = vec3_scale(PM_MAXS, PM_SCALE);
+        ctx.pm->mins = vec3_scale(PM_MINS, PM_SCALE);
+        ctx.pm->maxs = vec3_scale(PM_MAXS, PM_SCALE);
     }
 
     // Clear out previous PM iteration results
-    pm->viewAngles = vec3_zero();
+    ctx.pm->viewAngles = vec3_zero();
 
     // This is important too.
-    pm->numTouchedEntities = 0;
+    ctx.pm->numTouchedEntities = 0;
     
     // Reset water states.
-    pm->waterType = 0;
-    pm->waterLevel = 0;
+    ctx.pm->waterType = 0;
+    ctx.pm->waterLevel = 0;
 
     // Reset the flags, and step, values. These are set on a per frame basis.
-    pm->state.flags &= ~(PMF_ON_GROUND | PMF_ON_LADDER);
-    pm->state.flags &= ~(PMF_JUMPED | PMF_UNDER_WATER);
-    pm->step = 0.0f;
+    ctx.pm->state.flags &= ~(PMF_ON_GROUND | PMF_ON_LADDER);
+    ctx.pm->state.flags &= ~(PMF_JUMPED | PMF_UNDER_WATER);
+    ctx.pm->step = 0.0f;
 
     // Jump "held" also, in case its key was released.
-    if (pm->moveCommand.input.upMove < 1) {
-        pm->state.flags &= ~PMF_JUMP_HELD;
+    if (ctx.pm->moveCommand.input.upMove < 1) {
+        ctx.pm->state.flags &= ~PMF_JUMP_HELD;
     }
 
     // Decrement the movement timer, used for "dropping" the player, landing after jumps, 
     // or falling off a ledge/slope, by the duration of the command.
-    if (pm->state.time) {
-        if (pm->moveCommand.input.msec >= pm->state.time) { // clear the timer and timed flags
-            pm->state.flags &= ~PMF_TIME_MASK;
-            pm->state.time = 0;
+    if (ctx.pm->state.time) {
+        if (ctx.pm->moveCommand.input.msec >= ctx.pm->state.time) { // clear the timer and timed flags
+            ctx.pm->state.flags &= ~PMF_TIME_MASK;
+            ctx.pm->state.time = 0;
         }
         else { // or just decrement the timer
-            pm->state.time -= pm->moveCommand.input.msec;
+            ctx.pm->state.time -= ctx.pm->moveCommand.input.msec;
         }
     }
 }
@@ -1622,19 +1628,19 @@ static void PM_Init(PlayerMove * pmove) {
 // Clamp angles with deltas. Ensure they pitch doesn't exceed 90 or 270
 //===============
 //
-static void PM_ClampAngles(void) {
+static void PM_ClampAngles(PlayerMoveContext &ctx) {
     // Copy the command angles into the outgoing state
     for (int i = 0; i < 3; i++) {
-        float temp = pm->moveCommand.input.viewAngles[i] + pm->state.deltaAngles[i];
-        pm->viewAngles[i] = temp;
+        float temp = ctx.pm->moveCommand.input.viewAngles[i] + ctx.pm->state.deltaAngles[i];
+        ctx.pm->viewAngles[i] = temp;
     }
 
     // Clamp pitch to prevent the player from looking up or down more than 90
-    if (pm->viewAngles.x > 90.0f && pm->viewAngles.x < 270.0f) {
-        pm->viewAngles.x = 90.0f;
+    if (ctx.pm->viewAngles.x > 90.0f && ctx.pm->viewAngles.x < 270.0f) {
+        ctx.pm->viewAngles.x = 90.0f;
     }
-    else if (pm->viewAngles.x <= 360.0f && pm->viewAngles.x >= 270.0f) {
-        pm->viewAngles.x -= 360.0f;
+    else if (ctx.pm->viewAngles.x <= 360.0f && ctx.pm->viewAngles.x >= 270.0f) {
+        ctx.pm->viewAngles.x -= 360.0f;
     }
 }
 
@@ -1645,22 +1651,22 @@ static void PM_ClampAngles(void) {
 // Caculate the view step value that we are at when stepping up and down a ledge/slope/stairs.
 //===============
 //
-static void PM_CheckViewStep(void) {
+static void PM_CheckViewStep(PlayerMoveContext &ctx) {
     // Add the step offset we've made on this frame
-    if (pm->step) {
-        pm->state.stepOffset += pm->step;
+    if (ctx.pm->step) {
+        ctx.pm->state.stepOffset += ctx.pm->step;
     }
 
     // Calculate change to the step offset
-    if (pm->state.stepOffset) {
+    if (ctx.pm->state.stepOffset) {
         // Calculate the step speed to interpolate at.
-        const float step_speed = playerMoveLocals.frameTime * (PM_SPEED_STEP * (Maxf(1.f, fabsf(pm->state.stepOffset) / PM_STEP_HEIGHT)));
+        const float step_speed = ctx.locals.frameTime * (PM_SPEED_STEP * (Maxf(1.f, fabsf(ctx.pm->state.stepOffset) / PM_STEP_HEIGHT)));
 
         // Are we interpolating upwards, or downwards?
-        if (pm->state.stepOffset > 0) {
-            pm->state.stepOffset = Maxf(0.f, pm->state.stepOffset - step_speed);
+        if (ctx.pm->state.stepOffset > 0) {
+            ctx.pm->state.stepOffset = Maxf(0.f, ctx.pm->state.stepOffset - step_speed);
         } else {
-            pm->state.stepOffset = Minf(0.f, pm->state.stepOffset + step_speed);
+            ctx.pm->state.stepOffset = Minf(0.f, ctx.pm->state.stepOffset + step_speed);
         }
     }
 }
@@ -1673,20 +1679,20 @@ static void PM_CheckViewStep(void) {
 // reverting an invalid pmove command.
 //===============
 //
-static void PM_InitLocal() {
+static void PM_InitLocal(PlayerMoveContext &ctx) {
     // Clear all PM local vars
-    playerMoveLocals = {};
+    ctx.locals = {};
 
     // Increase frame time based on seconds.
-    playerMoveLocals.frameTime = pm->moveCommand.input.msec * 0.001f;
+    ctx.locals.frameTime = ctx.pm->moveCommand.input.msec * 0.001f;
 
     // Save in case we get stuck and wish to undo this move.
-    playerMoveLocals.previousOrigin = pm->state.origin;
-    playerMoveLocals.previousVelocity = pm->state.velocity;
+    ctx.locals.previousOrigin = ctx.pm->state.origin;
+    ctx.locals.previousVelocity = ctx.pm->state.velocity;
 
     // Calculate the directional vectors for this move, and in the XY Plane.
-    vec3_vectors(pm->viewAngles, &playerMoveLocals.forward, &playerMoveLocals.right, &playerMoveLocals.up);
-    vec3_vectors(vec3_t{ 0.f, pm->viewAngles.y, 0.f }, &playerMoveLocals.forwardXY, &playerMoveLocals.rightXY, NULL);
+    vec3_vectors(ctx.pm->viewAngles, &ctx.locals.forward, &ctx.locals.right, &ctx.locals.up);
+    vec3_vectors(vec3_t{ 0.f, ctx.pm->viewAngles.y, 0.f }, &ctx.locals.forwardXY, &ctx.locals.rightXY, NULL);
 }
 
 //
@@ -1698,78 +1704,81 @@ static void PM_InitLocal() {
 //
 void PMove(PlayerMove * pmove)
 {
+    // All working state of this move, nothing is kept between calls.
+    PlayerMoveContext ctx = {};
+
     // Initialize the PMove.
-    PM_Init(pmove);
+    PM_Init(ctx, pmove);
 
     // Ensure angles are clamped.
-    PM_ClampAngles();
+    PM_ClampAngles(ctx);
 
     // Initialize the locals.
-    PM_InitLocal();
+    PM_InitLocal(ctx);
 
     // Special PM_FREEZE(Player Movement is frozen, idle, not happening!) treatment.
-    if (pm->state.type == EnginePlayerMoveType::Freeze) {
-        PM_FreezeMove();
+    if (ctx.pm->state.type == EnginePlayerMoveType::Freeze) {
+        PM_FreezeMove(ctx);
         return;
     }
 
     // Special PM_SPECTATOR(Spectator Movement, viewing a match, etc) treatment.
-    if (pm->state.type == PlayerMoveType::Spectator) {
-        PM_SpectatorMove();
+    if (ctx.pm->state.type == PlayerMoveType::Spectator) {
+        PM_SpectatorMove(ctx);
         return;
     }
 
-    if (pm->state.type == PlayerMoveType::Noclip) {
-        PM_NoclipMove();
+    if (ctx.pm->state.type == PlayerMoveType::Noclip) {
+        PM_NoclipMove(ctx);
         return;
     }
 
     // Erase input direction values in case we are dead, or something alike.
-    if (pm->state.type >= EnginePlayerMoveType::Dead) {
-        pm->moveCommand.input.forwardMove = 0;
-        pm->moveCommand.input.rightMove = 0;
-        pm->moveCommand.input.upMove = 0;
+    if (ctx.pm->state.type >= EnginePlayerMoveType::Dead) {
+        ctx.pm->moveCommand.input.forwardMove = 0;
+        ctx.pm->moveCommand.input.rightMove = 0;
+        ctx.pm->moveCommand.input.upMove = 0;
     }
 
     // Check for Ladders.
-    PM_CheckLadder();
+    PM_CheckLadder(ctx);
 
     // Set mins, maxs, and viewHeight
-    PM_CheckDuck();
+    PM_CheckDuck(ctx);
 
     // Check for water.
-    PM_CheckWater();
+    PM_CheckWater(ctx);
 
     // Check for ground.
-    PM_CheckGround();
+    PM_CheckGround(ctx);
 
-    if (pm->state.flags & PMF_TIME_TELEPORT) {
+    if (ctx.pm->state.flags & PMF_TIME_TELEPORT) {
         // pause in place briefly
     }
-    else if (pm->state.flags & PMF_TIME_WATER_JUMP) {
-        PM_WaterJumpMove();
+    else if (ctx.pm->state.flags & PMF_TIME_WATER_JUMP) {
+        PM_WaterJumpMove(ctx);
     }
-    else if (pm->state.flags & PMF_ON_LADDER) {
-        PM_LadderMove();
+    else if (ctx.pm->state.flags & PMF_ON_LADDER) {
+        PM_LadderMove(ctx);
     }
-    else if (pm->state.flags & PMF_ON_GROUND) {
-        PM_WalkMove();
+    else if (ctx.pm->state.flags & PMF_ON_GROUND) {
+        PM_WalkMove(ctx);
         PM_Debug("Onground");
     }
-    else if (pm->waterLevel > WaterLevel::Feet) {
-        PM_WaterMove();
+    else if (ctx.pm->waterLevel > WaterLevel::Feet) {
+        PM_WaterMove(ctx);
     }
     else {
-        PM_AirMove();
+        PM_AirMove(ctx);
         PM_Debug("Airmove");
     }
 
     // Check for ground at new spot.
-    PM_CheckGround();
+    PM_CheckGround(ctx);
 
     // Check for water at new spot.
-    PM_CheckWater();
+    PM_CheckWater(ctx);
 
     // Check for view step changes, if so, interpolate.
-    PM_CheckViewStep();
+    PM_CheckViewStep(ctx);
 }
\ No newline at end of file
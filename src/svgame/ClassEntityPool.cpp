@@ -0,0 +1,256 @@
+/*
+// LICENSE HERE.
+
+//
+// ClassEntityPool.cpp
+//
+// Size-class pools for class entities. Each size class keeps a free list of
+// fixed size blocks, carved out of slabs that are allocated on demand. Every
+// block is prefixed with a small header, so deleting only needs the pointer.
+//
+*/
+#include "g_local.h"          // Include SVGame header.
+#include "entities.h"
+#include "ClassEntityPool.h"
+
+#include "entities/base/SVGBaseEntity.h"
+
+// Number of blocks that are carved out of a single slab.
+constexpr int32_t CLASSENTITY_SLAB_BLOCKS = MAX_EDICTS / 16;
+
+// Size classes, the last one is the largest size that is pooled at all.
+static constexpr size_t classEntityBlockSizes[] = { 512, 1024, 2048, 4096, 8192, 16384 };
+static constexpr int32_t CLASSENTITY_SIZE_CLASSES = Q_COUNTOF(classEntityBlockSizes);
+
+// Identifies oversized allocations, which bypass the pools.
+constexpr int32_t CLASSENTITY_OVERSIZED = -1;
+
+//
+// Header in front of every class entity block.
+//
+struct alignas(16) ClassEntityBlockHeader {
+    // Type that was allocated in this block.
+    TypeInfo* typeInfo;
+    // Size class index, or CLASSENTITY_OVERSIZED.
+    int32_t sizeClass;
+};
+
+//
+// Free blocks store the pointer to the next free block in their header space.
+//
+struct ClassEntityFreeBlock {
+    ClassEntityFreeBlock* next;
+};
+
+//
+// A single size class pool.
+//
+struct ClassEntitySizeClass {
+    // First free block.
+    ClassEntityFreeBlock* freeList;
+    // Number of blocks carved out of slabs, and the number in use.
+    int32_t totalBlocks;
+    int32_t usedBlocks;
+    // Highest number of blocks in use at once.
+    int32_t peakBlocks;
+};
+static ClassEntitySizeClass classEntitySizeClasses[CLASSENTITY_SIZE_CLASSES];
+
+// Oversized allocations that bypassed the pools.
+static int32_t classEntityOversizedCount;
+
+//
+//===============
+// ClassEntityPool_FindSizeClass
+//
+// Returns the smallest size class that fits 'size' bytes, including the
+// block header. Returns CLASSENTITY_OVERSIZED if none does.
+//===============
+//
+static int32_t ClassEntityPool_FindSizeClass(size_t size) {
+    size += sizeof(ClassEntityBlockHeader);
+
+    for (int32_t i = 0; i < CLASSENTITY_SIZE_CLASSES; i++) {
+        if (size <= classEntityBlockSizes[i]) {
+            return i;
+        }
+    }
+
+    return CLASSENTITY_OVERSIZED;
+}
+
+//
+//===============
+// ClassEntityPool_AllocateSlab
+//
+// Carves a new slab of blocks, and pushes them onto the free list.
+//===============
+//
+static void ClassEntityPool_AllocateSlab(int32_t sizeClass) {
+    ClassEntitySizeClass& pool = classEntitySizeClasses[sizeClass];
+    const size_t blockSize = classEntityBlockSizes[sizeClass];
+
+    byte* slab = (byte*)gi.TagMalloc(blockSize * CLASSENTITY_SLAB_BLOCKS, TAG_CLASSENTITY); // CPP: Cast
+
+    // Push them in reverse, so blocks are handed out in address order.
+    for (int32_t i = CLASSENTITY_SLAB_BLOCKS - 1; i >= 0; i--) {
+        ClassEntityFreeBlock* block = (ClassEntityFreeBlock*)(slab + i * blockSize);
+        block->next = pool.freeList;
+        pool.freeList = block;
+    }
+
+    pool.totalBlocks += CLASSENTITY_SLAB_BLOCKS;
+}
+
+//
+//===============
+// SVG_ClassEntityPool_Allocate
+//
+// Allocates pool memory for an instance of the given type. The caller is
+// expected to placement new the class entity into the returned memory.
+//===============
+//
+void* SVG_ClassEntityPool_Allocate(TypeInfo* typeInfo, size_t size) {
+    ClassEntityBlockHeader* header = nullptr;
+    const int32_t sizeClass = ClassEntityPool_FindSizeClass(size);
+
+    if (sizeClass == CLASSENTITY_OVERSIZED) {
+        // Too large for any of the pools, give it its own block.
+        header = (ClassEntityBlockHeader*)gi.TagMalloc(sizeof(ClassEntityBlockHeader) + size, TAG_CLASSENTITY); // CPP: Cast
+        classEntityOversizedCount++;
+    } else {
+        ClassEntitySizeClass& pool = classEntitySizeClasses[sizeClass];
+
+        if (!pool.freeList) {
+            ClassEntityPool_AllocateSlab(sizeClass);
+        }
+
+        // Pop a block off of the free list.
+        ClassEntityFreeBlock* block = pool.freeList;
+        pool.freeList = block->next;
+
+        pool.usedBlocks++;
+        if (pool.usedBlocks > pool.peakBlocks) {
+            pool.peakBlocks = pool.usedBlocks;
+        }
+
+        header = (ClassEntityBlockHeader*)block;
+    }
+
+    header->typeInfo = typeInfo;
+    header->sizeClass = sizeClass;
+
+    // Update the per class counters.
+    typeInfo->allocationCount++;
+    typeInfo->liveCount++;
+    if (typeInfo->liveCount > typeInfo->peakCount) {
+        typeInfo->peakCount = typeInfo->liveCount;
+    }
+
+    return header + 1;
+}
+
+//
+//===============
+// SVG_ClassEntityPool_Delete
+//
+// Destructs the class entity, and returns its memory to the pool.
+//===============
+//
+void SVG_ClassEntityPool_Delete(SVGBaseEntity* classEntity) {
+    if (!classEntity) {
+        return;
+    }
+
+    ClassEntityBlockHeader* header = (ClassEntityBlockHeader*)classEntity - 1;
+    const int32_t sizeClass = header->sizeClass;
+    TypeInfo* typeInfo = header->typeInfo;
+
+    // Run the destructors, our memory, our business.
+    classEntity->~SVGBaseEntity();
+
+    // Update the per class counters.
+    typeInfo->liveCount--;
+
+    if (sizeClass == CLASSENTITY_OVERSIZED) {
+        gi.TagFree(header);
+        classEntityOversizedCount--;
+        return;
+    }
+
+    // Push the block back onto the free list.
+    ClassEntitySizeClass& pool = classEntitySizeClasses[sizeClass];
+    ClassEntityFreeBlock* block = (ClassEntityFreeBlock*)header;
+    block->next = pool.freeList;
+    pool.freeList = block;
+    pool.usedBlocks--;
+}
+
+//
+//===============
+// SVG_ClassEntityPool_Reset
+//
+// Destructs all class entities that are still alive, and releases all pool
+// slabs at once. Called when a new map is spawned, and at shutdown.
+//===============
+//
+void SVG_ClassEntityPool_Reset(void) {
+    // Destruct the class entities, their members may own memory.
+    for (int32_t i = 0; i < MAX_EDICTS; i++) {
+        if (g_baseEntities[i]) {
+            if (g_entities[i].classEntity == g_baseEntities[i]) {
+                g_entities[i].classEntity = nullptr;
+            }
+
+            g_baseEntities[i]->~SVGBaseEntity();
+            g_baseEntities[i] = nullptr;
+        }
+    }
+
+    // Release the slabs wholesale.
+    gi.FreeTags(TAG_CLASSENTITY);
+
+    for (auto& pool : classEntitySizeClasses) {
+        pool = {};
+    }
+    classEntityOversizedCount = 0;
+
+    // Nothing is alive anymore.
+    for (TypeInfo* typeInfo = TypeInfo::head; typeInfo; typeInfo = typeInfo->prev) {
+        typeInfo->liveCount = 0;
+    }
+}
+
+//
+//===============
+// SVG_ClassEntityPool_PrintStats
+//
+// Prints the per class, and per size class, allocation counters.
+//===============
+//
+void SVG_ClassEntityPool_PrintStats(void) {
+    gi.CPrintf(NULL, PRINT_HIGH, "%-28s %8s %8s %8s %8s\n", "class", "allocs", "frees", "live", "peak");
+    gi.CPrintf(NULL, PRINT_HIGH, "---------------------------- -------- -------- -------- --------\n");
+
+    for (TypeInfo* typeInfo = TypeInfo::head; typeInfo; typeInfo = typeInfo->prev) {
+        if (!typeInfo->allocationCount) {
+            continue;
+        }
+
+        gi.CPrintf(NULL, PRINT_HIGH, "%-28s %8u %8u %8u %8u\n", typeInfo->className,
+            typeInfo->allocationCount, typeInfo->allocationCount - typeInfo->liveCount,
+            typeInfo->liveCount, typeInfo->peakCount);
+    }
+
+    gi.CPrintf(NULL, PRINT_HIGH, "\n%-10s %8s %8s %8s\n", "block", "total", "used", "peak");
+    gi.CPrintf(NULL, PRINT_HIGH, "---------- -------- -------- --------\n");
+
+    for (int32_t i = 0; i < CLASSENTITY_SIZE_CLASSES; i++) {
+        const ClassEntitySizeClass& pool = classEntitySizeClasses[i];
+
+        gi.CPrintf(NULL, PRINT_HIGH, "%-10i %8i %8i %8i\n", (int32_t)classEntityBlockSizes[i],
+            pool.totalBlocks, pool.usedBlocks, pool.peakBlocks);
+    }
+
+    gi.CPrintf(NULL, PRINT_HIGH, "%i oversized allocations\n", classEntityOversizedCount);
+}
@@ -0,0 +1,27 @@
+/*
+// LICENSE HERE.
+
+//
+// ClassEntityPool.h
+//
+// Class entities are allocated from size-class pools, and constructed in
+// place by the TypeInfo allocators. The pool memory has level lifetime,
+// and is released wholesale when a new map is spawned.
+//
+*/
+#ifndef __SVGAME_CLASSENTITYPOOL_H__
+#define __SVGAME_CLASSENTITYPOOL_H__
+
+class SVGBaseEntity;
+class TypeInfo;
+
+// Allocates pool memory for an instance of the given type, to placement new into.
+void* SVG_ClassEntityPool_Allocate(TypeInfo* typeInfo, size_t size);
+// Destructs the class entity, and returns its memory to the pool.
+void SVG_ClassEntityPool_Delete(SVGBaseEntity* classEntity);
+// Destructs all class entities that are alive, and releases the pool memory wholesale.
+void SVG_ClassEntityPool_Reset(void);
+// Prints the per class, and per size class, allocation counters.
+void SVG_ClassEntityPool_PrintStats(void);
+
+#endif // __SVGAME_CLASSENTITYPOOL_H__
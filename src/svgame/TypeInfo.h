@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <new>
+#include <type_traits>
 
 class SVGBaseEntity;
 typedef entity_s Entity;
@@ -28,6 +30,34 @@ private:
 
 using EntityAllocatorFn = SVGBaseEntity* ( Entity* );
 
+//===============
+// Persistent class entity fields, written to savegames column by column
+//===============
+enum class SaveFieldType : uint8_t {
+	Int32 = 1,
+	Float,
+	Vector3,
+	// std::string
+	String,
+	// SVGBaseEntity*, stored as an entity number and fixed up after loading
+	EntityPointer,
+	// Entity*, stored as an entity number and fixed up after loading
+	ServerEntity,
+	// bool, stored as an Int32
+	Bool
+};
+
+struct SaveField {
+	const char*     name;
+	SaveFieldType   type;
+	uint32_t        offset;
+};
+
+using SaveFieldsFn = const SaveField* ( uint32_t* count );
+
+// Class entities are constructed in place, in memory handed out by the class entity pools.
+void* SVG_ClassEntityPool_Allocate( class TypeInfo* typeInfo, size_t size );
+
 //===============
 // TypeInfo, a system for getting runtime information about classes
 //===============
@@ -140,6 +170,22 @@ public:
 	const char*     className;
 	const char*     superName;
 	uint8_t			typeFlags;
+
+	// Allocation counters, maintained by the class entity pools
+	uint32_t		allocationCount = 0;
+	uint32_t		liveCount = 0;
+	uint32_t		peakCount = 0;
+
+	// Persistent fields declared by this class itself, not including the superclasses
+	const SaveField* saveFields = nullptr;
+	uint32_t		numSaveFields = 0;
+};
+
+// Hooks the save fields of a class up to its type info during static initialisation
+struct SaveFieldsRegistrar {
+	SaveFieldsRegistrar( TypeInfo* typeInfo, SaveFieldsFn* fieldsFunction ) {
+		typeInfo->saveFields = fieldsFunction( &typeInfo->numSaveFields );
+	}
 };
 
 // ========================================================================
@@ -176,7 +222,7 @@ __DeclareTypeInfo( #className, #className, #superClass, TypeInfo::TypeFlag_Abstr
 #define DefineMapClass( mapClassName, className, superClass )	\
 using Base = superClass;										\
 static SVGBaseEntity* AllocateInstance( Entity* entity ) {		\
-	return new className( entity );								\
+	return new ( SVG_ClassEntityPool_Allocate( &ClassInfo, sizeof( className ) ) ) className( entity ); \
 }																\
 __DeclareTypeInfo( mapClassName, #className, #superClass, TypeInfo::TypeFlag_MapSpawn, &className::AllocateInstance );
 
@@ -195,6 +241,55 @@ __DeclareTypeInfo( mapClassName, #className, #superClass, TypeInfo::TypeFlag_Map
 #define DefineClass( className, superClass )					\
 using Base = superClass;										\
 static SVGBaseEntity* AllocateInstance( Entity* entity ) {		\
-	return new className( entity );								\
+	return new ( SVG_ClassEntityPool_Allocate( &ClassInfo, sizeof( className ) ) ) className( entity ); \
 }																\
 __DeclareTypeInfo( #className, #className, #superClass, TypeInfo::TypeFlag_None, &className::AllocateInstance );
+
+// Declares the persistent fields of this class, which are listed with
+// DefineSaveFields in its source file. Only list the fields the class adds
+// itself, the ones of its superclasses are saved along automatically.
+#define DeclareSaveFields()										\
+static const SaveField* GetSaveFields( uint32_t* count );
+
+// Save fields are located by offsetof on the entity classes, which aren't
+// standard layout, hence the silenced -Winvalid-offsetof. The offsets are
+// still fixed at compile time: entity classes only use single, non-virtual
+// inheritance from SVGBaseEntity, so a class its members always sit at the
+// same offset from the object pointer, which in turn equals its
+// SVGBaseEntity pointer. DefineSaveFields asserts what can be checked.
+#if defined( __GNUC__ )
+#define __SaveFieldsBegin _Pragma( "GCC diagnostic push" ) _Pragma( "GCC diagnostic ignored \"-Winvalid-offsetof\"" )
+#define __SaveFieldsEnd _Pragma( "GCC diagnostic pop" )
+#else
+#define __SaveFieldsBegin
+#define __SaveFieldsEnd
+#endif
+
+// Defines the persistent fields of a class, using the SaveField_ macros below
+// @param className (symbol) - the internal C++ class name
+#define DefineSaveFields( className, ... )						\
+static_assert( std::is_base_of_v<SVGBaseEntity, className>, #className " must derive from SVGBaseEntity" ); \
+__SaveFieldsBegin												\
+const SaveField* className::GetSaveFields( uint32_t* count ) {	\
+	using SaveClass = className;								\
+	static const SaveField fields[] = { __VA_ARGS__ };			\
+	*count = sizeof( fields ) / sizeof( fields[0] );			\
+	return fields;												\
+}																\
+__SaveFieldsEnd													\
+static SaveFieldsRegistrar className##SaveFieldsRegistrar( &className::ClassInfo, &className::GetSaveFields );
+
+template<size_t offset, size_t size>
+constexpr uint32_t __SaveFieldOffset() {
+	static_assert( offset < size, "save field lies outside of its class" );
+	return static_cast<uint32_t>( offset );
+}
+
+#define __SaveField( member, type ) { #member, (type), __SaveFieldOffset<offsetof( SaveClass, member ), sizeof( SaveClass )>() }
+#define SaveField_Int( member )			__SaveField( member, SaveFieldType::Int32 )
+#define SaveField_Float( member )		__SaveField( member, SaveFieldType::Float )
+#define SaveField_Vector3( member )		__SaveField( member, SaveFieldType::Vector3 )
+#define SaveField_String( member )		__SaveField( member, SaveFieldType::String )
+#define SaveField_Entity( member )		__SaveField( member, SaveFieldType::EntityPointer )
+#define SaveField_ServerEntity( member )	__SaveField( member, SaveFieldType::ServerEntity )
+#define SaveField_Bool( member )		__SaveField( member, SaveFieldType::Bool )
@@ -8,6 +8,7 @@
 */
 #include "g_local.h"			// Include SVGame header.
 #include "entities.h"			// Entities header.
+#include "ClassEntityPool.h"	// Class entity pools.
 #include "player/client.h"		// Include Player Client header.
 
 
@@ -153,9 +154,12 @@ void SVG_FreeClassEntity(Entity* ent) {
 
     // In case it exists in our base entitys, get rid of it, assign nullptr.
     if (g_baseEntities[entityNumber]) {
-        delete g_baseEntities[entityNumber];
+        SVG_ClassEntityPool_Delete(g_baseEntities[entityNumber]);
         g_baseEntities[entityNumber] = nullptr;
     }
+
+    // Hand a clean component slot to whoever spawns in here next.
+    g_entityComponents.Reset(entityNumber);
 }
 
 
@@ -321,30 +325,187 @@ SVGBaseEntity* SVG_FindEntityByKeyValue(const std::string& fieldKey, const std::
     return nullptr;
 }
 
+//-----------------
+// Frame entity arena.
+//
+// Scratch storage for entity lists that only have to live for the current
+// frame, such as radius query results. Reset at the start of each frame.
+// Lists that don't fit anymore are heap allocated, and freed along with it.
+//-----------------
+static constexpr size_t FRAME_ENTITY_ARENA_SIZE = MAX_EDICTS * 16;
+static SVGBaseEntity* frameEntityArena[FRAME_ENTITY_ARENA_SIZE];
+static size_t frameEntityArenaUsed = 0;
+static std::vector<BaseEntityVector> frameEntityOverflow;
+
+// Area tree query scratch list.
+static Entity* radiusAreaEntities[MAX_EDICTS];
+
+//===============
+// SVG_ResetFrameEntityArena
+// 
+// Releases all frame entity lists at once. Called at the start of a frame.
+//===============
+void SVG_ResetFrameEntityArena() {
+    frameEntityArenaUsed = 0;
+    frameEntityOverflow.clear();
+}
+
+//===============
+// SVG_AllocateFrameEntityList
+// 
+// Returns a span of 'count' entity pointers that stays valid until the end
+// of the current frame. Falls back to the heap if the arena runs out.
+//===============
+BaseEntitySpan SVG_AllocateFrameEntityList(size_t count) {
+    size_t available = FRAME_ENTITY_ARENA_SIZE - frameEntityArenaUsed;
+
+    if (count > available) {
+        frameEntityOverflow.emplace_back(count);
+        return BaseEntitySpan(frameEntityOverflow.back());
+    }
+
+    BaseEntitySpan entityList(&frameEntityArena[frameEntityArenaUsed], count);
+    frameEntityArenaUsed += count;
+
+    return entityList;
+}
+
+//===============
+// SVG_ReleaseFrameEntityList
+// 
+// Hands back the unused tail of the most recently allocated frame entity list.
+//===============
+static BaseEntitySpan SVG_ReleaseFrameEntityList(BaseEntitySpan entityList, size_t usedCount) {
+    if (entityList.data() + entityList.size() == &frameEntityArena[frameEntityArenaUsed]) {
+        frameEntityArenaUsed -= entityList.size() - usedCount;
+    }
+
+    return entityList.first(usedCount);
+}
+
+//===============
+// SVG_GatherRadiusAreaEntities
+// 
+// Boxes the solid and trigger entities from the area tree that can possibly
+// be within the given bounds. Entities that are Solid::Not aren't linked in
+// the area tree, and are thus never found. An entity is linked either as a
+// solid or as a trigger, so all of them always fit.
+//===============
+static int32_t SVG_GatherRadiusAreaEntities(const vec3_t& mins, const vec3_t& maxs) {
+    int32_t numEntities = gi.BoxEntities(mins, maxs, radiusAreaEntities, MAX_EDICTS, AREA_SOLID);
+    numEntities += gi.BoxEntities(mins, maxs, radiusAreaEntities + numEntities, MAX_EDICTS - numEntities, AREA_TRIGGERS);
+
+    return numEntities;
+}
+
+//===============
+// SVG_EntityWithinRadius
+// 
+// Returns true if the entity its bounding box center is within the sphere.
+//===============
+static inline qboolean SVG_EntityWithinRadius(SVGBaseEntity* ent, const vec3_t& origin, float radius) {
+    vec3_t delta = origin - (ent->GetOrigin() + vec3_scale(ent->GetMins() + ent->GetMaxs(), 0.5f));
+
+    return vec3_dot(delta, delta) <= radius * radius;
+}
+
 //===============
 // SVG_FindEntitiesWithinRadius
 // 
-// Returns entities that have origins within a spherical area
+// Returns entities that have origins within a spherical area. The area tree
+// is boxed first, after which the results are refined by the sphere.
 // 
-// SVG_FindEntitiesWithinRadius (origin, radius)
+// Results are written to 'entityList', returns the amount of entities found.
+// If 'entityList' is too small to hold them all, a warning is printed.
 //===============
-BaseEntityVector SVG_FindEntitiesWithinRadius(vec3_t origin, float radius, uint32_t excludeSolidFlags)
+int32_t SVG_FindEntitiesWithinRadius(const vec3_t &origin, float radius, BaseEntitySpan entityList)
 {
-    BaseEntityVector entityList;
+    int32_t numFound = 0;
 
-    // Iterate over all entities, see who is nearby, and who is not.
-    for (auto* radiusEntity : GetBaseEntityRange<0, MAX_EDICTS>()
-        | bef::IsValidPointer
-        | bef::HasServerEntity
-        | bef::InUse
-        | bef::WithinRadius(origin, radius, excludeSolidFlags)) {
+    // Box the area tree for our candidates.
+    const vec3_t extents = { radius, radius, radius };
+    int32_t numEntities = SVG_GatherRadiusAreaEntities(origin - extents, origin + extents);
+
+    for (int32_t i = 0; i < numEntities; i++) {
+        // Fetch the base entity and ensure it is valid.
+        SVGBaseEntity* radiusEntity = g_baseEntities[radiusAreaEntities[i]->state.number];
+
+        if (!radiusEntity || !radiusEntity->GetServerEntity() || !radiusEntity->IsInUse())
+            continue;
+
+        if (!SVG_EntityWithinRadius(radiusEntity, origin, radius))
+            continue;
+
+        if (numFound == (int32_t)entityList.size()) {
+            gi.CPrintf(NULL, PRINT_HIGH, "WARNING: %s: more than %i entities found, the rest is skipped\n", __func__, numFound);
+            break;
+        }
 
-        // Push radiusEntity result item to the list.
-        entityList.push_back(radiusEntity);
+        entityList[numFound++] = radiusEntity;
     }
 
-    // The list might be empty, ensure to check for that ;-)
-    return entityList;
+    return numFound;
+}
+
+//===============
+// SVG_FindEntitiesWithinRadius
+// 
+// Same as above, except that the results are stored in the frame entity arena.
+// The returned span is valid until the end of the current frame.
+//===============
+BaseEntitySpan SVG_FindEntitiesWithinRadius(const vec3_t& origin, float radius)
+{
+    BaseEntitySpan entityList = SVG_AllocateFrameEntityList(MAX_EDICTS);
+    int32_t numFound = SVG_FindEntitiesWithinRadius(origin, radius, entityList);
+
+    return SVG_ReleaseFrameEntityList(entityList, numFound);
+}
+
+//===============
+// SVG_FindEntitiesWithinRadii
+// 
+// Batched radius query, for when many explosions go off in a single frame.
+// The area tree is boxed once for the union of all queries, after which
+// each query refines the candidates by its own sphere. Results are stored
+// in the frame entity arena.
+//===============
+void SVG_FindEntitiesWithinRadii(std::span<RadiusQuery> queries)
+{
+    if (queries.empty())
+        return;
+
+    // Calculate the union bounds of all query spheres.
+    vec3_t mins = queries[0].origin;
+    vec3_t maxs = queries[0].origin;
+
+    for (auto& query : queries) {
+        const vec3_t extents = { query.radius, query.radius, query.radius };
+        mins = vec3_minf(mins, query.origin - extents);
+        maxs = vec3_maxf(maxs, query.origin + extents);
+    }
+
+    // Box the area tree once for all queries.
+    int32_t numEntities = SVG_GatherRadiusAreaEntities(mins, maxs);
+
+    for (auto& query : queries) {
+        // A query can't find more than all candidates, so the list never falls short.
+        BaseEntitySpan entityList = SVG_AllocateFrameEntityList(numEntities);
+        int32_t numFound = 0;
+
+        for (int32_t i = 0; i < numEntities; i++) {
+            SVGBaseEntity* radiusEntity = g_baseEntities[radiusAreaEntities[i]->state.number];
+
+            if (!radiusEntity || !radiusEntity->GetServerEntity() || !radiusEntity->IsInUse())
+                continue;
+
+            if (!SVG_EntityWithinRadius(radiusEntity, query.origin, query.radius))
+                continue;
+
+            entityList[numFound++] = radiusEntity;
+        }
+
+        query.results = SVG_ReleaseFrameEntityList(entityList, numFound);
+    }
 }
 
 //===============
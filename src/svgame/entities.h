@@ -165,6 +165,18 @@ using BaseEntitySpan = std::span<SVGBaseEntity*>;
 
 using BaseEntityVector = std::vector<SVGBaseEntity*>;
 
+//
+// A single radius query, as used by the batched SVG_FindEntitiesWithinRadii.
+//
+struct RadiusQuery {
+    // Center of the sphere.
+    vec3_t origin;
+    // Radius of the sphere.
+    float radius;
+    // Found entities, stored in the frame entity arena.
+    BaseEntitySpan results;
+};
+
 // Returns a span containing all the entities in the range of [start] to [start + count].
 template <std::size_t start, std::size_t count>
 inline auto GetEntityRange() -> std::span<Entity, count> {
@@ -191,14 +203,22 @@ inline BaseEntitySpan GetBaseEntityRange(std::size_t start, std::size_t count) {
 Entity* SVG_PickTarget(char* targetName);
 Entity* SVG_Find(Entity* from, int32_t fieldofs, const char* match); // C++20: Added const to char*
 
-// Find entities within a given radius.
-// Moved to gamemodes. This allows for them to customize what actually belongs in a certain radius.
-// All that might sound silly, but the key here is customization.
-//BaseEntityVector SVG_FindEntitiesWithinRadius(vec3_t org, float rad, uint32_t excludeSolidFlags = Solid::Not);
+// Find entities within a given radius, using the area tree.
+// Game modes wrap these, allowing them to customize what actually belongs in a certain radius.
+int32_t SVG_FindEntitiesWithinRadius(const vec3_t& origin, float radius, BaseEntitySpan entityList);
+BaseEntitySpan SVG_FindEntitiesWithinRadius(const vec3_t& origin, float radius);
+void SVG_FindEntitiesWithinRadii(std::span<RadiusQuery> queries);
 // Find entities based on their field(key), and field(value).
 SVGBaseEntity* SVG_FindEntityByKeyValue(const std::string& fieldKey, const std::string& fieldValue, SVGBaseEntity* lastEntity = nullptr);
 
 
+//
+// Frame entity arena, for entity lists that only live during the current frame.
+//
+void SVG_ResetFrameEntityArena();
+BaseEntitySpan SVG_AllocateFrameEntityList(size_t count);
+
+
 //
 // Server Entity handling.
 //
@@ -24,6 +24,7 @@ public:
     virtual ~Light();
 
     DefineMapClass( "light", Light, SVGBaseTrigger );
+    DeclareSaveFields();
 
     //
     // Interface functions. 
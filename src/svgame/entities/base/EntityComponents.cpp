@@ -0,0 +1,30 @@
+/*
+// LICENSE HERE.
+
+//
+// EntityComponents.cpp
+//
+//
+*/
+#include "../../g_local.h"		// SVGame.
+#include "EntityComponents.h"
+
+// Hot component arrays, matches g_entities index wise.
+EntityComponents g_entityComponents;
+
+//
+//===============
+// EntityComponents::Reset
+//
+// Resets the components of the given entity number to their defaults.
+//===============
+//
+void EntityComponents::Reset(int32_t number) {
+	velocity[number] = vec3_zero();
+	angularVelocity[number] = vec3_zero();
+	moveType[number] = MoveType::None;
+	gravity[number] = 1.f;
+	nextThinkTime[number] = 0.f;
+	groundEntity[number] = nullptr;
+	groundEntityLinkCount[number] = 0;
+}
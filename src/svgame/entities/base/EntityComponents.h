@@ -0,0 +1,43 @@
+/*
+// LICENSE HERE.
+
+//
+// EntityComponents.h
+//
+// Structure of arrays storage for the per tick hot class entity fields. The
+// physics code walks these arrays directly, while SVGBaseEntity its Get/Set
+// functions act as a facade on top of them.
+//
+// Indexed by entity number, just like g_entities and g_baseEntities. The
+// origin, and bounding box, live in g_entities since the server needs them
+// for linking and networking.
+//
+*/
+#ifndef __SVGAME_ENTITIES_BASE_ENTITYCOMPONENTS_H__
+#define __SVGAME_ENTITIES_BASE_ENTITYCOMPONENTS_H__
+
+class SVGBaseEntity;
+
+struct EntityComponents {
+    // Velocity.
+    vec3_t velocity[MAX_EDICTS];
+    // Angular Velocity.
+    vec3_t angularVelocity[MAX_EDICTS];
+    // Move Type. (MoveType::xxx)
+    int32_t moveType[MAX_EDICTS];
+    // Per entity gravity multiplier (1.0 is normal).
+    float gravity[MAX_EDICTS];
+    // The next 'think' time, determines when to call the 'think' callback.
+    float nextThinkTime[MAX_EDICTS];
+    // Ground entity we're standing on.
+    SVGBaseEntity* groundEntity[MAX_EDICTS];
+    // Ground Entity link count. (To keep track if it is linked or not.)
+    int32_t groundEntityLinkCount[MAX_EDICTS];
+
+    // Resets the components of the given entity number to their defaults.
+    void Reset(int32_t number);
+};
+
+extern EntityComponents g_entityComponents;
+
+#endif // __SVGAME_ENTITIES_BASE_ENTITYCOMPONENTS_H__
@@ -21,6 +21,15 @@
 #include "../base/SVGBaseEntity.h"
 #include "PlayerClient.h"
 
+// Savegame fields.
+DefineSaveFields( PlayerClient,
+	SaveField_Float( airFinishedTime ),
+	SaveField_Float( debounceTouchTime ),
+	SaveField_Float( debouncePainTime ),
+	SaveField_Float( debounceDamageTime ),
+	SaveField_Float( debounceSoundTime )
+)
+
 // Constructor/Deconstructor.
 PlayerClient::PlayerClient(Entity* svEntity) : SVGBaseEntity(svEntity) {
 
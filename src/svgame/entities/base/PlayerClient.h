@@ -18,6 +18,7 @@ public:
     virtual ~PlayerClient();
 
     DefineMapClass("PlayerClient", PlayerClient, SVGBaseEntity );
+    DeclareSaveFields();
 
     //
     // Interface functions. 
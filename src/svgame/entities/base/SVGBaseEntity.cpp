@@ -15,8 +15,47 @@
 #include "SVGBaseTrigger.h"
 #include "../trigger/TriggerDelayedUse.h"
 
+// Savegame fields. The hot fields in the entity component arrays are saved
+// separately, see write_components in save.cpp.
+DefineSaveFields( SVGBaseEntity,
+	SaveField_Int( flags ),
+	SaveField_Int( spawnFlags ),
+	SaveField_String( model ),
+	SaveField_String( killTargetStr ),
+	SaveField_String( targetStr ),
+	SaveField_String( targetNameStr ),
+	SaveField_String( messageStr ),
+	SaveField_Int( waterType ),
+	SaveField_Int( waterLevel ),
+	SaveField_Int( mass ),
+	SaveField_ServerEntity( goalEntityPtr ),
+	SaveField_ServerEntity( moveTargetPtr ),
+	SaveField_Entity( activator ),
+	SaveField_Float( yawSpeed ),
+	SaveField_Float( idealYawAngle ),
+	SaveField_Float( delayTime ),
+	SaveField_Float( waitTime ),
+	SaveField_Int( health ),
+	SaveField_Int( maxHealth ),
+	SaveField_Int( viewHeight ),
+	SaveField_Int( takeDamage ),
+	SaveField_Int( damage ),
+	SaveField_Int( deadFlag ),
+	SaveField_Entity( enemyEntity ),
+	SaveField_Entity( oldEnemyEntity ),
+	SaveField_Entity( ownerEntity ),
+	SaveField_Entity( teamChainEntity ),
+	SaveField_Entity( teamMasterEntity )
+)
+
 // Constructor/Deconstructor.
-SVGBaseEntity::SVGBaseEntity(Entity* svEntity) : serverEntity(svEntity) {
+SVGBaseEntity::SVGBaseEntity(Entity* svEntity) : serverEntity(svEntity), componentIndex(svEntity->state.number) {
+	//
+	// Our slot in the entity component arrays is not touched here, another
+	// instance may still be using it. It is reset when an entity is freed,
+	// and when the entities are cleared for a new level, or a savegame.
+	//
+
 	//
 	// All callback functions best be nullptr.
 	//
@@ -31,7 +70,6 @@ SVGBaseEntity::SVGBaseEntity(Entity* svEntity) : serverEntity(svEntity) {
 	// Set all entity pointer references to nullptr.
 	//
 	enemyEntity = nullptr;
-	groundEntity = nullptr;
 	oldEnemyEntity = nullptr;
 	teamChainEntity = nullptr;
 	teamMasterEntity = nullptr;
@@ -39,21 +77,14 @@ SVGBaseEntity::SVGBaseEntity(Entity* svEntity) : serverEntity(svEntity) {
 	//
 	// Default values for members.
 	//
-	moveType = MoveType::None;
-
-	// Velocity.
 	delayTime = 0;
 	waitTime = 0;
 
 	flags = 0;
 	spawnFlags = 0;
-	velocity = vec3_zero();
-	angularVelocity = vec3_zero();
 	mass = 0;
-	gravity = 1.f;
 	yawSpeed = 0.f;
 	idealYawAngle = 0.f;
-	groundEntityLinkCount = 0;
 	health = 0;
 	maxHealth = 0;
 	deadFlag = DEAD_NO;
@@ -15,6 +15,9 @@
 // because this class absolutely requires it
 #include "../../TypeInfo.h"
 
+// Hot per tick fields are stored in the entity component arrays.
+#include "EntityComponents.h"
+
 class SVGBaseEntity {
 public:
     //
@@ -35,6 +38,8 @@ public:
 
     // Runtime type information
     DefineTopAbstractClass( SVGBaseEntity );
+    // Savegame fields
+    DeclareSaveFields();
 
     // Checks if this entity class is exactly the given class
     // @param entityClass: an entity class which must inherint from SVGBaseEntity
@@ -110,7 +115,7 @@ public:
 
     // Return the 'angularVelocity' value.
     inline const vec3_t& GetAngularVelocity() {
-        return angularVelocity;
+        return g_entityComponents.angularVelocity[componentIndex];
     }
     // @returns The local center
     inline vec3_t GetCenter() {
@@ -192,17 +197,17 @@ public:
 
     // Return the 'gravity' value.
     inline const float GetGravity() {
-        return gravity;
+        return g_entityComponents.gravity[componentIndex];
     }
 
     // Return the 'groundEntitPtr' entity.
     inline SVGBaseEntity* GetGroundEntity() {
-        return groundEntity;
+        return g_entityComponents.groundEntity[componentIndex];
     }
 
     // Return the 'groundEntityLinkCount' value.
     inline int32_t GetGroundEntityLinkCount() {
-        return groundEntityLinkCount;
+        return g_entityComponents.groundEntityLinkCount[componentIndex];
     }
 
     // Return the 'health' value.
@@ -280,12 +285,12 @@ public:
 
     // Return the 'movetype' value.
     inline const int32_t GetMoveType() {
-        return moveType;
+        return g_entityComponents.moveType[componentIndex];
     } 
 
     // Return the 'nextThinkTime' value.
     inline const float GetNextThinkTime() {
-        return nextThinkTime;
+        return g_entityComponents.nextThinkTime[componentIndex];
     }
 
     // Return the 'noiseIndex' value.
@@ -416,7 +421,7 @@ public:
 
     // Return the 'velocity' value.
     inline const vec3_t& GetVelocity() {
-        return velocity;
+        return g_entityComponents.velocity[componentIndex];
     }
 
     // Return the 'wait' value.
@@ -458,7 +463,7 @@ public:
 
     // Set the 'angularVelocity' value.
     inline void SetAngularVelocity(const vec3_t& angularVelocity) {
-        this->angularVelocity = angularVelocity;
+        g_entityComponents.angularVelocity[componentIndex] = angularVelocity;
     }
 
     // Set the 'mins', and 'maxs' values of the entity bounding box.
@@ -514,19 +519,19 @@ public:
 
     // Set the 'gravity' value.
     inline void SetGravity(const float &gravity) {
-        this->gravity = gravity;
+        g_entityComponents.gravity[componentIndex] = gravity;
     }
 
     // Set the 'groundEntitPtr' entity.
     inline void SetGroundEntity(SVGBaseEntity* groundEntity) {
         // Set SVGBaseEntity variant ground entity.
-        this->groundEntity = groundEntity;
+        g_entityComponents.groundEntity[componentIndex] = groundEntity;
     }
 
     // Set the 'groundEntityLinkCount' value.
     inline void SetGroundEntityLinkCount(int32_t groundEntityLinkCount) {
         // Set it for THIS class entity.
-        this->groundEntityLinkCount = groundEntityLinkCount;
+        g_entityComponents.groundEntityLinkCount[componentIndex] = groundEntityLinkCount;
     }
 
     // Set the 'health' value.
@@ -607,12 +612,12 @@ public:
 
     // Set the 'moveType' value.
     inline void SetMoveType(const int32_t &moveType) {
-        this->moveType = moveType;
+        g_entityComponents.moveType[componentIndex] = moveType;
     }
 
     // Set the 'nextThinkTime' value.
     inline void SetNextThinkTime(const float& nextThinkTime) {
-        this->nextThinkTime = nextThinkTime;
+        g_entityComponents.nextThinkTime[componentIndex] = nextThinkTime;
     }
 
     // Set the 'noiseIndex' value.
@@ -720,7 +725,7 @@ public:
 
     // Set the 'velocity' value.
     inline void SetVelocity(const vec3_t &velocity) {
-        this->velocity = velocity;
+        g_entityComponents.velocity[componentIndex] = velocity;
     }
 
     // Return the 'wait' value.
@@ -761,6 +766,11 @@ public:
         return serverEntity;
     }
 
+    // Returns the index of this entity its slot in the entity component arrays.
+    inline int32_t GetComponentIndex() {
+        return componentIndex;
+    }
+
     // Used only in SVG_FreeEntity
     inline void SetServerEntity( Entity* svEntity )
     {
@@ -784,6 +794,13 @@ protected:
     //
     Entity *serverEntity;
 
+    //
+    // Index into the entity component arrays, which hold the hot per tick
+    // fields: velocity, angularVelocity, moveType, gravity, nextThinkTime,
+    // groundEntity and groundEntityLinkCount. Equals the entity number.
+    //
+    int32_t componentIndex;
+
     //
     // Other base entity members. (These were old fields in edict_T back in the day.)
     //
@@ -810,8 +827,6 @@ protected:
 
     //---------------------------------
     // -- Types (Move, Water, what have ya? Add in here.)
-    // Move Type. (MoveType::xxx)
-    int32_t moveType;
     // WaterType::xxxx
     int32_t waterType;
     // WaterLevel::xxxx
@@ -821,14 +836,8 @@ protected:
     // -- Physics
     // Angle direction: Set in Trenchbroom -1 = up -2 = down.
     //float angle;
-    // Velocity.
-    vec3_t velocity;
-    // Angular Velocity.
-    vec3_t angularVelocity;
     // Mass
     int32_t mass;
-    // Per entity gravity multiplier (1.0 is normal). TIP: Use for lowgrav artifact, flares
-    float gravity;
     
     //-----------------------------------
     // -- Pointers.
@@ -846,16 +855,11 @@ protected:
 
     //------------------------------------
     // Timing.
-    // The next 'think' time, determines when to call the 'think' callback.
-    float nextThinkTime;
     // Delay before calling trigger execution.
     float delayTime;
     // Wait time before triggering at all, in case it was set to auto.
     float waitTime;
 
-    // Ground Entity link count. (To keep track if it is linked or not.)
-    int32_t groundEntityLinkCount;
-
     //------------------------------------
     // Entity Status.
     // Current health.
@@ -884,8 +888,6 @@ protected:
     // 
     // Current active enemy, NULL if not any.    
     SVGBaseEntity *enemyEntity;
-    // Ground entity we're standing on.
-    SVGBaseEntity *groundEntity;
     // Old enemy, NULL if not any.
     SVGBaseEntity *oldEnemyEntity;
 
@@ -16,6 +16,36 @@
 #include "SVGBaseTrigger.h"
 #include "SVGBaseMover.h"
 
+// Savegame fields.
+DefineSaveFields( SVGBaseMover,
+	SaveField_Float( speed ),
+	SaveField_Float( acceleration ),
+	SaveField_Float( deceleration ),
+	SaveField_Vector3( moveDirection ),
+	SaveField_Vector3( startPosition ),
+	SaveField_Vector3( endPosition ),
+	SaveField_Vector3( moveInfo.startOrigin ),
+	SaveField_Vector3( moveInfo.startAngles ),
+	SaveField_Vector3( moveInfo.endOrigin ),
+	SaveField_Vector3( moveInfo.endAngles ),
+	SaveField_Int( moveInfo.startSoundIndex ),
+	SaveField_Int( moveInfo.middleSoundIndex ),
+	SaveField_Int( moveInfo.endSoundIndex ),
+	SaveField_Float( moveInfo.acceleration ),
+	SaveField_Float( moveInfo.speed ),
+	SaveField_Float( moveInfo.deceleration ),
+	SaveField_Float( moveInfo.distance ),
+	SaveField_Float( moveInfo.wait ),
+	SaveField_Int( moveInfo.state ),
+	SaveField_Vector3( moveInfo.dir ),
+	SaveField_Float( moveInfo.currentSpeed ),
+	SaveField_Float( moveInfo.moveSpeed ),
+	SaveField_Float( moveInfo.nextSpeed ),
+	SaveField_Float( moveInfo.remainingDistance ),
+	SaveField_Float( moveInfo.deceleratedDistance ),
+	SaveField_Float( lip )
+)
+
 // Constructor/Deconstructor.
 SVGBaseMover::SVGBaseMover(Entity* svEntity) : SVGBaseTrigger(svEntity) {
 	//
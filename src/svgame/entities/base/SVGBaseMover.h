@@ -68,6 +68,7 @@ public:
     virtual ~SVGBaseMover();
 
     DefineAbstractClass( SVGBaseMover, SVGBaseTrigger );
+    DeclareSaveFields();
 
     //
     // Interface functions. 
@@ -18,6 +18,11 @@
 // Included for delayed use.
 #include "../trigger/TriggerDelayedUse.h"
 
+// Savegame fields.
+DefineSaveFields( SVGBaseTrigger,
+	SaveField_Entity( activatorEntity )
+)
+
 // Constructor/Deconstructor.
 SVGBaseTrigger::SVGBaseTrigger(Entity* svEntity) : SVGBaseEntity(svEntity) {
 	//
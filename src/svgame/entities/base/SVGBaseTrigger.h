@@ -19,6 +19,7 @@ public:
     virtual ~SVGBaseTrigger();
 
     DefineAbstractClass( SVGBaseTrigger, SVGBaseEntity );
+    DeclareSaveFields();
 
     //
     // Interface functions. 
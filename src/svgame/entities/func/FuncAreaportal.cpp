@@ -15,6 +15,11 @@
 
 #include "FuncAreaportal.h"
 
+// Savegame fields.
+DefineSaveFields( FuncAreaportal,
+	SaveField_Bool( turnedOn )
+)
+
 //===============
 // FuncAreaportal::ctor
 //===============
@@ -15,6 +15,7 @@ public:
 	virtual ~FuncAreaportal() = default;
 
 	DefineMapClass( "func_areaportal", FuncAreaportal, SVGBaseEntity );
+	DeclareSaveFields();
 
 	void Spawn() override;
 	void SpawnKey( const std::string& key, const std::string& value ) override;
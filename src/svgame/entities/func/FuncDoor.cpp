@@ -20,6 +20,11 @@
 #include "FuncAreaportal.h"
 #include "FuncDoor.h"
 
+// Savegame fields.
+DefineSaveFields( FuncDoor,
+	SaveField_Float( debounceTouchTime )
+)
+
 //===============
 // FuncDoor::ctor
 //===============
@@ -11,6 +11,7 @@ public:
     virtual ~FuncDoor() = default;
 
     DefineMapClass( "func_door", FuncDoor, SVGBaseMover );
+    DeclareSaveFields();
 
     // Spawn flags
     static constexpr int32_t SF_StartOpen   = 1 << 0;
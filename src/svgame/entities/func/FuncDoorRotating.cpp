@@ -20,6 +20,11 @@
 #include "FuncDoor.h"
 #include "FuncDoorRotating.h"
 
+// Savegame fields.
+DefineSaveFields( FuncDoorRotating,
+	SaveField_Float( distance )
+)
+
 //===============
 // FuncDoorRotating::ctor
 //===============
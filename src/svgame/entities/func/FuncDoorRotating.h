@@ -10,6 +10,7 @@ public:
 	virtual ~FuncDoorRotating() = default;
 
 	DefineMapClass( "func_door_rotating", FuncDoorRotating, FuncDoor );
+	DeclareSaveFields();
 
 	void Spawn() override;
 	void SpawnKey( const std::string& key, const std::string& value ) override;
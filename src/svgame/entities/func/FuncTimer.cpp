@@ -15,6 +15,11 @@
 
 #include "FuncTimer.h"
 
+// Savegame fields.
+DefineSaveFields( FuncTimer,
+	SaveField_Float( randomTime )
+)
+
 //===============
 // FuncTimer::ctor
 //===============
@@ -42,7 +47,7 @@ void FuncTimer::Spawn() {
 	}
 
 	if ( spawnFlags & SF_StartOn ) {
-		nextThinkTime = level.time + 1.0f + st.pausetime + delayTime + waitTime + crandom() * randomTime;
+		SetNextThinkTime( level.time + 1.0f + st.pausetime + delayTime + waitTime + crandom() * randomTime );
 		activator = this;
 	}
 
@@ -78,7 +83,7 @@ void FuncTimer::TimerUse( SVGBaseEntity* other, SVGBaseEntity* activator ) {
 	this->activator = activator;
 
 	// If on, turn it off
-	if ( nextThinkTime ) {
+	if ( GetNextThinkTime() ) {
 		SetNextThinkTime( 0.0f );
 		return;
 	}
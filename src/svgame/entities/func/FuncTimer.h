@@ -16,6 +16,7 @@ public:
 	virtual ~FuncTimer() = default;
 
 	DefineMapClass( "func_timer", FuncTimer, SVGBaseEntity );
+	DeclareSaveFields();
 
 	// Spawn flags
 	static constexpr int32_t SF_StartOn = 1 << 0;
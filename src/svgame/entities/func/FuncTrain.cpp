@@ -14,6 +14,12 @@
 #include "../path/PathCorner.h"
 #include "FuncTrain.h"
 
+// Savegame fields.
+DefineSaveFields( FuncTrain,
+	SaveField_Entity( currentPathEntity ),
+	SaveField_Float( damageDebounceTime )
+)
+
 //===============
 // FuncTrain::ctor
 //===============
@@ -11,6 +11,7 @@ public:
 	virtual ~FuncTrain() = default;
 
 	DefineMapClass( "func_train", FuncTrain, SVGBaseMover );
+	DeclareSaveFields();
 
 	// Spawnflags
 	static constexpr int32_t SF_StartOn = 1 << 0;
@@ -12,6 +12,12 @@
 #include "base/SVGBaseTrigger.h"
 #include "Light.h"
 
+// Savegame fields.
+DefineSaveFields( Light,
+	SaveField_String( customLightStyle ),
+	SaveField_Int( lightState )
+)
+
 // SpawnFlags.
 #define START_OFF   1   
 #define TRIGGERABLE 2
@@ -18,6 +18,16 @@
 // Misc Server Model Entity.
 #include "MiscServerModel.h"
 
+// Savegame fields.
+DefineSaveFields( MiscServerModel,
+	SaveField_String( noisePath ),
+	SaveField_Int( precachedNoiseIndex ),
+	SaveField_Int( startFrame ),
+	SaveField_Int( endFrame ),
+	SaveField_Vector3( boundingBoxMins ),
+	SaveField_Vector3( boundingBoxMaxs )
+)
+
 
 
 //
@@ -18,6 +18,7 @@ public:
     virtual ~MiscServerModel();
 
     DefineMapClass("misc_servermodel", MiscServerModel, SVGBaseTrigger);
+    DeclareSaveFields();
 
     //
     // Interface functions. 
@@ -9,6 +9,11 @@
 
 #include "PathCorner.h"
 
+// Savegame fields.
+DefineSaveFields( PathCorner,
+	SaveField_String( pathTarget )
+)
+
 //===============
 // PathCorner::ctor
 //===============
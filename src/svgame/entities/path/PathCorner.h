@@ -8,6 +8,7 @@ public:
 	virtual ~PathCorner() = default;
 
 	DefineMapClass( "path_corner", PathCorner, SVGBaseEntity );
+	DeclareSaveFields();
 
 	const vec3_t	BboxSize = vec3_t( 8.0f, 8.0f, 8.0f );
 
@@ -19,6 +19,11 @@
 
 #include "TriggerAutoDoor.h"
 
+// Savegame fields.
+DefineSaveFields( TriggerAutoDoor,
+	SaveField_Float( debounceTouchTime )
+)
+
 //===============
 // TriggerAutoDoor::ctor
 //===============
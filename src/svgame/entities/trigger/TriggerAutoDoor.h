@@ -11,6 +11,7 @@ public:
 	virtual ~TriggerAutoDoor() = default;
 
 	DefineClass( TriggerAutoDoor, SVGBaseTrigger );
+	DeclareSaveFields();
 
 	void					Spawn() override;
 	// Responds to players touching this trigger
@@ -13,6 +13,11 @@
 #include "../base/SVGBaseTrigger.h"
 #include "TriggerHurt.h"
 
+// Savegame fields.
+DefineSaveFields( TriggerHurt,
+	SaveField_Float( lastHurtTime )
+)
+
 //
 // Spawn Flags.
 // 
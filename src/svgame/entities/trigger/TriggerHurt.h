@@ -19,6 +19,7 @@ public:
     virtual ~TriggerHurt();
 
     DefineMapClass( "trigger_hurt", TriggerHurt, SVGBaseTrigger );
+    DeclareSaveFields();
 
     //
     // Interface functions. 
@@ -81,6 +81,7 @@ constexpr float FRAMETIME = BASE_FRAMETIME_1000; // With the game set to run at
 // memory tags to allow dynamic memory to be cleaned up
 constexpr int32_t TAG_GAME = 765;     // clear when unloading the dll
 constexpr int32_t TAG_LEVEL = 766;     // clear when loading a new level
+constexpr int32_t TAG_CLASSENTITY = 767; // class entity pool slabs, cleared in SVG_ClassEntityPool_Reset
 
 
 constexpr int32_t MELEE_DISTANCE = 80;
@@ -657,6 +658,16 @@ Entity *SVG_PlayerTrail_LastSpot(void);
 void SVG_Player_Pain(Entity *self, Entity *other, float kick, int32_t damage);
 void SVG_Player_Die(Entity *self, Entity *inflictor, Entity *attacker, int32_t damage, const vec3_t& point);
 
+//
+// save.cpp
+//
+void SVG_SaveBenchmark_f(void);
+
+//
+// player/client.cpp
+//
+void SVG_PMoveBenchmark_f(void);
+
 //
 // g_svcmds.c
 //
@@ -672,6 +683,7 @@ void SVG_PlayerNoise(SVGBaseEntity *who, vec3_t where, int32_t type);
 // g_phys.c
 //
 void SVG_RunEntity(SVGBaseEntity *ent);
+void SVG_Physics_BuildRiderCache(void);
 
 //
 // g_main.c
@@ -167,28 +167,27 @@ qboolean DefaultGameMode::CanDamage(SVGBaseEntity* target, SVGBaseEntity* inflic
 //===============
 // DefaultGameMode::FindWithinRadius
 //
-// Returns a BaseEntityVector list containing the results of the found
+// Returns a BaseEntitySpan list containing the results of the found
 // given entities that reside within the origin to radius. 
 // 
-// Flags can be set to determine which "solids" to exclude.
-//===============
-BaseEntityVector DefaultGameMode::FindBaseEnitiesWithinRadius(const vec3_t& origin, float radius, uint32_t excludeSolidFlags) {
-    // List of base entities to return.
-    std::vector<SVGBaseEntity*> baseEntityList;
-
-    // Iterate over all entities, see who is nearby, and who is not.
-    for (auto* radiusBaseEntity : GetBaseEntityRange<0, MAX_EDICTS>()
-        | bef::IsValidPointer
-        | bef::HasServerEntity
-        | bef::InUse
-        | bef::WithinRadius(origin, radius, excludeSolidFlags)) {
+// Entities of the 'excludeSolidFlags' solid type are left out. Those that
+// are Solid::Not are never found, they aren't linked in the area tree.
+// The list is valid until the end of the current frame.
+//===============
+BaseEntitySpan DefaultGameMode::FindBaseEnitiesWithinRadius(const vec3_t& origin, float radius, uint32_t excludeSolidFlags) {
+    // Query the area tree, results are stored in the frame entity arena.
+    BaseEntitySpan radiusEntities = SVG_FindEntitiesWithinRadius(origin, radius);
+
+    // Filter out the excluded solids in place.
+    size_t numFound = 0;
+    for (auto* radiusEntity : radiusEntities) {
+        if (radiusEntity->GetSolid() == excludeSolidFlags)
+            continue;
 
-        // Push radiusEntity result item to the list.
-        baseEntityList.push_back(radiusBaseEntity);
+        radiusEntities[numFound++] = radiusEntity;
     }
 
-    // The list might be empty, ensure to check for that ;-)
-    return baseEntityList;
+    return radiusEntities.first(numFound);
 }
 
 //===============
@@ -402,7 +401,7 @@ void DefaultGameMode::InflictRadiusDamage(SVGBaseEntity* inflictor, SVGBaseEntit
     }
 
     // Find entities within radius.
-    BaseEntityVector radiusEntities = FindBaseEnitiesWithinRadius(inflictor->GetOrigin(), radius, Solid::Not);
+    BaseEntitySpan radiusEntities = FindBaseEnitiesWithinRadius(inflictor->GetOrigin(), radius, Solid::Not);
 
     //while ((ent = SVG_FindEntitiesWithinRadius(ent, inflictor->GetOrigin(), radius)) != NULL) {
     for (auto& baseEntity : radiusEntities) {
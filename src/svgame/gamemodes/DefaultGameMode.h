@@ -29,7 +29,7 @@ public:
     virtual qboolean GetEntityTeamName(SVGBaseEntity* ent, std::string &teamName) override;
     virtual qboolean OnSameTeam(SVGBaseEntity* ent1, SVGBaseEntity* ent2) override;
     virtual qboolean CanDamage(SVGBaseEntity* targ, SVGBaseEntity* inflictor) override;
-    virtual BaseEntityVector FindBaseEnitiesWithinRadius(const vec3_t& origin, float radius, uint32_t excludeSolidFlags) override;
+    virtual BaseEntitySpan FindBaseEnitiesWithinRadius(const vec3_t& origin, float radius, uint32_t excludeSolidFlags) override;
 
     //
     // Combat GameMode actions.
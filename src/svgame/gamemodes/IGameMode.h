@@ -15,6 +15,7 @@ class SVGBaseEntity;
 class PlayerClient;
 
 using BaseEntityVector = std::vector<SVGBaseEntity*>;
+using BaseEntitySpan = std::span<SVGBaseEntity*>;
 
 class IGameMode {
 public:
@@ -85,7 +86,8 @@ public:
     virtual qboolean CanDamage(SVGBaseEntity * target, SVGBaseEntity * inflictor) = 0;
     // Returns the entities found within a radius. Great for game mode fun times,
     // and that is why it resides here. Allows for customization.
-    virtual BaseEntityVector FindBaseEnitiesWithinRadius(const vec3_t &origin, float radius, uint32_t excludeSolidFlags) = 0;
+    // The returned span lives in the frame entity arena, valid until the end of the frame.
+    virtual BaseEntitySpan FindBaseEnitiesWithinRadius(const vec3_t &origin, float radius, uint32_t excludeSolidFlags) = 0;
 
     //
     // Combat GameMode actions.
@@ -21,6 +21,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 // Entities.
 #include "entities.h"
+#include "ClassEntityPool.h"
 #include "entities/base/SVGBaseEntity.h"
 #include "entities/base/PlayerClient.h"
 
@@ -112,6 +113,7 @@ void SVG_AllocateGamePlayerClientEntities();
 void SVG_InitializeCVars();
 
 void SVG_RunEntity(SVGBaseEntity *ent);
+void SVG_Physics_BuildRiderCache(void);
 void SVG_WriteGame(const char *filename, qboolean autosave);
 void SVG_ReadGame(const char *filename);
 void SVG_WriteLevel(const char *filename);
@@ -172,6 +174,9 @@ void SVG_ShutdownGame(void) {
         game.gameMode = nullptr;
     }
 
+    // Destruct the class entities, and release their pools.
+    SVG_ClassEntityPool_Reset();
+
     // These old school CVars gotta be deleted from their stash. 
     gi.FreeTags(TAG_LEVEL);
     gi.FreeTags(TAG_GAME);
@@ -635,6 +640,12 @@ void SVG_RunFrame(void)
     // Fetch the corresponding base entity.
     SVGBaseEntity* entity = g_baseEntities[stateNumber];
 
+    // Release the entity lists of the previous frame.
+    SVG_ResetFrameEntityArena();
+
+    // Index who is riding on who, so pushers don't have to scan all entities.
+    SVG_Physics_BuildRiderCache();
+
     // Loop through the server entities, and run the base entity frame if any exists.
     for (int32_t i = 0; i < globals.numberOfEntities; i++) {
         // Acquire state number.
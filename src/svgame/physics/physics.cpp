@@ -76,13 +76,12 @@ SVGBaseEntity *SVG_TestEntityPosition(SVGBaseEntity *ent)
 //
 void SVG_BoundVelocity(SVGBaseEntity *ent)
 {
-    vec3_t velocity = ent->GetVelocity();
+    // Operate on the component array directly.
+    vec3_t &velocity = g_entityComponents.velocity[ent->GetComponentIndex()];
 
-    ent->SetVelocity(vec3_t {
-        Clampf(velocity.x, -sv_maxvelocity->value, sv_maxvelocity->value),
-        Clampf(velocity.y, -sv_maxvelocity->value, sv_maxvelocity->value),
-        Clampf(velocity.z, -sv_maxvelocity->value, sv_maxvelocity->value)
-    });
+    velocity.x = Clampf(velocity.x, -sv_maxvelocity->value, sv_maxvelocity->value);
+    velocity.y = Clampf(velocity.y, -sv_maxvelocity->value, sv_maxvelocity->value);
+    velocity.z = Clampf(velocity.z, -sv_maxvelocity->value, sv_maxvelocity->value);
 }
 
 
@@ -355,14 +354,11 @@ int SVG_FlyMove(SVGBaseEntity *ent, float time, int mask)
 //
 void SVG_AddGravity(SVGBaseEntity *ent)
 {
-    // Fetch velocity.
-    vec3_t velocity = ent->GetVelocity();
+    // Fetch component index.
+    const int32_t index = ent->GetComponentIndex();
 
     // Apply gravity.
-    velocity.z -= ent->GetGravity() * sv_gravity->value * FRAMETIME;
-
-    // Apply new velocity to entity.
-    ent->SetVelocity(velocity);
+    g_entityComponents.velocity[index].z -= g_entityComponents.gravity[index] * sv_gravity->value * FRAMETIME;
 }
 
 //
@@ -433,6 +429,129 @@ pushed_t    pushed[MAX_EDICTS], *pushed_p;
 
 SVGBaseEntity *obstacle;
 
+//
+// Rider cache, a per frame index of "who is standing on who", built from the
+// ground entity links. Stored as a singly linked list of entity numbers per
+// ground entity, so building and walking it never allocates.
+//
+static int32_t riderCacheFirst[MAX_EDICTS];
+static int32_t riderCacheNext[MAX_EDICTS];
+
+//
+// Scratch space for SVG_Push its candidate gathering.
+//
+static Entity *pushAreaList[MAX_EDICTS];
+static int32_t pushCandidates[MAX_EDICTS];
+static int32_t pushCandidateStamps[MAX_EDICTS];
+static int32_t pushCandidateStamp;
+
+
+//
+//===============
+// SVG_Physics_BuildRiderCache
+//
+// Builds the rider cache out of the current ground entity links. Has to be
+// called once at the start of each frame, before any pusher gets to move.
+//===============
+//
+void SVG_Physics_BuildRiderCache(void)
+{
+    for (int32_t e = 0; e < globals.numberOfEntities; e++) {
+        riderCacheFirst[e] = -1;
+        riderCacheNext[e] = -1;
+    }
+
+    for (int32_t e = 1; e < globals.numberOfEntities; e++) {
+        // Walk the ground entity component array, skip those without.
+        SVGBaseEntity *groundEntity = g_entityComponents.groundEntity[e];
+
+        if (!groundEntity || !groundEntity->GetServerEntity())
+            continue;
+
+        SVGBaseEntity *rider = g_baseEntities[e];
+
+        if (!rider || !rider->GetServerEntity() || !rider->IsInUse())
+            continue;
+
+        int32_t groundNumber = groundEntity->GetNumber();
+        if (groundNumber <= 0 || groundNumber >= globals.numberOfEntities)
+            continue;
+
+        // Link it in.
+        riderCacheNext[e] = riderCacheFirst[groundNumber];
+        riderCacheFirst[groundNumber] = e;
+    }
+}
+
+//
+//===============
+// SVG_Push_AddCandidate
+//
+// Adds an entity number to the push candidate list, unless it was already
+// added for the current push.
+//===============
+//
+static inline void SVG_Push_AddCandidate(int32_t number, int32_t &numCandidates)
+{
+    if (number <= 0 || number >= globals.numberOfEntities)
+        return;
+
+    if (pushCandidateStamps[number] == pushCandidateStamp)
+        return;
+
+    pushCandidateStamps[number] = pushCandidateStamp;
+    pushCandidates[numCandidates++] = number;
+}
+
+static int SVG_Push_CandidateCmp(const void *p1, const void *p2)
+{
+    return *(const int32_t *)p1 - *(const int32_t *)p2;
+}
+
+//
+//===============
+// SVG_Push_GatherCandidates
+//
+// Collects every entity that SVG_Push has to consider: all entities linked
+// in the area tree within the swept pusher bounds, plus its cached riders.
+// The result is sorted by entity number, so the pushes are processed in the
+// exact same order as a full scan of the entity list would.
+//===============
+//
+static int32_t SVG_Push_GatherCandidates(SVGBaseEntity *pusher, const vec3_t &sweptMins, const vec3_t &sweptMaxs)
+{
+    int32_t numCandidates = 0;
+
+    // Start a new candidate stamp, wrapping around clears the old stamps.
+    if (++pushCandidateStamp <= 0) {
+        memset(pushCandidateStamps, 0, sizeof(pushCandidateStamps));
+        pushCandidateStamp = 1;
+    }
+
+    // Both solids and triggers, since items are Solid::Trigger, and are pushed too.
+    int32_t numAreaEntities = gi.BoxEntities(sweptMins, sweptMaxs, pushAreaList, MAX_EDICTS, AREA_SOLID);
+    for (int32_t i = 0; i < numAreaEntities; i++) {
+        SVG_Push_AddCandidate(pushAreaList[i]->state.number, numCandidates);
+    }
+
+    numAreaEntities = gi.BoxEntities(sweptMins, sweptMaxs, pushAreaList, MAX_EDICTS, AREA_TRIGGERS);
+    for (int32_t i = 0; i < numAreaEntities; i++) {
+        SVG_Push_AddCandidate(pushAreaList[i]->state.number, numCandidates);
+    }
+
+    // Riders may be out of the area bounds, they're moved regardless.
+    int32_t pusherNumber = pusher->GetNumber();
+    if (pusherNumber > 0 && pusherNumber < globals.numberOfEntities) {
+        for (int32_t e = riderCacheFirst[pusherNumber]; e != -1; e = riderCacheNext[e]) {
+            SVG_Push_AddCandidate(e, numCandidates);
+        }
+    }
+
+    qsort(pushCandidates, numCandidates, sizeof(pushCandidates[0]), SVG_Push_CandidateCmp);
+
+    return numCandidates;
+}
+
 
 //
 //===============
@@ -444,7 +563,6 @@ SVGBaseEntity *obstacle;
 //
 qboolean SVG_Push(SVGBaseEntity *pusher, vec3_t move, vec3_t amove)
 {
-    int e;
     SVGBaseEntity* check = NULL;
     SVGBaseEntity* block = NULL;
     pushed_t    *p = NULL;
@@ -454,6 +572,10 @@ qboolean SVG_Push(SVGBaseEntity *pusher, vec3_t move, vec3_t amove)
     vec3_t mins = pusher->GetAbsoluteMin() + move;
     vec3_t maxs = pusher->GetAbsoluteMax() + move;
 
+    // The swept bounds, covering both the original and final position.
+    vec3_t sweptMins = vec3_minf(pusher->GetAbsoluteMin(), mins);
+    vec3_t sweptMaxs = vec3_maxf(pusher->GetAbsoluteMax(), maxs);
+
     // We need this for pushing things later
     VectorSubtract(vec3_zero(), amove, org);
     AngleVectors(org, &forward, &right, &up);
@@ -475,10 +597,13 @@ qboolean SVG_Push(SVGBaseEntity *pusher, vec3_t move, vec3_t amove)
     pusher->SetAngles(pusher->GetAngles() + amove);
     pusher->LinkEntity();
 
+// gather the entities that could possibly be affected
+    int32_t numCandidates = SVG_Push_GatherCandidates(pusher, sweptMins, sweptMaxs);
+
 // see if any solid entities are inside the final position
-    for (e = 1; e < globals.numberOfEntities; e++) {
+    for (int32_t c = 0; c < numCandidates; c++) {
         // Fetch the base entity and ensure it is valid.
-        check = g_baseEntities[e];
+        check = g_baseEntities[pushCandidates[c]];
 
         if (!check)
             continue;
@@ -840,8 +965,8 @@ constexpr float STEPMOVE_WATERFRICTION = 1.f;
 //
 void SVG_AddRotationalFriction(SVGBaseEntity *ent)
 { 
-    // Acquire the rotational velocity first.
-    vec3_t angularVelocity = ent->GetAngularVelocity();
+    // Acquire the rotational velocity first, straight from the component array.
+    vec3_t &angularVelocity = g_entityComponents.angularVelocity[ent->GetComponentIndex()];
 
     // Set angles in proper direction.
     ent->SetAngles(vec3_fmaf(ent->GetAngles(), FRAMETIME, angularVelocity));
@@ -850,7 +975,6 @@ void SVG_AddRotationalFriction(SVGBaseEntity *ent)
     float adjustment = FRAMETIME * STEPMOVE_STOPSPEED * STEPMOVE_FRICTION;
 
     // Apply adjustments.
-    angularVelocity = ent->GetAngularVelocity();
     for (int32_t n = 0; n < 3; n++) {
         if (angularVelocity[n] > 0) {
             angularVelocity[n] -= adjustment;
@@ -862,9 +986,6 @@ void SVG_AddRotationalFriction(SVGBaseEntity *ent)
                 angularVelocity[n] = 0;
         }
     }
-
-    // Last but not least, set the new angularVelocity.
-    ent->SetAngularVelocity(angularVelocity);
 }
 
 //
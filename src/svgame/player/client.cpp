@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 // General.
+#include <chrono>
 #include "../g_local.h"     // SVGame.
 #include "../chasecamera.h" // Chase Camera.
 #include "../effects.h"     // Effects.
@@ -765,6 +766,32 @@ void SVG_ClientDisconnect(Entity *ent)
 
 Entity *pm_passent;
 
+// Moves of the first client, recorded on request of "sv pmovebench record"
+// and replayed by SVG_PMoveBenchmark_f.
+#define PMOVE_RECORD_SIZE   1024
+
+static struct {
+    PlayerMoveState     states[PMOVE_RECORD_SIZE];  // state before each move
+    ClientMoveCommand   commands[PMOVE_RECORD_SIZE];
+    Entity              *groundEntities[PMOVE_RECORD_SIZE];
+    int32_t             count;  // number of moves recorded
+    qboolean            active; // recording until the buffer is full
+} pmoveRecording;
+
+static void PM_RecordMove(const PlayerMove *pm)
+{
+    int32_t index = pmoveRecording.count++;
+
+    pmoveRecording.states[index] = pm->state;
+    pmoveRecording.commands[index] = pm->moveCommand;
+    pmoveRecording.groundEntities[index] = pm->groundEntityPtr;
+
+    if (pmoveRecording.count == PMOVE_RECORD_SIZE) {
+        pmoveRecording.active = false;
+        gi.CPrintf(NULL, PRINT_HIGH, "Recorded %i player moves.\n", pmoveRecording.count);
+    }
+}
+
 // pmove doesn't need to know about passent and contentmask
 trace_t q_gameabi PM_Trace(const vec3_t &start, const vec3_t &mins, const vec3_t &maxs, const vec3_t &end)
 {
@@ -876,6 +903,10 @@ void SVG_ClientThink(Entity *serverEntity, ClientMoveCommand *moveCommand)
         pm.Trace = PM_Trace;
         pm.PointContents = gi.PointContents;
 
+        // Keep the first client's moves around for benchmarking.
+        if (pmoveRecording.active && serverEntity == g_entities + 1)
+            PM_RecordMove(&pm);
+
         // perform a pmove
         PMove(&pm);
 
@@ -995,4 +1026,78 @@ void SVG_ClientThink(Entity *serverEntity, ClientMoveCommand *moveCommand)
         if (other->inUse && other->client->chaseTarget == serverEntity)
             SVG_UpdateChaseCam(classEntity);
     }
+}
+
+/*
+==============
+SVG_PMoveBenchmark_f
+
+sv pmovebench record
+sv pmovebench [players]
+
+Starts recording the moves of the first client, or replays the recorded
+moves for a number of simulated players, all starting from the same state. Moves of the players are
+interleaved the way a parallel simulation would run them, so all players
+ending up in the very same state shows that no state leaks between moves.
+==============
+*/
+void SVG_PMoveBenchmark_f(void)
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<PlayerMove> players;
+    Entity *serverEntity = g_entities + 1;
+    int32_t i, j, count, numPlayers, mismatches;
+
+    if (gi.argc() > 2 && !Q_stricmp(gi.argv(2), "record")) {
+        pmoveRecording.count = 0;
+        pmoveRecording.active = true;
+        gi.CPrintf(NULL, PRINT_HIGH, "Recording %i player moves.\n", PMOVE_RECORD_SIZE);
+        return;
+    }
+
+    numPlayers = gi.argc() > 2 ? atoi(gi.argv(2)) : 32;
+    numPlayers = max(numPlayers, 1);
+
+    count = pmoveRecording.count;
+    if (!count) {
+        gi.CPrintf(NULL, PRINT_HIGH, "No player moves recorded, use \"sv pmovebench record\" first.\n");
+        return;
+    }
+    if (!serverEntity->inUse || !serverEntity->classEntity) {
+        gi.CPrintf(NULL, PRINT_HIGH, "The recorded client is gone.\n");
+        return;
+    }
+
+    players.resize(numPlayers);
+    for (PlayerMove &pm : players) {
+        pm = {};
+        pm.state = pmoveRecording.states[0];
+        pm.groundEntityPtr = pmoveRecording.groundEntities[0];
+        pm.Trace = PM_Trace;
+        pm.PointContents = gi.PointContents;
+    }
+
+    pm_passent = serverEntity;
+
+    auto start = clock::now();
+    for (i = 0; i < count; i++) {
+        for (PlayerMove &pm : players) {
+            pm.moveCommand = pmoveRecording.commands[i];
+            PMove(&pm);
+        }
+    }
+    auto end = clock::now();
+
+    mismatches = 0;
+    for (j = 1; j < numPlayers; j++) {
+        if (memcmp(&players[j].state.origin, &players[0].state.origin, sizeof(vec3_t)) ||
+            memcmp(&players[j].state.velocity, &players[0].state.velocity, sizeof(vec3_t)) ||
+            players[j].state.flags != players[0].state.flags) {
+            mismatches++;
+        }
+    }
+
+    double msec = std::chrono::duration<double, std::milli>(end - start).count();
+    gi.CPrintf(NULL, PRINT_HIGH, "%i players x %i moves: %.3f ms, %.3f us per move, %i mismatches\n",
+        numPlayers, count, msec, msec * 1000 / ((double)numPlayers * count), mismatches);
 }
\ No newline at end of file
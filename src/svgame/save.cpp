@@ -16,8 +16,14 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 */
 
+#include <algorithm>
+#include <chrono>
+
 #include "g_local.h"
 #include "functionpointers.h"
+#include "entities.h"
+#include "ClassEntityPool.h"
+#include "entities/base/SVGBaseEntity.h"
 
 //#define _DEBUG
 typedef struct {
@@ -376,32 +382,92 @@ static const save_field_t gamefields[] = {
 
 //=========================================================
 
-static void write_data(void *buf, size_t len, FILE *f)
+// savegames are serialized into memory and handed over to the server,
+// which writes them out on its save thread
+typedef struct {
+    byte    *data;
+    size_t  size;
+    size_t  maxsize;
+    size_t  readcount;
+} savebuf_t;
+
+#define SAVEBUF_INITIAL_SIZE    0x40000
+
+static void open_write_buf(savebuf_t *f)
+{
+    f->data = (byte *)gi.TagMalloc(SAVEBUF_INITIAL_SIZE, TAG_GAME); // CPP: Cast
+    f->size = 0;
+    f->maxsize = SAVEBUF_INITIAL_SIZE;
+    f->readcount = 0;
+}
+
+static void close_write_buf(savebuf_t *f, const char *filename)
 {
-    if (fwrite(buf, 1, len, f) != len) {
-        gi.Error("%s: couldn't write %" PRIz " bytes", __func__, len); // CPP: String fix.
+    gi.WriteSaveFile(filename, f->data, f->size);
+    gi.TagFree(f->data);
+    f->data = NULL;
+}
+
+static void open_read_buf(savebuf_t *f, const char *filename)
+{
+    void *data;
+    ssize_t len;
+
+    len = gi.ReadSaveFile(filename, &data);
+    if (len < 0)
+        gi.Error("Couldn't open %s", filename);
+
+    f->data = (byte *)data; // CPP: Cast
+    f->size = len;
+    f->maxsize = len;
+    f->readcount = 0;
+}
+
+static void close_read_buf(savebuf_t *f)
+{
+    gi.TagFree(f->data);
+    f->data = NULL;
+}
+
+static void write_data(void *buf, size_t len, savebuf_t *f)
+{
+    if (f->size + len > f->maxsize) {
+        size_t maxsize = max(f->maxsize * 2, f->size + len);
+        byte *data = (byte *)gi.TagMalloc(maxsize, TAG_GAME); // CPP: Cast
+
+        if (!data) {
+            gi.Error("%s: couldn't write %" PRIz " bytes", __func__, len); // CPP: String fix.
+        }
+
+        memcpy(data, f->data, f->size);
+        gi.TagFree(f->data);
+        f->data = data;
+        f->maxsize = maxsize;
     }
+
+    memcpy(f->data + f->size, buf, len);
+    f->size += len;
 }
 
-static void write_short(FILE *f, short v)
+static void write_short(savebuf_t *f, short v)
 {
     v = LittleShort(v);
     write_data(&v, sizeof(v), f);
 }
 
-static void write_int(FILE *f, int v)
+static void write_int(savebuf_t *f, int v)
 {
     v = LittleLong(v);
     write_data(&v, sizeof(v), f);
 }
 
-static void write_float(FILE *f, float v)
+static void write_float(savebuf_t *f, float v)
 {
     v = LittleFloat(v);
     write_data(&v, sizeof(v), f);
 }
 
-static void write_string(FILE *f, char *s)
+static void write_string(savebuf_t *f, char *s)
 {
     size_t len;
 
@@ -415,14 +481,14 @@ static void write_string(FILE *f, char *s)
     write_data(s, len, f);
 }
 
-static void write_vector(FILE *f, vec_t *v)
+static void write_vector(savebuf_t *f, vec_t *v)
 {
     write_float(f, v[0]);
     write_float(f, v[1]);
     write_float(f, v[2]);
 }
 
-static void write_index(FILE *f, void *p, size_t size, void *start, int max_index)
+static void write_index(savebuf_t *f, void *p, size_t size, void *start, int max_index)
 {
     size_t diff;
 
@@ -442,10 +508,10 @@ static void write_index(FILE *f, void *p, size_t size, void *start, int max_inde
     write_int(f, (int)(diff / size));
 }
 
-static void write_pointer(FILE *f, void *p, ptr_type_t type)
+static void write_pointer(savebuf_t *f, void *p, ptr_type_t type)
 {
-    const save_ptr_t *ptr;
-    int i;
+    //const save_ptr_t *ptr;
+    //int i;
 
     if (!p) {
         write_int(f, -1);
@@ -463,7 +529,7 @@ static void write_pointer(FILE *f, void *p, ptr_type_t type)
     gi.Error("%s: unknown pointer: %p", __func__, p);
 }
 
-static void write_field(FILE *f, const save_field_t *field, void *base)
+static void write_field(savebuf_t *f, const save_field_t *field, void *base)
 {
     void *p = (byte *)base + field->ofs;
     int i;
@@ -520,7 +586,7 @@ static void write_field(FILE *f, const save_field_t *field, void *base)
     }
 }
 
-static void write_fields(FILE *f, const save_field_t *fields, void *base)
+static void write_fields(savebuf_t *f, const save_field_t *fields, void *base)
 {
     const save_field_t *field;
 
@@ -529,14 +595,17 @@ static void write_fields(FILE *f, const save_field_t *fields, void *base)
     }
 }
 
-static void read_data(void *buf, size_t len, FILE *f)
+static void read_data(void *buf, size_t len, savebuf_t *f)
 {
-    if (fread(buf, 1, len, f) != len) {
+    if (len > f->size - f->readcount) {
         gi.Error("%s: couldn't read %" PRIz " bytes", __func__, len); // CPP: String fix.
     }
+
+    memcpy(buf, f->data + f->readcount, len);
+    f->readcount += len;
 }
 
-static int read_short(FILE *f)
+static int read_short(savebuf_t *f)
 {
     short v;
 
@@ -546,7 +615,7 @@ static int read_short(FILE *f)
     return v;
 }
 
-static int read_int(FILE *f)
+static int read_int(savebuf_t *f)
 {
     int v;
 
@@ -556,7 +625,7 @@ static int read_int(FILE *f)
     return v;
 }
 
-static float read_float(FILE *f)
+static float read_float(savebuf_t *f)
 {
     float v;
 
@@ -567,7 +636,7 @@ static float read_float(FILE *f)
 }
 
 
-static char *read_string(FILE *f)
+static char *read_string(savebuf_t *f)
 {
     int len;
     char *s;
@@ -588,7 +657,7 @@ static char *read_string(FILE *f)
     return s;
 }
 
-static void read_zstring(FILE *f, char *s, size_t size)
+static void read_zstring(savebuf_t *f, char *s, size_t size)
 {
     int len;
 
@@ -601,14 +670,14 @@ static void read_zstring(FILE *f, char *s, size_t size)
     s[len] = 0;
 }
 
-static void read_vector(FILE *f, vec_t *v)
+static void read_vector(savebuf_t *f, vec_t *v)
 {
     v[0] = read_float(f);
     v[1] = read_float(f);
     v[2] = read_float(f);
 }
 
-static void *read_index(FILE *f, size_t size, void *start, int max_index)
+static void *read_index(savebuf_t *f, size_t size, void *start, int max_index)
 {
     int index;
     byte *p;
@@ -626,7 +695,7 @@ static void *read_index(FILE *f, size_t size, void *start, int max_index)
     return p;
 }
 
-static void *read_pointer(FILE *f, ptr_type_t type)
+static void *read_pointer(savebuf_t *f, ptr_type_t type)
 {
     int index;
     const save_ptr_t *ptr;
@@ -648,7 +717,7 @@ static void *read_pointer(FILE *f, ptr_type_t type)
     return ptr->ptr;
 }
 
-static void read_field(FILE *f, const save_field_t *field, void *base)
+static void read_field(savebuf_t *f, const save_field_t *field, void *base)
 {
     void *p = (byte *)base + field->ofs;
     int i;
@@ -705,7 +774,7 @@ static void read_field(FILE *f, const save_field_t *field, void *base)
     }
 }
 
-static void read_fields(FILE *f, const save_field_t *fields, void *base)
+static void read_fields(savebuf_t *f, const save_field_t *fields, void *base)
 {
     const save_field_t *field;
 
@@ -714,11 +783,460 @@ static void read_fields(FILE *f, const save_field_t *fields, void *base)
     }
 }
 
+//=========================================================
+//
+// Class entities are saved in one block per class, column by column. A
+// block holds the entity numbers of all its instances first, followed by
+// the values of one field for all instances, then the next field. Fields
+// are tagged with their name and type, and matched by name on load, so
+// fields added or removed since the save was made are simply skipped.
+//
+// Entity pointers are stored as entity numbers, and fixed up once all the
+// class entities have been allocated.
+//
+//=========================================================
+
+typedef struct {
+    void            *address;
+    int             number;
+    SaveFieldType   type;
+} pointer_fixup_t;
+
+typedef byte *(*column_address_t)(int number, const SaveField *field);
+
+static std::vector<pointer_fixup_t> pointerFixups;
+static std::vector<int32_t> columnScratch;
+
+// The hot fields, stored in the entity component arrays.
+#define _CF(name, type) { #name, type, (uint32_t)offsetof(EntityComponents, name) }
+static const SaveField componentfields[] = {
+    _CF(velocity, SaveFieldType::Vector3),
+    _CF(angularVelocity, SaveFieldType::Vector3),
+    _CF(moveType, SaveFieldType::Int32),
+    _CF(gravity, SaveFieldType::Float),
+    _CF(nextThinkTime, SaveFieldType::Float),
+    _CF(groundEntity, SaveFieldType::EntityPointer),
+    _CF(groundEntityLinkCount, SaveFieldType::Int32)
+};
+#undef _CF
+
+static size_t field_size(SaveFieldType type)
+{
+    switch (type) {
+    case SaveFieldType::Vector3:
+        return sizeof(vec3_t);
+    case SaveFieldType::EntityPointer:
+    case SaveFieldType::ServerEntity:
+        return sizeof(void *);
+    default:
+        return sizeof(int32_t);
+    }
+}
+
+static byte *class_field_address(int number, const SaveField *field)
+{
+    return (byte *)g_baseEntities[number] + field->offset;
+}
+
+static byte *component_field_address(int number, const SaveField *field)
+{
+    return (byte *)&g_entityComponents + field->offset + number * field_size(field->type);
+}
+
+// Returns the save fields of the class, and all of its superclasses.
+static void collect_save_fields(const TypeInfo *info, std::vector<const SaveField *> &fields)
+{
+    for (; info; info = info->super) {
+        for (uint32_t i = 0; i < info->numSaveFields; i++) {
+            fields.push_back(&info->saveFields[i]);
+        }
+    }
+}
+
+static int entity_number(void *p, SaveFieldType type)
+{
+    if (!p) {
+        return -1;
+    }
+
+    if (type == SaveFieldType::ServerEntity) {
+        return (Entity *)p - g_entities;
+    }
+
+    Entity *serverEntity = ((SVGBaseEntity *)p)->GetServerEntity();
+    return serverEntity ? serverEntity->state.number : -1;
+}
+
+static void write_column(savebuf_t *f, const SaveField *field, column_address_t address, const int *numbers, int count)
+{
+    int32_t *column;
+    byte *p;
+    int i, j;
+
+    if (field->type == SaveFieldType::String) {
+        // lengths first, then all characters in one go
+        columnScratch.resize(count);
+        column = columnScratch.data();
+        for (i = 0; i < count; i++) {
+            column[i] = (int32_t)LittleLong(((std::string *)address(numbers[i], field))->size());
+        }
+        write_data(column, count * sizeof(column[0]), f);
+
+        for (i = 0; i < count; i++) {
+            const std::string *s = (std::string *)address(numbers[i], field);
+            write_data((void *)s->data(), s->size(), f);
+        }
+        return;
+    }
+
+    int width = field->type == SaveFieldType::Vector3 ? 3 : 1;
+
+    columnScratch.resize(count * width);
+    column = columnScratch.data();
+
+    for (i = 0; i < count; i++) {
+        p = address(numbers[i], field);
+
+        switch (field->type) {
+        case SaveFieldType::Int32:
+        case SaveFieldType::Float:
+            memcpy(&column[i], p, sizeof(column[i]));
+            column[i] = (int32_t)LittleLong(column[i]);
+            break;
+        case SaveFieldType::Vector3:
+            for (j = 0; j < 3; j++) {
+                memcpy(&column[i * 3 + j], (float *)p + j, sizeof(column[0]));
+                column[i * 3 + j] = (int32_t)LittleLong(column[i * 3 + j]);
+            }
+            break;
+        case SaveFieldType::EntityPointer:
+        case SaveFieldType::ServerEntity:
+            column[i] = (int32_t)LittleLong(entity_number(*(void **)p, field->type));
+            break;
+        case SaveFieldType::Bool:
+            column[i] = (int32_t)LittleLong(*(bool *)p ? 1 : 0);
+            break;
+        default:
+            gi.Error("%s: unknown field type", __func__);
+        }
+    }
+
+    write_data(column, count * width * sizeof(column[0]), f);
+}
+
+// Reads a column written by write_column, a NULL address skips it.
+static void read_column(savebuf_t *f, SaveFieldType type, const SaveField *field, column_address_t address, const int *numbers, int count)
+{
+    int32_t *column;
+    byte *p;
+    int i, j;
+
+    if (type == SaveFieldType::String) {
+        size_t total = 0;
+
+        columnScratch.resize(count);
+        column = columnScratch.data();
+        read_data(column, count * sizeof(column[0]), f);
+
+        for (i = 0; i < count; i++) {
+            column[i] = (int32_t)LittleLong(column[i]);
+            if (column[i] < 0 || column[i] > 65536) {
+                gi.Error("%s: bad length", __func__);
+            }
+            total += column[i];
+        }
+
+        if (total > f->size - f->readcount) {
+            gi.Error("%s: couldn't read %" PRIz " bytes", __func__, total);
+        }
+
+        if (address) {
+            for (i = 0; i < count; i++) {
+                ((std::string *)address(numbers[i], field))->assign((const char *)f->data + f->readcount, column[i]);
+                f->readcount += column[i];
+            }
+        } else {
+            f->readcount += total;
+        }
+        return;
+    }
+
+    int width = type == SaveFieldType::Vector3 ? 3 : 1;
+
+    columnScratch.resize(count * width);
+    column = columnScratch.data();
+    read_data(column, count * width * sizeof(column[0]), f);
+
+    if (!address) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        p = address(numbers[i], field);
+
+        switch (type) {
+        case SaveFieldType::Int32:
+        case SaveFieldType::Float:
+            column[i] = (int32_t)LittleLong(column[i]);
+            memcpy(p, &column[i], sizeof(column[i]));
+            break;
+        case SaveFieldType::Vector3:
+            for (j = 0; j < 3; j++) {
+                column[i * 3 + j] = (int32_t)LittleLong(column[i * 3 + j]);
+                memcpy((float *)p + j, &column[i * 3 + j], sizeof(column[0]));
+            }
+            break;
+        case SaveFieldType::EntityPointer:
+        case SaveFieldType::ServerEntity:
+            pointerFixups.push_back({ p, (int32_t)LittleLong(column[i]), type });
+            break;
+        case SaveFieldType::Bool:
+            *(bool *)p = LittleLong(column[i]) != 0;
+            break;
+        default:
+            gi.Error("%s: unknown field type", __func__);
+        }
+    }
+}
+
+static void write_block(savebuf_t *f, const char *name, const std::vector<const SaveField *> &fields,
+                        column_address_t address, const int *numbers, int count)
+{
+    write_string(f, (char *)name);
+    write_int(f, count);
+    for (int i = 0; i < count; i++) {
+        write_int(f, numbers[i]);
+    }
+
+    write_int(f, fields.size());
+    for (const SaveField *field : fields) {
+        write_string(f, (char *)field->name);
+        write_int(f, (int)field->type);
+        write_column(f, field, address, numbers, count);
+    }
+}
+
+static void read_block_columns(savebuf_t *f, const std::vector<const SaveField *> &fields,
+                               column_address_t address, const int *numbers, int count)
+{
+    char name[MAX_QPATH];
+    int i, numFields;
+    SaveFieldType type;
+    const SaveField *match;
+
+    numFields = read_int(f);
+    for (i = 0; i < numFields; i++) {
+        read_zstring(f, name, sizeof(name));
+        type = (SaveFieldType)read_int(f);
+
+        match = nullptr;
+        for (const SaveField *field : fields) {
+            if (field->type == type && !strcmp(field->name, name)) {
+                match = field;
+                break;
+            }
+        }
+
+        if (type < SaveFieldType::Int32 || type > SaveFieldType::Bool) {
+            gi.Error("%s: bad field type for %s", __func__, name);
+        }
+
+        read_column(f, type, match, match ? address : nullptr, numbers, count);
+    }
+}
+
+// Client slots keep their class entities across level loads.
+static bool is_saved_class_entity(int number)
+{
+    return g_baseEntities[number] && g_entities[number].inUse &&
+        (number == 0 || number > game.maximumClients);
+}
+
+static void write_class_entities(savebuf_t *f, const int *numbers, int count)
+{
+    std::vector<const TypeInfo *> classes;
+    std::vector<int> instances;
+    std::vector<const SaveField *> fields;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        const TypeInfo *info = g_baseEntities[numbers[i]]->GetTypeInfo();
+        if (std::find(classes.begin(), classes.end(), info) == classes.end()) {
+            classes.push_back(info);
+        }
+    }
+
+    write_int(f, classes.size());
+    for (const TypeInfo *info : classes) {
+        instances.clear();
+        for (i = 0; i < count; i++) {
+            if (g_baseEntities[numbers[i]]->GetTypeInfo() == info) {
+                instances.push_back(numbers[i]);
+            }
+        }
+
+        fields.clear();
+        collect_save_fields(info, fields);
+        write_block(f, info->className, fields, class_field_address, instances.data(), instances.size());
+    }
+
+    fields.clear();
+    for (const SaveField &field : componentfields) {
+        fields.push_back(&field);
+    }
+    write_block(f, "EntityComponents", fields, component_field_address, numbers, count);
+}
+
+// Allocates the class entities and reads their fields. When allocate is false,
+// the fields are read back into the class entities that exist already.
+static void read_class_entities(savebuf_t *f, bool allocate)
+{
+    std::vector<const SaveField *> fields;
+    std::vector<int> numbers;
+    char name[MAX_QPATH];
+    TypeInfo *info;
+    Entity *ent;
+    int i, c, count, numClasses;
+
+    pointerFixups.clear();
+
+    numClasses = read_int(f);
+    for (c = 0; c <= numClasses; c++) {
+        read_zstring(f, name, sizeof(name));
+
+        count = read_int(f);
+        if (count < 0 || count > game.maxEntities) {
+            gi.Error("%s: bad instance count for %s", __func__, name);
+        }
+
+        numbers.resize(count);
+        for (i = 0; i < count; i++) {
+            numbers[i] = read_int(f);
+            if (numbers[i] < 0 || numbers[i] >= game.maxEntities) {
+                gi.Error("%s: bad entity number", __func__);
+            }
+        }
+
+        fields.clear();
+
+        // the last block holds the entity components
+        if (c == numClasses) {
+            for (const SaveField &field : componentfields) {
+                fields.push_back(&field);
+            }
+            read_block_columns(f, fields, component_field_address, numbers.data(), count);
+            break;
+        }
+
+        info = TypeInfo::GetInfoByName(name);
+        if (!info || !info->AllocateInstance) {
+            gi.Error("Savegame has unknown entity class %s", name);
+        }
+
+        for (i = 0; i < count; i++) {
+            ent = &g_entities[numbers[i]];
+
+            if (!allocate) {
+                if (!g_baseEntities[numbers[i]] || g_baseEntities[numbers[i]]->GetTypeInfo() != info) {
+                    gi.Error("%s: class entity mismatch", __func__);
+                }
+                continue;
+            }
+
+            if (g_baseEntities[numbers[i]]) {
+                gi.Error("%s: entity %i is already taken", __func__, numbers[i]);
+            }
+
+            g_baseEntities[numbers[i]] = ent->classEntity = info->AllocateInstance(ent);
+            ent->className = info->className;
+        }
+
+        collect_save_fields(info, fields);
+        read_block_columns(f, fields, class_field_address, numbers.data(), count);
+    }
+
+    for (const pointer_fixup_t &fixup : pointerFixups) {
+        if (fixup.number < -1 || fixup.number >= game.maxEntities) {
+            gi.Error("%s: bad entity pointer", __func__);
+        }
+
+        if (fixup.type == SaveFieldType::ServerEntity) {
+            *(Entity **)fixup.address = fixup.number == -1 ? nullptr : &g_entities[fixup.number];
+        } else {
+            *(SVGBaseEntity **)fixup.address = fixup.number == -1 ? nullptr : g_baseEntities[fixup.number];
+        }
+    }
+    pointerFixups.clear();
+}
+
+/*
+=================
+SVG_SaveBenchmark_f
+
+sv savebench [count] [iterations]
+
+Times writing and reading back the class entity section of a save, with the
+live class entities repeated up to count instances. The count is capped at
+maxEntities, the most instances a save can hold. Reading back restores
+the very same values, so the level is left as it was.
+=================
+*/
+void SVG_SaveBenchmark_f(void)
+{
+    using clock = std::chrono::steady_clock;
+    std::vector<int> live, numbers;
+    int i, count, iterations;
+    double saveTime = 0, loadTime = 0;
+    size_t size = 0;
+
+    count = gi.argc() > 2 ? atoi(gi.argv(2)) : game.maxEntities;
+    iterations = gi.argc() > 3 ? atoi(gi.argv(3)) : 10;
+    clamp(count, 1, game.maxEntities);
+    iterations = max(iterations, 1);
+
+    for (i = 0; i < globals.numberOfEntities; i++) {
+        if (is_saved_class_entity(i)) {
+            live.push_back(i);
+        }
+    }
+
+    if (live.empty()) {
+        gi.CPrintf(NULL, PRINT_HIGH, "No class entities to save.\n");
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        numbers.push_back(live[i % live.size()]);
+    }
+
+    for (i = 0; i < iterations; i++) {
+        savebuf_t buf, *f = &buf;
+
+        open_write_buf(f);
+
+        auto start = clock::now();
+        write_class_entities(f, numbers.data(), count);
+        auto middle = clock::now();
+        size = f->size;
+        f->readcount = 0;
+        read_class_entities(f, false);
+        auto end = clock::now();
+
+        gi.TagFree(f->data);
+
+        saveTime += std::chrono::duration<double, std::milli>(middle - start).count();
+        loadTime += std::chrono::duration<double, std::milli>(end - middle).count();
+    }
+
+    gi.CPrintf(NULL, PRINT_HIGH, "%i class entities (%i live), %" PRIz " bytes: save %.3f ms, load %.3f ms, average of %i runs\n",
+        count, (int)live.size(), size, saveTime / iterations, loadTime / iterations, iterations);
+}
+
 //=========================================================
 
 #define SAVE_MAGIC1     (('1'<<24)|('V'<<16)|('S'<<8)|'S')  // "SSV1"
 #define SAVE_MAGIC2     (('1'<<24)|('V'<<16)|('A'<<8)|'S')  // "SAV1"
-#define SAVE_VERSION    2
+#define SAVE_VERSION    3
 
 /*
 ============
@@ -736,15 +1254,13 @@ last save position.
 */
 void SVG_WriteGame(const char *filename, qboolean autosave)
 {
-    FILE    *f;
+    savebuf_t   buf, *f = &buf;
     int     i;
 
     if (!autosave)
         SVG_SaveClientData();
 
-    f = fopen(filename, "wb");
-    if (!f)
-        gi.Error("Couldn't open %s", filename);
+    open_write_buf(f);
 
     write_int(f, SAVE_MAGIC1);
     write_int(f, SAVE_VERSION);
@@ -757,29 +1273,27 @@ void SVG_WriteGame(const char *filename, qboolean autosave)
         write_fields(f, clientfields, &game.clients[i]);
     }
 
-    fclose(f);
+    close_write_buf(f, filename);
 }
 
 void SVG_ReadGame(const char *filename)
 {
-    FILE    *f;
+    savebuf_t   buf, *f = &buf;
     int     i;
 
     gi.FreeTags(TAG_GAME);
 
-    f = fopen(filename, "rb");
-    if (!f)
-        gi.Error("Couldn't open %s", filename);
+    open_read_buf(f, filename);
 
     i = read_int(f);
     if (i != SAVE_MAGIC1) {
-        fclose(f);
+        close_read_buf(f);
         gi.Error("Not a save game");
     }
 
     i = read_int(f);
     if (i != SAVE_VERSION) {
-        fclose(f);
+        close_read_buf(f);
         gi.Error("Savegame from an older version");
     }
 
@@ -787,11 +1301,11 @@ void SVG_ReadGame(const char *filename)
 
     // should agree with server's version
     if (game.maximumClients != (int)maximumClients->value) {
-        fclose(f);
+        close_read_buf(f);
         gi.Error("Savegame has bad maximumClients");
     }
     if (game.maxEntities <= game.maximumClients || game.maxEntities > MAX_EDICTS) {
-        fclose(f);
+        close_read_buf(f);
         gi.Error("Savegame has bad maxEntities");
     }
 
@@ -803,7 +1317,7 @@ void SVG_ReadGame(const char *filename)
         read_fields(f, clientfields, &game.clients[i]);
     }
 
-    fclose(f);
+    close_read_buf(f);
 }
 
 //==========================================================
@@ -819,11 +1333,9 @@ void SVG_WriteLevel(const char *filename)
 {
     int     i;
     Entity *ent;
-    FILE    *f;
+    savebuf_t   buf, *f = &buf;
 
-    f = fopen(filename, "wb");
-    if (!f)
-        gi.Error("Couldn't open %s", filename);
+    open_write_buf(f);
 
     write_int(f, SAVE_MAGIC2);
     write_int(f, SAVE_VERSION);
@@ -841,7 +1353,15 @@ void SVG_WriteLevel(const char *filename)
     }
     write_int(f, -1);
 
-    fclose(f);
+    // write out the class entities
+    std::vector<int> numbers;
+    for (i = 0; i < globals.numberOfEntities; i++) {
+        if (is_saved_class_entity(i))
+            numbers.push_back(i);
+    }
+    write_class_entities(f, numbers.data(), numbers.size());
+
+    close_write_buf(f, filename);
 }
 
 
@@ -864,7 +1384,7 @@ No clients are connected yet.
 void SVG_ReadLevel(const char *filename)
 {
     int     entnum;
-    FILE    *f;
+    savebuf_t   buf, *f = &buf;
     int     i;
     Entity *ent;
 
@@ -872,13 +1392,21 @@ void SVG_ReadLevel(const char *filename)
     // base state
     gi.FreeTags(TAG_LEVEL);
 
-    f = fopen(filename, "rb");
-    if (!f)
-        gi.Error("Couldn't open %s", filename);
+    open_read_buf(f, filename);
+
+    // Free the class entities spawned with the level, the client slots
+    // keep theirs.
+    for (i = 0; i < game.maxEntities; i++) {
+        if (g_baseEntities[i] && (i == 0 || i > game.maximumClients)) {
+            SVG_ClassEntityPool_Delete(g_baseEntities[i]);
+            g_baseEntities[i] = nullptr;
+        }
+    }
 
-    // Ensure all entities have a clean slate in memory.
+    // Ensure all entities, and their components, have a clean slate in memory.
     for (int32_t i = 0; i < game.maxEntities; i++) {
         g_entities[i] = {};
+        g_entityComponents.Reset(i);
     }
     //memset(g_entities, 0, game.maxEntities * sizeof(g_entities[0]));
 
@@ -887,13 +1415,13 @@ void SVG_ReadLevel(const char *filename)
 
     i = read_int(f);
     if (i != SAVE_MAGIC2) {
-        fclose(f);
+        close_read_buf(f);
         gi.Error("Not a save game");
     }
 
     i = read_int(f);
     if (i != SAVE_VERSION) {
-        fclose(f);
+        close_read_buf(f);
         gi.Error("Savegame from an older version");
     }
 
@@ -921,11 +1449,15 @@ void SVG_ReadLevel(const char *filename)
         gi.LinkEntity(ent);
     }
 
-    fclose(f);
+    // load the class entities
+    read_class_entities(f, true);
+
+    close_read_buf(f);
 
     // mark all clients as unconnected
     for (i = 0 ; i < maximumClients->value ; i++) {
         ent = &g_entities[i + 1];
+        ent->classEntity = g_baseEntities[i + 1];
         ent->client = game.clients + i;
         ent->client->persistent.isConnected = false;
     }
@@ -19,6 +19,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 
 #include "g_local.h"          // Include SVGame header.
 #include "entities.h"         // Entities.
+#include "ClassEntityPool.h"  // Class entity pools.
 #include "player/client.h"    // Include Player Client header.
 
 typedef struct {
@@ -422,21 +423,19 @@ void SVG_SpawnEntities(const char *mapName, const char *entities, const char *sp
     // Save client data.
     SVG_SaveClientData();
 
+    // Destruct all class entities, and release their pools wholesale.
+    SVG_ClassEntityPool_Reset();
+
     // Free level tag allocated data.
     gi.FreeTags(TAG_LEVEL);
 
     // Clear level state.
     level = {};
 
-    // Clear out entities.
+    // Clear out entities, and their components.
     for (int32_t i = 0; i < game.maxEntities; i++) {
-        // Delete class entities, if any.
-        if (g_baseEntities[i]) {
-            delete g_baseEntities[i];
-            g_baseEntities[i] = NULL;
-        }
-
         g_entities[i] = {};
+        g_entityComponents.Reset(i);
     }
 
     strncpy(level.mapName, mapName, sizeof(level.mapName) - 1);
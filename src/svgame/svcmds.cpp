@@ -17,6 +17,7 @@ with this program; if not, write to the Free Software Foundation, Inc.,
 */
 
 #include "g_local.h"
+#include "ClassEntityPool.h"
 
 
 void    Svcmd_Test_f(void)
@@ -287,6 +288,12 @@ void    SVG_ServerCommand(void)
         SVCmd_ListIP_f();
     else if (Q_stricmp(cmd, "writeip") == 0)
         SVCmd_WriteIP_f();
+    else if (Q_stricmp(cmd, "entitypools") == 0)
+        SVG_ClassEntityPool_PrintStats();
+    else if (Q_stricmp(cmd, "savebench") == 0)
+        SVG_SaveBenchmark_f();
+    else if (Q_stricmp(cmd, "pmovebench") == 0)
+        SVG_PMoveBenchmark_f();
     else
         gi.CPrintf(NULL, PRINT_HIGH, "Unknown server command \"%s\"\n", cmd);
 }